@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+
+# Plot the CSV of bench-scaling: wall time, peak RSS, and extents per second
+# over the number of files, with a line for each tool and file size (mean and
+# standard deviation over the runs).
+
+import csv
+import sys
+from collections import defaultdict
+
+import matplotlib
+import matplotlib.pyplot as plt
+import numpy as np
+
+matplotlib.rcParams['ps.useafm'] = True
+matplotlib.rcParams['pdf.use14corefonts'] = True
+
+text_font_size = 13
+label_font_size = 12
+axes_font_size = 12
+
+plt.rc('font', size=text_font_size)
+plt.rc('axes', labelsize=axes_font_size)
+plt.rc('xtick', labelsize=label_font_size)
+plt.rc('ytick', labelsize=label_font_size)
+plt.rc('legend', fontsize=label_font_size)
+
+metrics = [("wall_s", "runtime (seconds)"),
+           ("max_rss_kb", "peak RSS (KiB)"),
+           ("extents_per_s", "extents/second")]
+
+
+def load_runs(csv_file):
+    # runs[(tool, file_blocks, aging)][files][metric] = [values of the runs]
+    runs = defaultdict(lambda: defaultdict(lambda: defaultdict(list)))
+
+    with open(csv_file) as f:
+        for row in csv.DictReader(f):
+            key = (row["tool"], int(row["file_blocks"]), row["aging"])
+            for metric, _ in metrics:
+                runs[key][int(row["files"])][metric].append(float(row[metric]))
+
+    return runs
+
+
+def plot_scaling(csv_file, out_file):
+    runs = load_runs(csv_file)
+    fig, axes = plt.subplots(1, len(metrics), figsize=(5 * len(metrics), 4))
+
+    for ax, (metric, label) in zip(axes, metrics):
+        for (tool, blocks, aging), by_files in sorted(runs.items()):
+            files = sorted(by_files)
+            mean = [np.mean(by_files[n][metric]) for n in files]
+            std = [np.std(by_files[n][metric]) for n in files]
+            name = f"zns.{tool}, {blocks * 4}KiB files"
+            if aging != "0":
+                name += f", aged {aging}"
+            ax.errorbar(files, mean, yerr=std, marker='o', capsize=3,
+                        label=name)
+
+        ax.set_axisbelow(True)
+        ax.yaxis.grid(which='major', linestyle='dashed', linewidth='1')
+        ax.set_xscale("log")
+        ax.set_yscale("log")
+        ax.set_ylabel(label)
+        ax.set_xlabel("Number of files")
+
+    axes[0].legend()
+    fig.tight_layout()
+    plt.savefig(out_file, bbox_inches='tight')
+    plt.clf()
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(f"Usage: {sys.argv[0]} <scaling.csv> [output.pdf]")
+        sys.exit(1)
+
+    plot_scaling(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else "scaling.pdf")
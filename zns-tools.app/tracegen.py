@@ -6,6 +6,7 @@ import re
 import json
 import jsonpickle
 import glob
+import struct
 
 from util.timeline import Timeline
 from util.event import Event, MetaEvent
@@ -14,6 +15,14 @@ from util.helpers import *
 DIR = ""
 thread_ctr = 0
 
+# binary trace of zns.apptrace (see zns-tools.fs/bpf/apptrace.h)
+APPTRACE_FILE = "apptrace.bin"
+APPTRACE_HEADER = struct.Struct("<8sIIQQQ")
+APPTRACE_RECORD = struct.Struct("<QQIII36s")
+# event types of the records, named as the maps of the bpftrace probes
+APPTRACE_EVENTS = ["f2fs_submit_page_write", "f2fs_move_data", "vfs_open", "vfs_create",
+        "fcntl_set_rw_hint", "vfs_fsync", "vfs_rename", "vfs_unlink", "mm_do_writepages", "inodes"]
+
 watch_inodes = dict()
 tid_map = dict()
 timeline = Timeline()
@@ -46,6 +55,57 @@ def main(argv):
         print('Error missing directory. Usage: python3 tracegen.py -d [relative path to trace data directory]')
         sys.exit()
 
+def read_apptrace_header(file):
+    magic, version, record_size, zone_size, nr_records, dropped = APPTRACE_HEADER.unpack(file.read(APPTRACE_HEADER.size))
+    if magic != b"ZNSTRACE" or version != 1 or record_size != APPTRACE_RECORD.size:
+        print(f"{APPTRACE_FILE} is not a zns.apptrace trace of this version")
+        exit(1)
+
+    return zone_size, dropped
+
+def read_apptrace_records(file):
+    while True:
+        buf = file.read(APPTRACE_RECORD.size * 4096)
+        if not buf:
+            break
+        for record in APPTRACE_RECORD.iter_unpack(buf):
+            yield record
+
+def parse_apptrace_inodes(file):
+    read_apptrace_header(file)
+    for ts, ino, pid, tid, type, data in read_apptrace_records(file):
+        if APPTRACE_EVENTS[type] == "inodes":
+            watch_inodes[str(ino)] = data.split(b"\0", 1)[0].decode(errors="replace")
+
+def parse_apptrace_data(file):
+    zone_size, dropped = read_apptrace_header(file)
+    if dropped > 0:
+        print(f"Warning: zns.apptrace dropped {dropped} events, increase its ring buffer size with -b")
+    for ts, ino, pid, tid, type, data in read_apptrace_records(file):
+        args = dict()
+        name = APPTRACE_EVENTS[type]
+        inode = str(ino)
+
+        if name == "inodes" or inode not in watch_inodes.keys():
+            continue
+
+        args["inode"] = inode
+        if name == "fcntl_set_rw_hint":
+            args["rw_hint"] = get_hint(struct.unpack_from("<I", data)[0])
+        elif name == "f2fs_submit_page_write":
+            blkaddr, temp, page_type = struct.unpack_from("<IBB", data)
+            args["LBA"] = blkaddr
+            # zone size is in 512B sectors, F2FS blocks are 4KiB
+            args["zone"] = blkaddr * 8 // zone_size if zone_size else 0
+            args["temp"] = get_temp(temp)
+            args["type"] = get_type(page_type)
+
+        args["file"] = watch_inodes[inode]
+
+        event = Event(name, ts, "i", pid, tid, args, tid_map)
+
+        timeline.addTimestamp(event)
+
 def parse_f2fs_and_vfs_probe_data(file):
     for line in file:
         data = json.loads(line)
@@ -212,8 +272,14 @@ if __name__ == "__main__":
     main(sys.argv[1:])
     file_path = '/'.join(os.path.abspath(__file__).split('/')[:-1])
 
-    with open(f"{file_path}/{DIR}/inodes.json") as file:
-        parse_inodes(file)
+    if os.path.exists(f"{file_path}/{DIR}/inodes.json"):
+        with open(f"{file_path}/{DIR}/inodes.json") as file:
+            parse_inodes(file)
+
+    # zns.apptrace records file names in the same trace as the events
+    if os.path.exists(f"{file_path}/{DIR}/{APPTRACE_FILE}"):
+        with open(f"{file_path}/{DIR}/{APPTRACE_FILE}", "rb") as file:
+            parse_apptrace_inodes(file)
 
     init_tid_map(tid_map)
     set_metadata_events()
@@ -229,6 +295,11 @@ if __name__ == "__main__":
         if 'inodes' in file_name:
             continue
 
+        if file_name == APPTRACE_FILE:
+            with open(file, "rb") as file:
+                parse_apptrace_data(file)
+            continue
+
         with open(f"{file_path}/{DIR}/{file_name}") as file:
             if 'f2fs' in file_name or 'vfs' in file_name or 'mm' in file_name:
                 parse_f2fs_and_vfs_probe_data(file)
@@ -0,0 +1,364 @@
+#include "age.h"
+
+static char *dir = NULL;
+static uint32_t nr_files = AGE_NR_FILES;
+static uint64_t nr_ops = AGE_NR_OPS;
+static uint32_t max_append = AGE_MAX_APPEND;
+static uint32_t overwrite_pct = AGE_OVERWRITE_PCT;
+static uint32_t delete_pct = AGE_DELETE_PCT;
+static uint32_t hot_pct = AGE_HOT_PCT;
+static uint32_t cold_pct = AGE_COLD_PCT;
+static uint32_t fill_pct = AGE_FILL_PCT;
+static uint64_t gc_interval = 0;
+static uint64_t seed = AGE_SEED;
+static uint8_t o_direct = 0;
+
+static struct age_file *files;
+static uint64_t live_blocks = 0; /* blocks of all existing files */
+static uint64_t max_blocks = 0;  /* limit of live_blocks, from fill_pct */
+static uint64_t op_ctr[AGE_NR_OPS_TYPES];
+static char *buf;
+
+static const char *const op_names[AGE_NR_OPS_TYPES] = {
+    [AGE_OP_APPEND] = "append",
+    [AGE_OP_OVERWRITE] = "overwrite",
+    [AGE_OP_DELETE] = "delete",
+    [AGE_OP_GC] = "gc",
+};
+
+/*
+ *
+ * Show the command help.
+ *
+ *
+ * */
+static void show_help() {
+    MSG("Possible flags are:\n");
+    MSG("-d [dir]\tDirectory on the F2FS mount to age [Required]\n");
+    MSG("-f [uint]\tFiles written concurrently. Default %u\n", AGE_NR_FILES);
+    MSG("-n [uint]\tNumber of operations. Default %u\n", AGE_NR_OPS);
+    MSG("-a [uint]\tMaximum blocks of an append. Default %u\n",
+        AGE_MAX_APPEND);
+    MSG("-w [0-100]\tPercent of overwrites of a random block. Default %u\n",
+        AGE_OVERWRITE_PCT);
+    MSG("-u [0-100]\tPercent of file deletes. Default %u\n", AGE_DELETE_PCT);
+    MSG("-H [0-100]\tPercent of files with a short (hot) write hint. "
+        "Default %u\n",
+        AGE_HOT_PCT);
+    MSG("-C [0-100]\tPercent of files with an extreme (cold) write hint. "
+        "Default %u\n",
+        AGE_COLD_PCT);
+    MSG("-F [1-100]\tLive data in percent of the fs size, files are deleted "
+        "above it.\n\t\tDefault %u\n",
+        AGE_FILL_PCT);
+    MSG("-g [uint]\tRun F2FS_IOC_GARBAGE_COLLECT every n operations. "
+        "Default off\n");
+    MSG("-s [uint]\tSeed of the random operations. Default %u\n", AGE_SEED);
+    MSG("-D\t\tWrite with O_DIRECT, instead of O_DSYNC buffered writes\n");
+    MSG("-h\t\tShow this help\n");
+
+    exit(0);
+}
+
+/* xorshift, such that the same seed ages the file system in the same way */
+static uint64_t next_random() {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+
+    return seed;
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void get_file_path(char *path, size_t len, uint32_t id) {
+    snprintf(path, len, "%s/age.%u.%u", dir, id, files[id].gen);
+}
+
+/*
+ * Open a file of the aging run for writing, creating it if it was deleted.
+ * Writes are synchronous (or direct), such that they reach F2FS in the order
+ * they are issued, instead of being written back one file after another.
+ *
+ * @id: index of the file
+ *
+ * returns: file descriptor of the file
+ *
+ * */
+static int open_file(uint32_t id) {
+    char path[PATH_MAX];
+    uint64_t hint = files[id].hint;
+    int fd;
+
+    get_file_path(path, sizeof(path), id);
+
+    fd = open(path, O_WRONLY | O_CREAT | (o_direct ? O_DIRECT : O_DSYNC),
+              0644);
+    if (fd < 0) {
+        ERR_MSG("Failed opening %s\n", path);
+    }
+
+    /* F2FS places data of files with short and extreme hints in the hot and
+     * cold data logs */
+    if (hint && fcntl(fd, F_SET_RW_HINT, &hint) < 0) {
+        WARN("Failed setting write hint on %s, disabling hints\n", path);
+        hot_pct = cold_pct = 0;
+        for (uint32_t i = 0; i < nr_files; i++) {
+            files[i].hint = 0;
+        }
+    }
+
+    files[id].exists = 1;
+
+    return fd;
+}
+
+static void write_blocks(uint32_t id, uint64_t block, uint32_t nr_blocks) {
+    int fd = open_file(id);
+
+    if (pwrite(fd, buf, (size_t)nr_blocks * AGE_BLOCK_SIZE,
+               block * AGE_BLOCK_SIZE) < 0) {
+        ERR_MSG("Failed writing file %u: %s\n", id, strerror(errno));
+    }
+
+    close(fd);
+}
+
+static void append_file(uint32_t id) {
+    uint32_t nr_blocks = 1 + next_random() % max_append;
+
+    write_blocks(id, files[id].blocks, nr_blocks);
+
+    files[id].blocks += nr_blocks;
+    live_blocks += nr_blocks;
+    op_ctr[AGE_OP_APPEND]++;
+}
+
+static void overwrite_file(uint32_t id) {
+    write_blocks(id, next_random() % files[id].blocks, 1);
+
+    op_ctr[AGE_OP_OVERWRITE]++;
+}
+
+static void delete_file(uint32_t id) {
+    char path[PATH_MAX];
+
+    get_file_path(path, sizeof(path), id);
+    if (unlink(path) < 0) {
+        ERR_MSG("Failed deleting %s\n", path);
+    }
+
+    live_blocks -= files[id].blocks;
+    files[id].blocks = 0;
+    files[id].exists = 0;
+    files[id].gen++;
+    op_ctr[AGE_OP_DELETE]++;
+}
+
+/*
+ * Run a pass of F2FS garbage collection, which migrates the valid blocks of a
+ * victim section and further interleaves the files.
+ *
+ * @dir_fd: descriptor of the aged directory
+ *
+ * */
+static void collect_garbage(int dir_fd) {
+    __u32 sync = 1;
+
+    if (ioctl(dir_fd, F2FS_IOC_GARBAGE_COLLECT, &sync) < 0) {
+        /* EAGAIN if there is no victim section */
+        if (errno != EAGAIN) {
+            WARN("F2FS_IOC_GARBAGE_COLLECT failed: %s, disabling GC\n",
+                 strerror(errno));
+            gc_interval = 0;
+        }
+        return;
+    }
+
+    op_ctr[AGE_OP_GC]++;
+}
+
+/*
+ * Issue the next operation on a random file. Deleted and empty files can
+ * only be appended to, and above the fill limit files are deleted instead.
+ *
+ * */
+static void run_op() {
+    uint32_t id = next_random() % nr_files;
+    uint32_t pct = next_random() % 100;
+
+    if (live_blocks >= max_blocks) {
+        /* find an existing file to delete, there are many above the limit */
+        while (!files[id].exists || files[id].blocks == 0) {
+            id = next_random() % nr_files;
+        }
+        delete_file(id);
+    } else if (!files[id].exists || files[id].blocks == 0) {
+        append_file(id);
+    } else if (pct < delete_pct) {
+        delete_file(id);
+    } else if (pct < delete_pct + overwrite_pct) {
+        overwrite_file(id);
+    } else {
+        append_file(id);
+    }
+}
+
+static void init_files() {
+    struct statfs s;
+    uint32_t pct;
+
+    if (statfs(dir, &s) < 0) {
+        ERR_MSG("Failed statfs on %s\n", dir);
+    }
+    if (s.f_type != F2FS_MAGIC) {
+        WARN("%s is not on F2FS, GC and write hints may be ignored\n", dir);
+    }
+
+    max_blocks = (uint64_t)s.f_blocks * s.f_bsize / 100 * fill_pct /
+                 AGE_BLOCK_SIZE;
+    if (max_blocks < max_append) {
+        ERR_MSG("File system of %s is too small to age\n", dir);
+    }
+
+    files = calloc(nr_files, sizeof(struct age_file));
+    if (!files) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint32_t i = 0; i < nr_files; i++) {
+        pct = next_random() % 100;
+        if (pct < hot_pct) {
+            files[i].hint = RWH_WRITE_LIFE_SHORT;
+        } else if (pct < hot_pct + cold_pct) {
+            files[i].hint = RWH_WRITE_LIFE_EXTREME;
+        }
+    }
+
+    /* direct I/O needs aligned buffers, the data is random such that it
+     * is not compressed */
+    buf = aligned_alloc(AGE_BLOCK_SIZE, (size_t)max_append * AGE_BLOCK_SIZE);
+    if (!buf) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    for (size_t i = 0; i < (size_t)max_append * AGE_BLOCK_SIZE; i++) {
+        buf[i] = next_random();
+    }
+}
+
+static void show_summary(uint64_t elapsed_ns) {
+    uint32_t live_files = 0;
+
+    for (uint32_t i = 0; i < nr_files; i++) {
+        live_files += files[i].exists;
+    }
+
+    MSG("\n%lu operations in %.2fs (%.0f ops/s)\n", nr_ops, elapsed_ns / 1e9,
+        nr_ops / (elapsed_ns / 1e9));
+    for (uint8_t i = 0; i < AGE_NR_OPS_TYPES; i++) {
+        MSG("%-10s %12lu\n", op_names[i], op_ctr[i]);
+    }
+    MSG("Live files: %u  Live data: %lu MiB (limit %lu MiB)\n", live_files,
+        (live_blocks * AGE_BLOCK_SIZE) >> 20,
+        (max_blocks * AGE_BLOCK_SIZE) >> 20);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t start;
+    int c, dir_fd;
+
+    while ((c = getopt(argc, argv, "a:C:d:Df:F:g:hH:n:s:u:w:")) != -1) {
+        switch (c) {
+        case 'a':
+            max_append = atoi(optarg);
+            break;
+        case 'C':
+            cold_pct = atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        case 'D':
+            o_direct = 1;
+            break;
+        case 'f':
+            nr_files = atoi(optarg);
+            break;
+        case 'F':
+            fill_pct = atoi(optarg);
+            break;
+        case 'g':
+            gc_interval = strtoull(optarg, NULL, 0);
+            break;
+        case 'H':
+            hot_pct = atoi(optarg);
+            break;
+        case 'n':
+            nr_ops = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'u':
+            delete_pct = atoi(optarg);
+            break;
+        case 'w':
+            overwrite_pct = atoi(optarg);
+            break;
+        case 'h':
+        default:
+            show_help();
+            break;
+        }
+    }
+
+    if (!dir) {
+        ERR_MSG("Missing directory to age, set with -d\n");
+    }
+    if (nr_files == 0 || max_append == 0 || seed == 0) {
+        ERR_MSG("Files, append size, and seed must be larger than 0\n");
+    }
+    if (overwrite_pct + delete_pct > 100 || hot_pct + cold_pct > 100 ||
+        fill_pct == 0 || fill_pct > 100) {
+        ERR_MSG("Invalid percentages, see -h\n");
+    }
+
+    dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0) {
+        ERR_MSG("Failed opening dir %s\n", dir);
+    }
+
+    MSG("Aging %s with %lu operations on %u files, seed %lu\n", dir, nr_ops,
+        nr_files, seed);
+
+    init_files();
+
+    start = now_ns();
+    for (uint64_t op = 1; op <= nr_ops; op++) {
+        run_op();
+
+        if (gc_interval && op % gc_interval == 0) {
+            collect_garbage(dir_fd);
+        }
+
+        if (nr_ops >= 10 && op % (nr_ops / 10) == 0) {
+            MSG("%3lu%%  live data %lu MiB\n", op * 100 / nr_ops,
+                (live_blocks * AGE_BLOCK_SIZE) >> 20);
+        }
+    }
+
+    syncfs(dir_fd);
+    show_summary(now_ns() - start);
+
+    close(dir_fd);
+    free(buf);
+    free(files);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+#ifndef _AGE_H_
+#define _AGE_H_
+
+#define _GNU_SOURCE /* O_DIRECT and syncfs() */
+
+#include "zns-tools.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+
+#ifndef F2FS_IOC_GARBAGE_COLLECT
+#define F2FS_IOCTL_MAGIC 0xf5
+#define F2FS_IOC_GARBAGE_COLLECT _IOW(F2FS_IOCTL_MAGIC, 6, __u32)
+#endif
+
+#ifndef F_SET_RW_HINT
+#define F_LINUX_SPECIFIC_BASE 1024
+#define F_SET_RW_HINT (F_LINUX_SPECIFIC_BASE + 12)
+#define RWH_WRITE_LIFE_SHORT 2
+#define RWH_WRITE_LIFE_MEDIUM 3
+#define RWH_WRITE_LIFE_EXTREME 5
+#endif
+
+#define AGE_NR_FILES 10000  /* default files written concurrently */
+#define AGE_NR_OPS 1000000  /* default write, overwrite, and delete ops */
+#define AGE_BLOCK_SIZE 4096 /* size of all writes */
+#define AGE_MAX_APPEND 1    /* default max blocks of an append */
+#define AGE_OVERWRITE_PCT 20
+#define AGE_DELETE_PCT 2
+#define AGE_HOT_PCT 20  /* default files with a short write hint */
+#define AGE_COLD_PCT 20 /* default files with an extreme write hint */
+#define AGE_FILL_PCT 70 /* default live data, in percent of the fs size */
+#define AGE_SEED 42
+
+/*
+ * Operations of the aging run, each one is issued on a random file. Appends
+ * of different files are interleaved, such that F2FS places them next to each
+ * other in its logs and the files end up with many small extents.
+ *
+ * */
+enum age_op {
+    AGE_OP_APPEND = 0, /* append 1 to max_append blocks to the file */
+    AGE_OP_OVERWRITE,  /* overwrite a random block of the file */
+    AGE_OP_DELETE,     /* delete the file, it is recreated by the next append */
+    AGE_OP_GC,         /* F2FS_IOC_GARBAGE_COLLECT */
+    AGE_NR_OPS_TYPES
+};
+
+/* state of a file of the aging run */
+struct age_file {
+    uint64_t blocks; /* blocks written to the file */
+    uint32_t gen;    /* generation, incremented by each delete */
+    uint8_t hint;    /* RWH_WRITE_LIFE_* hint of the file */
+    uint8_t exists;  /* flag if the file exists */
+};
+
+#endif
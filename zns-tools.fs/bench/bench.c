@@ -0,0 +1,486 @@
+#include "bench.h"
+
+/*
+ * Allocations are counted by replacing the allocator of the process, the
+ * library calls resolve to these instead of the ones of glibc.
+ *
+ * */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void __libc_free(void *);
+
+static struct bench_allocs allocs;
+
+static void count_alloc(size_t size) {
+    __atomic_fetch_add(&allocs.ctr, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&allocs.bytes, size, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size) {
+    count_alloc(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    count_alloc(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    count_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) { __libc_free(ptr); }
+
+static uint64_t nr_extents = BENCH_NR_EXTENTS;
+static uint32_t nr_zones = BENCH_NR_ZONES;
+static uint32_t nr_reps = BENCH_REPS;
+static uint32_t nr_threads = 1;
+static char *only_stream = NULL;
+static char *only_bench = NULL;
+
+static const char *const stream_names[STREAM_NR_TYPES] = {
+    [STREAM_SORTED] = "sorted",
+    [STREAM_RANDOM] = "random",
+    [STREAM_SMALL] = "small-files",
+    [STREAM_HUGE] = "huge-files",
+};
+
+/*
+ *
+ * Show the command help.
+ *
+ *
+ * */
+static void show_help() {
+    MSG("Possible flags are:\n");
+    MSG("-n [uint]\tExtents of each stream. Default %u\n", BENCH_NR_EXTENTS);
+    MSG("-z [uint]\tZones of the synthetic device. Default %u\n",
+        BENCH_NR_ZONES);
+    MSG("-r [uint]\tRepetitions of each benchmark. Default %u\n", BENCH_REPS);
+    MSG("-t [uint]\tThreads to render the reports with. Default 1\n");
+    MSG("-s [name]\tOnly run the stream (sorted, random, small-files, "
+        "huge-files)\n");
+    MSG("-b [name]\tOnly run the benchmark (e.g., print_fiemap_report)\n");
+    MSG("-h\t\tShow this help\n");
+
+    exit(0);
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* xorshift, such that the random stream is the same in every run */
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+/*
+ * Allocate a control with the zonemap of a synthetic F2FS ZNS device, full
+ * zones of BENCH_ZONE_SIZE sectors, such that no device is needed.
+ *
+ * returns: struct control * to be freed with cleanup_ctrl()
+ *
+ * */
+static struct control *init_bench_ctrl() {
+    struct control *ctrl;
+    struct bdev *znsdev;
+    struct zone *zone;
+
+    ctrl = alloc_ctrl();
+    ctrl->argv = "zns-tools-bench";
+    ctrl->fs_magic = F2FS_MAGIC;
+    ctrl->sector_size = 512;
+    ctrl->sector_shift = 9;
+    ctrl->zns_sector_shift = 0;
+    ctrl->segment_shift = 12;
+    ctrl->f2fs_segment_sectors = 1 << ctrl->segment_shift;
+    ctrl->f2fs_segment_mask = ~(ctrl->f2fs_segment_sectors - 1);
+    ctrl->nr_threads = nr_threads;
+    ctrl->json_file = "/dev/null";
+    ctrl->start_zone = 1;
+    ctrl->end_zone = nr_zones;
+
+    ctrl->nr_znsdevs = 1;
+    znsdev = &ctrl->znsdev[0];
+    strcpy(znsdev->dev_name, "nullb0");
+    strcpy(znsdev->dev_path, "/dev/nullb0");
+    znsdev->is_zoned = 1;
+    znsdev->nr_zones = nr_zones;
+    znsdev->zone_size = BENCH_ZONE_SIZE;
+    znsdev->zone_mask = ~(BENCH_ZONE_SIZE - 1);
+
+    ctrl->zonemap =
+        calloc(1, sizeof(struct zone_map) + sizeof(struct zone) * nr_zones);
+    if (!ctrl->zonemap) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    ctrl->zonemap->nr_zones = nr_zones;
+
+    for (uint32_t i = 0; i < nr_zones; i++) {
+        zone = &ctrl->zonemap->zones[i];
+        zone->zone_number = i;
+        zone->start = (uint64_t)i * BENCH_ZONE_SIZE;
+        zone->capacity = BENCH_ZONE_SIZE;
+        zone->end = zone->start + zone->capacity;
+        zone->wp = zone->end;
+        zone->state = BLK_ZONE_COND_FULL << 4;
+        zone->mask = znsdev->zone_mask;
+    }
+
+    return ctrl;
+}
+
+/*
+ * Set an extent of a stream, with the zone info as get_extents() sets it.
+ *
+ * @extent: extent to set
+ * @slot: slot of the extent on the device, slots are BENCH_EXT_STRIDE apart
+ * @ext_nr: number of the extent in its file
+ * @file: number of the file the extent belongs to
+ *
+ * */
+static void set_stream_extent(struct control *ctrl, struct extent *extent,
+                              uint64_t slot, uint32_t ext_nr, uint32_t file) {
+    struct zone *zone;
+
+    memset(extent, 0, sizeof(struct extent));
+    extent->phy_blk = slot * BENCH_EXT_STRIDE;
+    extent->logical_blk = (uint64_t)ext_nr * BENCH_EXT_LEN;
+    extent->len = BENCH_EXT_LEN;
+    extent->ext_nr = ext_nr;
+    extent->zone =
+        get_zone_number(ctrl, extent->phy_blk << ctrl->zns_sector_shift);
+
+    zone = &ctrl->zonemap->zones[extent->zone];
+    extent->zone_size = BENCH_ZONE_SIZE;
+    extent->zone_lbas = zone->start;
+    extent->zone_cap = zone->capacity;
+    extent->zone_wp = zone->wp;
+    extent->zone_lbae = zone->start + zone->capacity;
+
+    snprintf(extent->file, sizeof(extent->file), "/mnt/f2fs/bench/file-%u",
+             file);
+}
+
+/*
+ * Generate the extents of a stream. Extents are spread over all zones of the
+ * device, the slots of the extents only differ in their order.
+ *
+ * @stream: stream to generate
+ * @type: enum bench_stream_type of the stream
+ *
+ * */
+static void init_stream(struct control *ctrl, struct bench_stream *stream,
+                        enum bench_stream_type type) {
+    uint64_t nr_slots = (uint64_t)nr_zones * BENCH_ZONE_SIZE / BENCH_EXT_STRIDE;
+    uint64_t spread = nr_slots / nr_extents;
+    uint64_t *slots, tmp, j, seed = 0x5A4E53;
+    uint64_t per_file, ext = 0;
+
+    if (spread == 0) {
+        ERR_MSG("%lu extents do not fit into %u zones\n", nr_extents,
+                nr_zones);
+    }
+
+    stream->name = stream_names[type];
+    stream->nr_extents = nr_extents;
+    stream->extents = calloc(nr_extents, sizeof(struct extent));
+    slots = malloc(sizeof(uint64_t) * nr_extents);
+    if (!stream->extents || !slots) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint64_t i = 0; i < nr_extents; i++) {
+        slots[i] = i * spread;
+    }
+
+    switch (type) {
+    case STREAM_SORTED:
+    case STREAM_RANDOM:
+        stream->nr_files = 1;
+        break;
+    case STREAM_SMALL:
+        stream->nr_files =
+            (nr_extents + BENCH_SMALL_FILE_EXTENTS - 1) /
+            BENCH_SMALL_FILE_EXTENTS;
+        break;
+    case STREAM_HUGE:
+        stream->nr_files = BENCH_HUGE_FILES;
+        break;
+    default:
+        break;
+    }
+
+    if (type == STREAM_RANDOM) {
+        for (uint64_t i = nr_extents - 1; i > 0; i--) {
+            j = next_random(&seed) % (i + 1);
+            tmp = slots[i];
+            slots[i] = slots[j];
+            slots[j] = tmp;
+        }
+    }
+
+    stream->file_ext_ctr = calloc(stream->nr_files, sizeof(uint32_t));
+    if (!stream->file_ext_ctr) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    per_file = (nr_extents + stream->nr_files - 1) / stream->nr_files;
+    for (uint32_t file = 0; file < stream->nr_files; file++) {
+        for (uint32_t nr = 0; nr < per_file && ext < nr_extents; nr++) {
+            /* files written concurrently interleave their extents */
+            if (type == STREAM_HUGE) {
+                j = (uint64_t)nr * stream->nr_files + file;
+                if (j >= nr_extents) {
+                    break;
+                }
+            } else {
+                j = ext;
+            }
+
+            set_stream_extent(ctrl, &stream->extents[ext], slots[j], nr,
+                              file);
+            stream->file_ext_ctr[file]++;
+            ext++;
+        }
+    }
+
+    stream->nr_extents = ext;
+
+    free(slots);
+}
+
+static void cleanup_stream(struct bench_stream *stream) {
+    free(stream->extents);
+    free(stream->file_ext_ctr);
+}
+
+static void load_stream(struct control *ctrl, struct bench_stream *stream) {
+    struct extent *extents = stream->extents;
+
+    for (uint32_t i = 0; i < stream->nr_files; i++) {
+        load_file_extents(ctrl, extents, stream->file_ext_ctr[i]);
+        extents += stream->file_ext_ctr[i];
+    }
+}
+
+static void bench_start(uint64_t *start) {
+    memset(&allocs, 0, sizeof(struct bench_allocs));
+    *start = now_ns();
+}
+
+static void bench_stop(struct bench_result *result, uint64_t start) {
+    uint64_t elapsed = now_ns() - start;
+
+    if (result->best_ns == 0 || elapsed < result->best_ns) {
+        result->best_ns = elapsed;
+    }
+    result->total_ns += elapsed;
+    result->alloc_ctr += allocs.ctr;
+    result->alloc_size += allocs.bytes;
+}
+
+static int skip_bench(const char *name) {
+    return only_bench && strcmp(only_bench, name) != 0;
+}
+
+static void print_result(const char *name, struct bench_stream *stream,
+                         struct bench_result *result) {
+    double ops = (double)result->ops;
+
+    if (skip_bench(name)) {
+        return;
+    }
+
+    MSG("%-30s %-12s %10lu %10.1f %10.1f %12.2f %12.1f\n", name, stream->name,
+        result->ops, (double)result->best_ns / ops,
+        (double)result->total_ns / ops / nr_reps,
+        (double)result->alloc_ctr / ops / nr_reps,
+        (double)result->alloc_size / ops / nr_reps);
+}
+
+/*
+ * Add the extents of a stream with only one of the two steps of
+ * load_file_extents(), on a control of its own, such that the cost of the
+ * sorted zone lists and of the file lookups are measured separately.
+ *
+ * @stream: stream to add
+ * @name: benchmark name of the step
+ * @result: struct bench_result * to add the time of the step to
+ *
+ * */
+static void bench_load_step(struct bench_stream *stream, const char *name,
+                            struct bench_result *result) {
+    struct control *ctrl;
+    uint64_t start;
+    int zone_list = strcmp(name, "add_extent_to_zone_list") == 0;
+
+    if (skip_bench(name)) {
+        return;
+    }
+
+    ctrl = init_bench_ctrl();
+
+    bench_start(&start);
+    for (uint64_t i = 0; i < stream->nr_extents; i++) {
+        if (zone_list) {
+            add_extent_to_zone_list(ctrl, stream->extents[i]);
+        } else {
+            increase_file_extent_counter(ctrl, stream->extents[i].file);
+        }
+    }
+    bench_stop(result, start);
+
+    cleanup_ctrl(ctrl);
+}
+
+/*
+ * Run the benchmarks of a stream. Extent insertion goes through
+ * load_file_extents(), which adds each extent with add_extent_to_zone_list()
+ * and increase_file_extent_counter(), the two are also run on their own. The
+ * reports render the zonemap of the stream into /dev/null.
+ *
+ * @stream: stream to run the benchmarks with
+ *
+ * */
+static void run_stream(struct bench_stream *stream) {
+    struct bench_result load, zone_list, file_ctr, zone, report, json;
+    struct control *ctrl;
+    uint64_t start, sink = 0;
+    int fd;
+
+    memset(&load, 0, sizeof(struct bench_result));
+    memset(&zone_list, 0, sizeof(struct bench_result));
+    memset(&file_ctr, 0, sizeof(struct bench_result));
+    memset(&zone, 0, sizeof(struct bench_result));
+    memset(&report, 0, sizeof(struct bench_result));
+    memset(&json, 0, sizeof(struct bench_result));
+    load.ops = zone_list.ops = file_ctr.ops = zone.ops = report.ops =
+        json.ops = stream->nr_extents;
+
+    fd = open("/dev/null", O_WRONLY);
+    if (fd < 0) {
+        ERR_MSG("Failed opening /dev/null\n");
+    }
+
+    for (uint32_t rep = 0; rep < nr_reps; rep++) {
+        bench_load_step(stream, "add_extent_to_zone_list", &zone_list);
+        bench_load_step(stream, "increase_file_extent_counter", &file_ctr);
+
+        ctrl = init_bench_ctrl();
+
+        bench_start(&start);
+        load_stream(ctrl, stream);
+        bench_stop(&load, start);
+
+        if (!skip_bench("get_zone_number")) {
+            bench_start(&start);
+            for (uint64_t i = 0; i < stream->nr_extents; i++) {
+                sink += get_zone_number(ctrl, stream->extents[i].phy_blk);
+            }
+            bench_stop(&zone, start);
+        }
+
+        if (!skip_bench("print_fiemap_report")) {
+            rep_set_fd(fd);
+            bench_start(&start);
+            print_fiemap_report(ctrl);
+            bench_stop(&report, start);
+            rep_set_fd(-1);
+        }
+
+        if (!skip_bench("json_dump_data")) {
+            bench_start(&start);
+            json_dump_data(ctrl);
+            bench_stop(&json, start);
+        }
+
+        cleanup_ctrl(ctrl);
+    }
+
+    close(fd);
+
+    /* keep the zone number loop from being optimized away */
+    if (sink == UINT64_MAX) {
+        MSG("\n");
+    }
+
+    print_result("load_file_extents", stream, &load);
+    print_result("add_extent_to_zone_list", stream, &zone_list);
+    print_result("increase_file_extent_counter", stream, &file_ctr);
+    print_result("get_zone_number", stream, &zone);
+    print_result("print_fiemap_report", stream, &report);
+    print_result("json_dump_data", stream, &json);
+}
+
+int main(int argc, char *argv[]) {
+    struct bench_stream stream;
+    struct control *ctrl;
+    int c;
+
+    while ((c = getopt(argc, argv, "b:hn:r:s:t:z:")) != -1) {
+        switch (c) {
+        case 'b':
+            only_bench = optarg;
+            break;
+        case 'n':
+            nr_extents = strtoull(optarg, NULL, 0);
+            break;
+        case 'r':
+            nr_reps = atoi(optarg);
+            break;
+        case 's':
+            only_stream = optarg;
+            break;
+        case 't':
+            nr_threads = atoi(optarg);
+            break;
+        case 'z':
+            nr_zones = atoi(optarg);
+            break;
+        case 'h':
+        default:
+            show_help();
+            break;
+        }
+    }
+
+    if (nr_extents == 0 || nr_zones == 0 || nr_reps == 0) {
+        ERR_MSG("Extents, zones, and repetitions must be larger than 0\n");
+    }
+
+    MSG("%lu extents, %u zones, best (BEST) and mean (MEAN) of %u runs, "
+        "%u render threads\n\n",
+        nr_extents, nr_zones, nr_reps, nr_threads);
+    MSG("%-30s %-12s %10s %10s %10s %12s %12s\n", "BENCHMARK", "STREAM", "OPS",
+        "BEST NS/OP", "MEAN NS/OP", "ALLOCS/OP", "BYTES/OP");
+
+    /* streams take the zones of the extents from the synthetic device */
+    ctrl = init_bench_ctrl();
+
+    for (uint32_t type = 0; type < STREAM_NR_TYPES; type++) {
+        if (only_stream && strcmp(only_stream, stream_names[type]) != 0) {
+            continue;
+        }
+
+        init_stream(ctrl, &stream, type);
+        run_stream(&stream);
+        cleanup_stream(&stream);
+    }
+
+    cleanup_ctrl(ctrl);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,55 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include "json.h"
+#include "zns-tools.h"
+
+#include <getopt.h>
+#include <time.h>
+
+#define BENCH_NR_EXTENTS 100000 /* default extents of each stream */
+#define BENCH_NR_ZONES 1024     /* default zones of the synthetic device */
+#define BENCH_ZONE_SIZE 0x80000 /* zone size in 512B sectors (256MiB) */
+#define BENCH_EXT_LEN 8         /* extent size in 512B sectors (4KiB) */
+#define BENCH_EXT_STRIDE 16     /* extents are followed by a hole of 4KiB */
+#define BENCH_SMALL_FILE_EXTENTS 4 /* extents of each file in STREAM_SMALL */
+#define BENCH_HUGE_FILES 4         /* number of files in STREAM_HUGE */
+#define BENCH_REPS 5
+
+/*
+ * Shapes of the synthetic extent streams, all extents of a file are in logical
+ * order and the placement on the device differs.
+ *
+ * */
+enum bench_stream_type {
+    STREAM_SORTED = 0, /* a single file, placed in PBAS order */
+    STREAM_RANDOM,     /* a single file, placed at random PBAS */
+    STREAM_SMALL,      /* many files of BENCH_SMALL_FILE_EXTENTS extents */
+    STREAM_HUGE,       /* BENCH_HUGE_FILES files with interleaved extents */
+    STREAM_NR_TYPES
+};
+
+struct bench_stream {
+    const char *name;       /* name of the stream in the results */
+    struct extent *extents; /* extents of all files, one file after another */
+    uint32_t *file_ext_ctr; /* number of extents of each file */
+    uint32_t nr_files;      /* number of files in file_ext_ctr */
+    uint64_t nr_extents;    /* number of extents in extents */
+};
+
+/* counters of the allocations of the library, see malloc() in bench.c */
+struct bench_allocs {
+    uint64_t ctr;   /* number of malloc(), calloc() and realloc() calls */
+    uint64_t bytes; /* bytes requested by these calls */
+};
+
+/* result of a benchmark over all repetitions */
+struct bench_result {
+    uint64_t ops;        /* operations of a single repetition */
+    uint64_t best_ns;    /* time of the fastest repetition */
+    uint64_t total_ns;   /* time of all repetitions */
+    uint64_t alloc_ctr;  /* allocations of all repetitions */
+    uint64_t alloc_size; /* bytes allocated in all repetitions */
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "vmlinux.h"
+
+#include <bpf/bpf_core_read.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+#include "apptrace.h"
+
+#define F_SET_RW_HINT 1036 /* F_LINUX_SPECIFIC_BASE + 12 */
+#define RWH_WRITE_LIFE_EXTREME 5
+
+char LICENSE[] SEC("license") = "GPL";
+
+/* F2FS types are private to fs/f2fs, and f2fs is often a module, hence only
+ * the used fields are defined here and relocated by CO-RE */
+enum page_type___zt { PAGE_TYPE___zt };
+enum temp_type___zt { TEMP_TYPE___zt };
+
+struct f2fs_io_info___zt {
+    unsigned int ino;
+    enum page_type___zt type;
+    enum temp_type___zt temp;
+    unsigned int new_blkaddr;
+} __attribute__((preserve_access_index));
+
+struct f2fs_filename___zt {
+    const struct qstr *usr_fname;
+} __attribute__((preserve_access_index));
+
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct apptrace_stage);
+} stages SEC(".maps");
+
+/* max_entries is set by zns.apptrace */
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, APPTRACE_RINGBUF_MB << 20);
+} records SEC(".maps");
+
+static __always_inline struct apptrace_stage *get_stage() {
+    __u32 key = 0;
+
+    return bpf_map_lookup_elem(&stages, &key);
+}
+
+/*
+ * Fill the next record of the batch of this CPU. BPF programs do not nest on
+ * a CPU, hence the batch is not accessed concurrently.
+ *
+ * returns: the record, to add the data of the event before commit_record()
+ *
+ * */
+static __always_inline struct apptrace_record *
+init_record(struct apptrace_stage *stage, __u32 type, __u64 ino) {
+    __u32 i = stage->nr & (APPTRACE_BATCH - 1);
+    struct apptrace_record *rec = &stage->recs[i];
+    __u64 id = bpf_get_current_pid_tgid();
+
+    rec->ts_ns = bpf_ktime_get_ns();
+    rec->ino = ino;
+    rec->pid = id >> 32;
+    rec->tid = id;
+    rec->type = type;
+    __builtin_memset(&rec->data, 0, sizeof(rec->data));
+
+    return rec;
+}
+
+/* send the batch once it is full, the last partial batches are read by user
+ * space from the stages map */
+static __always_inline void commit_record(struct apptrace_stage *stage) {
+    stage->nr++;
+    if (stage->nr < APPTRACE_BATCH) {
+        return;
+    }
+
+    if (bpf_ringbuf_output(&records, stage->recs, sizeof(stage->recs), 0)) {
+        stage->dropped += APPTRACE_BATCH;
+    }
+    stage->nr = 0;
+}
+
+static __always_inline int record_inode(__u32 type, struct inode *inode) {
+    struct apptrace_stage *stage = get_stage();
+
+    if (!stage || !inode) {
+        return 0;
+    }
+
+    init_record(stage, type, BPF_CORE_READ(inode, i_ino));
+    commit_record(stage);
+
+    return 0;
+}
+
+SEC("kprobe/f2fs_submit_page_write")
+int BPF_KPROBE(trace_f2fs_submit_page_write, struct f2fs_io_info___zt *fio) {
+    struct apptrace_stage *stage = get_stage();
+    struct apptrace_record *rec;
+
+    if (!stage) {
+        return 0;
+    }
+
+    rec = init_record(stage, APPTRACE_F2FS_SUBMIT_PAGE_WRITE,
+                      BPF_CORE_READ(fio, ino));
+    rec->data.page_write.blkaddr = BPF_CORE_READ(fio, new_blkaddr);
+    rec->data.page_write.temp = BPF_CORE_READ(fio, temp);
+    rec->data.page_write.page_type = BPF_CORE_READ(fio, type);
+    commit_record(stage);
+
+    return 0;
+}
+
+/* reclassifies to cold data, post-processing can identify if it was a
+ * reclassification */
+SEC("kprobe/move_data_page")
+int BPF_KPROBE(trace_move_data_page, struct inode *inode) {
+    return record_inode(APPTRACE_F2FS_MOVE_DATA, inode);
+}
+
+SEC("kprobe/move_data_block")
+int BPF_KPROBE(trace_move_data_block, struct inode *inode) {
+    return record_inode(APPTRACE_F2FS_MOVE_DATA, inode);
+}
+
+SEC("kprobe/f2fs_init_inode_metadata")
+int BPF_KPROBE(trace_f2fs_init_inode_metadata, struct inode *inode,
+               struct inode *dir, struct f2fs_filename___zt *fname) {
+    struct apptrace_stage *stage = get_stage();
+    struct apptrace_record *rec;
+
+    if (!stage) {
+        return 0;
+    }
+
+    rec = init_record(stage, APPTRACE_INODE_NAME, BPF_CORE_READ(inode, i_ino));
+    bpf_probe_read_kernel_str(rec->data.name, sizeof(rec->data.name),
+                              BPF_CORE_READ(fname, usr_fname, name));
+    commit_record(stage);
+
+    return 0;
+}
+
+SEC("kprobe/vfs_open")
+int BPF_KPROBE(trace_vfs_open, struct path *path) {
+    return record_inode(APPTRACE_VFS_OPEN,
+                        BPF_CORE_READ(path, dentry, d_inode));
+}
+
+SEC("kprobe/vfs_create")
+int BPF_KPROBE(trace_vfs_create, void *idmap, struct inode *dir) {
+    return record_inode(APPTRACE_VFS_CREATE, dir);
+}
+
+SEC("kprobe/do_fcntl")
+int BPF_KPROBE(trace_do_fcntl, int fd, unsigned int cmd, unsigned long arg,
+               struct file *filp) {
+    struct apptrace_stage *stage;
+    struct apptrace_record *rec;
+    __u64 hint = 0;
+
+    if (cmd != F_SET_RW_HINT) {
+        return 0;
+    }
+
+    /* invalid hints are ignored */
+    if (bpf_probe_read_user(&hint, sizeof(hint), (void *)arg) ||
+        hint > RWH_WRITE_LIFE_EXTREME) {
+        return 0;
+    }
+
+    stage = get_stage();
+    if (!stage) {
+        return 0;
+    }
+
+    rec = init_record(stage, APPTRACE_FCNTL_SET_RW_HINT,
+                      BPF_CORE_READ(filp, f_inode, i_ino));
+    rec->data.hint = hint;
+    commit_record(stage);
+
+    return 0;
+}
+
+SEC("kprobe/vfs_fsync")
+int BPF_KPROBE(trace_vfs_fsync, struct file *file) {
+    return record_inode(APPTRACE_VFS_FSYNC, BPF_CORE_READ(file, f_inode));
+}
+
+SEC("kprobe/vfs_rename")
+int BPF_KPROBE(trace_vfs_rename, struct renamedata *rd) {
+    return record_inode(APPTRACE_VFS_RENAME,
+                        BPF_CORE_READ(rd, old_dentry, d_inode));
+}
+
+SEC("kprobe/vfs_unlink")
+int BPF_KPROBE(trace_vfs_unlink, void *idmap, struct inode *dir,
+               struct dentry *dentry) {
+    return record_inode(APPTRACE_VFS_UNLINK, BPF_CORE_READ(dentry, d_inode));
+}
+
+SEC("kprobe/do_writepages")
+int BPF_KPROBE(trace_do_writepages, struct address_space *mapping) {
+    return record_inode(APPTRACE_MM_DO_WRITEPAGES,
+                        BPF_CORE_READ(mapping, host));
+}
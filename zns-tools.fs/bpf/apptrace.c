@@ -0,0 +1,299 @@
+#include "zns-tools.h"
+
+#include <bpf/libbpf.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+
+#include "apptrace.h"
+#include "apptrace.skel.h"
+
+#define APPTRACE_POLL_MS 100
+#define APPTRACE_OUT_FILE "apptrace.bin"
+#define APPTRACE_WRITE_BUF (1 << 20) /* buffer of the trace file */
+
+static struct apptrace_header header;
+static volatile sig_atomic_t stop = 0;
+
+/*
+ *
+ * Show the command help.
+ *
+ *
+ * */
+static void show_help() {
+    MSG("Possible flags are:\n");
+    MSG("-o [file]\tOutput file of the trace. Default %s\n",
+        APPTRACE_OUT_FILE);
+    MSG("-d [dev]\tZNS device of the file system (e.g., nvme0n2), for the "
+        "zone\n\t\tof F2FS writes\n");
+    MSG("-b [uint]\tRing buffer size in MiB, rounded up to a power of 2. "
+        "Default %u\n",
+        APPTRACE_RINGBUF_MB);
+    MSG("-t [uint]\tTrace duration in seconds. Default until Ctrl-C\n");
+    MSG("-h\t\tShow this help\n");
+
+    exit(0);
+}
+
+static void sig_handler(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static uint64_t now_ms() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Write a batch of records of the ring buffer to the trace file. The file is
+ * fully buffered, such that records are written in large chunks.
+ *
+ * returns: 0 to continue polling
+ *
+ * */
+static int handle_batch(void *ctx, void *data, size_t size) {
+    FILE *fp = ctx;
+    size_t nr = size / sizeof(struct apptrace_record);
+
+    if (fwrite(data, sizeof(struct apptrace_record), nr, fp) != nr) {
+        ERR_MSG("Failed writing the trace file\n");
+    }
+    header.nr_records += nr;
+
+    return 0;
+}
+
+/*
+ * Write the staged records of the partial batch of each CPU, and sum the
+ * records that were dropped on each CPU. Must be called after detaching the
+ * programs, such that the batches are no longer changed.
+ *
+ * @skel: the loaded BPF skeleton
+ * @fp: the trace file
+ *
+ * */
+static void drain_stages(struct apptrace_bpf *skel, FILE *fp) {
+    int nr_cpus = libbpf_num_possible_cpus();
+    struct apptrace_stage *percpu;
+    uint32_t key = 0;
+
+    percpu = calloc(nr_cpus, sizeof(struct apptrace_stage));
+    if (!percpu) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    if (bpf_map_lookup_elem(bpf_map__fd(skel->maps.stages), &key, percpu) <
+        0) {
+        ERR_MSG("Failed reading the staged records\n");
+    }
+
+    for (int cpu = 0; cpu < nr_cpus; cpu++) {
+        handle_batch(fp, percpu[cpu].recs,
+                     percpu[cpu].nr * sizeof(struct apptrace_record));
+        header.dropped += percpu[cpu].dropped;
+    }
+
+    free(percpu);
+}
+
+/*
+ * Attach each program on its own, as the probed F2FS functions are static and
+ * may be inlined in some kernels, in which case only these events are missing.
+ *
+ * @skel: the loaded BPF skeleton
+ * @nr_links: set to the number of attached programs
+ *
+ * returns: the links of the attached programs
+ *
+ * */
+static struct bpf_link **attach_progs(struct apptrace_bpf *skel,
+                                      uint32_t *nr_links) {
+    struct bpf_program *prog;
+    struct bpf_link **links;
+    uint32_t nr_progs = 0;
+
+    bpf_object__for_each_program(prog, skel->obj) { nr_progs++; }
+
+    links = calloc(nr_progs, sizeof(struct bpf_link *));
+    if (!links) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    *nr_links = 0;
+    bpf_object__for_each_program(prog, skel->obj) {
+        if (!bpf_program__autoload(prog)) {
+            continue;
+        }
+        links[*nr_links] = bpf_program__attach(prog);
+        if (!links[*nr_links]) {
+            WARN("Failed attaching %s, its events are not traced\n",
+                 bpf_program__name(prog));
+            continue;
+        }
+        (*nr_links)++;
+    }
+
+    if (*nr_links == 0) {
+        ERR_MSG("Failed attaching BPF programs\n");
+    }
+
+    return links;
+}
+
+/*
+ * Open, configure, and load the BPF program.
+ *
+ * @ringbuf_mb: size of the ring buffer in MiB, a power of 2
+ *
+ * returns: the loaded BPF skeleton
+ *
+ * */
+static struct apptrace_bpf *load_bpf(uint32_t ringbuf_mb) {
+    struct apptrace_bpf *skel;
+
+    skel = apptrace_bpf__open();
+    if (!skel) {
+        ERR_MSG("Failed opening BPF program\n");
+    }
+
+    if (bpf_map__set_max_entries(skel->maps.records, ringbuf_mb << 20)) {
+        ERR_MSG("Failed resizing the ring buffer to %u MiB\n", ringbuf_mb);
+    }
+
+    /* the F2FS types are only relocated if f2fs is loaded */
+    if (access("/sys/fs/f2fs", F_OK) < 0) {
+        WARN("f2fs is not loaded, F2FS events are not traced\n");
+        bpf_program__set_autoload(skel->progs.trace_f2fs_submit_page_write,
+                                  false);
+        bpf_program__set_autoload(skel->progs.trace_move_data_page, false);
+        bpf_program__set_autoload(skel->progs.trace_move_data_block, false);
+        bpf_program__set_autoload(skel->progs.trace_f2fs_init_inode_metadata,
+                                  false);
+    }
+
+    if (apptrace_bpf__load(skel)) {
+        ERR_MSG("Failed loading BPF program, is the kernel built with BTF?\n");
+    }
+
+    return skel;
+}
+
+int main(int argc, char *argv[]) {
+    struct apptrace_bpf *skel;
+    struct ring_buffer *rb;
+    struct bpf_link **links;
+    struct control *ctrl;
+    char dev_path[PATH_MAX];
+    char *dev = NULL, *out_file = APPTRACE_OUT_FILE, *buf;
+    uint32_t ringbuf_mb = APPTRACE_RINGBUF_MB, nr_links;
+    uint64_t duration_ms = 0, start;
+    FILE *fp;
+    int c, err;
+
+    while ((c = getopt(argc, argv, "b:d:ho:t:")) != -1) {
+        switch (c) {
+        case 'b':
+            ringbuf_mb = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            dev = optarg;
+            break;
+        case 'o':
+            out_file = optarg;
+            break;
+        case 't':
+            duration_ms = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        case 'h':
+        default:
+            show_help();
+            break;
+        }
+    }
+
+    if (ringbuf_mb == 0 || ringbuf_mb > 1024) {
+        ERR_MSG("Ring buffer size must be between 1 and 1024 MiB\n");
+    }
+    /* ring buffers are a power of 2 pages */
+    while (ringbuf_mb & (ringbuf_mb - 1)) {
+        ringbuf_mb += ringbuf_mb & -ringbuf_mb;
+    }
+
+    memcpy(header.magic, APPTRACE_MAGIC, sizeof(header.magic));
+    header.version = APPTRACE_VERSION;
+    header.record_size = sizeof(struct apptrace_record);
+
+    if (dev) {
+        snprintf(dev_path, sizeof(dev_path), "/dev/%s", dev);
+        ctrl = alloc_ctrl();
+        header.zone_size = get_zone_size(ctrl, dev_path);
+        cleanup_ctrl(ctrl);
+        if (header.zone_size == 0) {
+            ERR_MSG("%s is not a zoned device\n", dev_path);
+        }
+    }
+
+    fp = fopen(out_file, "w");
+    buf = malloc(APPTRACE_WRITE_BUF);
+    if (!fp || !buf) {
+        ERR_MSG("Failed opening %s\n", out_file);
+    }
+    setvbuf(fp, buf, _IOFBF, APPTRACE_WRITE_BUF);
+    /* rewritten with the number of records at the end */
+    fwrite(&header, sizeof(struct apptrace_header), 1, fp);
+
+    skel = load_bpf(ringbuf_mb);
+    rb = ring_buffer__new(bpf_map__fd(skel->maps.records), handle_batch, fp,
+                          NULL);
+    if (!rb) {
+        ERR_MSG("Failed creating ring buffer\n");
+    }
+
+    signal(SIGINT, sig_handler);
+    signal(SIGTERM, sig_handler);
+
+    links = attach_progs(skel, &nr_links);
+
+    MSG("Tracing to %s with a %u MiB ring buffer\n", out_file, ringbuf_mb);
+    MSG("Hit Ctrl-C or send INT to stop trace\n");
+
+    start = now_ms();
+    while (!stop && (!duration_ms || now_ms() - start < duration_ms)) {
+        err = ring_buffer__poll(rb, APPTRACE_POLL_MS);
+        if (err < 0 && err != -EINTR) {
+            ERR_MSG("Failed polling ring buffer: %s\n", strerror(-err));
+        }
+    }
+
+    for (uint32_t i = 0; i < nr_links; i++) {
+        bpf_link__destroy(links[i]);
+    }
+    free(links);
+
+    /* consume remaining batches and the partial batch of each CPU */
+    ring_buffer__consume(rb);
+    drain_stages(skel, fp);
+
+    fseek(fp, 0, SEEK_SET);
+    fwrite(&header, sizeof(struct apptrace_header), 1, fp);
+    if (fclose(fp)) {
+        ERR_MSG("Failed writing %s\n", out_file);
+    }
+    free(buf);
+
+    MSG("Traced %llu events to %s\n", header.nr_records, out_file);
+    if (header.dropped) {
+        WARN("Dropped %llu events, increase the ring buffer size with -b\n",
+             header.dropped);
+    }
+
+    ring_buffer__free(rb);
+    apptrace_bpf__destroy(skel);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#ifndef __APPTRACE_H__
+#define __APPTRACE_H__
+
+/*
+ * Shared definitions of the BPF program (apptrace.bpf.c) and zns.apptrace,
+ * which record the events of the F2FS, VFS, MM, and inode probes of
+ * zns-tools.app into a binary trace file.
+ *
+ * Events are fixed size records. Each CPU stages its records in a per-CPU
+ * batch, and a full batch is sent over the ring buffer at once, such that the
+ * CPUs only contend on the ring buffer once per batch. zns.apptrace streams
+ * the batches into the trace file through a fixed size buffer, such that its
+ * memory is bounded independent of the trace length, and records batches that
+ * are lost if the ring buffer is full. The trace file is a struct
+ * apptrace_header, followed by the records.
+ *
+ * */
+
+#define APPTRACE_BATCH 16 /* records of a batch, must be a power of 2 */
+#define APPTRACE_NAME_LEN 36
+#define APPTRACE_RINGBUF_MB 16 /* default ring buffer size */
+
+#define APPTRACE_MAGIC "ZNSTRACE"
+#define APPTRACE_VERSION 1
+
+/* the names are the map names of the bpftrace probes, used by tracegen.py */
+enum apptrace_event {
+    APPTRACE_F2FS_SUBMIT_PAGE_WRITE = 0, /* f2fs_submit_page_write */
+    APPTRACE_F2FS_MOVE_DATA,             /* f2fs_move_data */
+    APPTRACE_VFS_OPEN,                   /* vfs_open */
+    APPTRACE_VFS_CREATE,                 /* vfs_create */
+    APPTRACE_FCNTL_SET_RW_HINT,          /* fcntl_set_rw_hint */
+    APPTRACE_VFS_FSYNC,                  /* vfs_fsync */
+    APPTRACE_VFS_RENAME,                 /* vfs_rename */
+    APPTRACE_VFS_UNLINK,                 /* vfs_unlink */
+    APPTRACE_MM_DO_WRITEPAGES,           /* mm_do_writepages */
+    APPTRACE_INODE_NAME,                 /* inodes */
+    APPTRACE_NR_EVENTS
+};
+
+/* 64 bytes, such that a batch is a multiple of the cache line size */
+struct apptrace_record {
+    __u64 ts_ns; /* bpf_ktime_get_ns(), as nsecs of bpftrace */
+    __u64 ino;
+    __u32 pid;
+    __u32 tid;
+    __u32 type; /* enum apptrace_event */
+    union {
+        struct {
+            __u32 blkaddr;  /* F2FS block address */
+            __u8 temp;      /* F2FS enum temp_type */
+            __u8 page_type; /* F2FS enum page_type */
+        } page_write;
+        __u32 hint;                   /* RWH_WRITE_LIFE_* of fcntl */
+        char name[APPTRACE_NAME_LEN]; /* file name of the inode */
+    } data;
+};
+_Static_assert(sizeof(struct apptrace_record) == 64, "see tracegen.py");
+
+struct apptrace_stage {
+    __u32 nr;      /* staged records */
+    __u32 pad;
+    __u64 dropped; /* records lost as the ring buffer was full */
+    struct apptrace_record recs[APPTRACE_BATCH];
+};
+
+struct apptrace_header {
+    char magic[8];
+    __u32 version;
+    __u32 record_size;
+    __u64 zone_size; /* zone size of the device in 512B sectors, 0 if none */
+    __u64 nr_records;
+    __u64 dropped;
+};
+_Static_assert(sizeof(struct apptrace_header) == 40, "see tracegen.py");
+
+#endif
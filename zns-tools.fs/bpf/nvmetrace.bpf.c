@@ -0,0 +1,433 @@
+#include "vmlinux.h"
+
+#include <bpf/bpf_core_read.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+#include "nvmetrace.h"
+
+#define REQ_OP_BITS 8
+#define REQ_OP_MASK ((1 << REQ_OP_BITS) - 1)
+
+char LICENSE[] SEC("license") = "GPL";
+
+/* device and zone geometry, set by zns.nvmetrace before loading */
+const volatile __u32 dev_major = 0;
+const volatile __u32 dev_minor = 0;
+const volatile __u64 zone_size = 1; /* zone size in 512B sectors */
+const volatile __u32 nr_zones = 0;
+const volatile __u32 lba_shift = 0; /* LBA to 512B sector shift */
+const volatile __u32 nr_tags = 0; /* tags of each hardware queue */
+const volatile __u8 trace_hists = 1;
+
+/* counters of each zone, max_entries is set to the number of zones */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct nvmetrace_zone);
+} zones SEC(".maps");
+
+/* histograms of each zone, max_entries is set to the number of zones */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct nvmetrace_hist);
+} hists SEC(".maps");
+
+/* condition of each zone, max_entries is set to the number of zones. It is
+ * shared by all CPUs, as the condition of a zone is changed by its first
+ * write, on whichever CPU it is issued. */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct nvmetrace_zone_state);
+} zone_states SEC(".maps");
+
+/* requests in flight, by hardware queue and tag, start_ns is 0 if empty */
+struct req_start {
+    __u64 start_ns;
+    __u32 zone;
+    __u32 op; /* NVMETRACE_HIST_* or NVMETRACE_REQ_* */
+};
+
+/* max_entries is set to the hardware queues times nr_tags. It is not per
+ * CPU, as requests may complete on another CPU of their hardware queue, but
+ * an entry is only used by a single request at a time. */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct req_start);
+} starts SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, NVMETRACE_RINGBUF_SIZE);
+} events SEC(".maps");
+
+/* events that did not fit into the ring buffer, by enum nvmetrace_event_type */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, NVMETRACE_NR_EVENTS);
+    __type(key, __u32);
+    __type(value, __u64);
+} dropped SEC(".maps");
+
+/* requests are filtered by the major and minor of their disk, instead of
+ * comparing disk names */
+static __always_inline int is_traced(struct request *req) {
+    struct gendisk *disk = BPF_CORE_READ(req, q, disk);
+
+    return disk && BPF_CORE_READ(disk, major) == dev_major &&
+           BPF_CORE_READ(disk, first_minor) == dev_minor;
+}
+
+/* the struct nvme_command * is the first field of the nvme_request PDU, which
+ * follows the struct request */
+static __always_inline void *get_nvme_cmd(struct request *req) {
+    void *cmd = NULL;
+
+    bpf_probe_read_kernel(&cmd, sizeof(cmd),
+                          (void *)req + bpf_core_type_size(struct request));
+
+    return cmd;
+}
+
+/*
+ * Get the zone management command of a request, and the sector of its zone.
+ * In passthrough mode (e.g., qemu passthrough) these are REQ_OP_DRV_OUT zone
+ * management send commands, with the zone send action in the command.
+ *
+ * returns: NVMETRACE_REQ_* of the command, -1 if it is not one
+ *
+ * */
+static __always_inline int get_zone_mgmt(struct request *req, __u32 op,
+                                         __u64 *sector) {
+    __u8 opcode = 0, zsa = 0;
+    __u64 slba = 0;
+    void *cmd;
+
+    *sector = BPF_CORE_READ(req, __sector);
+
+    switch (op) {
+    case REQ_OP_ZONE_RESET:
+        return NVMETRACE_REQ_RESET;
+    case REQ_OP_ZONE_OPEN:
+        return NVMETRACE_REQ_OPEN;
+    case REQ_OP_ZONE_CLOSE:
+        return NVMETRACE_REQ_CLOSE;
+    case REQ_OP_ZONE_FINISH:
+        return NVMETRACE_REQ_FINISH;
+    case REQ_OP_DRV_OUT:
+        break;
+    default:
+        return -1;
+    }
+
+    cmd = get_nvme_cmd(req);
+    bpf_probe_read_kernel(&opcode, sizeof(opcode),
+                          cmd + NVMETRACE_NVME_OPCODE_OFF);
+    if (opcode != NVMETRACE_NVME_ZONE_MGMT_SEND) {
+        return -1;
+    }
+
+    bpf_probe_read_kernel(&slba, sizeof(slba), cmd + NVMETRACE_NVME_SLBA_OFF);
+    *sector = slba << lba_shift;
+
+    bpf_probe_read_kernel(&zsa, sizeof(zsa), cmd + NVMETRACE_NVME_ZSA_OFF);
+    switch (zsa) {
+    case NVMETRACE_NVME_ZONE_RESET:
+        return NVMETRACE_REQ_RESET;
+    case NVMETRACE_NVME_ZONE_OPEN:
+        return NVMETRACE_REQ_OPEN;
+    case NVMETRACE_NVME_ZONE_CLOSE:
+        return NVMETRACE_REQ_CLOSE;
+    case NVMETRACE_NVME_ZONE_FINISH:
+        return NVMETRACE_REQ_FINISH;
+    default:
+        return -1;
+    }
+}
+
+static __always_inline __u32 log2_u32(__u32 v) {
+    __u32 shift, r;
+
+    r = (v > 0xFFFF) << 4;
+    v >>= r;
+    shift = (v > 0xFF) << 3;
+    v >>= shift;
+    r |= shift;
+    shift = (v > 0xF) << 2;
+    v >>= shift;
+    r |= shift;
+    shift = (v > 0x3) << 1;
+    v >>= shift;
+    r |= shift;
+    r |= (v >> 1);
+
+    return r;
+}
+
+/* log2 slot of a value, the last slot holds all larger values */
+static __always_inline __u32 get_slot(__u64 v, __u32 nr_slots) {
+    __u32 slot = v >> 32 ? 32 + log2_u32(v >> 32) : log2_u32(v);
+
+    return slot < nr_slots ? slot : nr_slots - 1;
+}
+
+/* the tag of a request is unique in its hardware queue */
+static __always_inline struct req_start *get_start(struct request *req) {
+    __u32 idx = BPF_CORE_READ(req, mq_hctx, queue_num) * nr_tags +
+                BPF_CORE_READ(req, tag);
+
+    return bpf_map_lookup_elem(&starts, &idx);
+}
+
+static __always_inline void track_request(struct request *req, __u32 zone,
+                                          __u32 op) {
+    struct req_start *start = get_start(req);
+
+    if (!start) {
+        return;
+    }
+
+    start->zone = zone;
+    start->op = op;
+    start->start_ns = bpf_ktime_get_ns();
+}
+
+static __always_inline void send_event(__u32 type, __u32 zone, __u32 cond,
+                                       __u64 lat_ns) {
+    struct nvmetrace_event *event;
+    __u64 *ctr;
+
+    event = bpf_ringbuf_reserve(&events, sizeof(struct nvmetrace_event), 0);
+    if (!event) {
+        ctr = bpf_map_lookup_elem(&dropped, &type);
+        if (ctr) {
+            (*ctr)++;
+        }
+        return;
+    }
+
+    event->type = type;
+    event->zone = zone;
+    event->cond = cond;
+    event->pad = 0;
+    event->lat_ns = lat_ns;
+    event->ts_ns = bpf_ktime_get_ns();
+    bpf_ringbuf_submit(event, 0);
+}
+
+/*
+ * Track the condition of a zone for a write. The first write to an empty or
+ * closed zone implicitly opens it, and the write that reaches the zone
+ * capacity makes it full. Both are found with atomics, as appends to the same
+ * zone are issued concurrently, such that each is only sent once.
+ *
+ * @zone: zone number
+ * @len: write size in 512B sectors
+ *
+ * */
+static __always_inline void write_zone_state(__u32 zone, __u32 len) {
+    struct nvmetrace_zone_state *state;
+    __u64 written;
+    __u32 cond;
+
+    state = bpf_map_lookup_elem(&zone_states, &zone);
+    if (!state) {
+        return;
+    }
+
+    cond = state->cond;
+    if ((cond == NVMETRACE_COND_EMPTY || cond == NVMETRACE_COND_CLOSED) &&
+        __sync_val_compare_and_swap(&state->cond, cond,
+                                    NVMETRACE_COND_IMP_OPEN) == cond) {
+        send_event(NVMETRACE_EVENT_IMPLICIT_OPEN, zone,
+                   NVMETRACE_COND_IMP_OPEN, 0);
+    }
+
+    written = __sync_fetch_and_add(&state->written, len) + len;
+    if (written >= state->capacity && written - len < state->capacity) {
+        state->cond = NVMETRACE_COND_FULL;
+        send_event(NVMETRACE_EVENT_FULL, zone, NVMETRACE_COND_FULL, 0);
+    }
+}
+
+/*
+ * Apply a completed zone management command to the condition of its zone, and
+ * send its event with the command latency.
+ *
+ * */
+static __always_inline void complete_zone_mgmt(__u32 zone, __u32 op,
+                                               __u64 lat_ns) {
+    struct nvmetrace_zone_state *state;
+    __u32 type;
+
+    state = bpf_map_lookup_elem(&zone_states, &zone);
+    if (!state) {
+        return;
+    }
+
+    switch (op) {
+    case NVMETRACE_REQ_RESET:
+        type = NVMETRACE_EVENT_RESET;
+        state->written = 0;
+        state->cond = NVMETRACE_COND_EMPTY;
+        break;
+    case NVMETRACE_REQ_OPEN:
+        type = NVMETRACE_EVENT_OPEN;
+        state->cond = NVMETRACE_COND_EXP_OPEN;
+        break;
+    case NVMETRACE_REQ_CLOSE:
+        /* closing a zone without any writes makes it empty again */
+        type = NVMETRACE_EVENT_CLOSE;
+        state->cond =
+            state->written ? NVMETRACE_COND_CLOSED : NVMETRACE_COND_EMPTY;
+        break;
+    case NVMETRACE_REQ_FINISH:
+        type = NVMETRACE_EVENT_FINISH;
+        state->cond = NVMETRACE_COND_FULL;
+        break;
+    default:
+        return;
+    }
+
+    send_event(type, zone, state->cond, lat_ns);
+}
+
+SEC("kprobe/nvme_setup_cmd")
+int BPF_KPROBE(trace_setup_cmd, void *ns, struct request *req) {
+    struct nvmetrace_zone *counters;
+    struct nvmetrace_hist *hist;
+    __u32 op, zone, idx, hist_op, len;
+    __u64 sector;
+    int mgmt_op;
+
+    if (!is_traced(req)) {
+        return 0;
+    }
+
+    op = BPF_CORE_READ(req, cmd_flags) & REQ_OP_MASK;
+
+    if (op == REQ_OP_ZONE_RESET_ALL) {
+        send_event(NVMETRACE_EVENT_RESET_ALL, 0, NVMETRACE_COND_EMPTY, 0);
+        return 0;
+    }
+
+    mgmt_op = get_zone_mgmt(req, op, &sector);
+    if (mgmt_op >= 0) {
+        zone = sector / zone_size;
+        counters = bpf_map_lookup_elem(&zones, &zone);
+        if (!counters) {
+            return 0;
+        }
+        if (mgmt_op == NVMETRACE_REQ_RESET) {
+            counters->resets++;
+        }
+
+        track_request(req, zone, mgmt_op);
+        return 0;
+    }
+
+    if (op == REQ_OP_WRITE) {
+        idx = NVMETRACE_OP_WRITE;
+        hist_op = NVMETRACE_HIST_WRITE;
+    } else if (op == REQ_OP_ZONE_APPEND) {
+        idx = NVMETRACE_OP_WRITE;
+        hist_op = NVMETRACE_HIST_APPEND;
+    } else if (op == REQ_OP_READ) {
+        idx = NVMETRACE_OP_READ;
+        hist_op = NVMETRACE_HIST_READ;
+    } else {
+        return 0;
+    }
+
+    zone = BPF_CORE_READ(req, __sector) / zone_size;
+    counters = bpf_map_lookup_elem(&zones, &zone);
+    if (!counters) {
+        return 0;
+    }
+
+    /* the counters are per CPU, hence no atomics are needed */
+    len = BPF_CORE_READ(req, __data_len) >> 9;
+    counters->ctr[idx]++;
+    counters->data[idx] += len;
+
+    if (idx == NVMETRACE_OP_WRITE) {
+        write_zone_state(zone, len);
+    }
+
+    track_request(req, zone, hist_op);
+
+    if (!trace_hists) {
+        return 0;
+    }
+
+    hist = bpf_map_lookup_elem(&hists, &zone);
+    if (hist) {
+        hist->size[hist_op][get_slot(len, NVMETRACE_SIZE_SLOTS)]++;
+    }
+
+    return 0;
+}
+
+SEC("kprobe/nvme_complete_rq")
+int BPF_KPROBE(trace_complete_rq, struct request *req) {
+    struct nvmetrace_zone *counters;
+    struct nvmetrace_hist *hist;
+    struct req_start *start;
+    __u32 op, zone, idx;
+    __u64 lat_ns;
+
+    /* tags are only unique on a device */
+    if (!is_traced(req)) {
+        return 0;
+    }
+
+    start = get_start(req);
+    if (!start || !start->start_ns) {
+        return 0;
+    }
+
+    lat_ns = bpf_ktime_get_ns() - start->start_ns;
+    zone = start->zone;
+    op = start->op;
+    start->start_ns = 0;
+
+    counters = bpf_map_lookup_elem(&zones, &zone);
+
+    if (op >= NVMETRACE_REQ_RESET) {
+        complete_zone_mgmt(zone, op, lat_ns);
+        if (op != NVMETRACE_REQ_RESET || !counters) {
+            return 0;
+        }
+
+        counters->reset_lat_ns += lat_ns;
+        counters->reset_lat_ctr++;
+        hist = trace_hists ? bpf_map_lookup_elem(&hists, &zone) : NULL;
+        if (hist) {
+            hist->reset_lat[get_slot(lat_ns / 1000, NVMETRACE_LAT_SLOTS)]++;
+        }
+        return 0;
+    }
+
+    if (counters) {
+        idx = op == NVMETRACE_HIST_READ ? NVMETRACE_OP_READ
+                                        : NVMETRACE_OP_WRITE;
+        counters->lat_ns[idx] += lat_ns;
+        counters->lat_ctr[idx]++;
+    }
+
+    if (trace_hists && op < NVMETRACE_NR_HISTS) {
+        hist = bpf_map_lookup_elem(&hists, &zone);
+        if (hist) {
+            hist->lat[op][get_slot(lat_ns / 1000, NVMETRACE_LAT_SLOTS)]++;
+        }
+    }
+
+    return 0;
+}
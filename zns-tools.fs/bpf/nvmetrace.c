@@ -0,0 +1,731 @@
+#include "zns-tools.h"
+
+#include <bpf/libbpf.h>
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/sysmacros.h>
+
+#include "nvmetrace.h"
+#include "nvmetrace.skel.h"
+
+#define NVMETRACE_POLL_MS 100
+#define NVMETRACE_OUT_FILE "nvmetrace.dat"
+
+/* nvme_command opcodes used as keys of the bpftrace maps (see trace.bt) */
+static const uint8_t op_keys[NVMETRACE_NR_OPS] = {
+    [NVMETRACE_OP_WRITE] = NVMETRACE_NVME_CMD_WRITE,
+    [NVMETRACE_OP_READ] = NVMETRACE_NVME_CMD_READ,
+};
+
+static const uint8_t hist_keys[NVMETRACE_NR_HISTS] = {
+    [NVMETRACE_HIST_WRITE] = NVMETRACE_NVME_CMD_WRITE,
+    [NVMETRACE_HIST_APPEND] = NVMETRACE_NVME_ZONE_APPEND,
+    [NVMETRACE_HIST_READ] = NVMETRACE_NVME_CMD_READ,
+};
+
+/* reset latencies are written as the latencies of zone management sends */
+#define NVMETRACE_RESET_KEY NVMETRACE_NVME_ZONE_MGMT_SEND
+
+static const char *const event_names[NVMETRACE_NR_EVENTS] = {
+    [NVMETRACE_EVENT_RESET] = "reset",
+    [NVMETRACE_EVENT_RESET_ALL] = "reset_all",
+    [NVMETRACE_EVENT_OPEN] = "open",
+    [NVMETRACE_EVENT_CLOSE] = "close",
+    [NVMETRACE_EVENT_FINISH] = "finish",
+    [NVMETRACE_EVENT_IMPLICIT_OPEN] = "implicit_open",
+    [NVMETRACE_EVENT_FULL] = "full",
+};
+
+static uint64_t reset_all_ctr = 0;
+static uint64_t zone_size = 0; /* in 512B sectors */
+static uint32_t nr_zones = 0;
+static uint8_t trace_hists = 1;
+static volatile sig_atomic_t stop = 0;
+
+/* condition of each zone, and the resulting number of open and active zones,
+ * kept from the events of the BPF program */
+static uint8_t *conds;
+static uint32_t nr_open = 0;
+static uint32_t nr_active = 0;
+static FILE *timeline;
+static uint64_t start_ns;
+
+/*
+ *
+ * Show the command help.
+ *
+ *
+ * */
+static void show_help() {
+    MSG("Possible flags are:\n");
+    MSG("-d [dev]\tZNS device name to trace (e.g., nvme0n2) [Required]\n");
+    MSG("-o [file]\tOutput file of the snapshots. Default %s\n",
+        NVMETRACE_OUT_FILE);
+    MSG("-i [uint]\tSnapshot interval in seconds. Default 1\n");
+    MSG("-t [file]\tOutput file of the zone condition timeline.\n\t\tDefault "
+        "[output file].timeline\n");
+    MSG("-c\t\tOnly trace counters, without size and latency histograms\n");
+    MSG("-h\t\tShow this help\n");
+
+    exit(0);
+}
+
+static void sig_handler(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+/* CLOCK_MONOTONIC, as bpf_ktime_get_ns() */
+static uint64_t now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t now_ms() {
+    return now_ns() / 1000000;
+}
+
+static uint8_t is_open(uint8_t cond) {
+    return cond == NVMETRACE_COND_IMP_OPEN || cond == NVMETRACE_COND_EXP_OPEN;
+}
+
+/* open and closed zones count against the active zone limit */
+static uint8_t is_active(uint8_t cond) {
+    return is_open(cond) || cond == NVMETRACE_COND_CLOSED;
+}
+
+static void set_cond(uint32_t zone, uint8_t cond) {
+    nr_open += is_open(cond) - is_open(conds[zone]);
+    nr_active += is_active(cond) - is_active(conds[zone]);
+    conds[zone] = cond;
+}
+
+/*
+ * Reset the condition of all zones after a reset of all zones, also in the
+ * BPF map, as the BPF program cannot update all zones itself.
+ *
+ * @skel: the loaded BPF skeleton
+ *
+ * */
+static void reset_all_zones(struct nvmetrace_bpf *skel) {
+    int map_fd = bpf_map__fd(skel->maps.zone_states);
+    struct nvmetrace_zone_state state;
+
+    for (uint32_t i = 0; i < nr_zones; i++) {
+        if (bpf_map_lookup_elem(map_fd, &i, &state) == 0) {
+            state.written = 0;
+            state.cond = NVMETRACE_COND_EMPTY;
+            bpf_map_update_elem(map_fd, &i, &state, BPF_ANY);
+        }
+        set_cond(i, NVMETRACE_COND_EMPTY);
+    }
+}
+
+/*
+ * Append an event to the timeline, with the open and active zones after it.
+ *
+ * */
+static void write_timeline(struct nvmetrace_event *event) {
+    fprintf(timeline, "%.6f,%u,%s,%llu,%u,%u\n",
+            (event->ts_ns - start_ns) / 1e9, event->zone,
+            event_names[event->type], event->lat_ns, nr_open, nr_active);
+}
+
+/*
+ * Recount the open and active zones from the conditions the BPF program keeps,
+ * as the counts of the events are off after events were dropped. A change is
+ * appended to the timeline as a sync event.
+ *
+ * @skel: the loaded BPF skeleton
+ *
+ * */
+static void sync_zone_states(struct nvmetrace_bpf *skel) {
+    int map_fd = bpf_map__fd(skel->maps.zone_states);
+    struct nvmetrace_zone_state state;
+    uint32_t prev_open = nr_open, prev_active = nr_active;
+
+    for (uint32_t i = 0; i < nr_zones; i++) {
+        if (bpf_map_lookup_elem(map_fd, &i, &state) == 0) {
+            set_cond(i, state.cond);
+        }
+    }
+
+    if (nr_open != prev_open || nr_active != prev_active) {
+        fprintf(timeline, "%.6f,0,sync,0,%u,%u\n",
+                (now_ns() - start_ns) / 1e9, nr_open, nr_active);
+    }
+}
+
+/*
+ * Handle an event of the ring buffer
+ *
+ * returns: 0 to continue polling
+ *
+ * */
+static int handle_event(void *ctx, void *data, size_t size) {
+    struct nvmetrace_event *event = data;
+
+    if (size < sizeof(struct nvmetrace_event) ||
+        event->type >= NVMETRACE_NR_EVENTS || event->zone >= nr_zones) {
+        return 0;
+    }
+
+    if (event->type == NVMETRACE_EVENT_RESET_ALL) {
+        reset_all_ctr++;
+        reset_all_zones(ctx);
+        write_timeline(event);
+        return 0;
+    }
+
+    set_cond(event->zone, event->cond);
+    write_timeline(event);
+
+    return 0;
+}
+
+/*
+ * Initialize the condition of all zones from a zone report, such that the
+ * BPF program finds implicit opens of zones, and the timeline starts with the
+ * zones that are already open or active.
+ *
+ * @skel: the loaded BPF skeleton
+ * @dev_path: device path (e.g., /dev/nvme0n2)
+ *
+ * */
+static void init_zone_states(struct nvmetrace_bpf *skel, char *dev_path) {
+    int map_fd = bpf_map__fd(skel->maps.zone_states);
+    struct nvmetrace_zone_state state;
+    struct blk_zone_report *hdr;
+    struct blk_zone *zone;
+    uint32_t i = 0;
+    int fd;
+
+    conds = calloc(nr_zones, sizeof(uint8_t));
+    hdr = calloc(1, sizeof(struct blk_zone_report) +
+                        nr_zones * sizeof(struct blk_zone));
+    if (!conds || !hdr) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    fd = open(dev_path, O_RDONLY);
+    if (fd < 0) {
+        ERR_MSG("Failed opening %s\n", dev_path);
+    }
+
+    while (i < nr_zones) {
+        hdr->sector = i * zone_size;
+        hdr->nr_zones = nr_zones - i;
+        if (ioctl(fd, BLKREPORTZONE, hdr) < 0 || hdr->nr_zones == 0) {
+            ERR_MSG("Failed reporting zones of %s\n", dev_path);
+        }
+
+        for (uint32_t j = 0; j < hdr->nr_zones && i < nr_zones; j++, i++) {
+            zone = &hdr->zones[j];
+            memset(&state, 0, sizeof(struct nvmetrace_zone_state));
+            state.capacity = zone->capacity;
+            state.written = zone->wp - zone->start;
+
+            switch (zone->cond) {
+            case BLK_ZONE_COND_EMPTY:
+                state.cond = NVMETRACE_COND_EMPTY;
+                break;
+            case BLK_ZONE_COND_IMP_OPEN:
+                state.cond = NVMETRACE_COND_IMP_OPEN;
+                break;
+            case BLK_ZONE_COND_EXP_OPEN:
+                state.cond = NVMETRACE_COND_EXP_OPEN;
+                break;
+            case BLK_ZONE_COND_CLOSED:
+                state.cond = NVMETRACE_COND_CLOSED;
+                break;
+            default:
+                /* the write pointer of full zones is invalid */
+                state.cond = NVMETRACE_COND_FULL;
+                state.written = zone->capacity;
+                break;
+            }
+
+            if (bpf_map_update_elem(map_fd, &i, &state, BPF_ANY) < 0) {
+                ERR_MSG("Failed initializing the condition of zone %u\n", i);
+            }
+            set_cond(i, state.cond);
+        }
+    }
+
+    close(fd);
+    free(hdr);
+}
+
+/*
+ * Read a zone limit of a device, from /sys/block/<dev>/queue/<attr>
+ *
+ * returns: the limit, 0 if there is none
+ *
+ * */
+static uint32_t get_zone_limit(char *dev, char *attr) {
+    char path[PATH_MAX];
+    uint32_t limit = 0;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/sys/block/%s/queue/%s", dev, attr);
+    fp = fopen(path, "r");
+    if (fp) {
+        if (fscanf(fp, "%u", &limit) != 1) {
+            limit = 0;
+        }
+        fclose(fp);
+    }
+
+    return limit;
+}
+
+/*
+ * Write the non-empty slots of the histograms of a zone, summed over all CPUs.
+ * Slot i of z_size_hist holds I/Os of [2^i, 2^(i+1)) 512B sectors, and of
+ * z_lat_hist I/Os with a latency of [2^i, 2^(i+1)) usec. Reset latencies are
+ * in z_lat_hist under NVMETRACE_RESET_KEY.
+ *
+ * @fp: output file
+ * @map_fd: fd of the hists map
+ * @zone: zone number
+ * @percpu: buffer of an entry on each CPU
+ *
+ * */
+static void write_hists(FILE *fp, int map_fd, uint32_t zone,
+                        struct nvmetrace_hist *percpu) {
+    int nr_cpus = libbpf_num_possible_cpus();
+    uint64_t size[NVMETRACE_NR_HISTS][NVMETRACE_SIZE_SLOTS] = {0};
+    uint64_t lat[NVMETRACE_NR_HISTS][NVMETRACE_LAT_SLOTS] = {0};
+    uint64_t reset_lat[NVMETRACE_LAT_SLOTS] = {0};
+    uint64_t zlbas = zone * zone_size;
+
+    if (bpf_map_lookup_elem(map_fd, &zone, percpu) < 0) {
+        return;
+    }
+
+    for (int cpu = 0; cpu < nr_cpus; cpu++) {
+        for (uint8_t op = 0; op < NVMETRACE_NR_HISTS; op++) {
+            for (uint8_t i = 0; i < NVMETRACE_SIZE_SLOTS; i++) {
+                size[op][i] += percpu[cpu].size[op][i];
+            }
+            for (uint8_t i = 0; i < NVMETRACE_LAT_SLOTS; i++) {
+                lat[op][i] += percpu[cpu].lat[op][i];
+            }
+        }
+        for (uint8_t i = 0; i < NVMETRACE_LAT_SLOTS; i++) {
+            reset_lat[i] += percpu[cpu].reset_lat[i];
+        }
+    }
+
+    for (uint8_t op = 0; op < NVMETRACE_NR_HISTS; op++) {
+        for (uint8_t i = 0; i < NVMETRACE_SIZE_SLOTS; i++) {
+            if (size[op][i]) {
+                fprintf(fp, "@z_size_hist[%lu, %u, %u]: %lu\n", zlbas,
+                        hist_keys[op], i, size[op][i]);
+            }
+        }
+        for (uint8_t i = 0; i < NVMETRACE_LAT_SLOTS; i++) {
+            if (lat[op][i]) {
+                fprintf(fp, "@z_lat_hist[%lu, %u, %u]: %lu\n", zlbas,
+                        hist_keys[op], i, lat[op][i]);
+            }
+        }
+    }
+    for (uint8_t i = 0; i < NVMETRACE_LAT_SLOTS; i++) {
+        if (reset_lat[i]) {
+            fprintf(fp, "@z_lat_hist[%lu, %u, %u]: %lu\n", zlbas,
+                    NVMETRACE_RESET_KEY, i, reset_lat[i]);
+        }
+    }
+}
+
+/*
+ * Write the number of events that did not fit into the ring buffer, summed
+ * over all CPUs
+ *
+ * @fp: output file
+ * @skel: the loaded BPF skeleton
+ *
+ * returns: the number of dropped events
+ *
+ * */
+static uint64_t write_dropped(FILE *fp, struct nvmetrace_bpf *skel) {
+    int nr_cpus = libbpf_num_possible_cpus();
+    int map_fd = bpf_map__fd(skel->maps.dropped);
+    uint64_t *percpu, ctr, total = 0;
+
+    percpu = calloc(nr_cpus, sizeof(uint64_t));
+    if (!percpu) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint32_t type = 0; type < NVMETRACE_NR_EVENTS; type++) {
+        if (bpf_map_lookup_elem(map_fd, &type, percpu) < 0) {
+            continue;
+        }
+
+        ctr = 0;
+        for (int cpu = 0; cpu < nr_cpus; cpu++) {
+            ctr += percpu[cpu];
+        }
+        if (ctr) {
+            fprintf(fp, "@dropped_events[%s]: %lu\n", event_names[type], ctr);
+        }
+        total += ctr;
+    }
+
+    free(percpu);
+
+    return total;
+}
+
+/*
+ * Write a snapshot of all counters, in the format of the bpftrace maps of
+ * trace.bt, such that plot.py can be used on it. Reset latencies are written
+ * as the z_lat_map, z_lat_ctr_map and z_lat_hist of NVMETRACE_RESET_KEY, each
+ * single latency is in the timeline. The snapshot is written to a temporary
+ * file and renamed, such that the output file is always complete.
+ *
+ * @skel: the loaded BPF skeleton
+ * @out_file: path of the output file
+ *
+ * returns: the number of dropped events
+ *
+ * */
+static uint64_t write_snapshot(struct nvmetrace_bpf *skel, char *out_file) {
+    int nr_cpus = libbpf_num_possible_cpus();
+    int map_fd = bpf_map__fd(skel->maps.zones);
+    int hist_fd = bpf_map__fd(skel->maps.hists);
+    struct nvmetrace_zone *percpu, zone;
+    struct nvmetrace_hist *percpu_hist;
+    char tmp_file[PATH_MAX];
+    uint64_t zlbas, dropped;
+    FILE *fp;
+
+    percpu = calloc(nr_cpus, sizeof(struct nvmetrace_zone));
+    percpu_hist = calloc(nr_cpus, sizeof(struct nvmetrace_hist));
+    if (!percpu || !percpu_hist) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", out_file);
+    fp = fopen(tmp_file, "w");
+    if (!fp) {
+        ERR_MSG("Failed opening %s\n", tmp_file);
+    }
+
+    for (uint32_t i = 0; i < nr_zones; i++) {
+        if (bpf_map_lookup_elem(map_fd, &i, percpu) < 0) {
+            continue;
+        }
+
+        memset(&zone, 0, sizeof(struct nvmetrace_zone));
+        for (int cpu = 0; cpu < nr_cpus; cpu++) {
+            for (uint8_t op = 0; op < NVMETRACE_NR_OPS; op++) {
+                zone.ctr[op] += percpu[cpu].ctr[op];
+                zone.data[op] += percpu[cpu].data[op];
+                zone.lat_ns[op] += percpu[cpu].lat_ns[op];
+                zone.lat_ctr[op] += percpu[cpu].lat_ctr[op];
+            }
+            zone.resets += percpu[cpu].resets;
+            zone.reset_lat_ns += percpu[cpu].reset_lat_ns;
+            zone.reset_lat_ctr += percpu[cpu].reset_lat_ctr;
+        }
+
+        zlbas = i * zone_size;
+        for (uint8_t op = 0; op < NVMETRACE_NR_OPS; op++) {
+            if (zone.ctr[op] == 0) {
+                continue;
+            }
+            fprintf(fp, "@z_rw_ctr_map[%lu, %u]: %llu\n", zlbas, op_keys[op],
+                    zone.ctr[op]);
+            fprintf(fp, "@z_data_map[%lu, %u]: %llu\n", zlbas, op_keys[op],
+                    zone.data[op]);
+            if (zone.lat_ctr[op] == 0) {
+                continue;
+            }
+            fprintf(fp, "@z_lat_map[%lu, %u]: %llu\n", zlbas, op_keys[op],
+                    zone.lat_ns[op]);
+            fprintf(fp, "@z_lat_ctr_map[%lu, %u]: %llu\n", zlbas,
+                    op_keys[op], zone.lat_ctr[op]);
+        }
+        if (zone.resets) {
+            fprintf(fp, "@z_reset_ctr_map[%lu]: %llu\n", zlbas, zone.resets);
+        }
+        if (zone.reset_lat_ctr) {
+            fprintf(fp, "@z_lat_map[%lu, %u]: %llu\n", zlbas,
+                    NVMETRACE_RESET_KEY, zone.reset_lat_ns);
+            fprintf(fp, "@z_lat_ctr_map[%lu, %u]: %llu\n", zlbas,
+                    NVMETRACE_RESET_KEY, zone.reset_lat_ctr);
+        }
+
+        if (trace_hists &&
+            (zone.ctr[NVMETRACE_OP_WRITE] || zone.ctr[NVMETRACE_OP_READ] ||
+             zone.reset_lat_ctr)) {
+            write_hists(fp, hist_fd, i, percpu_hist);
+        }
+    }
+
+    if (reset_all_ctr) {
+        fprintf(fp, "@reset_all_ctr: %lu\n", reset_all_ctr);
+    }
+    dropped = write_dropped(fp, skel);
+
+    fclose(fp);
+    free(percpu);
+    free(percpu_hist);
+
+    if (rename(tmp_file, out_file) < 0) {
+        ERR_MSG("Failed renaming %s to %s\n", tmp_file, out_file);
+    }
+
+    return dropped;
+}
+
+/*
+ * Get the number of hardware queues of a device, and the max number of tags
+ * of its queues, from /sys/block/<dev>/mq/<queue>/nr_tags.
+ *
+ * @dev: device name (e.g., nvme0n2)
+ * @nr_queues: set to the number of hardware queues
+ * @nr_tags: set to the max number of tags of a queue
+ *
+ * */
+static void get_mq_tags(char *dev, uint32_t *nr_queues, uint32_t *nr_tags) {
+    char path[PATH_MAX];
+    struct dirent *entry;
+    uint32_t tags;
+    DIR *dir;
+    FILE *fp;
+
+    *nr_queues = 0;
+    *nr_tags = 0;
+
+    snprintf(path, sizeof(path), "/sys/block/%s/mq", dev);
+    dir = opendir(path);
+    if (!dir) {
+        ERR_MSG("Failed opening %s\n", path);
+    }
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/sys/block/%s/mq/%s/nr_tags", dev,
+                 entry->d_name);
+        fp = fopen(path, "r");
+        if (!fp) {
+            continue;
+        }
+        if (fscanf(fp, "%u", &tags) == 1 && tags > *nr_tags) {
+            *nr_tags = tags;
+        }
+        fclose(fp);
+        (*nr_queues)++;
+    }
+    closedir(dir);
+
+    if (*nr_queues == 0 || *nr_tags == 0) {
+        ERR_MSG("Failed getting hardware queues of %s\n", dev);
+    }
+}
+
+/*
+ * Open, configure, load, and attach the BPF program for a device.
+ *
+ * @dev: device name (e.g., nvme0n2)
+ * @dev_path: device path (e.g., /dev/nvme0n2)
+ *
+ * returns: the attached BPF skeleton
+ *
+ * */
+static struct nvmetrace_bpf *load_bpf(char *dev, char *dev_path) {
+    struct nvmetrace_bpf *skel;
+    struct control *ctrl;
+    uint32_t sector_size = 0, nr_queues, nr_tags;
+    struct stat st;
+    int fd;
+
+    if (stat(dev_path, &st) < 0 || !S_ISBLK(st.st_mode)) {
+        ERR_MSG("%s is not a block device\n", dev_path);
+    }
+
+    /* zone size in 512B sectors, as __sector of struct request */
+    ctrl = alloc_ctrl();
+    zone_size = get_zone_size(ctrl, dev_path);
+    nr_zones = get_nr_zones(dev_path);
+    cleanup_ctrl(ctrl);
+    if (zone_size == 0 || nr_zones == 0) {
+        ERR_MSG("%s is not a zoned device\n", dev_path);
+    }
+
+    fd = open(dev_path, O_RDONLY);
+    if (fd < 0 || ioctl(fd, BLKSSZGET, &sector_size) < 0) {
+        ERR_MSG("Failed getting sector size of %s\n", dev_path);
+    }
+    close(fd);
+
+    /* the slba of NVMe commands is in logical blocks */
+    if (sector_size < 512 || (sector_size & (sector_size - 1))) {
+        ERR_MSG("Unsupported logical block size %u of %s\n", sector_size,
+                dev_path);
+    }
+
+    get_mq_tags(dev, &nr_queues, &nr_tags);
+
+    skel = nvmetrace_bpf__open();
+    if (!skel) {
+        ERR_MSG("Failed opening BPF program\n");
+    }
+
+    skel->rodata->dev_major = major(st.st_rdev);
+    skel->rodata->dev_minor = minor(st.st_rdev);
+    skel->rodata->zone_size = zone_size;
+    skel->rodata->nr_zones = nr_zones;
+    skel->rodata->lba_shift = __builtin_ctz(sector_size >> 9);
+    skel->rodata->nr_tags = nr_tags;
+    skel->rodata->trace_hists = trace_hists;
+
+    /* the histograms are the largest map, with an entry of each zone on
+     * each CPU, hence it is only sized to the zones if it is used */
+    if (bpf_map__set_max_entries(skel->maps.zones, nr_zones) ||
+        bpf_map__set_max_entries(skel->maps.zone_states, nr_zones) ||
+        bpf_map__set_max_entries(skel->maps.hists,
+                                 trace_hists ? nr_zones : 1)) {
+        ERR_MSG("Failed resizing the zone maps to %u zones\n", nr_zones);
+    }
+    if (bpf_map__set_max_entries(skel->maps.starts, nr_queues * nr_tags)) {
+        ERR_MSG("Failed resizing the request map to %u queues of %u tags\n",
+                nr_queues, nr_tags);
+    }
+    if (trace_hists) {
+        MSG("Histograms use %lu MiB of kernel memory (disable with -c)\n",
+            ((uint64_t)nr_zones * libbpf_num_possible_cpus() *
+             sizeof(struct nvmetrace_hist)) >> 20);
+    }
+
+    if (nvmetrace_bpf__load(skel)) {
+        ERR_MSG("Failed loading BPF program, is the kernel built with BTF?\n");
+    }
+
+    init_zone_states(skel, dev_path);
+    start_ns = now_ns();
+
+    if (nvmetrace_bpf__attach(skel)) {
+        ERR_MSG("Failed attaching BPF program, is the nvme driver loaded?\n");
+    }
+
+    return skel;
+}
+
+int main(int argc, char *argv[]) {
+    struct nvmetrace_bpf *skel;
+    struct ring_buffer *rb;
+    char dev_path[PATH_MAX];
+    char *dev = NULL, *out_file = NVMETRACE_OUT_FILE, *timeline_file = NULL;
+    char timeline_path[PATH_MAX];
+    uint64_t interval_ms = 1000, last, dropped;
+    int c, err;
+
+    while ((c = getopt(argc, argv, "cd:hi:o:t:")) != -1) {
+        switch (c) {
+        case 'c':
+            trace_hists = 0;
+            break;
+        case 'd':
+            dev = optarg;
+            break;
+        case 'i':
+            interval_ms = strtoull(optarg, NULL, 0) * 1000;
+            break;
+        case 'o':
+            out_file = optarg;
+            break;
+        case 't':
+            timeline_file = optarg;
+            break;
+        case 'h':
+        default:
+            show_help();
+            break;
+        }
+    }
+
+    if (!dev) {
+        ERR_MSG("Missing device to trace, set with -d\n");
+    }
+    if (interval_ms == 0) {
+        ERR_MSG("Snapshot interval must be larger than 0\n");
+    }
+
+    snprintf(dev_path, sizeof(dev_path), "/dev/%s", dev);
+    skel = load_bpf(dev, dev_path);
+
+    if (!timeline_file) {
+        snprintf(timeline_path, sizeof(timeline_path), "%s.timeline",
+                 out_file);
+        timeline_file = timeline_path;
+    }
+    timeline = fopen(timeline_file, "w");
+    if (!timeline) {
+        ERR_MSG("Failed opening %s\n", timeline_file);
+    }
+    fprintf(timeline, "# max_open_zones %u max_active_zones %u\n",
+            get_zone_limit(dev, "max_open_zones"),
+            get_zone_limit(dev, "max_active_zones"));
+    fprintf(timeline, "time_s,zone,event,lat_ns,open,active\n");
+    fprintf(timeline, "0.000000,0,start,0,%u,%u\n", nr_open, nr_active);
+
+    rb = ring_buffer__new(bpf_map__fd(skel->maps.events), handle_event, skel,
+                          NULL);
+    if (!rb) {
+        ERR_MSG("Failed creating ring buffer\n");
+    }
+
+    signal(SIGINT, sig_handler);
+    signal(SIGTERM, sig_handler);
+
+    MSG("Tracing %s (%u zones of %lu sectors) to %s\n", dev, nr_zones,
+        zone_size, out_file);
+    MSG("%u zones open and %u active at start, timeline in %s\n", nr_open,
+        nr_active, timeline_file);
+    MSG("Hit Ctrl-C or send INT to stop trace\n");
+
+    last = now_ms();
+    while (!stop) {
+        err = ring_buffer__poll(rb, NVMETRACE_POLL_MS);
+        if (err < 0 && err != -EINTR) {
+            ERR_MSG("Failed polling ring buffer: %s\n", strerror(-err));
+        }
+
+        if (now_ms() - last >= interval_ms) {
+            sync_zone_states(skel);
+            write_snapshot(skel, out_file);
+            fflush(timeline);
+            last = now_ms();
+        }
+    }
+
+    /* consume remaining events for the final snapshot */
+    ring_buffer__consume(rb);
+    sync_zone_states(skel);
+    dropped = write_snapshot(skel, out_file);
+    if (dropped) {
+        WARN("Dropped %lu events of a full ring buffer, the open and active "
+             "zones were recounted at each snapshot\n",
+             dropped);
+    }
+
+    fclose(timeline);
+    ring_buffer__free(rb);
+    nvmetrace_bpf__destroy(skel);
+    free(conds);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#ifndef __NVMETRACE_H__
+#define __NVMETRACE_H__
+
+/*
+ * Shared definitions of the BPF program (nvmetrace.bpf.c) and zns.nvmetrace.
+ *
+ * Counters are kept in a per-CPU array indexed by zone number, such that
+ * requests on different CPUs never contend, and are summed by user space for
+ * each snapshot. The start time of each request is kept in an array indexed
+ * by its hardware queue and tag, which are unique among the requests in
+ * flight, such that tracking every I/O needs no hash map.
+ *
+ * Log2 histograms of the I/O size and completion latency of each zone are kept
+ * in a second per-CPU array, such that percentiles of each zone can be plotted
+ * instead of averages. Reset latencies are kept the same way.
+ *
+ * The condition of each zone is tracked in a shared array, initialized from a
+ * zone report, such that implicit opens (the first write to an empty or closed
+ * zone) are found. All zone condition changes are sent as events over a ring
+ * buffer, from which user space keeps the number of open and active zones over
+ * time. Events that do not fit into the ring buffer are counted in a per-CPU
+ * array, and user space recounts the zones from the shared array.
+ *
+ * */
+
+#define NVMETRACE_OP_WRITE 0 /* writes and zone appends */
+#define NVMETRACE_OP_READ 1
+#define NVMETRACE_NR_OPS 2
+
+/* histograms of each operation, appends are split from writes */
+#define NVMETRACE_HIST_WRITE 0
+#define NVMETRACE_HIST_APPEND 1
+#define NVMETRACE_HIST_READ 2
+#define NVMETRACE_NR_HISTS 3
+
+/* zone management commands in flight, tracked as requests after the hists */
+#define NVMETRACE_REQ_RESET (NVMETRACE_NR_HISTS + 0)
+#define NVMETRACE_REQ_OPEN (NVMETRACE_NR_HISTS + 1)
+#define NVMETRACE_REQ_CLOSE (NVMETRACE_NR_HISTS + 2)
+#define NVMETRACE_REQ_FINISH (NVMETRACE_NR_HISTS + 3)
+
+#define NVMETRACE_SIZE_SLOTS 16 /* log2 of 512B sectors, 512B to 16MiB */
+#define NVMETRACE_LAT_SLOTS 24  /* log2 of usec, 1usec to 8sec */
+#define NVMETRACE_RINGBUF_SIZE (256 * 1024)
+
+/* NVMe opcodes and the zone send action of the command (NVMe ZNS spec) */
+#define NVMETRACE_NVME_CMD_WRITE 0x01
+#define NVMETRACE_NVME_CMD_READ 0x02
+#define NVMETRACE_NVME_ZONE_MGMT_SEND 0x79
+#define NVMETRACE_NVME_ZONE_APPEND 0x7d
+#define NVMETRACE_NVME_ZONE_CLOSE 0x01
+#define NVMETRACE_NVME_ZONE_FINISH 0x02
+#define NVMETRACE_NVME_ZONE_OPEN 0x03
+#define NVMETRACE_NVME_ZONE_RESET 0x04
+
+/* byte offsets of fields in the 64 byte struct nvme_command */
+#define NVMETRACE_NVME_OPCODE_OFF 0
+#define NVMETRACE_NVME_SLBA_OFF 40
+#define NVMETRACE_NVME_ZSA_OFF 52
+
+struct nvmetrace_zone {
+    __u64 ctr[NVMETRACE_NR_OPS];  /* commands of each operation */
+    __u64 data[NVMETRACE_NR_OPS]; /* 512B sectors of each operation */
+    __u64 resets;                 /* zone reset commands */
+    __u64 lat_ns[NVMETRACE_NR_OPS];  /* sum of completion latencies */
+    __u64 lat_ctr[NVMETRACE_NR_OPS]; /* completed commands */
+    __u64 reset_lat_ns;              /* sum of reset latencies */
+    __u64 reset_lat_ctr;             /* completed zone resets */
+};
+
+/* counters are 32 bit, as the map has an entry of each zone on each CPU */
+struct nvmetrace_hist {
+    __u32 size[NVMETRACE_NR_HISTS][NVMETRACE_SIZE_SLOTS];
+    __u32 lat[NVMETRACE_NR_HISTS][NVMETRACE_LAT_SLOTS];
+    __u32 reset_lat[NVMETRACE_LAT_SLOTS];
+};
+
+/* zone conditions, the read only and offline conditions are tracked as full,
+ * as these zones are not active */
+enum nvmetrace_zone_cond {
+    NVMETRACE_COND_EMPTY = 0,
+    NVMETRACE_COND_IMP_OPEN,
+    NVMETRACE_COND_EXP_OPEN,
+    NVMETRACE_COND_CLOSED,
+    NVMETRACE_COND_FULL,
+};
+
+struct nvmetrace_zone_state {
+    __u64 written;  /* 512B sectors written since the zone was empty */
+    __u64 capacity; /* zone capacity in 512B sectors */
+    __u32 cond;     /* enum nvmetrace_zone_cond */
+    __u32 pad;
+};
+
+enum nvmetrace_event_type {
+    NVMETRACE_EVENT_RESET = 0,     /* completed zone reset */
+    NVMETRACE_EVENT_RESET_ALL,     /* issued reset of all zones */
+    NVMETRACE_EVENT_OPEN,          /* completed explicit zone open */
+    NVMETRACE_EVENT_CLOSE,         /* completed zone close */
+    NVMETRACE_EVENT_FINISH,        /* completed zone finish */
+    NVMETRACE_EVENT_IMPLICIT_OPEN, /* first write to an empty or closed zone */
+    NVMETRACE_EVENT_FULL,          /* write up to the zone capacity */
+    NVMETRACE_NR_EVENTS
+};
+
+struct nvmetrace_event {
+    __u32 type;   /* enum nvmetrace_event_type */
+    __u32 zone;   /* zone number of the event */
+    __u32 cond;   /* enum nvmetrace_zone_cond of the zone after the event */
+    __u32 pad;
+    __u64 lat_ns; /* latency of zone management commands */
+    __u64 ts_ns;  /* CLOCK_MONOTONIC time of the event */
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef __BACKEND_H__
+#define __BACKEND_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
+/*
+ * Backend of all device and file system accesses of the libraries (zone
+ * reports, device ioctl()s, superblock and metadata reads, procfs
+ * segment_info, and FIEMAP of files).
+ *
+ * The live backend issues the calls. The record backend issues them as well
+ * and appends each call with its result to a capture file, the replay backend
+ * answers the calls from a capture file instead, such that captures of
+ * production systems can be analyzed and profiled without the devices or
+ * files. Calls are identified by the call, the path, and its arguments (e.g.,
+ * the offset of a read), if a call was recorded several times (e.g., zone
+ * reports before and after mapping) the replay returns the results in the
+ * recorded order, repeating the last one.
+ *
+ * The capture file starts with a struct backend_capture_header, followed by
+ * the records. Each record is a struct backend_record, followed by the path
+ * (NUL terminated) and the data returned by the call, padded to 8 bytes.
+ * Values are in host byte order, captures are replayed on hosts of the same
+ * byte order.
+ *
+ * */
+
+#define BACKEND_CAPTURE_MAGIC "ZNSCAPT"
+#define BACKEND_CAPTURE_VERSION 1
+
+enum backend_mode {
+    BACKEND_LIVE = 0, /* issue the calls */
+    BACKEND_RECORD,   /* issue the calls and record them to a capture */
+    BACKEND_REPLAY,   /* answer the calls from a capture */
+};
+
+enum backend_call {
+    BACKEND_CALL_OPEN = 0, /* open() of a device or file */
+    BACKEND_CALL_IOCTL,    /* ioctl(), args[0] is the request */
+    BACKEND_CALL_PREAD,    /* read of a device, args are offset and size */
+    BACKEND_CALL_STATFS,   /* statfs() of a path */
+    BACKEND_CALL_FSTAT,    /* fstat() of an opened file */
+    BACKEND_CALL_READLINK, /* readlink() of a device link */
+    BACKEND_CALL_PROC,     /* contents of a procfs file */
+    BACKEND_CALL_DIR,      /* entries of a directory */
+};
+
+struct backend_capture_header {
+    char magic[8];        /* BACKEND_CAPTURE_MAGIC */
+    uint32_t version;     /* BACKEND_CAPTURE_VERSION */
+    uint32_t header_size; /* sizeof(struct backend_capture_header) */
+};
+
+struct backend_record {
+    uint32_t type;     /* enum backend_call */
+    int32_t ret;       /* return value of the call */
+    int32_t err;       /* errno of a failed call */
+    uint32_t path_len; /* bytes of the path, including the NUL */
+    uint64_t args[3];  /* arguments identifying the call, 0 if unused */
+    uint64_t data_len; /* bytes of the data returned by the call */
+};
+
+/* entries of BACKEND_CALL_DIR are a d_type byte followed by the NUL
+ * terminated name, see backend_read_dir() */
+#define BACKEND_DIRENT_TYPE(entry) ((uint8_t)(entry)[0])
+#define BACKEND_DIRENT_NAME(entry) ((entry) + 1)
+#define BACKEND_DIRENT_NEXT(entry) ((entry) + strlen((entry) + 1) + 2)
+
+extern int backend_init(enum backend_mode, const char *);
+extern void backend_cleanup();
+extern enum backend_mode backend_get_mode();
+
+extern int backend_open(const char *);
+extern int backend_ioctl(int, const char *, unsigned long, void *);
+extern int backend_pread(int, const char *, void *, uint64_t, size_t);
+extern int backend_statfs(const char *, struct statfs *);
+extern int backend_fstat(int, const char *, struct stat *);
+extern ssize_t backend_readlink(const char *, char *, size_t);
+extern FILE *backend_fopen_proc(const char *);
+extern int backend_read_dir(const char *, char **, size_t *);
+
+#endif
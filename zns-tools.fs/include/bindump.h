@@ -0,0 +1,137 @@
+#ifndef __BINDUMP_H__
+#define __BINDUMP_H__
+
+#include "zns-tools.h"
+
+/*
+ * Binary columnar zonemap dump
+ *
+ * The file starts with a struct bin_dump_header, followed by the column blocks
+ * the header points to. All values are little-endian and every column block
+ * starts at an 8 byte aligned offset, such that the file can be mmap()'ed and
+ * the columns used as plain arrays (e.g., with numpy.frombuffer()).
+ *
+ * Zone columns have nr_zones entries, file columns nr_files entries, and
+ * extent columns nr_extents entries. Extents are stored sorted by zone and
+ * PBAS, the extents of zone i are at [ZONE_EXT_START[i], ZONE_EXT_START[i] +
+ * ZONE_EXT_CTR[i]). All addresses and sizes are in sectors of sector_size.
+ *
+ * The size histogram columns hold SIZE_HIST_BUCKETS entries for each zone, row
+ * i being the log2 buckets of zone i (bucket j counts sizes in [2^j,
+ * 2^(j+1))). They were added in version 2 after all version 1 columns, such
+ * that the ids of existing columns are unchanged.
+ *
+ * Version 3 added the index columns, which make the dump a zonemap index that
+ * can answer queries without mapping the files again (see bin_dump_index()).
+ * The file columns hold the absolute path and the stat() values of each file
+ * at the time it was mapped, FILE_EXTENTS holds the extent indexes of each
+ * file in logical order at [FILE_EXT_START[i], FILE_EXT_START[i] +
+ * FILE_EXT_CTR[i]), and FILE_ORDER the file indexes sorted by path for binary
+ * search. The index columns are empty in plain dumps (see bin_dump_data()).
+ *
+ * */
+
+#define BIN_DUMP_MAGIC "ZNSDUMP"
+#define BIN_DUMP_VERSION 3
+#define BIN_DUMP_NO_TYPE 0xff /* EXT_SEG_TYPE of extents without fs info */
+
+enum bin_dump_column_id {
+    BIN_COL_ZONE_START = 0, /* uint64_t zone LBAS */
+    BIN_COL_ZONE_CAP,       /* uint64_t zone capacity */
+    BIN_COL_ZONE_WP,        /* uint64_t zone write pointer */
+    BIN_COL_ZONE_STATE,     /* uint8_t zone state */
+    BIN_COL_ZONE_EXT_START, /* uint64_t index of the first extent of the zone */
+    BIN_COL_ZONE_EXT_CTR,   /* uint32_t number of extents in the zone */
+    BIN_COL_FILE_NAME_OFF,  /* uint32_t offset of the file name in FILE_NAMES */
+    BIN_COL_FILE_EXT_CTR,   /* uint32_t number of extents of the file */
+    BIN_COL_FILE_NAMES,     /* char NUL terminated file names */
+    BIN_COL_EXT_PHY_BLK,    /* uint64_t PBAS of the extent */
+    BIN_COL_EXT_LOGICAL_BLK, /* uint64_t logical start of the extent */
+    BIN_COL_EXT_LEN,         /* uint64_t length of the extent */
+    BIN_COL_EXT_FILE_ID,     /* uint32_t index into the file columns */
+    BIN_COL_EXT_NR,          /* uint32_t extent number within the file */
+    BIN_COL_EXT_FLAGS,       /* uint32_t FIEMAP extent flags */
+    BIN_COL_EXT_SEG_TYPE,    /* uint8_t F2FS segment type (enum type) */
+    BIN_COL_EXT_VALID_BLOCKS, /* uint32_t valid sectors in the segment */
+    BIN_COL_ZONE_EXT_HIST,    /* uint32_t extent size buckets of the zone */
+    BIN_COL_ZONE_HOLE_HIST,   /* uint32_t hole size buckets of the zone */
+    BIN_COL_FILE_PATH_OFF,    /* uint64_t offset of the path in FILE_PATHS */
+    BIN_COL_FILE_PATHS,       /* char NUL terminated absolute file paths */
+    BIN_COL_FILE_INO,         /* uint64_t inode number of the file */
+    BIN_COL_FILE_SIZE,        /* uint64_t size of the file in bytes */
+    BIN_COL_FILE_MTIME,       /* uint64_t modification time of the file (ns) */
+    BIN_COL_FILE_EXT_START,   /* uint64_t index of the first FILE_EXTENTS */
+    BIN_COL_FILE_EXTENTS,     /* uint64_t extent index, in logical order */
+    BIN_COL_FILE_ORDER,       /* uint32_t file indexes sorted by path */
+    BIN_COL_INDEX_DIR,        /* char NUL terminated mapped directory */
+    BIN_COL_NR_COLUMNS
+};
+
+struct bin_dump_column {
+    uint32_t id;        /* enum bin_dump_column_id */
+    uint32_t elem_size; /* size in bytes of a single entry */
+    uint64_t offset;    /* byte offset of the column block in the file */
+    uint64_t length;    /* length in bytes of the column block */
+};
+
+struct bin_dump_header {
+    char magic[8];          /* BIN_DUMP_MAGIC */
+    uint32_t version;       /* BIN_DUMP_VERSION */
+    uint32_t header_size;   /* sizeof(struct bin_dump_header) */
+    uint64_t fs_magic;      /* file system magic value */
+    uint32_t sector_size;   /* sector size of addresses and sizes */
+    uint32_t segment_shift; /* F2FS sector to segment shift */
+    uint64_t zone_size;     /* zone size in sectors */
+    uint32_t nr_zones;      /* entries in the zone columns */
+    uint32_t nr_files;      /* entries in the file columns */
+    uint64_t nr_extents;    /* entries in the extent columns */
+    uint32_t nr_columns;    /* BIN_COL_NR_COLUMNS */
+    uint32_t reserved;
+    struct bin_dump_column columns[BIN_COL_NR_COLUMNS];
+};
+
+#define BIN_INDEX_NO_FILE UINT32_MAX
+
+/* stat() values of a mapped file, indexed by its fileID */
+struct bin_index_file {
+    char *path;     /* absolute path of the file */
+    uint64_t ino;   /* inode number of the file */
+    uint64_t size;  /* size of the file in bytes */
+    uint64_t mtime; /* modification time of the file in ns */
+};
+
+/* zonemap index mapped with bin_index_open() */
+struct bin_index {
+    const char *data;                     /* mmap()'ed index file */
+    size_t size;                          /* size in bytes of the index file */
+    const struct bin_dump_header *header; /* header at the start of data */
+};
+
+/* file holding an address, see bin_index_find_lba() */
+struct bin_index_lba {
+    const char *path;     /* absolute path of the file */
+    uint32_t ext_nr;      /* number of the extent in the file, from 0 */
+    uint32_t nr_extents;  /* number of extents of the file */
+    uint64_t logical_blk; /* logical address of the LBA in the file */
+    uint8_t seg_type;     /* segment type, BIN_DUMP_NO_TYPE if unknown */
+};
+
+extern int bin_dump_data(struct control *);
+extern int bin_dump_index(struct control *, const char *, const char *,
+                          struct bin_index_file *);
+extern struct bin_index *bin_index_open(struct control *, const char *,
+                                        const char *);
+extern void bin_index_close(struct bin_index *);
+extern uint32_t bin_index_find_file(struct bin_index *, const char *);
+extern int bin_index_find_lba(struct bin_index *, uint64_t,
+                              struct bin_index_lba *);
+extern int bin_index_file_is_fresh(struct control *, struct bin_index *,
+                                   uint32_t, struct stat *);
+extern int bin_index_zones_are_fresh(struct control *, struct bin_index *,
+                                     uint32_t, uint32_t);
+extern int bin_index_load_file(struct control *, struct bin_index *, uint32_t,
+                               char *);
+extern int bin_index_load_zones(struct control *, struct bin_index *,
+                                uint32_t, uint32_t);
+
+#endif
@@ -324,14 +324,25 @@ struct segment_manager {
     struct segment_info segments[];
 };
 
-extern struct f2fs_super_block f2fs_sb;
-extern struct f2fs_checkpoint f2fs_cp;
-
-extern void f2fs_read_super_block(char *);
-extern void f2fs_show_super_block();
-extern void f2fs_read_checkpoint(char *);
-extern void f2fs_show_checkpoint();
-struct f2fs_nat_entry *f2fs_get_inode_nat_entry(char *, uint32_t);
+/*
+ * F2FS metadata of a single mount, read by f2fs_read_super_block(). The NAT
+ * offsets track where f2fs_get_inode_nat_entry() continues its search, when
+ * called again for the same inode.
+ *
+ * */
+struct f2fs_sb_info {
+    struct f2fs_super_block sb; /* superblock of the mount */
+    uint32_t nat_block_offset;  /* tracking the nat block traversal */
+    uint32_t nat_entry_offset;  /* tracking offset to start at in nat_blocks */
+    struct f2fs_checkpoint cp;  /* checkpoint, see f2fs_read_checkpoint() */
+};
+
+extern struct f2fs_sb_info *f2fs_read_super_block(char *);
+extern void f2fs_show_super_block(struct f2fs_sb_info *);
+extern void f2fs_read_checkpoint(struct f2fs_sb_info *, char *);
+extern void f2fs_show_checkpoint(struct f2fs_sb_info *);
+struct f2fs_nat_entry *f2fs_get_inode_nat_entry(struct f2fs_sb_info *, char *,
+                                                uint32_t);
 struct f2fs_node *f2fs_get_node_block(char *, uint32_t);
 extern void f2fs_show_inode_info(struct f2fs_inode *);
 extern fs_manager_cleanup f2fs_fs_manager_cleanup();
@@ -339,7 +350,7 @@ extern fs_info_init f2fs_fs_info_init();
 extern fs_info_show f2fs_fs_info_show();
 extern fs_info_cleanup f2fs_fs_info_cleanup();
 extern uint32_t get_fs_info_bytes();
-extern void *f2fs_fs_manager_init();
+extern void *f2fs_fs_manager_init(struct f2fs_sb_info *, char *);
 
 static inline int IS_INODE(struct f2fs_node *node) {
     return ((node)->footer.nid == (node)->footer.ino);
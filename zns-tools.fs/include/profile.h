@@ -0,0 +1,113 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Profiling of the phases of a run (e.g., zns.segmap --profile)
+ *
+ * Phases are timed with the monotonic clock and do not overlap, each one
+ * covering only the calls of its kind (e.g., the FIEMAP ioctl()s of
+ * get_extents(), not the extent insertion that follows). Calls of the backend
+ * and fsync() are counted by type, and the memory of the zonemap (zone table
+ * and extent nodes) is accounted as it is allocated and freed.
+ *
+ * All hooks only test profile.enabled when profiling is off, such that they
+ * can stay in the hot paths.
+ *
+ * */
+
+enum profile_phase {
+    PROFILE_DIR_WALK = 0, /* reading the entries of directories */
+    PROFILE_FSYNC,        /* fsync() of the mapped files */
+    PROFILE_FIEMAP,       /* FIEMAP ioctl()s of the mapped files */
+    PROFILE_ZONE_REPORT,  /* zone reports of all ZNS devices */
+    PROFILE_PROCFS,       /* reading and parsing F2FS segment_info */
+    PROFILE_SORT,         /* sorted insertion of extents, sorting files */
+    PROFILE_PRINT,        /* rendering the report */
+    PROFILE_JSON,         /* rendering the json dump */
+    PROFILE_NR_PHASES
+};
+
+enum profile_syscall {
+    PROFILE_SYS_OPEN = 0,
+    PROFILE_SYS_IOCTL,
+    PROFILE_SYS_PREAD,
+    PROFILE_SYS_STATFS,
+    PROFILE_SYS_FSTAT,
+    PROFILE_SYS_READLINK,
+    PROFILE_SYS_READDIR, /* counted once for each directory */
+    PROFILE_SYS_PROCFS,  /* counted once for each procfs file */
+    PROFILE_SYS_FSYNC,
+    PROFILE_NR_SYSCALLS
+};
+
+struct profile {
+    uint8_t enabled;                         /* flag if profiling is on */
+    uint64_t start;                          /* ns of profile_init() */
+    uint64_t phase_ns[PROFILE_NR_PHASES];    /* ns spent in each phase */
+    uint64_t phase_ctr[PROFILE_NR_PHASES];   /* times each phase was run */
+    uint64_t syscall_ctr[PROFILE_NR_SYSCALLS]; /* calls of each type */
+    uint64_t alloc_ctr;      /* number of zonemap allocations */
+    uint64_t alloc_bytes;    /* bytes allocated for the zonemap */
+    uint64_t zonemap_bytes;  /* bytes of the zonemap currently allocated */
+    uint64_t zonemap_peak;   /* peak of zonemap_bytes */
+};
+
+extern struct profile profile;
+extern const char *profile_phase_names[PROFILE_NR_PHASES];
+extern const char *profile_syscall_names[PROFILE_NR_SYSCALLS];
+
+#define PROFILE_ENABLED() __builtin_expect(profile.enabled, 0)
+
+static inline uint64_t profile_clock() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* returns: the start of a phase, to pass to profile_stop() */
+static inline uint64_t profile_start() {
+    return PROFILE_ENABLED() ? profile_clock() : 0;
+}
+
+static inline void profile_stop(enum profile_phase phase, uint64_t start) {
+    if (PROFILE_ENABLED()) {
+        __atomic_fetch_add(&profile.phase_ns[phase], profile_clock() - start,
+                           __ATOMIC_RELAXED);
+        __atomic_fetch_add(&profile.phase_ctr[phase], 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* zone reports of several devices are issued in parallel, hence atomics */
+static inline void profile_syscall(enum profile_syscall call) {
+    if (PROFILE_ENABLED()) {
+        __atomic_fetch_add(&profile.syscall_ctr[call], 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * Account bytes allocated (positive) or freed (negative) for the zonemap, which
+ * is only modified by the thread mapping the files
+ *
+ * */
+static inline void profile_zonemap(int64_t bytes) {
+    if (PROFILE_ENABLED()) {
+        profile.zonemap_bytes += bytes;
+        if (bytes > 0) {
+            profile.alloc_ctr++;
+            profile.alloc_bytes += bytes;
+        }
+        if (profile.zonemap_bytes > profile.zonemap_peak) {
+            profile.zonemap_peak = profile.zonemap_bytes;
+        }
+    }
+}
+
+extern void profile_init();
+extern void profile_report();
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __REPORT_H__
+#define __REPORT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Buffered report writer. Report lines are formatted by hand into a per-thread
+ * buffer and written out with write() once the buffer fills up, avoiding the
+ * printf() format parsing and stdio locking for every printed extent.
+ *
+ * Output goes to stdout, unless redirected to a file with rep_set_fd(), or kept
+ * in memory between rep_capture() and rep_capture_end().
+ *
+ * Widths follow the printf() convention: a negative width left-justifies the
+ * value (e.g., rep_hex(v, -10) is equivalent to "%#-10" PRIx64).
+ *
+ * */
+
+#define REP_BUF_SIZE (1 << 20) /* 1MiB buffer per thread */
+
+extern void rep_write(const char *, size_t);
+extern void rep_str(const char *, int);
+extern void rep_dec(uint64_t, int);
+extern void rep_hex(uint64_t, int);
+extern void rep_hex_zero(uint64_t, int);
+extern void rep_double(double, int);
+extern void rep_flush();
+extern void rep_set_fd(int);
+extern void rep_capture();
+extern void rep_capture_end(char **, size_t *);
+
+/* append a string literal, the length is known at compile time */
+#define REP_LIT(s) rep_write(s, sizeof(s) - 1)
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+/*
+ * Query API of zns-toolsd. The daemon keeps the zonemap of a directory in
+ * memory, clients connect to its Unix socket, send a single query line and read
+ * the response until the daemon closes the connection. Queries are:
+ *
+ *   extents <path>  extents of the file (absolute path)
+ *   zone <number>   files with extents in the zone (as numbered in reports)
+ *   stats           statistics of all mapped files
+ *   refresh         refresh the mappings, instead of waiting for the interval
+ *
+ * Responses are text reports, a failed query responds with a line starting with
+ * SERVER_ERROR.
+ *
+ * */
+
+#define ZNS_TOOLSD_SOCKET "/run/zns-toolsd.sock"
+#define SERVER_MAX_QUERY 4352 /* keyword of a query and a path of PATH_MAX */
+#define SERVER_ERROR "Error: "
+
+extern int server_query(const char *, const char *);
+
+#endif
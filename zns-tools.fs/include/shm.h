@@ -0,0 +1,71 @@
+#ifndef __SHM_H__
+#define __SHM_H__
+
+#include <stdint.h>
+
+/*
+ * Zonemap summary published in a POSIX shared memory segment. A collector
+ * (e.g., zns-toolsd -m) creates the segment and publishes the summary after
+ * every update of its zonemap, any number of readers map the segment read-only
+ * and take consistent snapshots without locking or IPC to the collector.
+ *
+ * Updates are protected by a seqlock: the collector increments seq to an odd
+ * value before updating the summary and to the next even value after it.
+ * Readers copy the summary and retry if seq was odd or changed during the copy,
+ * see shm_zonemap_snapshot().
+ *
+ * All addresses and sizes are in bytes of the file system address space, zones
+ * are in the order of the zonemap (the zones of all ZNS devices).
+ *
+ * */
+
+#define ZNS_SHM_NAME "/zns-tools"
+#define ZNS_SHM_MAGIC 0x5A4E534D /* "ZNSM" */
+#define ZNS_SHM_VERSION 1
+
+/* dominant temperature of the data in a zone */
+enum shm_temp {
+    SHM_TEMP_NONE = 0, /* no extents or segment types are unknown */
+    SHM_TEMP_HOT,
+    SHM_TEMP_WARM,
+    SHM_TEMP_COLD,
+};
+
+struct shm_zone {
+    uint64_t start;       /* start address of the zone */
+    uint64_t capacity;    /* capacity of the zone */
+    uint64_t wp;          /* write pointer of the zone */
+    uint64_t valid_bytes; /* bytes of the mapped extents in the zone */
+    uint32_t extent_ctr;  /* number of extents in the zone */
+    uint32_t file_ctr;    /* number of files with extents in the zone */
+    uint8_t state;        /* zone condition (BLK_ZONE_COND_*) */
+    uint8_t temp;         /* dominant temperature (enum shm_temp) */
+    uint8_t reserved[6];
+};
+
+struct shm_zonemap {
+    uint32_t magic;       /* ZNS_SHM_MAGIC, 0 once the collector exited */
+    uint32_t version;     /* ZNS_SHM_VERSION */
+    uint64_t seq;         /* seqlock sequence, odd while being updated */
+    uint32_t nr_zones;    /* number of zones in zones[], fixed at creation */
+    uint32_t nr_files;    /* number of mapped files */
+    uint64_t extent_ctr;  /* number of mapped extents */
+    uint64_t valid_bytes; /* bytes of all mapped extents */
+    uint64_t nr_updates;  /* number of published updates */
+    uint64_t update_time; /* time of the last update (seconds since epoch) */
+    struct shm_zone zones[];
+};
+
+struct control;
+
+/* collector */
+extern struct shm_zonemap *shm_zonemap_create(const char *, uint32_t);
+extern void shm_zonemap_publish(struct control *, struct shm_zonemap *);
+extern void shm_zonemap_destroy(const char *, struct shm_zonemap *);
+
+/* readers */
+extern const struct shm_zonemap *shm_zonemap_open(const char *);
+extern struct shm_zonemap *shm_zonemap_snapshot(const struct shm_zonemap *);
+extern void shm_zonemap_close(const struct shm_zonemap *);
+
+#endif
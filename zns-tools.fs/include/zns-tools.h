@@ -1,7 +1,10 @@
 #ifndef __ZNS_TOOLS_H__
 #define __ZNS_TOOLS_H__
 
+#include "backend.h"
 #include "f2fs.h"
+#include "profile.h"
+#include "report.h"
 
 #include <fcntl.h>
 #include <libgen.h>
@@ -26,14 +29,12 @@
 
 #include <linux/blkzoned.h>
 
-#include <json-c/json.h>
-
 #define F2FS_SEGMENT_BYTES 2097152
 
 #define MAX_FILE_LENGTH 50
 #define MAX_DEV_NAME 15
 
-#define ZNS_TOOLS_MAX_DEVS 2
+#define ZNS_TOOLS_MAX_DEVS MAX_DEVICES /* F2FS supports up to 8 devices */
 #define F2FS_SECS_PER_BLOCK 9
 
 #define BTRFS_MAGIC 0x9123683E
@@ -45,9 +46,14 @@ struct bdev {
     char link_name[MAX_PATH_LEN]; /* linkname from /dev/block/<major>:<minor> */
     uint8_t is_zoned;             /* flag if device is a zoned device */
     uint32_t nr_zones;            /* Number of zones on the ZNS device */
-    uint64_t zone_size; /* the size of a zone on the device ZNS in 512B or 4KiB
-                           depending on LBAF*/
-    uint32_t zone_mask; /* zone mask for bitwise AND */
+    uint64_t zone_size;   /* the size of a zone on the device ZNS in 512B or
+                             4KiB depending on LBAF*/
+    uint32_t zone_mask;   /* zone mask for bitwise AND */
+    uint64_t offset;      /* byte offset of the device in the file system
+                             address space (e.g., FIEMAP fe_physical) */
+    uint64_t end;         /* byte offset of the end of the device in the file
+                             system address space */
+    uint32_t zone_offset; /* zonemap index of the first zone of the device */
 };
 
 struct extent {
@@ -83,6 +89,18 @@ struct node {
     struct node *next;
 };
 
+#define SIZE_HIST_BUCKETS 64 /* bucket i has sizes [2^i, 2^(i+1)) */
+
+/*
+ * Histogram of extent or hole sizes (in 512B sectors), bucket 0 also holds
+ * sizes of 0.
+ *
+ * */
+struct size_hist {
+    uint64_t ctr;                        /* number of sizes in the buckets */
+    uint32_t buckets[SIZE_HIST_BUCKETS]; /* counters of the log2 buckets */
+};
+
 struct zone {
     uint32_t zone_number;      /* number of the zone */
     uint64_t start;            /* PBAS of the zone */
@@ -94,6 +112,8 @@ struct zone {
     uint32_t extent_ctr;       /* number of extents in the zone */
     struct node *extents_head; /* pointer to head of sorted singly linked list
                                   of the extents in the zone */
+    struct size_hist extent_hist; /* sizes of the extents in the zone */
+    struct size_hist hole_hist;   /* sizes of holes between extents */
 };
 
 struct zone_map {
@@ -102,6 +122,8 @@ struct zone_map {
     uint64_t
         cum_extent_size; /* Cumulative size of all extents in 512B sectors */
     uint32_t zone_ctr;   /* number of zones that hold extents */
+    struct size_hist extent_hist; /* sizes of all extents */
+    struct size_hist hole_hist;   /* sizes of all holes between extents */
     struct zone zones[];
 };
 
@@ -121,12 +143,23 @@ struct file_counter {
                                  file */
     uint32_t last_zone;       /* track the last zone number so we don't increase
                                  counters for extents in the same zone */
+    /* Fragmentation of the file, updated in get_extents() as extents arrive
+     * in logical order */
+    uint32_t frag_runs;      /* number of physically discontiguous runs */
+    uint32_t frag_zone_ctr;  /* number of distinct zones the file is in */
+    uint64_t frag_size;      /* cumulative size of the runs (in sectors) */
+    uint64_t frag_seek_dist; /* sum of the physical distances between the
+                                end of a run and the start of the next run */
+    uint64_t frag_last_pbae; /* PBAE of the last extent in logical order */
     /* void *fs_info; /1* other file system dependent data can be put here *1/
      */
 };
 
 struct file_counter_map {
     uint32_t file_ctr; /* indicate the number of file entries in *files */
+    uint32_t files_size; /* number of entries allocated in *files */
+    uint32_t *hash;      /* index + 1 of the file of each slot, by name */
+    uint32_t hash_mask;  /* number of slots in hash - 1 */
     struct file_counter files[]; /* track the file counters */
 };
 
@@ -135,18 +168,41 @@ typedef void (*fs_info_init)();
 typedef void (*fs_info_show)(void *, uint8_t, unsigned int);
 typedef void (*fs_info_cleanup)();
 
+struct control;
+
+/*
+ * Renders the zones in [start, end) with the report writer, and accumulates
+ * any statistics into the zeroed task accumulator (see render_zones()).
+ * */
+typedef void (*zone_render)(struct control *, uint32_t, uint32_t, void *);
+/* reduce a task accumulator into the final one, called in zone order */
+typedef void (*zone_reduce)(void *, void *);
+/* called with each extent of a file as it is added to the zonemap, the extent
+ * stays valid until the file is removed from the zonemap */
+typedef void (*extent_added)(struct control *, struct extent *);
+
+#define RENDER_MIN_EXTENTS 16384 /* render smaller zonemaps single threaded */
+#define RENDER_TASKS_PER_THREAD 4
+#define RENDER_TASK_EXTENTS 4096 /* extents of a task, bounds its output */
+#define RENDER_TASKS_IN_FLIGHT 2 /* rendered tasks per thread not written yet */
+
 struct control {
     char *argv;         /* program name being run */
     struct bdev bdev;   /* block device file is located on */
-    struct bdev znsdev; /* additional ZNS device if file F2FS reporst file on
-                            prior bdev */
+    struct bdev znsdev[ZNS_TOOLS_MAX_DEVS]; /* ZNS devices in the order of the
+                                               file system address space, the
+                                               zonemap holds their zones in the
+                                               same order */
+    uint8_t nr_znsdevs; /* number of ZNS devices in znsdev */
     uint8_t multi_dev;  /* flag if device setup is using bdev + ZNS */
     uint8_t log_level;  /* Logging level */
     uint8_t show_holes; /* cmd_line flag to show holes */
     uint8_t show_flags; /* cmd_line flag to show extent flags */
+    uint8_t show_hist;  /* cmd_line flag to show size histograms */
     uint8_t json_dump;  /* dump collected data as json */
     char *json_file;    /* json file name to output data to */
-    json_object *json_root; /* root json object for data output */
+    uint8_t bin_dump;       /* dump collected data in binary column format */
+    char *bin_file;         /* binary dump file name to output data to */
     uint8_t info;           /* cmd_line flag to show info */
     uint64_t fs_magic;      /* store the file system magic value */
 
@@ -178,9 +234,7 @@ struct control {
     uint32_t nr_files;      /* Total number of files in segmap */
     uint32_t exclude_flags; /* Flags of extents that are excluded in maintaining
                                mapping */
-    uint64_t offset;        /* offset for the ZNS - only in multi_dev setup */
-    uint64_t
-        cur_segment; /* tracking which segment we are currently in for segmap */
+    uint32_t nr_threads; /* threads for rendering reports, 0 for all CPUs */
     uint8_t show_superblock; /* zns.inode flag to print superblock */
     uint8_t show_checkpoint; /* zns.inode flag to print checkpoint */
     uint8_t procfs; /* zns.segmap use procfs entry segment_info from F2FS */
@@ -198,8 +252,11 @@ struct control {
     struct zone_map *zonemap; /* track extents in zones with zone information */
     struct file_counter_map
         *file_counter_map; /* tracking extent counters per file */
+    uint32_t *file_counter_ids; /* file_counter_map index of each fileID */
+    uint32_t file_counter_ids_size; /* entries allocated in file_counter_ids */
+    uint8_t *file_zones; /* bitmap of zones the file in get_extents() is in */
     void *fs_super_block;  /* if parsed by the fs lib, can store the super block
-                              in the control */
+                              in the control (struct f2fs_sb_info for F2FS) */
     void *fs_manager; /* any global file system related info can be set by the
                          fs lib */
     fs_manager_cleanup
@@ -214,35 +271,54 @@ struct control {
                                   to work correctly */
     fs_info_cleanup fs_info_cleanup; /* function pointer to cleanup the fs_info
                                         - free its memory */
+    extent_added extent_added; /* called by get_extents() and
+                                  load_file_extents() for each added extent,
+                                  can be NULL */
 };
 
-extern struct control ctrl;
-
-extern uint8_t is_zoned(char *);
-extern void init_dev(struct stat *);
-extern uint8_t init_znsdev();
+extern uint8_t is_zoned(struct control *, char *);
+extern void init_dev(struct control *, struct stat *);
+extern uint8_t init_znsdev(struct control *, struct bdev *);
+extern void init_zone_map(struct control *);
+extern int update_zone_map(struct control *);
 extern uint64_t get_dev_size(char *);
-extern uint64_t get_zone_size();
-extern uint32_t get_nr_zones();
-extern uint32_t get_zone_number(uint64_t);
-extern void cleanup_ctrl();
-extern void cleanup_zonemap();
-extern void print_zone_info(uint32_t);
-extern int get_extents(char *, int, struct stat *);
+extern uint64_t get_zone_size(struct control *, char *);
+extern uint32_t get_nr_zones(char *);
+extern uint32_t get_zone_number(struct control *, uint64_t);
+extern struct bdev *get_fs_dev(struct control *, uint64_t);
+extern struct bdev *get_zone_dev(struct control *, uint32_t);
+extern struct control *alloc_ctrl();
+extern void cleanup_ctrl(struct control *);
+extern void cleanup_zonemap(struct control *);
+extern void print_zone_info(struct control *, uint32_t);
+extern void rep_zone_info(struct control *, uint32_t);
+extern int sync_file(int);
+extern int get_extents(struct control *, char *, int, struct stat *);
+extern int load_file_extents(struct control *, struct extent *, uint32_t);
+extern struct node *add_extent_to_zone_list(struct control *, struct extent);
+extern uint32_t increase_file_extent_counter(struct control *, char *);
 extern int contains_element(uint32_t[], uint32_t, uint32_t);
 extern void map_extents(struct extent_map *);
 extern void show_extent_flags(uint32_t);
-extern uint32_t get_file_extent_count(char *);
-extern void increase_file_segment_counter(char *, unsigned int, unsigned int,
-                                          void *, uint64_t);
-extern void set_super_block_info(struct f2fs_super_block);
-extern void set_fs_magic(char *);
-extern void init_ctrl(char *, int, struct stat *);
-extern void print_fiemap_report();
+extern uint32_t get_file_extent_count(struct control *, char *);
+extern void remove_file_extents(struct control *, uint8_t *);
+extern void clear_file_extents(struct control *);
+extern struct file_counter *get_extent_file_counter(struct control *,
+                                                    struct extent *);
+extern uint64_t size_hist_percentile(struct size_hist *, uint32_t);
+extern void print_zone_size_hist(struct control *, uint32_t);
+extern void print_size_hist(struct size_hist *, struct size_hist *);
+extern void set_super_block_info(struct control *,
+                                 struct f2fs_super_block *);
+extern void set_fs_magic(struct control *, char *);
+extern void init_ctrl(struct control *, char *, int, struct stat *);
+extern void print_fiemap_report(struct control *);
+extern void render_zones(struct control *, zone_render, zone_reduce, void *,
+                         size_t, const char *);
 
 #define INFO(n, fmt, ...)                                                      \
     do {                                                                       \
-        if (ctrl.log_level >= n) {                                             \
+        if (ctrl->log_level >= n) {                                            \
             printf("\033[1;33mInfo\033[0m: " fmt, ##__VA_ARGS__);              \
         }                                                                      \
     } while (0)
@@ -260,8 +336,8 @@ extern void print_fiemap_report();
         "----------------------------------------\n");
 
 #define HOLE_FORMATTER                                                         \
-    MSG("-----------------------------------------"                            \
-        "--------------------------------------------------------"             \
-        "--------\n")
+    REP_LIT("-----------------------------------------"                        \
+            "--------------------------------------------------------"         \
+            "--------\n")
 
 #endif
@@ -0,0 +1,780 @@
+#include "backend.h"
+#include "profile.h"
+#include "zns-tools.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+/* records of the same call in a replayed capture, in recorded order */
+struct replay_key {
+    const struct backend_record *rec; /* first record of the call, NULL if
+                                         the slot is empty */
+    uint64_t last;                    /* index of the last record */
+    uint64_t cursor;                  /* index of the record returned next */
+};
+
+static struct {
+    enum backend_mode mode;
+    pthread_mutex_t lock; /* serializes recording and replay cursors */
+    FILE *capture;        /* capture being recorded */
+    const char *data;     /* mmap()'ed capture being replayed */
+    size_t size;          /* size in bytes of data */
+    const struct backend_record **records; /* records of data, in order */
+    uint64_t *next;          /* index + 1 of the next record of the call */
+    uint64_t nr_records;     /* number of records */
+    struct replay_key *keys; /* hash table of the calls */
+    uint64_t keys_mask;      /* number of slots in keys - 1 */
+    char **buffers;          /* procfs contents read through fmemopen() */
+    uint32_t nr_buffers;     /* number of buffers */
+    uint8_t registered;      /* flag if backend_cleanup() is registered */
+} backend = {.mode = BACKEND_LIVE, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+static const char *record_path(const struct backend_record *rec) {
+    return (const char *)(rec + 1);
+}
+
+static const void *record_data(const struct backend_record *rec) {
+    return record_path(rec) + rec->path_len;
+}
+
+static uint64_t record_size(const struct backend_record *rec) {
+    return (sizeof(struct backend_record) + rec->path_len + rec->data_len +
+            7) &
+           ~7ULL;
+}
+
+/* FNV-1a of the call, path, and arguments */
+static uint64_t hash_call(uint32_t type, const char *path,
+                          const uint64_t args[3]) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const unsigned char *bytes;
+
+    hash = (hash ^ type) * 0x100000001b3ULL;
+    for (bytes = (const unsigned char *)path; *bytes; bytes++) {
+        hash = (hash ^ *bytes) * 0x100000001b3ULL;
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        hash = (hash ^ args[i]) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static int is_same_call(const struct backend_record *rec, uint32_t type,
+                        const char *path, const uint64_t args[3]) {
+    return rec->type == type && rec->args[0] == args[0] &&
+           rec->args[1] == args[1] && rec->args[2] == args[2] &&
+           strcmp(record_path(rec), path) == 0;
+}
+
+static struct replay_key *find_key(uint32_t type, const char *path,
+                                   const uint64_t args[3]) {
+    uint64_t slot = hash_call(type, path, args) & backend.keys_mask;
+
+    while (backend.keys[slot].rec &&
+           !is_same_call(backend.keys[slot].rec, type, path, args)) {
+        slot = (slot + 1) & backend.keys_mask;
+    }
+
+    return &backend.keys[slot];
+}
+
+/*
+ * Map a capture and index its records by call.
+ *
+ * @capture: path of the capture file
+ *
+ * returns: EXIT_SUCCESS, EXIT_FAILURE if the capture is missing or invalid
+ *
+ * */
+static int load_capture(const char *capture) {
+    const struct backend_capture_header *header;
+    const struct backend_record *rec;
+    struct replay_key *key;
+    struct stat stats;
+    uint64_t offset, nr_slots = 1;
+    int fd;
+
+    fd = open(capture, O_RDONLY);
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (fstat(fd, &stats) < 0 ||
+        (size_t)stats.st_size < sizeof(struct backend_capture_header)) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    backend.size = stats.st_size;
+    backend.data = mmap(NULL, backend.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (backend.data == MAP_FAILED) {
+        backend.data = NULL;
+        return EXIT_FAILURE;
+    }
+
+    header = (const struct backend_capture_header *)backend.data;
+    if (memcmp(header->magic, BACKEND_CAPTURE_MAGIC,
+               sizeof(BACKEND_CAPTURE_MAGIC)) != 0 ||
+        header->version != BACKEND_CAPTURE_VERSION ||
+        header->header_size != sizeof(struct backend_capture_header)) {
+        return EXIT_FAILURE;
+    }
+
+    /* records are variable sized, count them before indexing */
+    for (offset = header->header_size;
+         offset + sizeof(struct backend_record) <= backend.size;
+         offset += record_size(rec)) {
+        rec = (const struct backend_record *)(backend.data + offset);
+        if (rec->path_len == 0 || offset + record_size(rec) > backend.size ||
+            record_path(rec)[rec->path_len - 1] != '\0') {
+            return EXIT_FAILURE;
+        }
+        backend.nr_records++;
+    }
+
+    while (nr_slots < backend.nr_records * 2) {
+        nr_slots <<= 1;
+    }
+    backend.keys_mask = nr_slots - 1;
+
+    backend.records =
+        malloc(sizeof(struct backend_record *) * (backend.nr_records + 1));
+    backend.next = calloc(backend.nr_records + 1, sizeof(uint64_t));
+    backend.keys = calloc(nr_slots, sizeof(struct replay_key));
+    if (!backend.records || !backend.next || !backend.keys) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    offset = header->header_size;
+    for (uint64_t i = 0; i < backend.nr_records; i++) {
+        rec = (const struct backend_record *)(backend.data + offset);
+        backend.records[i] = rec;
+        offset += record_size(rec);
+
+        key = find_key(rec->type, record_path(rec), rec->args);
+        if (!key->rec) {
+            key->rec = rec;
+            key->cursor = i;
+        } else {
+            backend.next[key->last] = i + 1;
+        }
+        key->last = i;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Select the backend of the device and file system accesses, for the entire
+ * process. Recording starts a new capture, and is finished by
+ * backend_cleanup(), which runs at exit.
+ *
+ * @mode: enum backend_mode to use
+ * @capture: path of the capture to record to or replay from, unused for
+ * BACKEND_LIVE
+ *
+ * returns: EXIT_SUCCESS, EXIT_FAILURE if the capture cannot be created, or is
+ * missing or invalid
+ *
+ * */
+int backend_init(enum backend_mode mode, const char *capture) {
+    struct backend_capture_header header;
+
+    backend_cleanup();
+
+    if (mode == BACKEND_RECORD) {
+        backend.capture = fopen(capture, "w");
+        if (!backend.capture) {
+            return EXIT_FAILURE;
+        }
+
+        memset(&header, 0, sizeof(struct backend_capture_header));
+        memcpy(header.magic, BACKEND_CAPTURE_MAGIC,
+               sizeof(BACKEND_CAPTURE_MAGIC));
+        header.version = BACKEND_CAPTURE_VERSION;
+        header.header_size = sizeof(struct backend_capture_header);
+
+        if (fwrite(&header, sizeof(header), 1, backend.capture) != 1) {
+            fclose(backend.capture);
+            backend.capture = NULL;
+            return EXIT_FAILURE;
+        }
+    } else if (mode == BACKEND_REPLAY &&
+               load_capture(capture) == EXIT_FAILURE) {
+        backend_cleanup();
+        return EXIT_FAILURE;
+    }
+
+    backend.mode = mode;
+
+    if (!backend.registered) {
+        atexit(backend_cleanup);
+        backend.registered = 1;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Finish recording or replaying, and return to the live backend.
+ *
+ * */
+void backend_cleanup() {
+    if (backend.capture) {
+        fclose(backend.capture);
+        backend.capture = NULL;
+    }
+
+    if (backend.data) {
+        munmap((void *)backend.data, backend.size);
+        backend.data = NULL;
+    }
+
+    for (uint32_t i = 0; i < backend.nr_buffers; i++) {
+        free(backend.buffers[i]);
+    }
+    free(backend.buffers);
+    backend.buffers = NULL;
+    backend.nr_buffers = 0;
+
+    free(backend.records);
+    free(backend.next);
+    free(backend.keys);
+    backend.records = NULL;
+    backend.next = NULL;
+    backend.keys = NULL;
+    backend.nr_records = 0;
+
+    backend.mode = BACKEND_LIVE;
+}
+
+enum backend_mode backend_get_mode() { return backend.mode; }
+
+/*
+ * Append a call and its result to the capture.
+ *
+ * @type: enum backend_call of the call
+ * @path: path the call was issued on
+ * @args: arguments identifying the call
+ * @ret: return value of the call
+ * @data: data returned by the call
+ * @data_len: bytes of data
+ *
+ * */
+static void record_call(uint32_t type, const char *path,
+                        const uint64_t args[3], int ret, const void *data,
+                        uint64_t data_len) {
+    static const char pad[8];
+    struct backend_record rec;
+    uint64_t pad_len;
+    int err = errno;
+
+    memset(&rec, 0, sizeof(struct backend_record));
+    rec.type = type;
+    rec.ret = ret;
+    rec.err = ret < 0 ? err : 0;
+    rec.path_len = strlen(path) + 1;
+    memcpy(rec.args, args, sizeof(rec.args));
+    rec.data_len = data_len;
+    pad_len = record_size(&rec) - sizeof(rec) - rec.path_len - data_len;
+
+    pthread_mutex_lock(&backend.lock);
+    if (fwrite(&rec, sizeof(rec), 1, backend.capture) != 1 ||
+        fwrite(path, rec.path_len, 1, backend.capture) != 1 ||
+        (data_len > 0 && fwrite(data, data_len, 1, backend.capture) != 1) ||
+        (pad_len > 0 && fwrite(pad, pad_len, 1, backend.capture) != 1)) {
+        ERR_MSG("Failed writing capture\n");
+    }
+    pthread_mutex_unlock(&backend.lock);
+
+    errno = err;
+}
+
+/*
+ * Get the next recorded result of a call.
+ *
+ * @type: enum backend_call of the call
+ * @path: path the call is issued on
+ * @args: arguments identifying the call
+ *
+ * returns: the record, NULL with errno set to ENODATA if the call was not
+ * recorded
+ *
+ * */
+static const struct backend_record *replay_call(uint32_t type,
+                                                const char *path,
+                                                const uint64_t args[3]) {
+    const struct backend_record *rec = NULL;
+    struct replay_key *key;
+
+    pthread_mutex_lock(&backend.lock);
+    key = find_key(type, path, args);
+    if (key->rec) {
+        rec = backend.records[key->cursor];
+        if (backend.next[key->cursor]) {
+            key->cursor = backend.next[key->cursor] - 1;
+        }
+    }
+    pthread_mutex_unlock(&backend.lock);
+
+    if (!rec) {
+        errno = ENODATA;
+    } else if (rec->ret < 0) {
+        errno = rec->err;
+    }
+
+    return rec;
+}
+
+/*
+ * Open a device or file read-only. Replayed calls return a descriptor of
+ * /dev/null, such that callers can fsync() and close() it as usual.
+ *
+ * @path: path of the device or file
+ *
+ * returns: file descriptor, -1 with errno set on failure
+ *
+ * */
+int backend_open(const char *path) {
+    const uint64_t args[3] = {0};
+    const struct backend_record *rec;
+    int fd;
+
+    profile_syscall(PROFILE_SYS_OPEN);
+
+    if (backend.mode == BACKEND_REPLAY) {
+        rec = replay_call(BACKEND_CALL_OPEN, path, args);
+        if (!rec || rec->ret < 0) {
+            return -1;
+        }
+
+        return open("/dev/null", O_RDONLY);
+    }
+
+    fd = open(path, O_RDONLY);
+
+    if (backend.mode == BACKEND_RECORD) {
+        record_call(BACKEND_CALL_OPEN, path, args, fd < 0 ? -1 : 0, NULL, 0);
+    }
+
+    return fd;
+}
+
+/*
+ * Bytes of the argument of an ioctl() that the call fills, and identifying
+ * arguments of the call.
+ *
+ * @req: ioctl() request
+ * @arg: argument of the request
+ * @args: set to the arguments identifying the call
+ * @done: if the call was issued, such that variable sized results are known
+ *
+ * returns: bytes of arg the call fills (at most, if !done)
+ *
+ * */
+static size_t ioctl_data_len(unsigned long req, void *arg, uint64_t args[3],
+                             uint8_t done) {
+    struct blk_zone_report *hdr = (struct blk_zone_report *)arg;
+    struct fiemap *fiemap = (struct fiemap *)arg;
+
+    args[0] = req;
+
+    switch (req) {
+    case BLKSSZGET:
+        return sizeof(int);
+    case BLKGETSIZE64:
+        return sizeof(uint64_t);
+    case BLKGETZONESZ:
+    case BLKGETNRZONES:
+        return sizeof(uint32_t);
+    case BLKREPORTZONE:
+        if (!done) {
+            args[1] = hdr->sector;
+            args[2] = hdr->nr_zones;
+        }
+        return sizeof(struct blk_zone_report) +
+               sizeof(struct blk_zone) * hdr->nr_zones;
+    case FS_IOC_FIEMAP:
+        if (!done) {
+            args[1] = fiemap->fm_start;
+            args[2] = fiemap->fm_extent_count;
+        }
+        return sizeof(struct fiemap) +
+               sizeof(struct fiemap_extent) *
+                   (done ? fiemap->fm_mapped_extents
+                         : fiemap->fm_extent_count);
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Issue an ioctl() on an opened device or file. Only the requests of the
+ * libraries are recorded (zone reports, zone and device sizes, FIEMAP).
+ *
+ * @fd: file descriptor returned by backend_open()
+ * @path: path fd was opened with
+ * @req: ioctl() request
+ * @arg: argument of the request
+ *
+ * returns: return value of ioctl(), -1 with errno set on failure
+ *
+ * */
+int backend_ioctl(int fd, const char *path, unsigned long req, void *arg) {
+    const struct backend_record *rec;
+    uint64_t args[3] = {0};
+    size_t len;
+    int ret;
+
+    profile_syscall(PROFILE_SYS_IOCTL);
+
+    if (backend.mode == BACKEND_LIVE) {
+        return ioctl(fd, req, arg);
+    }
+
+    len = ioctl_data_len(req, arg, args, 0);
+
+    if (backend.mode == BACKEND_REPLAY) {
+        rec = replay_call(BACKEND_CALL_IOCTL, path, args);
+        if (!rec) {
+            return -1;
+        }
+
+        memcpy(arg, record_data(rec),
+               rec->data_len < len ? rec->data_len : len);
+
+        return rec->ret;
+    }
+
+    ret = ioctl(fd, req, arg);
+    len = ret < 0 ? 0 : ioctl_data_len(req, arg, args, 1);
+    record_call(BACKEND_CALL_IOCTL, path, args, ret, arg, len);
+
+    return ret;
+}
+
+/*
+ * Read from an opened device.
+ *
+ * @fd: file descriptor returned by backend_open()
+ * @path: path fd was opened with
+ * @dest: buffer to read into
+ * @offset: byte offset to read from
+ * @size: bytes to read
+ *
+ * returns: bytes read, -1 with errno set on failure
+ *
+ * */
+int backend_pread(int fd, const char *path, void *dest, uint64_t offset,
+                  size_t size) {
+    const uint64_t args[3] = {offset, size, 0};
+    const struct backend_record *rec;
+    ssize_t ret;
+
+    profile_syscall(PROFILE_SYS_PREAD);
+
+    if (backend.mode == BACKEND_REPLAY) {
+        rec = replay_call(BACKEND_CALL_PREAD, path, args);
+        if (!rec) {
+            return -1;
+        }
+
+        memcpy(dest, record_data(rec), rec->data_len);
+
+        return rec->ret;
+    }
+
+    ret = pread(fd, dest, size, offset);
+
+    if (backend.mode == BACKEND_RECORD) {
+        record_call(BACKEND_CALL_PREAD, path, args, ret, dest,
+                    ret < 0 ? 0 : ret);
+    }
+
+    return ret;
+}
+
+/*
+ * Replay a call returning a fixed size struct.
+ *
+ * returns: return value of the call, -1 with errno set on failure
+ *
+ * */
+static int replay_struct(uint32_t type, const char *path, void *dest,
+                         size_t size) {
+    const uint64_t args[3] = {0};
+    const struct backend_record *rec;
+
+    rec = replay_call(type, path, args);
+    if (!rec) {
+        return -1;
+    }
+
+    memcpy(dest, record_data(rec), rec->data_len < size ? rec->data_len : size);
+
+    return rec->ret;
+}
+
+/*
+ * statfs() of a path (e.g., for the file system magic).
+ *
+ * */
+int backend_statfs(const char *path, struct statfs *s) {
+    const uint64_t args[3] = {0};
+    int ret;
+
+    profile_syscall(PROFILE_SYS_STATFS);
+
+    if (backend.mode == BACKEND_REPLAY) {
+        return replay_struct(BACKEND_CALL_STATFS, path, s,
+                             sizeof(struct statfs));
+    }
+
+    ret = statfs(path, s);
+
+    if (backend.mode == BACKEND_RECORD) {
+        record_call(BACKEND_CALL_STATFS, path, args, ret, s,
+                    ret < 0 ? 0 : sizeof(struct statfs));
+    }
+
+    return ret;
+}
+
+/*
+ * fstat() of a file opened with backend_open().
+ *
+ * @fd: file descriptor of the file
+ * @path: path fd was opened with
+ * @st: struct stat * to fill
+ *
+ * */
+int backend_fstat(int fd, const char *path, struct stat *st) {
+    const uint64_t args[3] = {0};
+    int ret;
+
+    profile_syscall(PROFILE_SYS_FSTAT);
+
+    if (backend.mode == BACKEND_REPLAY) {
+        return replay_struct(BACKEND_CALL_FSTAT, path, st,
+                             sizeof(struct stat));
+    }
+
+    ret = fstat(fd, st);
+
+    if (backend.mode == BACKEND_RECORD) {
+        record_call(BACKEND_CALL_FSTAT, path, args, ret, st,
+                    ret < 0 ? 0 : sizeof(struct stat));
+    }
+
+    return ret;
+}
+
+/*
+ * readlink() of a device link (e.g., /dev/block/<major>:<minor>).
+ *
+ * returns: bytes placed in buf (not NUL terminated), -1 with errno set on
+ * failure
+ *
+ * */
+ssize_t backend_readlink(const char *path, char *buf, size_t size) {
+    const uint64_t args[3] = {0};
+    const struct backend_record *rec;
+    ssize_t ret;
+
+    profile_syscall(PROFILE_SYS_READLINK);
+
+    if (backend.mode == BACKEND_REPLAY) {
+        rec = replay_call(BACKEND_CALL_READLINK, path, args);
+        if (!rec) {
+            return -1;
+        }
+
+        memcpy(buf, record_data(rec),
+               rec->data_len < size ? rec->data_len : size);
+
+        return rec->data_len < size ? (ssize_t)rec->data_len : (ssize_t)size;
+    }
+
+    ret = readlink(path, buf, size);
+
+    if (backend.mode == BACKEND_RECORD) {
+        record_call(BACKEND_CALL_READLINK, path, args, ret, buf,
+                    ret < 0 ? 0 : ret);
+    }
+
+    return ret;
+}
+
+/*
+ * Open a stream over contents held in memory until backend_cleanup().
+ *
+ * @buffer: malloc()'ed contents, owned by the backend
+ * @len: bytes of the contents
+ *
+ * */
+static FILE *open_buffer(char *buffer, size_t len) {
+    char **buffers;
+
+    buffers = realloc(backend.buffers,
+                      sizeof(char *) * (backend.nr_buffers + 1));
+    if (!buffers) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    backend.buffers = buffers;
+    backend.buffers[backend.nr_buffers++] = buffer;
+
+    /* fmemopen() of an empty buffer fails */
+    if (len == 0) {
+        return fopen("/dev/null", "r");
+    }
+
+    return fmemopen(buffer, len, "r");
+}
+
+/*
+ * Open a procfs file for reading (e.g., the F2FS segment_info). Recorded
+ * contents are read entirely at once, such that the capture holds a single
+ * snapshot of the file.
+ *
+ * @path: path of the procfs file
+ *
+ * returns: FILE * to fclose(), NULL with errno set on failure
+ *
+ * */
+FILE *backend_fopen_proc(const char *path) {
+    const uint64_t args[3] = {0};
+    const struct backend_record *rec;
+    char *buffer = NULL;
+    size_t len = 0, size = 0, read;
+    FILE *fp;
+
+    profile_syscall(PROFILE_SYS_PROCFS);
+
+    if (backend.mode == BACKEND_REPLAY) {
+        rec = replay_call(BACKEND_CALL_PROC, path, args);
+        if (!rec || rec->ret < 0) {
+            return NULL;
+        }
+
+        buffer = malloc(rec->data_len + 1);
+        if (!buffer) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        memcpy(buffer, record_data(rec), rec->data_len);
+
+        return open_buffer(buffer, rec->data_len);
+    }
+
+    fp = fopen(path, "r");
+
+    if (backend.mode != BACKEND_RECORD) {
+        return fp;
+    }
+
+    if (!fp) {
+        record_call(BACKEND_CALL_PROC, path, args, -1, NULL, 0);
+        return NULL;
+    }
+
+    /* procfs files have no size, read until the end */
+    do {
+        if (len == size) {
+            size = size ? size * 2 : 65536;
+            buffer = realloc(buffer, size);
+            if (!buffer) {
+                ERR_MSG("Failed memory allocation\n");
+            }
+        }
+        read = fread(buffer + len, 1, size - len, fp);
+        len += read;
+    } while (read > 0);
+    fclose(fp);
+
+    record_call(BACKEND_CALL_PROC, path, args, 0, buffer, len);
+
+    return open_buffer(buffer, len);
+}
+
+/*
+ * Read the entries of a directory, without "." and "..".
+ *
+ * @path: path of the directory
+ * @entries: set to the malloc()'ed entries, iterated with the
+ * BACKEND_DIRENT_*() macros, to be freed by the caller
+ * @len: set to the bytes of the entries
+ *
+ * returns: EXIT_SUCCESS, EXIT_FAILURE with errno set if the directory cannot
+ * be opened
+ *
+ * */
+int backend_read_dir(const char *path, char **entries, size_t *len) {
+    const uint64_t args[3] = {0};
+    const struct backend_record *rec;
+    struct dirent *dir;
+    DIR *directory;
+    size_t size = 0, name_len;
+    char *buffer = NULL;
+
+    profile_syscall(PROFILE_SYS_READDIR);
+
+    *len = 0;
+
+    if (backend.mode == BACKEND_REPLAY) {
+        rec = replay_call(BACKEND_CALL_DIR, path, args);
+        if (!rec || rec->ret < 0) {
+            return EXIT_FAILURE;
+        }
+
+        *entries = malloc(rec->data_len + 1);
+        if (!*entries) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        memcpy(*entries, record_data(rec), rec->data_len);
+        *len = rec->data_len;
+
+        return EXIT_SUCCESS;
+    }
+
+    directory = opendir(path);
+    if (!directory) {
+        if (backend.mode == BACKEND_RECORD) {
+            record_call(BACKEND_CALL_DIR, path, args, -1, NULL, 0);
+        }
+        return EXIT_FAILURE;
+    }
+
+    while ((dir = readdir(directory)) != NULL) {
+        if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) {
+            continue;
+        }
+
+        name_len = strlen(dir->d_name);
+        if (*len + name_len + 2 > size) {
+            size = size ? size * 2 : 4096;
+            while (*len + name_len + 2 > size) {
+                size *= 2;
+            }
+            buffer = realloc(buffer, size);
+            if (!buffer) {
+                ERR_MSG("Failed memory allocation\n");
+            }
+        }
+
+        buffer[*len] = dir->d_type;
+        memcpy(buffer + *len + 1, dir->d_name, name_len + 1);
+        *len += name_len + 2;
+    }
+    closedir(directory);
+
+    if (backend.mode == BACKEND_RECORD) {
+        record_call(BACKEND_CALL_DIR, path, args, 0, buffer, *len);
+    }
+
+    *entries = buffer ? buffer : calloc(1, 1);
+
+    return EXIT_SUCCESS;
+}
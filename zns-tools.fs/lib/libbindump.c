@@ -0,0 +1,1109 @@
+#include "bindump.h"
+#include <endian.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define BIN_DUMP_BUF_SIZE (1 << 20)
+#define BIN_DUMP_ALIGN(x) (((x) + 7) & ~7ULL)
+
+struct bin_writer {
+    int fd;       /* fd of the dump file */
+    char *buf;    /* BIN_DUMP_BUF_SIZE write buffer */
+    size_t len;   /* pending bytes in buf */
+    uint64_t pos; /* current offset in the file */
+};
+
+struct bin_file {
+    const char *name; /* file name, points into the extent of the zonemap */
+    uint32_t name_off; /* offset of the name in BIN_COL_FILE_NAMES */
+    uint32_t ext_ctr;  /* number of extents of the file in the zonemap */
+    uint64_t path_off; /* offset of the path in BIN_COL_FILE_PATHS */
+    uint64_t ext_start; /* index of the first BIN_COL_FILE_EXTENTS entry */
+};
+
+/* index columns of bin_dump_index(), the index is empty in plain dumps */
+struct bin_index_data {
+    struct bin_index_file *files; /* stat() values of each fileID */
+    const char *dir;              /* mapped directory */
+    uint64_t paths_len;           /* length in bytes of BIN_COL_FILE_PATHS */
+    uint64_t *extents;            /* BIN_COL_FILE_EXTENTS */
+    uint32_t *order;              /* BIN_COL_FILE_ORDER */
+};
+
+/* file path and index, to sort the file indexes by path */
+struct bin_path {
+    const char *path;
+    uint32_t id;
+};
+
+static const uint32_t bin_column_elem_size[BIN_COL_NR_COLUMNS] = {
+    [BIN_COL_ZONE_START] = sizeof(uint64_t),
+    [BIN_COL_ZONE_CAP] = sizeof(uint64_t),
+    [BIN_COL_ZONE_WP] = sizeof(uint64_t),
+    [BIN_COL_ZONE_STATE] = sizeof(uint8_t),
+    [BIN_COL_ZONE_EXT_START] = sizeof(uint64_t),
+    [BIN_COL_ZONE_EXT_CTR] = sizeof(uint32_t),
+    [BIN_COL_FILE_NAME_OFF] = sizeof(uint32_t),
+    [BIN_COL_FILE_EXT_CTR] = sizeof(uint32_t),
+    [BIN_COL_FILE_NAMES] = sizeof(char),
+    [BIN_COL_EXT_PHY_BLK] = sizeof(uint64_t),
+    [BIN_COL_EXT_LOGICAL_BLK] = sizeof(uint64_t),
+    [BIN_COL_EXT_LEN] = sizeof(uint64_t),
+    [BIN_COL_EXT_FILE_ID] = sizeof(uint32_t),
+    [BIN_COL_EXT_NR] = sizeof(uint32_t),
+    [BIN_COL_EXT_FLAGS] = sizeof(uint32_t),
+    [BIN_COL_EXT_SEG_TYPE] = sizeof(uint8_t),
+    [BIN_COL_EXT_VALID_BLOCKS] = sizeof(uint32_t),
+    [BIN_COL_ZONE_EXT_HIST] = sizeof(uint32_t),
+    [BIN_COL_ZONE_HOLE_HIST] = sizeof(uint32_t),
+    [BIN_COL_FILE_PATH_OFF] = sizeof(uint64_t),
+    [BIN_COL_FILE_PATHS] = sizeof(char),
+    [BIN_COL_FILE_INO] = sizeof(uint64_t),
+    [BIN_COL_FILE_SIZE] = sizeof(uint64_t),
+    [BIN_COL_FILE_MTIME] = sizeof(uint64_t),
+    [BIN_COL_FILE_EXT_START] = sizeof(uint64_t),
+    [BIN_COL_FILE_EXTENTS] = sizeof(uint64_t),
+    [BIN_COL_FILE_ORDER] = sizeof(uint32_t),
+    [BIN_COL_INDEX_DIR] = sizeof(char),
+};
+
+static void bin_flush(struct bin_writer *w) {
+    char *data = w->buf;
+    ssize_t ret;
+
+    while (w->len > 0) {
+        ret = write(w->fd, data, w->len);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ERR_MSG("Failed writing binary dump\n");
+        }
+        data += ret;
+        w->len -= ret;
+    }
+}
+
+static void bin_put(struct bin_writer *w, const void *data, size_t len) {
+    if (w->len + len > BIN_DUMP_BUF_SIZE) {
+        bin_flush(w);
+    }
+
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+    w->pos += len;
+}
+
+static void bin_put_u8(struct bin_writer *w, uint8_t value) {
+    bin_put(w, &value, sizeof(value));
+}
+
+static void bin_put_u32(struct bin_writer *w, uint32_t value) {
+    value = htole32(value);
+    bin_put(w, &value, sizeof(value));
+}
+
+static void bin_put_u64(struct bin_writer *w, uint64_t value) {
+    value = htole64(value);
+    bin_put(w, &value, sizeof(value));
+}
+
+/*
+ * Zero pad the file up to the provided offset
+ *
+ * */
+static void bin_pad(struct bin_writer *w, uint64_t offset) {
+    while (w->pos < offset) {
+        bin_put_u8(w, 0);
+    }
+}
+
+/*
+ * Collect the file table from the extents in the zonemap. Files are indexed
+ * by the fileID of their extents.
+ *
+ * @names_len: returns the length in bytes of the file name column
+ *
+ * returns: struct bin_file * array with ctrl->nr_files entries
+ *
+ * */
+static struct bin_file *bin_get_files(struct control *ctrl,
+                                      uint64_t *names_len) {
+    struct bin_file *files;
+    struct node *current;
+
+    files = calloc(ctrl->nr_files + 1, sizeof(struct bin_file));
+    if (!files) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        current = ctrl->zonemap->zones[i].extents_head;
+        while (current) {
+            files[current->extent->fileID].name = current->extent->file;
+            files[current->extent->fileID].ext_ctr++;
+            current = current->next;
+        }
+    }
+
+    *names_len = 0;
+    for (uint32_t i = 0; i < ctrl->nr_files; i++) {
+        if (!files[i].name) {
+            files[i].name = "";
+        }
+        files[i].name_off = *names_len;
+        *names_len += strlen(files[i].name) + 1;
+    }
+
+    return files;
+}
+
+static void bin_put_extent_value(struct control *ctrl, struct bin_writer *w,
+                                 uint32_t id, struct extent *extent) {
+    struct segment_info *seg_i = (struct segment_info *)extent->fs_info;
+
+    switch (id) {
+    case BIN_COL_EXT_PHY_BLK:
+        bin_put_u64(w, extent->phy_blk);
+        break;
+    case BIN_COL_EXT_LOGICAL_BLK:
+        bin_put_u64(w, extent->logical_blk);
+        break;
+    case BIN_COL_EXT_LEN:
+        bin_put_u64(w, extent->len);
+        break;
+    case BIN_COL_EXT_FILE_ID:
+        bin_put_u32(w, extent->fileID);
+        break;
+    case BIN_COL_EXT_NR:
+        bin_put_u32(w, extent->ext_nr);
+        break;
+    case BIN_COL_EXT_FLAGS:
+        bin_put_u32(w, extent->flags);
+        break;
+    case BIN_COL_EXT_SEG_TYPE:
+        bin_put_u8(w, seg_i ? seg_i->type : BIN_DUMP_NO_TYPE);
+        break;
+    case BIN_COL_EXT_VALID_BLOCKS:
+        bin_put_u32(w, seg_i ? seg_i->valid_blocks << F2FS_BLKSIZE_BITS >>
+                                   ctrl->sector_shift
+                             : 0);
+        break;
+    }
+}
+
+static void bin_put_index_column(struct bin_writer *w, uint32_t id,
+                                 uint32_t nr_files, struct bin_file *files,
+                                 struct bin_index_data *index) {
+    struct bin_index_file *file;
+
+    if (!index->files) {
+        return;
+    }
+
+    if (id == BIN_COL_FILE_EXTENTS) {
+        for (uint64_t i = 0; i < files[nr_files].ext_start; i++) {
+            bin_put_u64(w, index->extents[i]);
+        }
+        return;
+    } else if (id == BIN_COL_INDEX_DIR) {
+        bin_put(w, index->dir, strlen(index->dir) + 1);
+        return;
+    }
+
+    for (uint32_t i = 0; i < nr_files; i++) {
+        file = &index->files[i];
+
+        switch (id) {
+        case BIN_COL_FILE_PATH_OFF:
+            bin_put_u64(w, files[i].path_off);
+            break;
+        case BIN_COL_FILE_PATHS:
+            bin_put(w, file->path ? file->path : "",
+                    file->path ? strlen(file->path) + 1 : 1);
+            break;
+        case BIN_COL_FILE_INO:
+            bin_put_u64(w, file->ino);
+            break;
+        case BIN_COL_FILE_SIZE:
+            bin_put_u64(w, file->size);
+            break;
+        case BIN_COL_FILE_MTIME:
+            bin_put_u64(w, file->mtime);
+            break;
+        case BIN_COL_FILE_EXT_START:
+            bin_put_u64(w, files[i].ext_start);
+            break;
+        case BIN_COL_FILE_ORDER:
+            bin_put_u32(w, index->order[i]);
+            break;
+        }
+    }
+}
+
+static void bin_put_column(struct control *ctrl, struct bin_writer *w,
+                           uint32_t id, struct bin_file *files,
+                           struct bin_index_data *index) {
+    struct node *current;
+    uint64_t ext_start = 0;
+
+    if (id >= BIN_COL_FILE_PATH_OFF) {
+        bin_put_index_column(w, id, ctrl->nr_files, files, index);
+        return;
+    }
+
+    for (uint32_t i = 0;
+         id <= BIN_COL_ZONE_EXT_CTR && i < ctrl->zonemap->nr_zones; i++) {
+        struct zone *zone = &ctrl->zonemap->zones[i];
+
+        switch (id) {
+        case BIN_COL_ZONE_START:
+            bin_put_u64(w, zone->start);
+            break;
+        case BIN_COL_ZONE_CAP:
+            bin_put_u64(w, zone->capacity);
+            break;
+        case BIN_COL_ZONE_WP:
+            bin_put_u64(w, zone->wp);
+            break;
+        case BIN_COL_ZONE_STATE:
+            bin_put_u8(w, zone->state);
+            break;
+        case BIN_COL_ZONE_EXT_START:
+            bin_put_u64(w, ext_start);
+            ext_start += zone->extent_ctr;
+            break;
+        case BIN_COL_ZONE_EXT_CTR:
+            bin_put_u32(w, zone->extent_ctr);
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; id >= BIN_COL_FILE_NAME_OFF &&
+                         id <= BIN_COL_FILE_NAMES && i < ctrl->nr_files;
+         i++) {
+        switch (id) {
+        case BIN_COL_FILE_NAME_OFF:
+            bin_put_u32(w, files[i].name_off);
+            break;
+        case BIN_COL_FILE_EXT_CTR:
+            bin_put_u32(w, files[i].ext_ctr);
+            break;
+        case BIN_COL_FILE_NAMES:
+            bin_put(w, files[i].name, strlen(files[i].name) + 1);
+            break;
+        }
+    }
+
+    for (uint32_t i = 0;
+         id >= BIN_COL_ZONE_EXT_HIST && i < ctrl->zonemap->nr_zones; i++) {
+        struct zone *zone = &ctrl->zonemap->zones[i];
+        struct size_hist *hist = id == BIN_COL_ZONE_EXT_HIST
+                                     ? &zone->extent_hist
+                                     : &zone->hole_hist;
+
+        for (uint32_t j = 0; j < SIZE_HIST_BUCKETS; j++) {
+            bin_put_u32(w, hist->buckets[j]);
+        }
+    }
+
+    if (id < BIN_COL_EXT_PHY_BLK || id >= BIN_COL_ZONE_EXT_HIST) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        current = ctrl->zonemap->zones[i].extents_head;
+        while (current) {
+            bin_put_extent_value(ctrl, w, id, current->extent);
+            current = current->next;
+        }
+    }
+}
+
+static int compare_bin_paths(const void *a, const void *b) {
+    return strcmp(((struct bin_path *)a)->path, ((struct bin_path *)b)->path);
+}
+
+/*
+ * Collect the index columns. Extent numbers of a file must be the order of its
+ * extents in the zonemap, as assigned by get_extents().
+ *
+ * @files: file table of bin_get_files(), with an extra entry to hold the
+ * total number of extents in ext_start
+ * @index: struct bin_index_data * with the files and dir set
+ *
+ * */
+static void bin_get_index(struct control *ctrl, struct bin_file *files,
+                          struct bin_index_data *index) {
+    struct bin_path *paths;
+    struct node *current;
+    uint64_t ext_idx = 0;
+
+    index->paths_len = 0;
+    files[0].ext_start = 0;
+    for (uint32_t i = 0; i < ctrl->nr_files; i++) {
+        files[i].path_off = index->paths_len;
+        index->paths_len +=
+            index->files[i].path ? strlen(index->files[i].path) + 1 : 1;
+        files[i + 1].ext_start = files[i].ext_start + files[i].ext_ctr;
+    }
+
+    index->extents =
+        malloc(sizeof(uint64_t) * (files[ctrl->nr_files].ext_start + 1));
+    paths = malloc(sizeof(struct bin_path) * (ctrl->nr_files + 1));
+    index->order = malloc(sizeof(uint32_t) * (ctrl->nr_files + 1));
+    if (!index->extents || !paths || !index->order) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        current = ctrl->zonemap->zones[i].extents_head;
+        while (current) {
+            index->extents[files[current->extent->fileID].ext_start +
+                           current->extent->ext_nr] = ext_idx++;
+            current = current->next;
+        }
+    }
+
+    for (uint32_t i = 0; i < ctrl->nr_files; i++) {
+        paths[i].path = index->files[i].path ? index->files[i].path : "";
+        paths[i].id = i;
+    }
+    qsort(paths, ctrl->nr_files, sizeof(struct bin_path), compare_bin_paths);
+
+    for (uint32_t i = 0; i < ctrl->nr_files; i++) {
+        index->order[i] = paths[i].id;
+    }
+
+    free(paths);
+}
+
+/*
+ * Number of entries of a column in the dump
+ *
+ * */
+static uint64_t bin_column_entries(struct control *ctrl, uint32_t id,
+                                   uint64_t names_len, uint64_t nr_extents,
+                                   struct bin_index_data *index) {
+    if (id >= BIN_COL_FILE_PATH_OFF && !index->files) {
+        return 0;
+    }
+
+    switch (id) {
+    case BIN_COL_ZONE_EXT_HIST:
+    case BIN_COL_ZONE_HOLE_HIST:
+        return (uint64_t)ctrl->zonemap->nr_zones * SIZE_HIST_BUCKETS;
+    case BIN_COL_FILE_NAMES:
+        return names_len;
+    case BIN_COL_FILE_PATHS:
+        return index->paths_len;
+    case BIN_COL_FILE_EXTENTS:
+        return nr_extents;
+    case BIN_COL_INDEX_DIR:
+        return strlen(index->dir) + 1;
+    }
+
+    if (id <= BIN_COL_ZONE_EXT_CTR) {
+        return ctrl->zonemap->nr_zones;
+    } else if (id <= BIN_COL_FILE_NAMES || id >= BIN_COL_FILE_PATH_OFF) {
+        return ctrl->nr_files;
+    }
+
+    return nr_extents;
+}
+
+/*
+ * Write the dump with the (possibly empty) index columns
+ *
+ * @fd: file descriptor of the dump file, at offset 0
+ *
+ * returns: EXIT_SUCCESS or EXIT_FAILURE
+ *
+ * */
+static int bin_dump(struct control *ctrl, int fd,
+                    struct bin_index_data *index) {
+    struct bin_dump_header header;
+    struct bin_writer w;
+    struct bin_file *files;
+    uint64_t names_len = 0, nr_extents = 0, offset, entries;
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        nr_extents += ctrl->zonemap->zones[i].extent_ctr;
+    }
+
+    files = bin_get_files(ctrl, &names_len);
+    if (index->files) {
+        bin_get_index(ctrl, files, index);
+    }
+
+    memset(&header, 0, sizeof(struct bin_dump_header));
+    memcpy(header.magic, BIN_DUMP_MAGIC, sizeof(BIN_DUMP_MAGIC));
+    header.version = htole32(BIN_DUMP_VERSION);
+    header.header_size = htole32(sizeof(struct bin_dump_header));
+    header.fs_magic = htole64(ctrl->fs_magic);
+    header.sector_size = htole32(ctrl->sector_size);
+    header.segment_shift = htole32(ctrl->segment_shift);
+    header.zone_size = htole64(ctrl->znsdev[0].zone_size);
+    header.nr_zones = htole32(ctrl->zonemap->nr_zones);
+    header.nr_files = htole32(ctrl->nr_files);
+    header.nr_extents = htole64(nr_extents);
+    header.nr_columns = htole32(BIN_COL_NR_COLUMNS);
+
+    offset = BIN_DUMP_ALIGN(sizeof(struct bin_dump_header));
+    for (uint32_t id = 0; id < BIN_COL_NR_COLUMNS; id++) {
+        entries = bin_column_entries(ctrl, id, names_len, nr_extents, index);
+
+        header.columns[id].id = htole32(id);
+        header.columns[id].elem_size = htole32(bin_column_elem_size[id]);
+        header.columns[id].offset = htole64(offset);
+        header.columns[id].length =
+            htole64(entries * bin_column_elem_size[id]);
+        offset = BIN_DUMP_ALIGN(offset + entries * bin_column_elem_size[id]);
+    }
+
+    w.fd = fd;
+    w.buf = malloc(BIN_DUMP_BUF_SIZE);
+    w.len = 0;
+    w.pos = 0;
+
+    bin_put(&w, &header, sizeof(struct bin_dump_header));
+    for (uint32_t id = 0; id < BIN_COL_NR_COLUMNS; id++) {
+        bin_pad(&w, le64toh(header.columns[id].offset));
+        bin_put_column(ctrl, &w, id, files, index);
+    }
+    bin_pad(&w, offset);
+    bin_flush(&w);
+
+    free(w.buf);
+    free(files);
+    free(index->extents);
+    free(index->order);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Dump the zonemap into ctrl->bin_file in the binary columnar format described
+ * in bindump.h, without the index columns
+ *
+ * returns: EXIT_SUCCESS or EXIT_FAILURE
+ *
+ * */
+int bin_dump_data(struct control *ctrl) {
+    struct bin_index_data index;
+    int fd, ret;
+
+    memset(&index, 0, sizeof(struct bin_index_data));
+
+    fd = open(ctrl->bin_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ERR_MSG("Failed opening %s\n", ctrl->bin_file);
+        return EXIT_FAILURE;
+    }
+
+    ret = bin_dump(ctrl, fd, &index);
+    close(fd);
+
+    return ret;
+}
+
+/*
+ * Write the zonemap as a zonemap index, a dump including the index columns.
+ * The index is written to a temporary file with a unique name in the same
+ * directory and renamed, such that concurrent readers never map a partially
+ * written index, and concurrent writers do not write into the same file.
+ *
+ * @file: path of the index file
+ * @dir: absolute path of the mapped directory
+ * @files: stat() values of each fileID in the zonemap
+ *
+ * returns: EXIT_SUCCESS or EXIT_FAILURE
+ *
+ * */
+int bin_dump_index(struct control *ctrl, const char *file, const char *dir,
+                   struct bin_index_file *files) {
+    struct bin_index_data index;
+    char *tmp;
+    int fd, ret;
+
+    memset(&index, 0, sizeof(struct bin_index_data));
+    index.files = files;
+    index.dir = dir;
+
+    tmp = malloc(strlen(file) + 8);
+    if (!tmp) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    sprintf(tmp, "%s.XXXXXX", file);
+
+    fd = mkstemp(tmp);
+    if (fd < 0) {
+        WARN("Failed creating a temporary file for %s\n", file);
+        free(tmp);
+        return EXIT_FAILURE;
+    }
+
+    /* mkstemp() creates the file 0600, the index is as readable as dumps */
+    fchmod(fd, 0644);
+    ret = bin_dump(ctrl, fd, &index);
+    close(fd);
+    if (ret == EXIT_FAILURE || rename(tmp, file) < 0) {
+        unlink(tmp);
+        ret = EXIT_FAILURE;
+    }
+
+    free(tmp);
+
+    return ret;
+}
+
+static const void *bin_index_column(struct bin_index *index, uint32_t id) {
+    return index->data + le64toh(index->header->columns[id].offset);
+}
+
+static uint64_t bin_index_u64(struct bin_index *index, uint32_t id,
+                              uint64_t i) {
+    return le64toh(((const uint64_t *)bin_index_column(index, id))[i]);
+}
+
+static uint32_t bin_index_u32(struct bin_index *index, uint32_t id,
+                              uint64_t i) {
+    return le32toh(((const uint32_t *)bin_index_column(index, id))[i]);
+}
+
+static uint8_t bin_index_u8(struct bin_index *index, uint32_t id, uint64_t i) {
+    return ((const uint8_t *)bin_index_column(index, id))[i];
+}
+
+static const char *bin_index_path(struct bin_index *index, uint32_t file) {
+    return (const char *)bin_index_column(index, BIN_COL_FILE_PATHS) +
+           bin_index_u64(index, BIN_COL_FILE_PATH_OFF, file);
+}
+
+/*
+ * Number of entries of a column in an index, as given by the counts of its
+ * header
+ *
+ * returns: number of entries, UINT64_MAX for the columns of NUL terminated
+ * strings, which have any length
+ *
+ * */
+static uint64_t bin_index_column_entries(const struct bin_dump_header *header,
+                                         uint32_t id) {
+    switch (id) {
+    case BIN_COL_FILE_NAMES:
+    case BIN_COL_FILE_PATHS:
+    case BIN_COL_INDEX_DIR:
+        return UINT64_MAX;
+    case BIN_COL_ZONE_EXT_HIST:
+    case BIN_COL_ZONE_HOLE_HIST:
+        return (uint64_t)le32toh(header->nr_zones) * SIZE_HIST_BUCKETS;
+    case BIN_COL_FILE_EXTENTS:
+        return le64toh(header->nr_extents);
+    }
+
+    if (id <= BIN_COL_ZONE_EXT_CTR) {
+        return le32toh(header->nr_zones);
+    } else if (id <= BIN_COL_FILE_NAMES || id >= BIN_COL_FILE_PATH_OFF) {
+        return le32toh(header->nr_files);
+    }
+
+    return le64toh(header->nr_extents);
+}
+
+/*
+ * Check that a column lies within the mapped index, is aligned for its
+ * entries, and holds as many entries as the header counts. String columns
+ * must end with a NUL, such that offsets into them are terminated.
+ *
+ * returns: 1 if the column is usable, 0 otherwise
+ *
+ * */
+static int bin_index_column_is_valid(struct bin_index *index, uint32_t id) {
+    const struct bin_dump_column *column = &index->header->columns[id];
+    uint64_t offset = le64toh(column->offset);
+    uint64_t length = le64toh(column->length);
+    uint64_t entries = bin_index_column_entries(index->header, id);
+
+    if (le32toh(column->id) != id ||
+        le32toh(column->elem_size) != bin_column_elem_size[id] ||
+        offset != BIN_DUMP_ALIGN(offset) || offset > index->size ||
+        length > index->size - offset) {
+        return 0;
+    }
+
+    if (entries == UINT64_MAX) {
+        return length == 0 || index->data[offset + length - 1] == '\0';
+    }
+
+    return length % bin_column_elem_size[id] == 0 &&
+           length / bin_column_elem_size[id] == entries;
+}
+
+/*
+ * Check the values of the zone and file columns that index other columns, the
+ * lookups use them without further checks. Per extent values are checked
+ * where they are used, such that opening the index does not read all extents.
+ *
+ * returns: 1 if the values are in range, 0 otherwise
+ *
+ * */
+static int bin_index_ranges_are_valid(struct bin_index *index) {
+    const struct bin_dump_header *header = index->header;
+    uint64_t nr_extents = le64toh(header->nr_extents), start;
+    uint64_t names_len = le64toh(header->columns[BIN_COL_FILE_NAMES].length);
+    uint64_t paths_len = le64toh(header->columns[BIN_COL_FILE_PATHS].length);
+    uint32_t nr_files = le32toh(header->nr_files);
+
+    for (uint32_t i = 0; i < le32toh(header->nr_zones); i++) {
+        start = bin_index_u64(index, BIN_COL_ZONE_EXT_START, i);
+        if (start > nr_extents ||
+            bin_index_u32(index, BIN_COL_ZONE_EXT_CTR, i) >
+                nr_extents - start) {
+            return 0;
+        }
+    }
+
+    for (uint32_t i = 0; i < nr_files; i++) {
+        start = bin_index_u64(index, BIN_COL_FILE_EXT_START, i);
+        if (start > nr_extents ||
+            bin_index_u32(index, BIN_COL_FILE_EXT_CTR, i) >
+                nr_extents - start ||
+            bin_index_u32(index, BIN_COL_FILE_NAME_OFF, i) >= names_len ||
+            bin_index_u64(index, BIN_COL_FILE_PATH_OFF, i) >= paths_len ||
+            bin_index_u32(index, BIN_COL_FILE_ORDER, i) >= nr_files) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Check the header and the columns of a mapped index, and that it was written
+ * for the same devices (and directory) as the ctrl was initialized for.
+ *
+ * returns: 1 if the index is usable, 0 otherwise
+ *
+ * */
+static int bin_index_is_valid(struct control *ctrl, struct bin_index *index,
+                              const char *dir) {
+    const struct bin_dump_header *header = index->header;
+
+    if (index->size < sizeof(struct bin_dump_header) ||
+        memcmp(header->magic, BIN_DUMP_MAGIC, sizeof(BIN_DUMP_MAGIC)) != 0 ||
+        le32toh(header->version) != BIN_DUMP_VERSION ||
+        le32toh(header->header_size) != sizeof(struct bin_dump_header) ||
+        le32toh(header->nr_columns) != BIN_COL_NR_COLUMNS) {
+        INFO(1, "Index is not a version %u zonemap index\n", BIN_DUMP_VERSION);
+        return 0;
+    }
+
+    if (le64toh(header->columns[BIN_COL_INDEX_DIR].length) == 0) {
+        INFO(1, "Binary dump has no index columns\n");
+        return 0;
+    }
+
+    for (uint32_t id = 0; id < BIN_COL_NR_COLUMNS; id++) {
+        if (!bin_index_column_is_valid(index, id)) {
+            INFO(1, "Index is truncated or corrupt\n");
+            return 0;
+        }
+    }
+
+    if (!bin_index_ranges_are_valid(index)) {
+        INFO(1, "Index is corrupt\n");
+        return 0;
+    }
+
+    /* lookups of addresses do not need the devices */
+    if (!ctrl->zonemap) {
+        return 1;
+    }
+
+    if (le64toh(header->fs_magic) != ctrl->fs_magic ||
+        le32toh(header->sector_size) != ctrl->sector_size ||
+        le64toh(header->zone_size) != ctrl->znsdev[0].zone_size ||
+        le32toh(header->nr_zones) != ctrl->zonemap->nr_zones) {
+        INFO(1, "Index was written for different devices\n");
+        return 0;
+    }
+
+    if (dir && strcmp(bin_index_column(index, BIN_COL_INDEX_DIR), dir) != 0) {
+        INFO(1, "Index was written for %s\n",
+             (const char *)bin_index_column(index, BIN_COL_INDEX_DIR));
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Map a zonemap index written by bin_dump_index()
+ *
+ * @file: path of the index file
+ * @dir: absolute path of the directory the index must be written for, NULL to
+ * accept an index of any directory
+ *
+ * returns: struct bin_index * to close with bin_index_close(), NULL if the
+ * index does not exist or is not usable for the devices of the ctrl (not
+ * checked if the ctrl has no zonemap)
+ *
+ * */
+struct bin_index *bin_index_open(struct control *ctrl, const char *file,
+                                 const char *dir) {
+    struct bin_index *index;
+    struct stat stats;
+    void *data;
+    int fd;
+
+    fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        INFO(1, "No index %s\n", file);
+        return NULL;
+    }
+
+    if (fstat(fd, &stats) < 0 || stats.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    index = calloc(1, sizeof(struct bin_index));
+    if (!index) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    index->data = data;
+    index->size = stats.st_size;
+    index->header = data;
+
+    if (!bin_index_is_valid(ctrl, index, dir)) {
+        bin_index_close(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+void bin_index_close(struct bin_index *index) {
+    munmap((void *)index->data, index->size);
+    free(index);
+}
+
+/*
+ * Find a file in the index by binary search over the sorted paths
+ *
+ * @path: absolute path of the file
+ *
+ * returns: index of the file, BIN_INDEX_NO_FILE if it is not in the index
+ *
+ * */
+uint32_t bin_index_find_file(struct bin_index *index, const char *path) {
+    uint32_t low = 0, high = le32toh(index->header->nr_files), mid, file;
+    int cmp;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        file = bin_index_u32(index, BIN_COL_FILE_ORDER, mid);
+        cmp = strcmp(bin_index_path(index, file), path);
+
+        if (cmp == 0) {
+            return file;
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return BIN_INDEX_NO_FILE;
+}
+
+/*
+ * Find the file holding an address. The zone of the address is computed from
+ * the zone size, and the extents of the zone, which are sorted by PBAS, are
+ * binary searched for the last extent starting at or before the address.
+ *
+ * @lba: address in sectors of the index (as PBAS in the reports)
+ * @result: struct bin_index_lba * to store the file and extent in
+ *
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE if no extent holds the address
+ *
+ * */
+int bin_index_find_lba(struct bin_index *index, uint64_t lba,
+                       struct bin_index_lba *result) {
+    uint64_t zone_size = le64toh(index->header->zone_size);
+    uint64_t low, high, mid, pbas;
+    uint32_t zone, file;
+
+    if (zone_size == 0 || lba / zone_size >= le32toh(index->header->nr_zones)) {
+        return EXIT_FAILURE;
+    }
+    zone = lba / zone_size;
+
+    low = bin_index_u64(index, BIN_COL_ZONE_EXT_START, zone);
+    high = low + bin_index_u32(index, BIN_COL_ZONE_EXT_CTR, zone);
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (bin_index_u64(index, BIN_COL_EXT_PHY_BLK, mid) <= lba) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    /* low is the first extent after the address, if any extent holds it, it
+     * is the one prior */
+    if (low == bin_index_u64(index, BIN_COL_ZONE_EXT_START, zone)) {
+        return EXIT_FAILURE;
+    }
+
+    pbas = bin_index_u64(index, BIN_COL_EXT_PHY_BLK, low - 1);
+    if (lba >= pbas + bin_index_u64(index, BIN_COL_EXT_LEN, low - 1)) {
+        return EXIT_FAILURE;
+    }
+
+    file = bin_index_u32(index, BIN_COL_EXT_FILE_ID, low - 1);
+    if (file >= le32toh(index->header->nr_files)) {
+        return EXIT_FAILURE;
+    }
+    result->path = bin_index_path(index, file);
+    result->ext_nr = bin_index_u32(index, BIN_COL_EXT_NR, low - 1);
+    result->nr_extents = bin_index_u32(index, BIN_COL_FILE_EXT_CTR, file);
+    result->logical_blk =
+        bin_index_u64(index, BIN_COL_EXT_LOGICAL_BLK, low - 1) + lba - pbas;
+    result->seg_type = bin_index_u8(index, BIN_COL_EXT_SEG_TYPE, low - 1);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Check if a file is unchanged since the index was written: its inode, size
+ * and modification time are the same, and the write pointers of the zones of
+ * its extents did not move (e.g., by a reset after garbage collection).
+ *
+ * @file: index of the file
+ * @stats: stat() of the file, NULL to stat() the indexed path
+ *
+ * returns: 1 if the indexed extents are current, 0 if they are stale
+ *
+ * */
+int bin_index_file_is_fresh(struct control *ctrl, struct bin_index *index,
+                            uint32_t file, struct stat *stats) {
+    struct stat file_stats;
+    uint64_t start, ext_idx, pbas;
+    uint32_t zone;
+
+    if (!stats) {
+        if (stat(bin_index_path(index, file), &file_stats) < 0) {
+            return 0;
+        }
+        stats = &file_stats;
+    }
+
+    if (bin_index_u64(index, BIN_COL_FILE_INO, file) != stats->st_ino ||
+        bin_index_u64(index, BIN_COL_FILE_SIZE, file) !=
+            (uint64_t)stats->st_size ||
+        bin_index_u64(index, BIN_COL_FILE_MTIME, file) !=
+            (uint64_t)stats->st_mtim.tv_sec * 1000000000 +
+                stats->st_mtim.tv_nsec) {
+        return 0;
+    }
+
+    start = bin_index_u64(index, BIN_COL_FILE_EXT_START, file);
+    for (uint32_t i = 0; i < bin_index_u32(index, BIN_COL_FILE_EXT_CTR, file);
+         i++) {
+        ext_idx = bin_index_u64(index, BIN_COL_FILE_EXTENTS, start + i);
+        if (ext_idx >= le64toh(index->header->nr_extents)) {
+            return 0;
+        }
+        pbas = bin_index_u64(index, BIN_COL_EXT_PHY_BLK, ext_idx);
+        zone = get_zone_number(ctrl, pbas << ctrl->zns_sector_shift);
+
+        if (!bin_index_zones_are_fresh(ctrl, index, zone, zone + 1)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Check if the write pointers of a range of zones are the same as when the
+ * index was written, i.e., no data was written to or reset in the zones.
+ *
+ * @start: first zone of the range
+ * @end: zone after the last zone of the range
+ *
+ * returns: 1 if the indexed zones are current, 0 if they are stale
+ *
+ * */
+int bin_index_zones_are_fresh(struct control *ctrl, struct bin_index *index,
+                              uint32_t start, uint32_t end) {
+    for (uint32_t i = start; i < end && i < ctrl->zonemap->nr_zones; i++) {
+        if (bin_index_u64(index, BIN_COL_ZONE_WP, i) !=
+            ctrl->zonemap->zones[i].wp) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Add the extents of an indexed file to the zonemap, as if they were mapped
+ * with get_extents(). Segment information is restored if the ctrl has the F2FS
+ * fs_info set up.
+ *
+ * @file: index of the file
+ * @name: file name of the extents, NULL for the name at mapping time
+ *
+ * returns: EXIT_SUCCESS or EXIT_FAILURE
+ *
+ * */
+int bin_index_load_file(struct control *ctrl, struct bin_index *index,
+                        uint32_t file, char *name) {
+    struct extent *extents;
+    struct segment_info *segments;
+    struct zone *zone;
+    uint64_t start, ext_idx;
+    uint32_t nr_extents;
+    uint8_t seg_type;
+    int ret;
+
+    if (!name) {
+        name = (char *)bin_index_column(index, BIN_COL_FILE_NAMES) +
+               bin_index_u32(index, BIN_COL_FILE_NAME_OFF, file);
+    }
+
+    start = bin_index_u64(index, BIN_COL_FILE_EXT_START, file);
+    nr_extents = bin_index_u32(index, BIN_COL_FILE_EXT_CTR, file);
+
+    extents = calloc(nr_extents + 1, sizeof(struct extent));
+    segments = calloc(nr_extents + 1, sizeof(struct segment_info));
+    if (!extents || !segments) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint32_t i = 0; i < nr_extents; i++) {
+        ext_idx = bin_index_u64(index, BIN_COL_FILE_EXTENTS, start + i);
+        if (ext_idx >= le64toh(index->header->nr_extents)) {
+            INFO(1, "Index is corrupt\n");
+            free(extents);
+            free(segments);
+            return EXIT_FAILURE;
+        }
+
+        extents[i].phy_blk = bin_index_u64(index, BIN_COL_EXT_PHY_BLK, ext_idx);
+        extents[i].logical_blk =
+            bin_index_u64(index, BIN_COL_EXT_LOGICAL_BLK, ext_idx);
+        extents[i].len = bin_index_u64(index, BIN_COL_EXT_LEN, ext_idx);
+        extents[i].ext_nr = bin_index_u32(index, BIN_COL_EXT_NR, ext_idx);
+        extents[i].flags = bin_index_u32(index, BIN_COL_EXT_FLAGS, ext_idx);
+        extents[i].zone = get_zone_number(
+            ctrl, extents[i].phy_blk << ctrl->zns_sector_shift);
+
+        /* zone info as get_zone_info() reports it */
+        zone = &ctrl->zonemap->zones[extents[i].zone];
+        extents[i].zone_size = ctrl->znsdev[0].zone_size;
+        extents[i].zone_lbas = zone->start;
+        extents[i].zone_cap = zone->capacity;
+        extents[i].zone_wp = zone->wp;
+        extents[i].zone_lbae = zone->start + zone->capacity;
+
+        strncpy(extents[i].file, name, sizeof(extents[i].file) - 1);
+
+        seg_type = bin_index_u8(index, BIN_COL_EXT_SEG_TYPE, ext_idx);
+        if (seg_type != BIN_DUMP_NO_TYPE &&
+            ctrl->fs_info_bytes == sizeof(struct segment_info)) {
+            segments[i].id = (extents[i].phy_blk & ctrl->f2fs_segment_mask) >>
+                             ctrl->segment_shift;
+            segments[i].type = seg_type;
+            segments[i].valid_blocks =
+                bin_index_u32(index, BIN_COL_EXT_VALID_BLOCKS, ext_idx)
+                << ctrl->sector_shift >> F2FS_BLKSIZE_BITS;
+            extents[i].fs_info = &segments[i];
+        }
+    }
+
+    ret = load_file_extents(ctrl, extents, nr_extents);
+
+    free(extents);
+    free(segments);
+
+    return ret;
+}
+
+/*
+ * Add all files with extents in a range of zones to the zonemap, if the zones
+ * and the files are unchanged since the index was written. Files are added in
+ * the order they were mapped in, with all their extents.
+ *
+ * @start: first zone of the range
+ * @end: zone after the last zone of the range
+ *
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE if the index is stale and nothing was
+ * added
+ *
+ * */
+int bin_index_load_zones(struct control *ctrl, struct bin_index *index,
+                         uint32_t start, uint32_t end) {
+    uint32_t nr_files = le32toh(index->header->nr_files), file;
+    uint64_t ext_start;
+    uint8_t *files;
+    int ret = EXIT_SUCCESS;
+
+    if (!bin_index_zones_are_fresh(ctrl, index, start, end)) {
+        INFO(1, "Index is stale, zones were written or reset\n");
+        return EXIT_FAILURE;
+    }
+
+    files = calloc((nr_files + 8) >> 3, 1);
+    if (!files) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint32_t i = start; i < end && i < ctrl->zonemap->nr_zones; i++) {
+        ext_start = bin_index_u64(index, BIN_COL_ZONE_EXT_START, i);
+        for (uint32_t j = 0; j < bin_index_u32(index, BIN_COL_ZONE_EXT_CTR, i);
+             j++) {
+            file = bin_index_u32(index, BIN_COL_EXT_FILE_ID, ext_start + j);
+            if (file >= nr_files) {
+                INFO(1, "Index is corrupt\n");
+                ret = EXIT_FAILURE;
+                goto out;
+            }
+            files[file >> 3] |= 1 << (file & 7);
+        }
+    }
+
+    for (file = 0; file < nr_files; file++) {
+        if ((files[file >> 3] & (1 << (file & 7))) &&
+            !bin_index_file_is_fresh(ctrl, index, file, NULL)) {
+            INFO(1, "Index is stale, %s changed\n",
+                 bin_index_path(index, file));
+            ret = EXIT_FAILURE;
+            goto out;
+        }
+    }
+
+    for (file = 0; file < nr_files; file++) {
+        if ((files[file >> 3] & (1 << (file & 7))) &&
+            bin_index_load_file(ctrl, index, file, NULL) == EXIT_FAILURE) {
+            ret = EXIT_FAILURE;
+            goto out;
+        }
+    }
+
+out:
+    free(files);
+
+    return ret;
+}
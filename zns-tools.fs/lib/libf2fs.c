@@ -1,18 +1,15 @@
+#include "backend.h"
 #include "f2fs.h"
+#include "profile.h"
+#include "report.h"
 #include <stdint.h>
 #include <string.h>
 
-struct f2fs_super_block
-    f2fs_sb; // TODO move this to the void * to store the super block
-struct f2fs_checkpoint
-    f2fs_cp; // TODO: the superblock can hold this info or we can union it
-uint32_t nat_block_offset = 0; /* tracking the nat block traversal */
-uint32_t nat_entry_offset = 0; /* tracking offset to start at in nat_blocks */
-
 /*
  * Read a block of specified size from the device
  *
  * @fd: open file descriptor to the device containg the block
+ * @dev_path: path of the device fd was opened with
  * @dest: void * to the destination buffer
  * @offset: starting offset to read from
  * @size: size in bytes to read
@@ -20,12 +17,9 @@ uint32_t nat_entry_offset = 0; /* tracking offset to start at in nat_blocks */
  * returns: 1 on success, 0 on Failure
  *
  * */
-static int f2fs_read_block(int fd, void *dest, __u64 offset, size_t size) {
-    if (lseek(fd, offset, SEEK_SET) < 0) {
-        return 0;
-    }
-
-    if (read(fd, dest, size) < 0) {
+static int f2fs_read_block(int fd, char *dev_path, void *dest, __u64 offset,
+                           size_t size) {
+    if (backend_pread(fd, dev_path, dest, offset, size) < 0) {
         return 0;
     }
 
@@ -37,30 +31,39 @@ static int f2fs_read_block(int fd, void *dest, __u64 offset, size_t size) {
  *
  * @dev_path: char * to the device containing the superblock
  *
- * Note, function sets the global f2fs_sb struct with the read superblock data.
+ * returns: struct f2fs_sb_info * with the read superblock data, to be freed
+ * by the caller
  *
  * */
-void f2fs_read_super_block(char *dev_path) {
+struct f2fs_sb_info *f2fs_read_super_block(char *dev_path) {
+    struct f2fs_sb_info *sbi;
     int fd;
 
-    fd = open(dev_path, O_RDONLY);
+    sbi = calloc(1, sizeof(struct f2fs_sb_info));
+    if (!sbi) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    fd = backend_open(dev_path);
     if (fd < 0) {
         ERR_MSG("opening device fd for %s\n", dev_path);
     }
 
-    if (!f2fs_read_block(fd, &f2fs_sb, F2FS_SUPER_OFFSET,
+    if (!f2fs_read_block(fd, dev_path, &sbi->sb, F2FS_SUPER_OFFSET,
                          sizeof(struct f2fs_super_block))) {
         ERR_MSG("reading superblock from %s\n", dev_path);
     }
 
     close(fd);
+
+    return sbi;
 }
 
 /*
  * Print all information in the superblock
  *
  * */
-void f2fs_show_super_block() {
+void f2fs_show_super_block(struct f2fs_sb_info *sbi) {
 
     MSG("================================================================"
         "=\n");
@@ -68,76 +71,80 @@ void f2fs_show_super_block() {
     MSG("================================================================"
         "=\n");
     MSG("Note: Sizes and Addresses are in 4KiB units (F2FS Block Size)\n");
-    MSG("magic: \t\t\t%#10" PRIx32 "\n", f2fs_sb.magic);
-    MSG("major_version: \t\t%hu\n", f2fs_sb.major_ver);
-    MSG("minor_version: \t\t%hu\n", f2fs_sb.minor_ver);
-    MSG("log_sectorsize: \t%u\n", f2fs_sb.log_sectorsize);
-    MSG("log_sectors_per_block: \t%u\n", f2fs_sb.log_sectors_per_block);
-    MSG("log_blocksize: \t\t%u\n", f2fs_sb.log_blocksize);
-    MSG("log_blocks_per_seg: \t%u\n", f2fs_sb.log_blocks_per_seg);
-    MSG("segs_per_sec: \t\t%u\n", f2fs_sb.segs_per_sec);
-    MSG("secs_per_zone: \t\t%u\n", f2fs_sb.secs_per_zone);
-    MSG("checksum_offset: \t%u\n", f2fs_sb.checksum_offset);
-    MSG("block_count: \t\t%llu\n", f2fs_sb.block_count);
-    MSG("section_count: \t\t%u\n", f2fs_sb.section_count);
-    MSG("segment_count: \t\t%u\n", f2fs_sb.segment_count);
-    MSG("segment_count_ckpt: \t%u\n", f2fs_sb.segment_count_ckpt);
-    MSG("segment_count_sit: \t%u\n", f2fs_sb.segment_count_sit);
-    MSG("segment_count_nat: \t%u\n", f2fs_sb.segment_count_nat);
-    MSG("segment_count_ssa: \t%u\n", f2fs_sb.segment_count_ssa);
-    MSG("segment_count_main: \t%u\n", f2fs_sb.segment_count_main);
-    MSG("segment0_blkaddr: \t%#" PRIx32 "\n", f2fs_sb.segment0_blkaddr);
-    MSG("cp_blkaddr: \t\t%#" PRIx32 "\n", f2fs_sb.cp_blkaddr);
-    MSG("sit_blkaddr: \t\t%#" PRIx32 "\n", f2fs_sb.sit_blkaddr);
-    MSG("nat_blkaddr: \t\t%#" PRIx32 "\n", f2fs_sb.nat_blkaddr);
-    MSG("ssa_blkaddr: \t\t%#" PRIx32 "\n", f2fs_sb.ssa_blkaddr);
-    MSG("main_blkaddr: \t\t%#" PRIx32 "\n", f2fs_sb.main_blkaddr);
-    MSG("root_ino: \t\t%u\n", f2fs_sb.root_ino);
-    MSG("node_ino: \t\t%u\n", f2fs_sb.node_ino);
-    MSG("meta_ino: \t\t%u\n", f2fs_sb.meta_ino);
-    MSG("extension_count: \t%u\n", f2fs_sb.extension_count);
+    MSG("magic: \t\t\t%#10" PRIx32 "\n", sbi->sb.magic);
+    MSG("major_version: \t\t%hu\n", sbi->sb.major_ver);
+    MSG("minor_version: \t\t%hu\n", sbi->sb.minor_ver);
+    MSG("log_sectorsize: \t%u\n", sbi->sb.log_sectorsize);
+    MSG("log_sectors_per_block: \t%u\n", sbi->sb.log_sectors_per_block);
+    MSG("log_blocksize: \t\t%u\n", sbi->sb.log_blocksize);
+    MSG("log_blocks_per_seg: \t%u\n", sbi->sb.log_blocks_per_seg);
+    MSG("segs_per_sec: \t\t%u\n", sbi->sb.segs_per_sec);
+    MSG("secs_per_zone: \t\t%u\n", sbi->sb.secs_per_zone);
+    MSG("checksum_offset: \t%u\n", sbi->sb.checksum_offset);
+    MSG("block_count: \t\t%llu\n", sbi->sb.block_count);
+    MSG("section_count: \t\t%u\n", sbi->sb.section_count);
+    MSG("segment_count: \t\t%u\n", sbi->sb.segment_count);
+    MSG("segment_count_ckpt: \t%u\n", sbi->sb.segment_count_ckpt);
+    MSG("segment_count_sit: \t%u\n", sbi->sb.segment_count_sit);
+    MSG("segment_count_nat: \t%u\n", sbi->sb.segment_count_nat);
+    MSG("segment_count_ssa: \t%u\n", sbi->sb.segment_count_ssa);
+    MSG("segment_count_main: \t%u\n", sbi->sb.segment_count_main);
+    MSG("segment0_blkaddr: \t%#" PRIx32 "\n", sbi->sb.segment0_blkaddr);
+    MSG("cp_blkaddr: \t\t%#" PRIx32 "\n", sbi->sb.cp_blkaddr);
+    MSG("sit_blkaddr: \t\t%#" PRIx32 "\n", sbi->sb.sit_blkaddr);
+    MSG("nat_blkaddr: \t\t%#" PRIx32 "\n", sbi->sb.nat_blkaddr);
+    MSG("ssa_blkaddr: \t\t%#" PRIx32 "\n", sbi->sb.ssa_blkaddr);
+    MSG("main_blkaddr: \t\t%#" PRIx32 "\n", sbi->sb.main_blkaddr);
+    MSG("root_ino: \t\t%u\n", sbi->sb.root_ino);
+    MSG("node_ino: \t\t%u\n", sbi->sb.node_ino);
+    MSG("meta_ino: \t\t%u\n", sbi->sb.meta_ino);
+    MSG("extension_count: \t%u\n", sbi->sb.extension_count);
 
     MSG("Extensions: \t\t");
     for (uint8_t i = 0; i < F2FS_MAX_EXTENSION; i++) {
-        MSG("%s ", f2fs_sb.extension_list[i]);
+        MSG("%s ", sbi->sb.extension_list[i]);
     }
     MSG("\n");
 
-    MSG("cp_payload: \t\t%u\n", f2fs_sb.cp_payload);
-    MSG("version: \t\t%s\n", f2fs_sb.version);
-    MSG("init_version: \t\t%s\n", f2fs_sb.init_version);
-    MSG("feature: \t\t%u\n", f2fs_sb.feature);
-    MSG("encryption_level: \t%u\n", f2fs_sb.encryption_level);
-    MSG("encrypt_pw_salt: \t\t%s\n", f2fs_sb.encrypt_pw_salt);
+    MSG("cp_payload: \t\t%u\n", sbi->sb.cp_payload);
+    MSG("version: \t\t%s\n", sbi->sb.version);
+    MSG("init_version: \t\t%s\n", sbi->sb.init_version);
+    MSG("feature: \t\t%u\n", sbi->sb.feature);
+    MSG("encryption_level: \t%u\n", sbi->sb.encryption_level);
+    MSG("encrypt_pw_salt: \t\t%s\n", sbi->sb.encrypt_pw_salt);
 
     MSG("Devices: \t\t");
     for (uint8_t i = 0; i < MAX_DEVICES; i++) {
-        if (f2fs_sb.devs[i].total_segments == 0) {
+        if (sbi->sb.devs[i].total_segments == 0) {
             MSG("\n");
             break;
         }
-        MSG("%s ", f2fs_sb.devs[i].path);
+        MSG("%s ", sbi->sb.devs[i].path);
     }
 
-    MSG("hot_ext_count: \t\t%hhu\n", f2fs_sb.hot_ext_count);
-    MSG("s_encoding: \t\t%hu\n", f2fs_sb.s_encoding);
-    MSG("s_encoding_flags: \t%hu\n", f2fs_sb.s_encoding_flags);
-    MSG("crc: \t\t\t%u\n", f2fs_sb.crc);
+    MSG("hot_ext_count: \t\t%hhu\n", sbi->sb.hot_ext_count);
+    MSG("s_encoding: \t\t%hu\n", sbi->sb.s_encoding);
+    MSG("s_encoding_flags: \t%hu\n", sbi->sb.s_encoding_flags);
+    MSG("crc: \t\t\t%u\n", sbi->sb.crc);
 }
 
 /*
- * Read the F2FS checkpoint into the global f2fs_cp variable
+ * Read the F2FS checkpoint of the mount
+ *
+ * @sbi: struct f2fs_sb_info * of the mount, to store the checkpoint in
+ * @dev_path: char * to the device containing the checkpoint
  *
  * */
-void f2fs_read_checkpoint(char *dev_path) {
+void f2fs_read_checkpoint(struct f2fs_sb_info *sbi, char *dev_path) {
     int fd;
 
-    fd = open(dev_path, O_RDONLY);
+    fd = backend_open(dev_path);
     if (fd < 0) {
         ERR_MSG("opening device fd for %s\n", dev_path);
     }
 
-    if (!f2fs_read_block(fd, &f2fs_cp, f2fs_sb.cp_blkaddr << F2FS_BLKSIZE_BITS,
+    if (!f2fs_read_block(fd, dev_path, &sbi->cp,
+                         sbi->sb.cp_blkaddr << F2FS_BLKSIZE_BITS,
                          sizeof(struct f2fs_checkpoint))) {
         ERR_MSG("reading checkpoint from %s\n", dev_path);
     }
@@ -149,63 +156,64 @@ void f2fs_read_checkpoint(char *dev_path) {
  * Print the fields of the F2FS checkpoint
  *
  * */
-void f2fs_show_checkpoint() {
+void f2fs_show_checkpoint(struct f2fs_sb_info *sbi) {
     MSG("================================================================"
         "=\n");
     MSG("\t\t\tCHECKPOINT\n");
     MSG("================================================================"
         "=\n");
 
-    MSG("checkpoint_ver: \t\t%llu\n", f2fs_cp.checkpoint_ver);
-    MSG("user_block_count: \t\t%llu\n", f2fs_cp.user_block_count);
-    MSG("valid_block_count: \t\t%llu\n", f2fs_cp.valid_block_count);
-    MSG("rsvd_segment_count: \t\t%u\n", f2fs_cp.rsvd_segment_count);
-    MSG("overprov_segment_count: \t%u\n", f2fs_cp.overprov_segment_count);
-    MSG("free_segment_count: \t\t%u\n", f2fs_cp.free_segment_count);
-
-    MSG("ckpt_flags: \t\t\t%u\n", f2fs_cp.ckpt_flags);
-    MSG("cp_pack_total_block_count: \t%u\n", f2fs_cp.cp_pack_total_block_count);
-    MSG("cp_pack_start_sum: \t\t%u\n", f2fs_cp.cp_pack_start_sum);
-    MSG("valid_node_count: \t\t%u\n", f2fs_cp.valid_node_count);
-    MSG("valid_inode_count: \t\t%u\n", f2fs_cp.valid_inode_count);
-    MSG("next_free_nid: \t\t\t%u\n", f2fs_cp.next_free_nid);
-    MSG("sit_ver_bitmap_bytesize: \t%u\n", f2fs_cp.sit_ver_bitmap_bytesize);
-    MSG("nat_ver_bitmap_bytesize: \t%u\n", f2fs_cp.nat_ver_bitmap_bytesize);
-    MSG("checksum_offset: \t\t%u\n", f2fs_cp.checksum_offset);
-    MSG("elapsed_time: \t\t\t%llu\n", f2fs_cp.elapsed_time);
+    MSG("checkpoint_ver: \t\t%llu\n", sbi->cp.checkpoint_ver);
+    MSG("user_block_count: \t\t%llu\n", sbi->cp.user_block_count);
+    MSG("valid_block_count: \t\t%llu\n", sbi->cp.valid_block_count);
+    MSG("rsvd_segment_count: \t\t%u\n", sbi->cp.rsvd_segment_count);
+    MSG("overprov_segment_count: \t%u\n", sbi->cp.overprov_segment_count);
+    MSG("free_segment_count: \t\t%u\n", sbi->cp.free_segment_count);
+
+    MSG("ckpt_flags: \t\t\t%u\n", sbi->cp.ckpt_flags);
+    MSG("cp_pack_total_block_count: \t%u\n", sbi->cp.cp_pack_total_block_count);
+    MSG("cp_pack_start_sum: \t\t%u\n", sbi->cp.cp_pack_start_sum);
+    MSG("valid_node_count: \t\t%u\n", sbi->cp.valid_node_count);
+    MSG("valid_inode_count: \t\t%u\n", sbi->cp.valid_inode_count);
+    MSG("next_free_nid: \t\t\t%u\n", sbi->cp.next_free_nid);
+    MSG("sit_ver_bitmap_bytesize: \t%u\n", sbi->cp.sit_ver_bitmap_bytesize);
+    MSG("nat_ver_bitmap_bytesize: \t%u\n", sbi->cp.nat_ver_bitmap_bytesize);
+    MSG("checksum_offset: \t\t%u\n", sbi->cp.checksum_offset);
+    MSG("elapsed_time: \t\t\t%llu\n", sbi->cp.elapsed_time);
     MSG("alloc_type[CURSEG_HOT_NODE]: \t%hhu\n",
-        f2fs_cp.alloc_type[CURSEG_HOT_NODE]);
+        sbi->cp.alloc_type[CURSEG_HOT_NODE]);
     MSG("alloc_type[CURSEG_WARM_NODE]: \t%hhu\n",
-        f2fs_cp.alloc_type[CURSEG_WARM_NODE]);
+        sbi->cp.alloc_type[CURSEG_WARM_NODE]);
     MSG("alloc_type[CURSEG_COLD_NODE]: \t%hhu\n",
-        f2fs_cp.alloc_type[CURSEG_COLD_NODE]);
-    MSG("cur_node_segno[0]: \t\t%u\n", f2fs_cp.cur_node_segno[0]);
-    MSG("cur_node_segno[1]: \t\t%u\n", f2fs_cp.cur_node_segno[1]);
-    MSG("cur_node_segno[2]: \t\t%u\n", f2fs_cp.cur_node_segno[2]);
+        sbi->cp.alloc_type[CURSEG_COLD_NODE]);
+    MSG("cur_node_segno[0]: \t\t%u\n", sbi->cp.cur_node_segno[0]);
+    MSG("cur_node_segno[1]: \t\t%u\n", sbi->cp.cur_node_segno[1]);
+    MSG("cur_node_segno[2]: \t\t%u\n", sbi->cp.cur_node_segno[2]);
 
-    MSG("cur_node_blkoff[0]: \t\t%u\n", f2fs_cp.cur_node_blkoff[0]);
-    MSG("cur_node_blkoff[1]: \t\t%u\n", f2fs_cp.cur_node_blkoff[1]);
-    MSG("cur_node_blkoff[2]: \t\t%u\n", f2fs_cp.cur_node_blkoff[2]);
+    MSG("cur_node_blkoff[0]: \t\t%u\n", sbi->cp.cur_node_blkoff[0]);
+    MSG("cur_node_blkoff[1]: \t\t%u\n", sbi->cp.cur_node_blkoff[1]);
+    MSG("cur_node_blkoff[2]: \t\t%u\n", sbi->cp.cur_node_blkoff[2]);
 
     MSG("alloc_type[CURSEG_HOT_DATA]: \t%hhu\n",
-        f2fs_cp.alloc_type[CURSEG_HOT_DATA]);
+        sbi->cp.alloc_type[CURSEG_HOT_DATA]);
     MSG("alloc_type[CURSEG_WARM_DATA]: \t%hhu\n",
-        f2fs_cp.alloc_type[CURSEG_WARM_DATA]);
+        sbi->cp.alloc_type[CURSEG_WARM_DATA]);
     MSG("alloc_type[CURSEG_COLD_DATA]: \t%hhu\n",
-        f2fs_cp.alloc_type[CURSEG_COLD_DATA]);
+        sbi->cp.alloc_type[CURSEG_COLD_DATA]);
 
-    MSG("cur_data_segno[0]: \t\t%u\n", f2fs_cp.cur_data_segno[0]);
-    MSG("cur_data_segno[1]: \t\t%u\n", f2fs_cp.cur_data_segno[1]);
-    MSG("cur_data_segno[2]: \t\t%u\n", f2fs_cp.cur_data_segno[2]);
+    MSG("cur_data_segno[0]: \t\t%u\n", sbi->cp.cur_data_segno[0]);
+    MSG("cur_data_segno[1]: \t\t%u\n", sbi->cp.cur_data_segno[1]);
+    MSG("cur_data_segno[2]: \t\t%u\n", sbi->cp.cur_data_segno[2]);
 
-    MSG("cur_data_blkoff[0]: \t\t%u\n", f2fs_cp.cur_data_blkoff[0]);
-    MSG("cur_data_blkoff[1]: \t\t%u\n", f2fs_cp.cur_data_blkoff[1]);
-    MSG("cur_data_blkoff[2]: \t\t%u\n", f2fs_cp.cur_data_blkoff[2]);
+    MSG("cur_data_blkoff[0]: \t\t%u\n", sbi->cp.cur_data_blkoff[0]);
+    MSG("cur_data_blkoff[1]: \t\t%u\n", sbi->cp.cur_data_blkoff[1]);
+    MSG("cur_data_blkoff[2]: \t\t%u\n", sbi->cp.cur_data_blkoff[2]);
 }
 
 /*
  *  Get the NAT entry for an inode
  *
+ *  @sbi: struct f2fs_sb_info * of the mount, tracking the NAT offsets
  *  @dev_path: device path where the NAT is on
  *  @inode_number: inode number to locate
  *
@@ -215,7 +223,8 @@ void f2fs_show_checkpoint() {
  *
  * returns: f2fs_nat_entry * with the NAT entry
  *  */
-struct f2fs_nat_entry *f2fs_get_inode_nat_entry(char *dev_path,
+struct f2fs_nat_entry *f2fs_get_inode_nat_entry(struct f2fs_sb_info *sbi,
+                                                char *dev_path,
                                                 uint32_t inode_number) {
     int fd;
     uint32_t nat_segments = 0;
@@ -226,40 +235,41 @@ struct f2fs_nat_entry *f2fs_get_inode_nat_entry(char *dev_path,
 
     /* from:f2fs.tools mount.c:1680
      * segment_count_nat includes pair segment so divide to 2. */
-    nat_segments = f2fs_sb.segment_count_nat >> 1;
-    nat_blocks = nat_segments << f2fs_sb.log_blocks_per_seg;
+    nat_segments = sbi->sb.segment_count_nat >> 1;
+    nat_blocks = nat_segments << sbi->sb.log_blocks_per_seg;
 
     nat_block = (struct f2fs_nat_block *)calloc(1, BLOCK_SZ);
     nat_entry =
         (struct f2fs_nat_entry *)calloc(1, sizeof(struct f2fs_nat_entry));
 
-    fd = open(dev_path, O_RDONLY);
+    fd = backend_open(dev_path);
     if (fd < 0) {
         ERR_MSG("opening device fd for %s\n", dev_path);
     }
 
     for (uint32_t i = 0; i < nat_blocks; i++) {
-        cur_nat_blkaddress = (f2fs_sb.nat_blkaddr << F2FS_BLKSIZE_BITS) +
-                             (nat_block_offset * BLOCK_SZ);
+        cur_nat_blkaddress = (sbi->sb.nat_blkaddr << F2FS_BLKSIZE_BITS) +
+                             (sbi->nat_block_offset * BLOCK_SZ);
 
-        if (!f2fs_read_block(fd, nat_block, cur_nat_blkaddress, BLOCK_SZ)) {
+        if (!f2fs_read_block(fd, dev_path, nat_block, cur_nat_blkaddress,
+                             BLOCK_SZ)) {
             ERR_MSG("reading NAT Block %#" PRIx64 " from %s\n",
                     cur_nat_blkaddress, dev_path);
         }
 
-        for (uint32_t i = nat_entry_offset; i < NAT_ENTRY_PER_BLOCK; i++) {
+        for (uint32_t i = sbi->nat_entry_offset; i < NAT_ENTRY_PER_BLOCK; i++) {
             if (nat_block->entries[i].ino == inode_number) {
                 // Next time we check nat entries, we need to start at differnet
                 // locations
                 if (i == NAT_ENTRY_PER_BLOCK - 1) {
                     /* If we are at the last entry in the nat block, start at
                      * the next block */
-                    nat_block_offset++;
-                    nat_entry_offset = 0;
+                    sbi->nat_block_offset++;
+                    sbi->nat_entry_offset = 0;
                 } else {
                     /* if we are in the nat block, start at the next nat entry
                      * in this block */
-                    nat_entry_offset = i + 1;
+                    sbi->nat_entry_offset = i + 1;
                 }
                 nat_entry->version = nat_block->entries[i].version;
                 nat_entry->ino = nat_block->entries[i].ino;
@@ -271,8 +281,8 @@ struct f2fs_nat_entry *f2fs_get_inode_nat_entry(char *dev_path,
                 return nat_entry;
             }
         }
-        nat_block_offset++;
-        nat_entry_offset = 0;
+        sbi->nat_block_offset++;
+        sbi->nat_entry_offset = 0;
     }
 
     close(fd);
@@ -299,12 +309,13 @@ struct f2fs_node *f2fs_get_node_block(char *dev_path, uint32_t block_addr) {
 
     node_block = (struct f2fs_node *)calloc(sizeof(struct f2fs_node), 1);
 
-    fd = open(dev_path, O_RDONLY);
+    fd = backend_open(dev_path);
     if (fd < 0) {
         ERR_MSG("opening device fd for %s\n", dev_path);
     }
 
-    if (!f2fs_read_block(fd, node_block, block_addr << F2FS_BLKSIZE_BITS,
+    if (!f2fs_read_block(fd, dev_path, node_block,
+                         block_addr << F2FS_BLKSIZE_BITS,
                          sizeof(struct f2fs_node))) {
         ERR_MSG("reading NAT Block %#" PRIx32 " from %s\n", block_addr,
                 dev_path);
@@ -448,6 +459,7 @@ static int init_procfs_segment_bits(char *dev_name, uint32_t highest_segment,
     char *device, *dev_string, *dev, *line;
     size_t len = 0;
     uint32_t line_ctr = 0;
+    uint64_t start = profile_start();
     ssize_t read;
 
     dev_string = strdup(dev_name);
@@ -457,12 +469,13 @@ static int init_procfs_segment_bits(char *dev_name, uint32_t highest_segment,
 
     sprintf(path, "/proc/fs/f2fs/%s/segment_info", dev);
 
-    fp = fopen(path, "r");
+    fp = backend_fopen_proc(path);
     if (!fp) {
         WARN("Failed opening %s\nEnsure Kernel is running with F2FS Debugging "
              "enabled.\nFalling back to disabling procfs segment resolving.\n",
              path);
         free(dev_string);
+        profile_stop(PROFILE_PROCFS, start);
         return EXIT_FAILURE;
     }
 
@@ -509,18 +522,19 @@ static int init_procfs_segment_bits(char *dev_name, uint32_t highest_segment,
 finish:
     fclose(fp);
     free(dev_string);
+    profile_stop(PROFILE_PROCFS, start);
 
     return EXIT_SUCCESS;
 }
 
-extern void *f2fs_fs_manager_init(char *dev_name) {
+extern void *f2fs_fs_manager_init(struct f2fs_sb_info *sbi, char *dev_name) {
     struct segment_manager *segman;
 
     segman =
         calloc(1, sizeof(struct segment_manager) +
-                      sizeof(struct segment_info) * f2fs_sb.segment_count_main);
+                      sizeof(struct segment_info) * sbi->sb.segment_count_main);
 
-    if (init_procfs_segment_bits(dev_name, f2fs_sb.segment_count_main,
+    if (init_procfs_segment_bits(dev_name, sbi->sb.segment_count_main,
                                  segman) == EXIT_FAILURE) {
         goto cleanup;
     }
@@ -572,23 +586,30 @@ static void f2fs_show_segment(void *fs_info, uint8_t show_only_stats,
                               unsigned int sector_shift) {
     struct segment_info *seg_i = (struct segment_info *)fs_info;
 
-    REP(show_only_stats, "+++++ TYPE: ");
+    if (show_only_stats) {
+        return;
+    }
+
+    REP_LIT("+++++ TYPE: ");
     if (seg_i->type == CURSEG_HOT_DATA) {
-        REP(show_only_stats, "CURSEG_HOT_DATA");
+        REP_LIT("CURSEG_HOT_DATA");
     } else if (seg_i->type == CURSEG_WARM_DATA) {
-        REP(show_only_stats, "CURSEG_WARM_DATA");
+        REP_LIT("CURSEG_WARM_DATA");
     } else if (seg_i->type == CURSEG_COLD_DATA) {
-        REP(show_only_stats, "CURSEG_COLD_DATA");
+        REP_LIT("CURSEG_COLD_DATA");
     } else if (seg_i->type == CURSEG_HOT_NODE) {
-        REP(show_only_stats, "CURSEG_HOT_NODE");
+        REP_LIT("CURSEG_HOT_NODE");
     } else if (seg_i->type == CURSEG_WARM_NODE) {
-        REP(show_only_stats, "CURSEG_WARM_NODE");
+        REP_LIT("CURSEG_WARM_NODE");
     } else if (seg_i->type == CURSEG_COLD_NODE) {
-        REP(show_only_stats, "CURSEG_COLD_NODE");
+        REP_LIT("CURSEG_COLD_NODE");
     }
 
-    REP(show_only_stats, "  VALID BLOCKS: %3u\n",
-        seg_i->valid_blocks << F2FS_BLKSIZE_BITS >> sector_shift);
+    REP_LIT("  VALID BLOCKS: ");
+    rep_dec((uint32_t)(seg_i->valid_blocks << F2FS_BLKSIZE_BITS >>
+                       sector_shift),
+            3);
+    REP_LIT("\n");
     // TODO: REMOVE RANGE SEGMENTS, just show each segment, should simplify
     // segmap while loop as well
     /* if (is_range) { */
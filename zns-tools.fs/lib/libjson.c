@@ -3,547 +3,514 @@
 #include <string.h>
 #include <time.h>
 
-static char *uint64_to_hex_string_cast(uint64_t value) {
-    char *buf = calloc(1, sizeof(uint64_t) + 8);
+/*
+ * The json data is streamed into the file with the buffered report writer,
+ * instead of building the entire document in memory first. The writer only
+ * tracks if the current object/array already has an element, to know where
+ * the commas go.
+ *
+ * */
+
+#define JSON_MAX_DEPTH 16
+
+struct json_writer {
+    uint8_t depth;                    /* current nesting depth */
+    uint8_t has_elem[JSON_MAX_DEPTH]; /* depth already has an element */
+};
+
+static void json_sep(struct json_writer *jw) {
+    if (jw->has_elem[jw->depth]) {
+        REP_LIT(",");
+    }
+    jw->has_elem[jw->depth] = 1;
+}
 
-    snprintf(buf, sizeof(uint64_t) + 7, "0x%" PRIx64 "", value);
+static void json_open(struct json_writer *jw, const char *bracket) {
+    rep_write(bracket, 1);
+    jw->depth++;
+    jw->has_elem[jw->depth] = 0;
+}
 
-    return buf;
+static void json_close(struct json_writer *jw, const char *bracket) {
+    jw->depth--;
+    rep_write(bracket, 1);
 }
 
-static char *uint32_to_hex_string_cast(uint32_t value) {
-    char *buf = calloc(1, sizeof(uint32_t) + 8);
+/*
+ * Write a string value with json escaping
+ *
+ * */
+static void json_string(const char *value) {
+    static const char hex_digits[] = "0123456789abcdef";
+    const char *start = value;
+    char esc[6] = {'\\', 'u', '0', '0', 0, 0};
 
-    snprintf(buf, sizeof(uint32_t) + 7, "0x%" PRIx32 "", value);
+    REP_LIT("\"");
+    for (; *value; value++) {
+        unsigned char c = *value;
+
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
 
-    return buf;
+        rep_write(start, value - start);
+        start = value + 1;
+
+        if (c == '"') {
+            REP_LIT("\\\"");
+        } else if (c == '\\') {
+            REP_LIT("\\\\");
+        } else if (c == '\n') {
+            REP_LIT("\\n");
+        } else if (c == '\t') {
+            REP_LIT("\\t");
+        } else {
+            esc[4] = hex_digits[c >> 4];
+            esc[5] = hex_digits[c & 0xf];
+            rep_write(esc, sizeof(esc));
+        }
+    }
+    rep_write(start, value - start);
+    REP_LIT("\"");
 }
 
-static char *uint32_to_string_cast(uint32_t value) {
-    char *buf = calloc(1, sizeof(uint32_t) + 1);
+static void json_key(struct json_writer *jw, const char *key) {
+    json_sep(jw);
+    json_string(key);
+    REP_LIT(":");
+}
 
-    snprintf(buf, sizeof(uint32_t), "%d", value);
+/* numeric keys, such as zone and segment numbers */
+static void json_key_dec(struct json_writer *jw, uint64_t key) {
+    json_sep(jw);
+    REP_LIT("\"");
+    rep_dec(key, 0);
+    REP_LIT("\":");
+}
 
-    return buf;
+static void json_add_string(struct json_writer *jw, const char *key,
+                            const char *value) {
+    json_key(jw, key);
+    json_string(value);
 }
 
-static json_object *json_get_bdev(struct bdev bdev) {
-    char *value;
-    json_object *dev = json_object_new_object();
-
-    json_object_object_add(dev, "dev_name",
-                           json_object_new_string(bdev.dev_name));
-    json_object_object_add(dev, "dev_path",
-                           json_object_new_string(bdev.dev_path));
-    json_object_object_add(dev, "link_name",
-                           json_object_new_string(bdev.link_name));
-    json_object_object_add(dev, "is_zoned",
-                           json_object_new_boolean(bdev.is_zoned));
-
-    if (bdev.is_zoned) {
-        json_object_object_add(dev, "nr_zones",
-                               json_object_new_int(bdev.nr_zones));
-        json_object_object_add(dev, "zone_size",
-                               json_object_new_int(bdev.zone_size));
-
-        value = uint32_to_hex_string_cast(bdev.zone_mask);
-        json_object_object_add(dev, "zone_mask", json_object_new_string(value));
-        free(value);
-
-        json_object_object_add(dev, "sector_size",
-                               json_object_new_int(ctrl.sector_size));
-        json_object_object_add(dev, "sector_shift",
-                               json_object_new_int(ctrl.sector_shift));
-    }
+static void json_add_int(struct json_writer *jw, const char *key,
+                         uint64_t value) {
+    json_key(jw, key);
+    rep_dec(value, 0);
+}
+
+/* hex values are strings in the "0x%" PRIx64 format */
+static void json_add_hex(struct json_writer *jw, const char *key,
+                         uint64_t value) {
+    json_key(jw, key);
+    REP_LIT("\"");
+    rep_hex_zero(value, 0);
+    REP_LIT("\"");
+}
 
-    return dev;
+static void json_add_bool(struct json_writer *jw, const char *key,
+                          uint8_t value) {
+    json_key(jw, key);
+    if (value) {
+        REP_LIT("true");
+    } else {
+        REP_LIT("false");
+    }
 }
 
-static json_object *json_get_fs_info() {
-    char *value;
-    json_object *fs = json_object_new_object();
-
-    value = uint64_to_hex_string_cast(ctrl.fs_magic);
-    json_object_object_add(fs, "fs_magic", json_object_new_string(value));
-    free(value);
-
-    if (ctrl.fs_magic == F2FS_MAGIC) {
-        json_object_object_add(fs, "fs", json_object_new_string("F2FS"));
-        json_object_object_add(
-            fs, "f2fs_segment_sectors",
-            json_object_new_double(ctrl.f2fs_segment_sectors));
-        json_object_object_add(fs, "f2fs_segment_shift",
-                               json_object_new_int(ctrl.segment_shift));
-
-        value = uint64_to_hex_string_cast(ctrl.f2fs_segment_mask);
-        json_object_object_add(fs, "f2fs_segment_mask",
-                               json_object_new_string(value));
-        free(value);
-    } else if (ctrl.fs_magic == BTRFS_MAGIC) {
-        json_object_object_add(fs, "fs", json_object_new_string("Btrfs"));
+static void json_add_bdev(struct control *ctrl, struct json_writer *jw,
+                          const char *key, struct bdev *bdev) {
+    json_key(jw, key);
+    json_open(jw, "{");
+
+    json_add_string(jw, "dev_name", bdev->dev_name);
+    json_add_string(jw, "dev_path", bdev->dev_path);
+    json_add_string(jw, "link_name", bdev->link_name);
+    json_add_bool(jw, "is_zoned", bdev->is_zoned);
+
+    if (bdev->is_zoned) {
+        json_add_int(jw, "nr_zones", bdev->nr_zones);
+        json_add_int(jw, "zone_size", bdev->zone_size);
+        json_add_hex(jw, "zone_mask", bdev->zone_mask);
+        json_add_int(jw, "sector_size", ctrl->sector_size);
+        json_add_int(jw, "sector_shift", ctrl->sector_shift);
+        json_add_hex(jw, "offset", bdev->offset);
+        json_add_int(jw, "zone_offset", bdev->zone_offset);
     }
 
-    return fs;
+    json_close(jw, "}");
 }
 
-static json_object *json_get_ctrl_config() {
-    json_object *config, *dev, *fs;
+static void json_add_fs_info(struct control *ctrl, struct json_writer *jw) {
+    json_key(jw, "filesystem");
+    json_open(jw, "{");
+
+    json_add_hex(jw, "fs_magic", ctrl->fs_magic);
+
+    if (ctrl->fs_magic == F2FS_MAGIC) {
+        json_add_string(jw, "fs", "F2FS");
+        /* kept as a double for compatibility with prior dumps */
+        json_key(jw, "f2fs_segment_sectors");
+        rep_dec(ctrl->f2fs_segment_sectors, 0);
+        REP_LIT(".0");
+        json_add_int(jw, "f2fs_segment_shift", ctrl->segment_shift);
+        json_add_hex(jw, "f2fs_segment_mask", ctrl->f2fs_segment_mask);
+    } else if (ctrl->fs_magic == BTRFS_MAGIC) {
+        json_add_string(jw, "fs", "Btrfs");
+    }
 
-    config = json_object_new_object();
+    json_close(jw, "}");
+}
 
-    if (ctrl.multi_dev) {
-        dev = json_get_bdev(ctrl.bdev);
-        json_object_object_add(config, "dev-1", dev);
+/*
+ * Add the profile of the run up to the json dump, which itself is only in the
+ * profile printed at the end of the run.
+ *
+ * */
+static void json_add_profile(struct json_writer *jw) {
+    json_key(jw, "profile");
+    json_open(jw, "{");
+
+    json_add_int(jw, "elapsed_ns", profile_clock() - profile.start);
+
+    json_key(jw, "phases");
+    json_open(jw, "{");
+    for (uint8_t i = 0; i < PROFILE_NR_PHASES; i++) {
+        json_key(jw, profile_phase_names[i]);
+        json_open(jw, "{");
+        json_add_int(jw, "calls", profile.phase_ctr[i]);
+        json_add_int(jw, "ns", profile.phase_ns[i]);
+        json_close(jw, "}");
     }
+    json_close(jw, "}");
 
-    dev = json_get_bdev(ctrl.znsdev);
-    json_object_object_add(config, "dev-2", dev);
+    json_key(jw, "syscalls");
+    json_open(jw, "{");
+    for (uint8_t i = 0; i < PROFILE_NR_SYSCALLS; i++) {
+        json_add_int(jw, profile_syscall_names[i], profile.syscall_ctr[i]);
+    }
+    json_close(jw, "}");
 
-    fs = json_get_fs_info();
-    json_object_object_add(config, "filesystem", fs);
+    json_add_int(jw, "zonemap_allocs", profile.alloc_ctr);
+    json_add_int(jw, "zonemap_alloc_bytes", profile.alloc_bytes);
+    json_add_int(jw, "zonemap_peak_bytes", profile.zonemap_peak);
 
-    return config;
+    json_close(jw, "}");
 }
 
-static int init_json_file() {
-    json_object *info;
+static void json_add_info(struct control *ctrl, struct json_writer *jw) {
     struct timespec ts;
+    char key[16];
 
-    ctrl.json_root = json_object_new_object();
-
-    if (!ctrl.json_root)
-        ERR_MSG("Failed setting json output root object\n");
-
-    info = json_object_new_object();
+    json_key(jw, "info");
+    json_open(jw, "{");
 
-    json_object_object_add(info, "program", json_object_new_string(ctrl.argv));
+    json_add_string(jw, "program", ctrl->argv);
 
     // TODO: What time do we need? realtime format with day...?
     clock_gettime(CLOCK_REALTIME, &ts);
+    json_add_int(jw, "time", ts.tv_sec);
 
-    json_object_object_add(info, "time", json_object_new_uint64(ts.tv_sec));
-    json_object_object_add(info, "config", json_get_ctrl_config());
-
-    json_object_object_add(ctrl.json_root, "info", info);
-
-    return EXIT_SUCCESS;
-}
-
-static json_object *json_get_zone_info(uint32_t zone) {
-    json_object *zone_json = json_object_new_object();
-    char *value;
-    unsigned long long start_sector = 0;
-    struct blk_zone_report *hdr = NULL;
-
-    start_sector = (ctrl.znsdev.zone_size << ctrl.zns_sector_shift) * zone;
-
-    int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
-    if (fd < 0) {
-        return NULL;
+    json_key(jw, "config");
+    json_open(jw, "{");
+    if (ctrl->multi_dev) {
+        json_add_bdev(ctrl, jw, "dev-1", &ctrl->bdev);
     }
-
-    hdr = calloc(1, sizeof(struct blk_zone_report) + sizeof(struct blk_zone));
-    hdr->sector = start_sector;
-    hdr->nr_zones = 1;
-
-    if (ioctl(fd, BLKREPORTZONE, hdr) < 0) {
-        ERR_MSG("getting Zone Info\n");
-        return NULL;
+    /* ZNS devices follow as dev-2, dev-3, ... */
+    for (uint8_t i = 0; i < ctrl->nr_znsdevs; i++) {
+        snprintf(key, sizeof(key), "dev-%u", i + 2);
+        json_add_bdev(ctrl, jw, key, &ctrl->znsdev[i]);
     }
+    json_add_fs_info(ctrl, jw);
+    json_close(jw, "}");
 
-    value =
-        uint64_to_hex_string_cast(hdr->zones[0].start >> ctrl.zns_sector_shift);
-    json_object_object_add(zone_json, "lbas", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(
-        (hdr->zones[0].start >> ctrl.zns_sector_shift) +
-        (hdr->zones[0].capacity >> ctrl.zns_sector_shift));
-    json_object_object_add(zone_json, "lbae", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(hdr->zones[0].capacity >>
-                                      ctrl.zns_sector_shift);
-    json_object_object_add(zone_json, "cap", json_object_new_string(value));
-    free(value);
-
-    value =
-        uint64_to_hex_string_cast(hdr->zones[0].wp >> ctrl.zns_sector_shift);
-    json_object_object_add(zone_json, "wp", json_object_new_string(value));
-    free(value);
-
-    value =
-        uint64_to_hex_string_cast(hdr->zones[0].len >> ctrl.zns_sector_shift);
-    json_object_object_add(zone_json, "size", json_object_new_string(value));
-    free(value);
-
-    value = uint32_to_hex_string_cast(hdr->zones[0].cond << 4);
-    json_object_object_add(zone_json, "state", json_object_new_string(value));
-    free(value);
-
-    value = uint32_to_hex_string_cast(ctrl.znsdev.zone_mask);
-    json_object_object_add(zone_json, "mask", json_object_new_string(value));
-    free(value);
-
-    close(fd);
-
-    free(hdr);
-    hdr = NULL;
-
-    return zone_json;
-}
-
-static json_object *json_get_segment_info(struct extent *extent,
-                                          uint64_t segment_start) {
-    struct segment_info *seg_i = (struct segment_info *)extent->fs_info;
-    char *value;
-    json_object *segment = json_object_new_object();
-
-    value = uint64_to_hex_string_cast(segment_start << ctrl.segment_shift);
-    json_object_object_add(segment, "pbas", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast((segment_start << ctrl.segment_shift) +
-                                      ctrl.f2fs_segment_sectors);
-    json_object_object_add(segment, "pbae", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(ctrl.f2fs_segment_sectors);
-    json_object_object_add(segment, "size", json_object_new_string(value));
-    free(value);
-
-    switch (seg_i->type) {
-    case CURSEG_HOT_DATA:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_HOT_DATA"));
-        break;
-    case CURSEG_WARM_DATA:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_WARM_DATA"));
-        break;
-    case CURSEG_COLD_DATA:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_COLD_DATA"));
-        break;
-    case CURSEG_HOT_NODE:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_HOT_NODE"));
-        break;
-    case CURSEG_WARM_NODE:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_WARM_NODE"));
-        break;
-    case CURSEG_COLD_NODE:
-        json_object_object_add(segment, "type",
-                               json_object_new_string("CURSEG_COLD_NODE"));
-        break;
-    case NO_CHECK_TYPE:
-        break;
+    if (profile.enabled) {
+        json_add_profile(jw);
     }
 
-    json_object_object_add(
-        segment, "valid_blocks",
-        json_object_new_int(seg_i->valid_blocks << F2FS_BLKSIZE_BITS >>
-                            ctrl.sector_shift));
-
-    return segment;
+    json_close(jw, "}");
 }
 
-static json_object *json_get_extent_info(struct extent *extent) {
-    char *value;
-    json_object *ext = json_object_new_object();
-
-    json_object_object_add(ext, "file", json_object_new_string(extent->file));
-
-    value = uint64_to_hex_string_cast(extent->phy_blk);
-    json_object_object_add(ext, "pbas", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(extent->phy_blk + extent->len);
-    json_object_object_add(ext, "pbae", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(extent->len);
-    json_object_object_add(ext, "size", json_object_new_string(value));
-    free(value);
-
-    json_object_object_add(ext, "ext_nr",
-                           json_object_new_int(extent->ext_nr + 1));
-    json_object_object_add(
-        ext, "total_exts",
-        json_object_new_int(get_file_extent_count(extent->file)));
-
-    return ext;
+/*
+ * Zone info is taken from the zone report collected during init of the
+ * zonemap, instead of issuing a report for each zone.
+ *
+ * */
+static void json_add_zone_info(struct control *ctrl, struct json_writer *jw,
+                               struct zone *zone) {
+    json_key(jw, "zone_info");
+    json_open(jw, "{");
+
+    json_add_hex(jw, "lbas", zone->start);
+    json_add_hex(jw, "lbae", zone->end);
+    json_add_hex(jw, "cap", zone->capacity);
+    json_add_hex(jw, "wp", zone->wp);
+    json_add_hex(jw, "size", ctrl->znsdev[0].zone_size);
+    json_add_hex(jw, "state", zone->state);
+    json_add_hex(jw, "mask", zone->mask);
+
+    json_close(jw, "}");
 }
 
-static json_object *
-json_get_beginning_segment_extent_info(struct extent *extent) {
-    char *value;
-    json_object *ext = json_object_new_object();
-    uint64_t segment_start = (extent->phy_blk & ctrl.f2fs_segment_mask);
-    uint64_t segment_end = segment_start + (ctrl.f2fs_segment_sectors);
-
-    json_object_object_add(ext, "file", json_object_new_string(extent->file));
-
-    value = uint64_to_hex_string_cast(extent->phy_blk);
-    json_object_object_add(ext, "pbas", json_object_new_string(value));
-    free(value);
+static void json_add_hist(struct json_writer *jw, const char *key,
+                          struct size_hist *hist) {
+    uint32_t i, nr_buckets = 0;
 
-    value = uint64_to_hex_string_cast(segment_end);
-    json_object_object_add(ext, "pbae", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(segment_end - extent->phy_blk);
-    json_object_object_add(ext, "size", json_object_new_string(value));
-    free(value);
+    for (i = 0; i < SIZE_HIST_BUCKETS; i++) {
+        if (hist->buckets[i]) {
+            nr_buckets = i + 1;
+        }
+    }
 
-    json_object_object_add(ext, "ext_nr",
-                           json_object_new_int(extent->ext_nr + 1));
-    json_object_object_add(
-        ext, "total_exts",
-        json_object_new_int(get_file_extent_count(extent->file)));
+    json_key(jw, key);
+    json_open(jw, "{");
+
+    json_add_int(jw, "count", hist->ctr);
+    json_add_hex(jw, "p50", size_hist_percentile(hist, 50));
+    json_add_hex(jw, "p90", size_hist_percentile(hist, 90));
+    json_add_hex(jw, "p99", size_hist_percentile(hist, 99));
+
+    /* bucket i counts sizes in [2^i, 2^(i+1)), trailing empty buckets are
+     * omitted */
+    json_key(jw, "buckets");
+    json_open(jw, "[");
+    for (i = 0; i < nr_buckets; i++) {
+        json_sep(jw);
+        rep_dec(hist->buckets[i], 0);
+    }
+    json_close(jw, "]");
 
-    return ext;
+    json_close(jw, "}");
 }
 
-/* function is only for an extent that occupies the entire segment (up to the
- * last LBA) */
-static void json_add_single_segment_extent_info(struct extent *extent,
-                                                uint64_t segment_start,
-                                                json_object *root) {
-    char *value;
-    json_object *curseg, *curseg_extents, *curext;
-
-    curseg = json_object_new_object();
-    json_object_object_add(curseg, "seg_info",
-                           json_get_segment_info(extent, segment_start));
-    curseg_extents = json_object_new_array();
+/*
+ * Add the extent and hole size histograms, of a zone or the entire zonemap
+ *
+ * */
+static void json_add_size_hist(struct json_writer *jw,
+                               struct size_hist *extent_hist,
+                               struct size_hist *hole_hist) {
+    json_key(jw, "size_hist");
+    json_open(jw, "{");
+    json_add_hist(jw, "extents", extent_hist);
+    json_add_hist(jw, "holes", hole_hist);
+    json_close(jw, "}");
+}
 
-    curext = json_object_new_object();
+static void json_add_segment_info(struct control *ctrl, struct json_writer *jw,
+                                  struct extent *extent,
+                                  uint64_t segment_id) {
+    static const char *const type_names[] = {
+        [CURSEG_HOT_DATA] = "CURSEG_HOT_DATA",
+        [CURSEG_WARM_DATA] = "CURSEG_WARM_DATA",
+        [CURSEG_COLD_DATA] = "CURSEG_COLD_DATA",
+        [CURSEG_HOT_NODE] = "CURSEG_HOT_NODE",
+        [CURSEG_WARM_NODE] = "CURSEG_WARM_NODE",
+        [CURSEG_COLD_NODE] = "CURSEG_COLD_NODE",
+    };
+    struct segment_info *seg_i = (struct segment_info *)extent->fs_info;
 
-    json_object_object_add(curext, "ext_info", json_get_extent_info(extent));
-    json_object_array_add(curseg_extents, curext);
-    json_object_object_add(curseg, "extents", curseg_extents);
+    json_key(jw, "seg_info");
+    json_open(jw, "{");
 
-    value = uint32_to_string_cast(segment_start);
-    json_object_object_add(root, value, curseg);
-    free(value);
-}
+    json_add_hex(jw, "pbas", segment_id << ctrl->segment_shift);
+    json_add_hex(jw, "pbae", (segment_id << ctrl->segment_shift) +
+                                 ctrl->f2fs_segment_sectors);
+    json_add_hex(jw, "size", ctrl->f2fs_segment_sectors);
 
-static void json_add_consecutive_segments_extent_info(struct extent *extent,
-                                                      uint64_t segment_start,
-                                                      json_object *root) {
-    uint64_t segment_end =
-        ((extent->phy_blk + extent->len) & ctrl.f2fs_segment_mask) >>
-        ctrl.segment_shift;
-    uint64_t num_segments = segment_end - segment_start;
-
-    if (num_segments == 1) {
-        /* The extent starts exactly at the segment beginning and ends somewhere
-         * in the next segment then we just want to show the 1st segment */
-        json_add_single_segment_extent_info(extent, segment_start, root);
-    } else {
-        for (uint32_t cur = segment_start; cur < segment_end - 1;
-             cur += ctrl.f2fs_segment_sectors) {
-            json_add_single_segment_extent_info(extent, segment_start, root);
+    if (seg_i) {
+        if (seg_i->type < NO_CHECK_TYPE) {
+            json_add_string(jw, "type", type_names[seg_i->type]);
         }
+        json_add_int(jw, "valid_blocks", seg_i->valid_blocks
+                                             << F2FS_BLKSIZE_BITS >>
+                                             ctrl->sector_shift);
     }
+
+    json_close(jw, "}");
 }
 
-static void json_add_remainder_segment_extent_info(struct extent *extent,
-                                                   json_object *root) {
-    uint64_t segment_start =
-        ((extent->phy_blk + extent->len) & ctrl.f2fs_segment_mask) >>
-        ctrl.segment_shift;
-    uint64_t remainder =
-        extent->phy_blk + extent->len - (segment_start << ctrl.segment_shift);
-    char *value;
-    json_object *curext;
-
-    curext = json_object_new_object();
-
-    json_object_object_add(curext, "file",
-                           json_object_new_string(extent->file));
-
-    value = uint64_to_hex_string_cast(segment_start << ctrl.segment_shift);
-    json_object_object_add(curext, "pbas", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast((segment_start << ctrl.segment_shift) +
-                                      remainder);
-    json_object_object_add(curext, "pbae", json_object_new_string(value));
-    free(value);
-
-    value = uint64_to_hex_string_cast(remainder);
-    json_object_object_add(curext, "size", json_object_new_string(value));
-    free(value);
-
-    json_object_object_add(curext, "ext_nr",
-                           json_object_new_int(extent->ext_nr + 1));
-    json_object_object_add(
-        curext, "total_exts",
-        json_object_new_int(get_file_extent_count(extent->file)));
-
-    json_object_array_add(root, curext);
+/*
+ * Add the part of an extent that is in a single segment
+ *
+ * */
+static void json_add_extent_info(struct control *ctrl, struct json_writer *jw,
+                                 struct extent *extent, uint64_t pbas,
+                                 uint64_t pbae) {
+    json_sep(jw);
+    json_open(jw, "{");
+    json_key(jw, "ext_info");
+    json_open(jw, "{");
+
+    json_add_string(jw, "file", extent->file);
+    json_add_hex(jw, "pbas", pbas);
+    json_add_hex(jw, "pbae", pbae);
+    json_add_hex(jw, "size", pbae - pbas);
+    json_add_int(jw, "ext_nr", extent->ext_nr + 1);
+    json_add_int(jw, "total_exts",
+                 get_extent_file_counter(ctrl, extent)->ext_ctr);
+
+    json_close(jw, "}");
+    json_close(jw, "}");
 }
 
 /* F2FS specific report of file mappings similarly results in a different
- * json data for the segment info, which is dumped by this function */
-static int json_dump_f2fs_zonemap() {
+ * json data for the segment info, which is rendered by this function for a
+ * range of zones (see render_zones()).
+ *
+ * Extents are split up at segment boundaries and each part is added to the
+ * extents of its segment. Since extents in a zone are sorted by PBAS, segments
+ * are visited in order, and each zone and segment object is opened once and
+ * closed as soon as the next one starts. */
+static void json_render_f2fs_zones(struct control *ctrl, uint32_t start,
+                                   uint32_t end, void *arg) {
+    struct json_writer writer, *jw = &writer;
+    struct zone *zone;
     struct node *current;
-    uint32_t i = 0, extents = 0;
-    uint32_t current_zone = 0;
-    uint64_t segment_id = 0;
-    uint64_t start_lba =
-        ctrl.start_zone * ctrl.znsdev.zone_size - ctrl.znsdev.zone_size;
-    uint64_t end_lba =
-        (ctrl.end_zone + 1) * ctrl.znsdev.zone_size - ctrl.znsdev.zone_size;
-    json_object *zonemap = json_object_new_object();
-    json_object *zone, *zone_segments,
-        *curseg = json_object_new_object(),
-        *curseg_extents = json_object_new_array(), *curext;
-    uint32_t curseg_id = 0;
-    char *value;
-
-    for (i = 0; i < ctrl.zonemap->nr_zones; i++) {
-        if (ctrl.zonemap->zones[i].extent_ctr == 0) {
+    uint32_t i = 0;
+    uint8_t zone_open = 0, segment_open = 0;
+    uint64_t segment_id = 0, cur_segment = 0;
+    uint64_t pbas, pbae, segment_end;
+    uint64_t start_lba = ctrl->start_zone * ctrl->znsdev[0].zone_size -
+                         ctrl->znsdev[0].zone_size;
+    uint64_t end_lba = (ctrl->end_zone + 1) * ctrl->znsdev[0].zone_size -
+                       ctrl->znsdev[0].zone_size;
+
+    (void)arg;
+
+    /* zones are members of the zonemap object, separated by render_zones() */
+    memset(jw, 0, sizeof(struct json_writer));
+    jw->depth = 1;
+
+    for (i = start; i < end; i++) {
+        if (ctrl->zonemap->zones[i].extent_ctr == 0) {
             continue;
         }
 
-        current = ctrl.zonemap->zones[i].extents_head;
-        zone = json_object_new_object();
-        zone_segments = json_object_new_object();
-        extents = 0;
+        current = ctrl->zonemap->zones[i].extents_head;
 
         while (current) {
-            extents++;
-            segment_id = (current->extent->phy_blk & ctrl.f2fs_segment_mask) >>
-                         ctrl.segment_shift;
-            if ((segment_id << ctrl.segment_shift) >= end_lba) {
-                break;
-            }
-
-            if ((segment_id << ctrl.segment_shift) < start_lba) {
-                continue;
-            }
-
-            if (current_zone != current->extent->zone) {
-                current_zone = current->extent->zone;
-            }
-
-            if (curseg_id != segment_id) {
-                /* Add all previously collected segments and extents to the
-                 * zonemap json, only if data has been written. First iteration
-                 * in the loop this array will be empty. */
-                if (json_object_array_length(curseg_extents) > 0) {
-                    json_object_object_add(curseg, "extents", curseg_extents);
-
-                    value = uint32_to_string_cast(segment_id);
-                    json_object_object_add(zone_segments, value, curseg);
-                    free(value);
+            pbas = current->extent->phy_blk;
+            pbae = current->extent->phy_blk + current->extent->len;
+
+            do {
+                segment_id =
+                    (pbas & ctrl->f2fs_segment_mask) >> ctrl->segment_shift;
+                if ((segment_id << ctrl->segment_shift) >= end_lba) {
+                    goto finish;
                 }
 
-                curseg = json_object_new_object();
-                json_object_object_add(
-                    curseg, "seg_info",
-                    json_get_segment_info(current->extent, segment_id));
-                curseg_extents = json_object_new_array();
-
-                curseg_id = segment_id;
-            }
-
-            uint64_t segment_start =
-                (current->extent->phy_blk & ctrl.f2fs_segment_mask);
-            uint64_t extent_end =
-                current->extent->phy_blk + current->extent->len;
-
-            /* if the beginning of the extent and the ending of the extent are
-             * in the same segment */
-            if (segment_start == (extent_end & ctrl.f2fs_segment_mask) ||
-                extent_end == (segment_start +
-                               (F2FS_SEGMENT_BYTES >> ctrl.sector_shift))) {
-                if (segment_id != ctrl.cur_segment) {
-                    curext = json_object_new_object();
-
-                    json_object_object_add(
-                        curext, "ext_info",
-                        json_get_extent_info(current->extent));
-                    json_object_array_add(curseg_extents, curext);
-
-                    ctrl.cur_segment = segment_id;
-                } else {
-                    curext = json_object_new_object();
-
-                    json_object_object_add(
-                        curext, "ext_info",
-                        json_get_extent_info(current->extent));
-                    json_object_array_add(curseg_extents, curext);
+                segment_end = (segment_id + 1) << ctrl->segment_shift;
+                if (segment_end > pbae) {
+                    segment_end = pbae;
                 }
-            } else {
-                /* Else the extent spans across multiple segments, so we need to
-                 * break it up */
-
-                /* part 1: the beginning of extent to end of that single segment
-                 */
-                if (current->extent->phy_blk != segment_start) {
-                    curext = json_object_new_object();
-                    json_object_object_add(
-                        curext, "ext_info",
-                        json_get_beginning_segment_extent_info(
-                            current->extent));
-                    json_object_array_add(curseg_extents, curext);
-                    segment_id++;
+
+                if ((segment_id << ctrl->segment_shift) < start_lba) {
+                    pbas = segment_end;
+                    continue;
+                }
+
+                if (!zone_open) {
+                    zone = &ctrl->zonemap->zones[current->extent->zone];
+                    json_key_dec(jw, current->extent->zone);
+                    json_open(jw, "{");
+                    json_add_zone_info(ctrl, jw, zone);
+                    json_add_size_hist(jw, &zone->extent_hist,
+                                       &zone->hole_hist);
+                    json_key(jw, "segments");
+                    json_open(jw, "{");
+                    zone_open = 1;
                 }
 
-                /* part 2: all in between segments after the 1st segment and the
-                 * last (in case the last is only partially used by the segment)
-                 * - checks if there are more than 1 segments after the start */
-                uint64_t segment_end =
-                    ((current->extent->phy_blk + current->extent->len) &
-                     ctrl.f2fs_segment_mask);
-                if ((segment_end - segment_start) >> ctrl.segment_shift > 1)
-                    json_add_consecutive_segments_extent_info(
-                        current->extent, segment_id, zone_segments);
-
-                /* part 3: any remaining parts of the last segment, which do not
-                 * fill the entire last segment only if the segment actually has
-                 * a remaining fragment */
-                if (segment_end !=
-                    current->extent->phy_blk + current->extent->len) {
-                    json_add_remainder_segment_extent_info(current->extent,
-                                                           curseg_extents);
+                if (!segment_open || cur_segment != segment_id) {
+                    if (segment_open) {
+                        json_close(jw, "]");
+                        json_close(jw, "}");
+                    }
+
+                    json_key_dec(jw, segment_id);
+                    json_open(jw, "{");
+                    json_add_segment_info(ctrl, jw, current->extent,
+                                          segment_id);
+                    json_key(jw, "extents");
+                    json_open(jw, "[");
+                    segment_open = 1;
+                    cur_segment = segment_id;
                 }
-            }
+
+                json_add_extent_info(ctrl, jw, current->extent, pbas,
+                                     segment_end);
+                pbas = segment_end;
+            } while (pbas < pbae);
 
             current = current->next;
         }
 
-        json_object_object_add(zone, "zone_info",
-                               json_get_zone_info(current_zone));
-        json_object_object_add(zone, "segments", zone_segments);
+        if (segment_open) {
+            json_close(jw, "]");
+            json_close(jw, "}");
+            segment_open = 0;
+        }
 
-        value = uint32_to_string_cast(current_zone);
-        json_object_object_add(zonemap, value, zone);
-        free(value);
+        if (zone_open) {
+            json_close(jw, "}");
+            json_close(jw, "}");
+            zone_open = 0;
+        }
     }
 
-    json_object_object_add(ctrl.json_root, "zonemap", zonemap);
+finish:
+    if (segment_open) {
+        json_close(jw, "]");
+        json_close(jw, "}");
+    }
 
-    return EXIT_SUCCESS;
+    if (zone_open) {
+        json_close(jw, "}");
+        json_close(jw, "}");
+    }
+}
+
+static void json_dump_f2fs_zonemap(struct control *ctrl,
+                                   struct json_writer *jw) {
+    json_key(jw, "zonemap");
+    json_open(jw, "{");
+    render_zones(ctrl, json_render_f2fs_zones, NULL, NULL, 0, ",");
+    json_close(jw, "}");
 }
 
-int json_dump_data() {
-    if (init_json_file() == EXIT_FAILURE)
+int json_dump_data(struct control *ctrl) {
+    struct json_writer jw;
+    uint64_t start = profile_start();
+    int fd;
+
+    memset(&jw, 0, sizeof(struct json_writer));
+
+    fd = open(ctrl->json_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ERR_MSG("Failed saving json data to %s\n", ctrl->json_file);
         return EXIT_FAILURE;
+    }
 
-    if (ctrl.fs_magic == F2FS_MAGIC)
-        json_dump_f2fs_zonemap();
+    rep_set_fd(fd);
+
+    json_open(&jw, "{");
+    json_add_info(ctrl, &jw);
+
+    if (ctrl->fs_magic == F2FS_MAGIC) {
+        json_dump_f2fs_zonemap(ctrl, &jw);
+        json_add_size_hist(&jw, &ctrl->zonemap->extent_hist,
+                            &ctrl->zonemap->hole_hist);
+    }
     // TODO: else just dump the zonemap to json
 
-    if (json_object_to_file(ctrl.json_file, ctrl.json_root) == EXIT_FAILURE)
-        ERR_MSG("Failed saving json data to %s\n", ctrl.json_file);
+    json_close(&jw, "}");
+
+    rep_set_fd(-1);
+    close(fd);
 
-    json_object_put(ctrl.json_root);
+    profile_stop(PROFILE_JSON, start);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,66 @@
+#include "profile.h"
+
+#include <stdio.h>
+#include <sys/resource.h>
+
+struct profile profile;
+
+const char *profile_phase_names[PROFILE_NR_PHASES] = {
+    "dir_walk", "fsync", "fiemap", "zone_report",
+    "procfs",   "sort",  "print",  "json"};
+
+const char *profile_syscall_names[PROFILE_NR_SYSCALLS] = {
+    "open",     "ioctl",   "pread",  "statfs", "fstat",
+    "readlink", "readdir", "procfs", "fsync"};
+
+/*
+ * Enable profiling, the total time of the run is taken from here.
+ *
+ * */
+void profile_init() {
+    profile.enabled = 1;
+    profile.start = profile_clock();
+}
+
+/*
+ * Print the phases, call counters, and zonemap memory of the run to stderr,
+ * such that they do not mix with the report on stdout.
+ *
+ * */
+void profile_report() {
+    struct rusage usage;
+    uint64_t total, phases = 0;
+
+    if (!profile.enabled) {
+        return;
+    }
+
+    total = profile_clock() - profile.start;
+
+    fprintf(stderr, "\n==== PROFILE ====\n%-12s %10s %14s %7s\n", "PHASE",
+            "CALLS", "TIME (ms)", "%");
+    for (uint8_t i = 0; i < PROFILE_NR_PHASES; i++) {
+        phases += profile.phase_ns[i];
+        fprintf(stderr, "%-12s %10lu %14.3f %6.1f%%\n",
+                profile_phase_names[i], profile.phase_ctr[i],
+                profile.phase_ns[i] / 1e6,
+                total ? profile.phase_ns[i] * 100.0 / total : 0);
+    }
+    fprintf(stderr, "%-12s %10s %14.3f %6.1f%%\n", "other", "",
+            (total - phases) / 1e6,
+            total ? (total - phases) * 100.0 / total : 0);
+    fprintf(stderr, "%-12s %10s %14.3f\n", "total", "", total / 1e6);
+
+    fprintf(stderr, "\n%-12s %10s\n", "SYSCALL", "CALLS");
+    for (uint8_t i = 0; i < PROFILE_NR_SYSCALLS; i++) {
+        fprintf(stderr, "%-12s %10lu\n", profile_syscall_names[i],
+                profile.syscall_ctr[i]);
+    }
+
+    fprintf(stderr, "\nZonemap allocations: %lu (%lu bytes)\n",
+            profile.alloc_ctr, profile.alloc_bytes);
+    fprintf(stderr, "Zonemap peak memory: %lu bytes\n", profile.zonemap_peak);
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        fprintf(stderr, "Max RSS: %ld KiB\n", usage.ru_maxrss);
+    }
+}
@@ -0,0 +1,283 @@
+#include "report.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct rep_buffer {
+    char *data;      /* REP_BUF_SIZE bytes, allocated on first use */
+    size_t len;      /* number of bytes pending in data */
+    size_t size;     /* allocated bytes of data, grows while capturing */
+    int fd;          /* fd to write to if to_fd is set, else stdout */
+    uint8_t to_fd;   /* flag if output is redirected with rep_set_fd() */
+    uint8_t capture; /* flag if output is kept in memory, see rep_capture() */
+    uint8_t failed;  /* flag if a write failed, output is dropped until the
+                        next rep_set_fd() */
+};
+
+static __thread struct rep_buffer rep_buf;
+static pthread_once_t rep_atexit_once = PTHREAD_ONCE_INIT;
+
+static const char hex_digits[] = "0123456789abcdef";
+static const char spaces[] = "                                ";
+
+/*
+ * Write the entire buffer to the fd, retrying on short writes. Once a write
+ * fails (e.g., a send timeout of a socket), the remaining output is dropped,
+ * such that a peer that stopped reading only blocks the writer once.
+ *
+ * */
+static void rep_write_fd(int fd, const char *data, size_t len) {
+    ssize_t ret;
+
+    while (len > 0 && !rep_buf.failed) {
+        ret = write(fd, data, len);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            rep_buf.failed = 1;
+            return;
+        }
+        data += ret;
+        len -= ret;
+    }
+}
+
+/*
+ * Write out any pending report output of the calling thread.
+ *
+ * Anything that was printed with printf() prior to the buffered output is
+ * flushed first, such that the ordering of the output is retained.
+ *
+ * */
+void rep_flush() {
+    if (rep_buf.len == 0 || rep_buf.capture) {
+        return;
+    }
+
+    if (rep_buf.to_fd) {
+        rep_write_fd(rep_buf.fd, rep_buf.data, rep_buf.len);
+    } else {
+        fflush(stdout);
+        rep_write_fd(STDOUT_FILENO, rep_buf.data, rep_buf.len);
+    }
+    rep_buf.len = 0;
+}
+
+/*
+ * Redirect the report output of the calling thread to a file. Pending output
+ * is flushed to the prior destination first.
+ *
+ * @fd: fd to write to, or -1 to go back to stdout
+ *
+ * */
+void rep_set_fd(int fd) {
+    rep_flush();
+
+    rep_buf.fd = fd;
+    rep_buf.to_fd = fd >= 0;
+    rep_buf.failed = 0;
+}
+
+/*
+ * Start keeping the report output of the calling thread in memory, instead of
+ * writing it out. The buffer grows as needed until rep_capture_end() hands it
+ * over to the caller. Used to render parts of a report in parallel, which are
+ * then written out in order.
+ *
+ * */
+void rep_capture() {
+    rep_flush();
+    rep_buf.capture = 1;
+}
+
+/*
+ * Stop capturing the report output of the calling thread.
+ *
+ * @data: returns the captured output, to be freed by the caller
+ * @len: returns the number of bytes in data
+ *
+ * */
+void rep_capture_end(char **data, size_t *len) {
+    *data = rep_buf.data;
+    *len = rep_buf.len;
+
+    rep_buf.data = NULL;
+    rep_buf.len = 0;
+    rep_buf.size = 0;
+    rep_buf.capture = 0;
+}
+
+static void rep_register_atexit() {
+    /* ERR_MSG() exits, make sure the report up to the error is shown */
+    atexit(rep_flush);
+}
+
+/*
+ * Make room for len bytes in the buffer of the calling thread.
+ *
+ * returns: char * to the position to write to
+ *
+ * */
+static char *rep_reserve(size_t len) {
+    size_t size;
+
+    if (rep_buf.data == NULL) {
+        rep_buf.data = malloc(REP_BUF_SIZE);
+        if (rep_buf.data == NULL) {
+            fprintf(stderr, "Failed allocating report buffer\n");
+            exit(1);
+        }
+        rep_buf.size = REP_BUF_SIZE;
+        pthread_once(&rep_atexit_once, rep_register_atexit);
+    }
+
+    if (rep_buf.len + len > rep_buf.size && rep_buf.capture) {
+        size = rep_buf.size;
+        while (rep_buf.len + len > size) {
+            size <<= 1;
+        }
+
+        rep_buf.data = realloc(rep_buf.data, size);
+        if (rep_buf.data == NULL) {
+            fprintf(stderr, "Failed allocating report buffer\n");
+            exit(1);
+        }
+        rep_buf.size = size;
+    } else if (rep_buf.len + len > rep_buf.size) {
+        rep_flush();
+    }
+
+    return rep_buf.data + rep_buf.len;
+}
+
+/*
+ * Append len bytes of s to the report.
+ *
+ * */
+void rep_write(const char *s, size_t len) {
+    if (len > REP_BUF_SIZE && !rep_buf.capture) {
+        rep_flush();
+        if (rep_buf.to_fd) {
+            rep_write_fd(rep_buf.fd, s, len);
+        } else {
+            fflush(stdout);
+            rep_write_fd(STDOUT_FILENO, s, len);
+        }
+        return;
+    }
+
+    memcpy(rep_reserve(len), s, len);
+    rep_buf.len += len;
+}
+
+static void rep_spaces(size_t n) {
+    while (n > sizeof(spaces) - 1) {
+        rep_write(spaces, sizeof(spaces) - 1);
+        n -= sizeof(spaces) - 1;
+    }
+    rep_write(spaces, n);
+}
+
+/*
+ * Append s of length len, padded with spaces to the printf() style width.
+ *
+ * */
+static void rep_pad(const char *s, size_t len, int width) {
+    size_t abs_width = width < 0 ? -width : width;
+    size_t pad = len < abs_width ? abs_width - len : 0;
+
+    if (width > 0) {
+        rep_spaces(pad);
+    }
+    rep_write(s, len);
+    if (width < 0) {
+        rep_spaces(pad);
+    }
+}
+
+/*
+ * Append a string, equivalent to "%<width>s"
+ *
+ * */
+void rep_str(const char *s, int width) { rep_pad(s, strlen(s), width); }
+
+/*
+ * Append an unsigned decimal, equivalent to "%<width>" PRIu64
+ *
+ * */
+void rep_dec(uint64_t value, int width) {
+    char buf[20];
+    int pos = sizeof(buf);
+
+    do {
+        buf[--pos] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    rep_pad(buf + pos, sizeof(buf) - pos, width);
+}
+
+/*
+ * Append an alternate form hex value, equivalent to "%#<width>" PRIx64.
+ * Note, as with printf() a value of 0 is printed without the 0x prefix.
+ *
+ * */
+void rep_hex(uint64_t value, int width) {
+    char buf[18];
+    int pos = sizeof(buf);
+
+    do {
+        buf[--pos] = hex_digits[value & 0xf];
+        value >>= 4;
+    } while (value);
+
+    if (pos != sizeof(buf) - 1 || buf[pos] != '0') {
+        buf[--pos] = 'x';
+        buf[--pos] = '0';
+    }
+
+    rep_pad(buf + pos, sizeof(buf) - pos, width);
+}
+
+/*
+ * Append a zero padded hex value, equivalent to "0x%0<digits>" PRIx64
+ *
+ * */
+void rep_hex_zero(uint64_t value, int digits) {
+    char buf[18];
+    int pos = sizeof(buf);
+
+    do {
+        buf[--pos] = hex_digits[value & 0xf];
+        value >>= 4;
+    } while (value);
+
+    while (pos > 2 && (int)sizeof(buf) - pos < digits) {
+        buf[--pos] = '0';
+    }
+    buf[--pos] = 'x';
+    buf[--pos] = '0';
+
+    rep_write(buf + pos, sizeof(buf) - pos);
+}
+
+/*
+ * Append a double, equivalent to "%<width>f". Only used for summaries, hence
+ * it is fine to fall back to snprintf().
+ *
+ * */
+void rep_double(double value, int width) {
+    char buf[64];
+    int len;
+
+    len = snprintf(buf, sizeof(buf), "%*f", width, value);
+    if (len > (int)sizeof(buf) - 1) {
+        len = sizeof(buf) - 1;
+    }
+
+    rep_write(buf, len);
+}
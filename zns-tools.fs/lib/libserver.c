@@ -0,0 +1,79 @@
+#include "server.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Send a query to zns-toolsd and write its response to stdout.
+ *
+ * @socket_path: path of the Unix socket of the daemon
+ * @query: query line, without the newline
+ *
+ * returns: 0 on Success, 1 if the daemon is not reachable or the query failed
+ *
+ * */
+int server_query(const char *socket_path, const char *query) {
+    struct sockaddr_un addr;
+    char buf[65536];
+    ssize_t ret;
+    size_t len = 0;
+    int fd, failed = 0;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", socket_path);
+        return EXIT_FAILURE;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Failed connecting to zns-toolsd on %s: %s\n",
+                socket_path, strerror(errno));
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    if (dprintf(fd, "%s\n", query) < 0) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    shutdown(fd, SHUT_WR);
+
+    fflush(stdout);
+    while ((ret = read(fd, buf, sizeof(buf))) != 0) {
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed = 1;
+            break;
+        }
+
+        /* the daemon reports failed queries in the first line */
+        if (len == 0 && (size_t)ret >= sizeof(SERVER_ERROR) - 1 &&
+            strncmp(buf, SERVER_ERROR, sizeof(SERVER_ERROR) - 1) == 0) {
+            failed = 1;
+        }
+        len += ret;
+
+        if (fwrite(buf, 1, ret, stdout) != (size_t)ret) {
+            failed = 1;
+            break;
+        }
+    }
+
+    close(fd);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,299 @@
+#include "shm.h"
+#include "zns-tools.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+static size_t shm_zonemap_size(uint32_t nr_zones) {
+    return sizeof(struct shm_zonemap) + sizeof(struct shm_zone) * nr_zones;
+}
+
+/*
+ * Create (or replace) the shared memory segment of a zonemap summary.
+ *
+ * @name: name of the POSIX shared memory segment (e.g., ZNS_SHM_NAME)
+ * @nr_zones: number of zones of the zonemap
+ *
+ * returns: the segment mapped read-write, NULL on failure
+ *
+ * */
+struct shm_zonemap *shm_zonemap_create(const char *name, uint32_t nr_zones) {
+    struct shm_zonemap *map;
+    size_t size = shm_zonemap_size(nr_zones);
+    int fd;
+
+    /* readers still mapping a previous segment keep it until they close it */
+    shm_unlink(name);
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    map->version = ZNS_SHM_VERSION;
+    map->nr_zones = nr_zones;
+    __atomic_store_n(&map->magic, ZNS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return map;
+}
+
+/*
+ * Summarize the zonemap into the zones of a summary, outside of the seqlock
+ * write section to keep it short.
+ *
+ * @ctrl: struct control of the collector
+ * @zones: summary of each zone in the zonemap
+ * @nr_files: set to the number of distinct files with extents in the zonemap
+ *
+ * returns: number of bytes of all extents
+ *
+ * */
+static uint64_t summarize_zones(struct control *ctrl, struct shm_zone *zones,
+                                uint32_t *nr_files) {
+    struct zone *zone;
+    struct node *current;
+    struct segment_info *seg_i;
+    uint64_t temp_bytes[SHM_TEMP_COLD + 1];
+    uint64_t bytes, valid_bytes = 0;
+    uint32_t *last_zone;
+    uint8_t temp;
+
+    /* count a file once per zone, its extents in a zone are not adjacent */
+    last_zone = malloc(sizeof(uint32_t) * (ctrl->nr_files + 1));
+    if (!last_zone) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    memset(last_zone, 0xff, sizeof(uint32_t) * (ctrl->nr_files + 1));
+    *nr_files = 0;
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        zone = &ctrl->zonemap->zones[i];
+
+        zones[i].start = zone->start << ctrl->sector_shift;
+        zones[i].capacity = zone->capacity << ctrl->sector_shift;
+        zones[i].wp = zone->wp << ctrl->sector_shift;
+        zones[i].extent_ctr = zone->extent_ctr;
+        zones[i].state = zone->state >> 4;
+        zones[i].temp = SHM_TEMP_NONE;
+        memset(temp_bytes, 0, sizeof(temp_bytes));
+
+        for (current = zone->extents_head; current; current = current->next) {
+            bytes = current->extent->len << ctrl->sector_shift;
+            zones[i].valid_bytes += bytes;
+
+            if (last_zone[current->extent->fileID] != i) {
+                /* fileIDs are unique, unlike the truncated file names */
+                if (last_zone[current->extent->fileID] == UINT32_MAX) {
+                    (*nr_files)++;
+                }
+                last_zone[current->extent->fileID] = i;
+                zones[i].file_ctr++;
+            }
+
+            /* F2FS segment types are only known with the procfs */
+            seg_i = (struct segment_info *)current->extent->fs_info;
+            if (ctrl->fs_magic != F2FS_MAGIC || !seg_i) {
+                continue;
+            }
+
+            switch (seg_i->type) {
+            case CURSEG_HOT_DATA:
+            case CURSEG_HOT_NODE:
+                temp_bytes[SHM_TEMP_HOT] += bytes;
+                break;
+            case CURSEG_WARM_DATA:
+            case CURSEG_WARM_NODE:
+                temp_bytes[SHM_TEMP_WARM] += bytes;
+                break;
+            case CURSEG_COLD_DATA:
+            case CURSEG_COLD_NODE:
+                temp_bytes[SHM_TEMP_COLD] += bytes;
+                break;
+            default:
+                break;
+            }
+        }
+
+        for (temp = SHM_TEMP_HOT; temp <= SHM_TEMP_COLD; temp++) {
+            if (temp_bytes[temp] > temp_bytes[zones[i].temp]) {
+                zones[i].temp = temp;
+            }
+        }
+
+        valid_bytes += zones[i].valid_bytes;
+    }
+
+    free(last_zone);
+
+    return valid_bytes;
+}
+
+/*
+ * Publish the summary of the current zonemap. The collector must be the only
+ * writer of the segment.
+ *
+ * @ctrl: struct control of the collector
+ * @map: segment returned by shm_zonemap_create()
+ *
+ * */
+void shm_zonemap_publish(struct control *ctrl, struct shm_zonemap *map) {
+    struct shm_zone *zones;
+    uint64_t seq, valid_bytes;
+    uint32_t nr_zones, nr_files;
+
+    nr_zones = ctrl->zonemap->nr_zones < map->nr_zones ? ctrl->zonemap->nr_zones
+                                                       : map->nr_zones;
+
+    zones = calloc(ctrl->zonemap->nr_zones, sizeof(struct shm_zone));
+    if (!zones) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    valid_bytes = summarize_zones(ctrl, zones, &nr_files);
+
+    seq = map->seq;
+    __atomic_store_n(&map->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(map->zones, zones, sizeof(struct shm_zone) * nr_zones);
+    map->nr_files = nr_files;
+    map->extent_ctr = ctrl->zonemap->extent_ctr;
+    map->valid_bytes = valid_bytes;
+    map->nr_updates++;
+    map->update_time = time(NULL);
+
+    __atomic_store_n(&map->seq, seq + 2, __ATOMIC_RELEASE);
+
+    free(zones);
+}
+
+/*
+ * Mark the summary as no longer updated, unmap, and remove the segment.
+ *
+ * @name: name of the POSIX shared memory segment
+ * @map: segment returned by shm_zonemap_create()
+ *
+ * */
+void shm_zonemap_destroy(const char *name, struct shm_zonemap *map) {
+    uint64_t seq = map->seq;
+
+    __atomic_store_n(&map->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    map->magic = 0;
+    __atomic_store_n(&map->seq, seq + 2, __ATOMIC_RELEASE);
+
+    munmap(map, shm_zonemap_size(map->nr_zones));
+    shm_unlink(name);
+}
+
+/*
+ * Map the zonemap summary of a collector read-only.
+ *
+ * @name: name of the POSIX shared memory segment (e.g., ZNS_SHM_NAME)
+ *
+ * returns: the mapped segment, NULL with errno set on failure
+ *
+ * */
+const struct shm_zonemap *shm_zonemap_open(const char *name) {
+    struct shm_zonemap *map;
+    struct stat stats;
+    int fd;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &stats) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    if ((size_t)stats.st_size < sizeof(struct shm_zonemap)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    map = mmap(NULL, stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (__atomic_load_n(&map->magic, __ATOMIC_ACQUIRE) != ZNS_SHM_MAGIC ||
+        map->version != ZNS_SHM_VERSION ||
+        shm_zonemap_size(map->nr_zones) > (size_t)stats.st_size) {
+        munmap(map, stats.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return map;
+}
+
+/*
+ * Take a consistent snapshot of the summary, retrying while the collector
+ * updates it. Readers never block the collector.
+ *
+ * @map: segment returned by shm_zonemap_open()
+ *
+ * returns: a copy of the summary to free(), NULL with errno set on failure
+ * (ESTALE if the collector exited)
+ *
+ * */
+struct shm_zonemap *shm_zonemap_snapshot(const struct shm_zonemap *map) {
+    struct shm_zonemap *snap;
+    size_t size = shm_zonemap_size(map->nr_zones);
+    uint64_t seq;
+
+    snap = malloc(size);
+    if (!snap) {
+        return NULL;
+    }
+
+    for (;;) {
+        seq = __atomic_load_n(&map->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+
+        memcpy(snap, map, size);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&map->seq, __ATOMIC_RELAXED) == seq) {
+            break;
+        }
+    }
+
+    if (snap->magic != ZNS_SHM_MAGIC) {
+        free(snap);
+        errno = ESTALE;
+        return NULL;
+    }
+
+    return snap;
+}
+
+/*
+ * Unmap a segment returned by shm_zonemap_open().
+ *
+ * */
+void shm_zonemap_close(const struct shm_zonemap *map) {
+    munmap((void *)map, shm_zonemap_size(map->nr_zones));
+}
@@ -1,6 +1,34 @@
 #include "zns-tools.h"
+#include <pthread.h>
 #include <stdlib.h>
-struct control ctrl;
+
+struct render_task {
+    uint32_t start; /* first zone of the task */
+    uint32_t end;   /* zone after the last zone of the task */
+    char *data;     /* rendered output of the zones */
+    size_t len;     /* length of the rendered output */
+    void *acc;      /* accumulator of the task */
+    uint8_t done;   /* flag if rendering the task finished */
+};
+
+struct render_pool {
+    struct control *ctrl;      /* context of the rendered zonemap */
+    zone_render render;        /* function rendering a range of zones */
+    struct render_task *tasks; /* tasks, in zone order */
+    uint32_t nr_tasks;         /* number of tasks */
+    uint32_t next_task;        /* next task for a thread to pick up */
+    uint32_t written;          /* tasks written out by the calling thread */
+    uint32_t max_in_flight;    /* tasks rendered but not yet written out */
+    pthread_mutex_t lock;      /* protects the task counters and done flags */
+    pthread_cond_t cond;       /* signaled when a task is done or written */
+};
+
+struct zone_report_task {
+    struct control *ctrl; /* context of the zonemap to fill */
+    struct bdev *znsdev;  /* ZNS device to report the zones of */
+    pthread_t thread;     /* thread issuing the report */
+    int ret;              /* EXIT_SUCCESS if the zones were reported */
+};
 
 /*
  * Check if a device a zoned device.
@@ -11,13 +39,13 @@ struct control ctrl;
  * TODO: fix return codes
  *
  * */
-uint8_t is_zoned(char *dev_path) {
+uint8_t is_zoned(struct control *ctrl, char *dev_path) {
     unsigned long long start_sector = 0;
     struct blk_zone_report *hdr = NULL;
     int nr_zones = 1;
     int fd;
 
-    fd = open(dev_path, O_RDONLY);
+    fd = backend_open(dev_path);
     if (fd < 0) {
         ERR_MSG("Failed opening fd on %s. Try running "
                 "as root.\n",
@@ -27,11 +55,12 @@ uint8_t is_zoned(char *dev_path) {
 
     hdr = calloc(1, sizeof(struct blk_zone_report) + nr_zones +
                         sizeof(struct blk_zone));
-    hdr->sector = start_sector >> ctrl.zns_sector_shift;
+    hdr->sector = start_sector >> ctrl->zns_sector_shift;
     hdr->nr_zones = nr_zones;
 
-    if (ioctl(fd, BLKREPORTZONE, hdr) < 0) {
+    if (backend_ioctl(fd, dev_path, BLKREPORTZONE, hdr) < 0) {
         INFO(1, "Device is conventional block device: %s\n", dev_path);
+        close(fd);
         free(hdr);
         hdr = NULL;
 
@@ -54,24 +83,25 @@ uint8_t is_zoned(char *dev_path) {
  * returns: unsigned int sector size
  *
  * */
-static unsigned int get_sector_size(char *dev_path) {
+static unsigned int get_sector_size(struct control *ctrl, char *dev_path) {
     uint64_t sector_size = 0;
     int fd;
 
-    fd = open(dev_path, O_RDONLY);
+    fd = backend_open(dev_path);
     if (fd < 0) {
         ERR_MSG("opening device fd for %s\n", dev_path);
         return 0;
     }
 
-    if (ioctl(fd, BLKSSZGET, &sector_size)) {
+    if (backend_ioctl(fd, dev_path, BLKSSZGET, &sector_size)) {
         ERR_MSG("failed getting sector size for %s\n", dev_path);
     }
+    close(fd);
 
     INFO(1, "Device %s has sector size %lu\n", dev_path, sector_size);
 
     if (sector_size == 4096) {
-        ctrl.zns_sector_shift = 3;
+        ctrl->zns_sector_shift = 3;
     }
 
     return sector_size;
@@ -83,113 +113,213 @@ static unsigned int get_sector_size(char *dev_path) {
  * st: struct stat * from fstat() call on file
  *
  * */
-void init_dev(struct stat *st) {
+void init_dev(struct control *ctrl, struct stat *st) {
     int fd;
 
-    sprintf(ctrl.bdev.dev_path, "/dev/block/%d:%d", major(st->st_dev),
+    sprintf(ctrl->bdev.dev_path, "/dev/block/%d:%d", major(st->st_dev),
             minor(st->st_dev));
 
-    fd = open(ctrl.bdev.dev_path, O_RDONLY);
+    fd = backend_open(ctrl->bdev.dev_path);
     if (fd < 0) {
-        ERR_MSG("opening device fd for %s\n", ctrl.bdev.dev_path);
+        ERR_MSG("opening device fd for %s\n", ctrl->bdev.dev_path);
     }
 
-    if (readlink(ctrl.bdev.dev_path, ctrl.bdev.link_name,
-                 sizeof(ctrl.bdev.link_name)) < 0) {
-        ERR_MSG("opening device fd for %s\n", ctrl.bdev.dev_path);
+    if (backend_readlink(ctrl->bdev.dev_path, ctrl->bdev.link_name,
+                 sizeof(ctrl->bdev.link_name)) < 0) {
+        ERR_MSG("opening device fd for %s\n", ctrl->bdev.dev_path);
     }
 
-    strcpy(ctrl.bdev.dev_name, basename(ctrl.bdev.link_name));
+    strcpy(ctrl->bdev.dev_name, basename(ctrl->bdev.link_name));
 
     close(fd);
 }
 
 /*
- * initialize the zone map with the zone information,
- * allocate all space for the zones.
+ * Report all zones of a ZNS device into its part of the zonemap. Zone
+ * addresses are offset by the zones of prior devices, such that the zonemap
+ * covers all ZNS devices as one address space. Runs in a thread of
+ * update_zone_map(), hence failures are returned in task->ret, and the zones
+ * of the device are kept as they were.
  *
- * Zone WP and state are initialized but will be updated
- * during reporting, for each zone at the time of reporting.
+ * @arg: struct zone_report_task * of the device
  *
  * */
-static void init_zone_map() {
+static void *report_dev_zones(void *arg) {
+    struct zone_report_task *task = (struct zone_report_task *)arg;
+    struct control *ctrl = task->ctrl;
+    struct bdev *znsdev = task->znsdev;
     struct blk_zone_report *hdr = NULL;
+    struct zone *zone;
+    uint64_t base;
 
-    int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
+    task->ret = EXIT_FAILURE;
+
+    int fd = backend_open(znsdev->dev_path);
     if (fd < 0) {
-        return;
+        return NULL;
     }
 
     hdr = calloc(1, sizeof(struct blk_zone_report) +
-                        sizeof(struct blk_zone) * ctrl.znsdev.nr_zones);
+                        sizeof(struct blk_zone) * znsdev->nr_zones);
+    if (!hdr) {
+        close(fd);
+        return NULL;
+    }
     hdr->sector = 0;
-    hdr->nr_zones = ctrl.znsdev.nr_zones;
+    hdr->nr_zones = znsdev->nr_zones;
 
-    if (ioctl(fd, BLKREPORTZONE, hdr) < 0) {
-        ERR_MSG("getting Zone Info\n");
-        return;
+    if (backend_ioctl(fd, znsdev->dev_path, BLKREPORTZONE, hdr) < 0) {
+        close(fd);
+        free(hdr);
+        return NULL;
     }
 
-    ctrl.zonemap = calloc(1, sizeof(struct zone_map) +
-                                 sizeof(struct zone) * ctrl.znsdev.nr_zones);
-    // TODO: later we want multi zns device support
-    ctrl.zonemap->nr_zones = ctrl.znsdev.nr_zones;
-
-    for (int i = 0; i < ctrl.znsdev.nr_zones; i++) {
-        ctrl.zonemap->zones[i].zone_number = i;
-        ctrl.zonemap->zones[i].start =
-            hdr->zones[i].start >> ctrl.zns_sector_shift;
-        ctrl.zonemap->zones[i].end =
-            (hdr->zones[i].start >> ctrl.zns_sector_shift) +
-            (hdr->zones[i].capacity >> ctrl.zns_sector_shift);
-        ctrl.zonemap->zones[i].capacity =
-            hdr->zones[i].capacity >> ctrl.zns_sector_shift;
-        ctrl.zonemap->zones[i].state = hdr->zones[i].cond << 4;
-        ctrl.zonemap->zones[i].mask = ctrl.znsdev.zone_mask;
-        ctrl.zonemap->zones[i].extents_head = NULL;
+    base = znsdev->zone_offset * znsdev->zone_size;
+
+    for (uint32_t i = 0; i < znsdev->nr_zones; i++) {
+        zone = &ctrl->zonemap->zones[znsdev->zone_offset + i];
+        zone->zone_number = znsdev->zone_offset + i;
+        zone->start = base + (hdr->zones[i].start >> ctrl->zns_sector_shift);
+        zone->end =
+            zone->start + (hdr->zones[i].capacity >> ctrl->zns_sector_shift);
+        zone->capacity = hdr->zones[i].capacity >> ctrl->zns_sector_shift;
+        zone->wp = base + (hdr->zones[i].wp >> ctrl->zns_sector_shift);
+        zone->state = hdr->zones[i].cond << 4;
+        zone->mask = znsdev->zone_mask;
     }
 
     close(fd);
 
     free(hdr);
     hdr = NULL;
+
+    task->ret = EXIT_SUCCESS;
+
+    return NULL;
+}
+
+/*
+ * Update the zone information of the zonemap (e.g., WP and state) from the
+ * zone reports of all ZNS devices, the extents in the zones are kept.
+ *
+ * Reporting all zones of a device is slow, hence the devices are reported in
+ * parallel, with a thread for each device.
+ *
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE if the zones of a device could not be
+ *          reported, which are then left unchanged
+ *
+ * */
+int update_zone_map(struct control *ctrl) {
+    struct zone_report_task *tasks;
+    uint64_t start = profile_start();
+    int ret = EXIT_SUCCESS;
+    uint8_t i;
+
+    tasks = calloc(ctrl->nr_znsdevs, sizeof(struct zone_report_task));
+    if (!tasks) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (i = 0; i < ctrl->nr_znsdevs; i++) {
+        tasks[i].ctrl = ctrl;
+        tasks[i].znsdev = &ctrl->znsdev[i];
+    }
+
+    /* the calling thread reports the first device */
+    for (i = 1; i < ctrl->nr_znsdevs; i++) {
+        if (pthread_create(&tasks[i].thread, NULL, report_dev_zones,
+                           &tasks[i])) {
+            ERR_MSG("Failed creating zone report thread\n");
+        }
+    }
+
+    if (ctrl->nr_znsdevs > 0) {
+        report_dev_zones(&tasks[0]);
+    }
+
+    for (i = 1; i < ctrl->nr_znsdevs; i++) {
+        pthread_join(tasks[i].thread, NULL);
+    }
+
+    for (i = 0; i < ctrl->nr_znsdevs; i++) {
+        if (tasks[i].ret == EXIT_FAILURE) {
+            WARN("Failed reporting the zones of %s\n",
+                 ctrl->znsdev[i].dev_path);
+            ret = EXIT_FAILURE;
+        }
+    }
+
+    free(tasks);
+
+    profile_stop(PROFILE_ZONE_REPORT, start);
+
+    return ret;
+}
+
+/*
+ * initialize the zone map with the zone information of all ZNS devices,
+ * allocate all space for the zones.
+ *
+ * Zone WP and state are initialized but will be updated
+ * during reporting, for each zone at the time of reporting.
+ *
+ * */
+void init_zone_map(struct control *ctrl) {
+    uint32_t nr_zones = 0;
+
+    for (uint8_t i = 0; i < ctrl->nr_znsdevs; i++) {
+        nr_zones += ctrl->znsdev[i].nr_zones;
+    }
+
+    ctrl->zonemap =
+        calloc(1, sizeof(struct zone_map) + sizeof(struct zone) * nr_zones);
+    if (!ctrl->zonemap) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    ctrl->zonemap->nr_zones = nr_zones;
+    profile_zonemap(sizeof(struct zone_map) + sizeof(struct zone) * nr_zones);
+
+    if (update_zone_map(ctrl) == EXIT_FAILURE) {
+        ERR_MSG("Failed initializing the zonemap\n");
+    }
 }
 
 /*
  *
- * Init the struct bdev * for the ZNS device.
+ * Init the struct bdev * for a ZNS device, its dev_name must be set.
  *
  * @znsdev: struct bdev * to initialize
  *
  * returns: 0 on Success
  *
  * */
-uint8_t init_znsdev() {
+uint8_t init_znsdev(struct control *ctrl, struct bdev *znsdev) {
     int fd;
 
-    sprintf(ctrl.znsdev.dev_path, "/dev/%s", ctrl.znsdev.dev_name);
+    sprintf(znsdev->dev_path, "/dev/%s", znsdev->dev_name);
 
-    fd = open(ctrl.znsdev.dev_path, O_RDONLY);
+    fd = backend_open(znsdev->dev_path);
     if (fd < 0) {
-        ERR_MSG("opening device fd for %s\n", ctrl.znsdev.dev_path);
+        ERR_MSG("opening device fd for %s\n", znsdev->dev_path);
         return EXIT_FAILURE;
     }
 
-    ctrl.znsdev.is_zoned = is_zoned(ctrl.znsdev.dev_path);
+    znsdev->is_zoned = is_zoned(ctrl, znsdev->dev_path);
     close(fd);
 
-    ctrl.sector_size = get_sector_size(ctrl.znsdev.dev_path);
-    ctrl.znsdev.nr_zones = get_nr_zones();
+    ctrl->sector_size = get_sector_size(ctrl, znsdev->dev_path);
 
     // for F2FS both conventional and ZNS device must have same sector size
     // therefore, we can assign one independent of which
-    ctrl.sector_shift = ctrl.sector_size == 512 ? 9 : 12;
-    ctrl.f2fs_segment_sectors = F2FS_SEGMENT_BYTES >> ctrl.sector_shift;
-    ctrl.f2fs_segment_mask = ~(ctrl.f2fs_segment_sectors - 1);
+    ctrl->sector_shift = ctrl->sector_size == 512 ? 9 : 12;
+    ctrl->f2fs_segment_sectors = F2FS_SEGMENT_BYTES >> ctrl->sector_shift;
+    ctrl->f2fs_segment_mask = ~(ctrl->f2fs_segment_sectors - 1);
 
-    ctrl.segment_shift = ctrl.sector_size == 512 ? 12 : 9;
+    ctrl->segment_shift = ctrl->sector_size == 512 ? 12 : 9;
 
-    init_zone_map();
+    znsdev->nr_zones = get_nr_zones(znsdev->dev_path);
+    znsdev->zone_size = get_zone_size(ctrl, znsdev->dev_path);
+    znsdev->zone_mask = ~(znsdev->zone_size - 1);
 
     return EXIT_SUCCESS;
 }
@@ -206,15 +336,18 @@ uint8_t init_znsdev() {
 uint64_t get_dev_size(char *dev_path) {
     uint64_t dev_size = 0;
 
-    int fd = open(dev_path, O_RDONLY);
+    int fd = backend_open(dev_path);
     if (fd < 0) {
         return -1;
     }
 
-    if (ioctl(fd, BLKGETSIZE64, &dev_size) < 0) {
+    if (backend_ioctl(fd, dev_path, BLKGETSIZE64, &dev_size) < 0) {
+        close(fd);
         return -1;
     }
 
+    close(fd);
+
     return dev_size;
 }
 
@@ -222,41 +355,47 @@ uint64_t get_dev_size(char *dev_path) {
  * Get the zone size of a ZNS device.
  * Note: Assumes zone size is equal for all zones.
  *
+ * @dev_path: device path (e.g., /dev/nvme0n2)
+ *
  * returns: uint64_t zone size, 0 on failure
  *
  * */
-uint64_t get_zone_size() {
+uint64_t get_zone_size(struct control *ctrl, char *dev_path) {
     uint64_t zone_size = 0;
 
-    int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
+    int fd = backend_open(dev_path);
     if (fd < 0) {
         return 0;
     }
 
-    if (ioctl(fd, BLKGETZONESZ, &zone_size) < 0) {
+    if (backend_ioctl(fd, dev_path, BLKGETZONESZ, &zone_size) < 0) {
+        close(fd);
         return 0;
     }
 
     close(fd);
 
-    return zone_size >> ctrl.zns_sector_shift;
+    return zone_size >> ctrl->zns_sector_shift;
 }
 
 /*
- * Get the number of zones on the ZNS device in ctrl.znsdev
+ * Get the number of zones on a ZNS device
+ *
+ * @dev_path: device path (e.g., /dev/nvme0n2)
  *
  * returns: uint32_t number of zones, 0 on failure
  *
  * */
-uint32_t get_nr_zones() {
+uint32_t get_nr_zones(char *dev_path) {
     uint32_t nr_zones = 0;
 
-    int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
+    int fd = backend_open(dev_path);
     if (fd < 0) {
         return 0;
     }
 
-    if (ioctl(fd, BLKGETNRZONES, &nr_zones) < 0) {
+    if (backend_ioctl(fd, dev_path, BLKGETNRZONES, &nr_zones) < 0) {
+        close(fd);
         return 0;
     }
 
@@ -266,27 +405,70 @@ uint32_t get_nr_zones() {
 }
 
 /*
- * Cleanup control struct - free memory
+ * Allocate the control struct, the context of a single analysis. All library
+ * functions operate on the context they are passed, such that a process can
+ * analyze several mounts or devices at once, each with its own context.
+ *
+ * returns: zeroed struct control *, to be freed with cleanup_ctrl()
+ *
+ * */
+struct control *alloc_ctrl() {
+    struct control *ctrl;
+
+    ctrl = calloc(1, sizeof(struct control));
+    if (!ctrl) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    return ctrl;
+}
+
+/*
+ * Cleanup control struct - free memory, including the struct itself
  *
  * */
-void cleanup_ctrl() {
-    cleanup_zonemap();
+void cleanup_ctrl(struct control *ctrl) {
+    if (ctrl->zonemap) {
+        cleanup_zonemap(ctrl);
+        profile_zonemap(-(int64_t)(sizeof(struct zone_map) +
+                                   sizeof(struct zone) *
+                                       ctrl->zonemap->nr_zones));
+        free(ctrl->zonemap);
+    }
+
+    if (ctrl->fs_manager != NULL) {
+        ctrl->fs_manager_cleanup(ctrl->fs_manager);
+    }
+
+    free(ctrl->fs_super_block);
+    if (ctrl->file_counter_map) {
+        free(ctrl->file_counter_map->hash);
+    }
+    free(ctrl->file_counter_map);
+    free(ctrl->file_counter_ids);
+    free(ctrl->file_zones);
+    free(ctrl);
+}
 
-    free(ctrl.file_counter_map);
+/* bytes allocated for an extent node of the zonemap, for profiling */
+static int64_t get_node_bytes(struct control *ctrl, struct node *node) {
+    return sizeof(struct node) + sizeof(struct extent) +
+           (node->extent->fs_info ? ctrl->fs_info_bytes : 0);
 }
 
 /*
  * Cleanup zonemap struct - free memory
  *
  * */
-void cleanup_zonemap() {
+void cleanup_zonemap(struct control *ctrl) {
     struct node *head;
     struct node *next;
 
-    for (uint32_t i = 0; i < ctrl.zonemap->nr_zones; i++) {
-        head = ctrl.zonemap->zones[i].extents_head;
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        head = ctrl->zonemap->zones[i].extents_head;
         while (head != NULL) {
             next = head->next;
+            profile_zonemap(-get_node_bytes(ctrl, head));
             free(head->extent);
             free(head);
             head = next;
@@ -334,10 +516,10 @@ void cleanup_zonemap() {
 /* static void add_extent_to_zone_btree(struct extent *extent) { */
 /*     struct node *node = create_zone_btree_node(extent); */
 
-/*     ctrl.zonemap.zones[extent->zone].extent_ctr++; */
+/*     ctrl->zonemap.zones[extent->zone].extent_ctr++; */
 
-/*     if (!ctrl.zonemap.zones[extent->zone].btree) { */
-/*         ctrl.zonemap.zones[extent->zone].btree = node; */
+/*     if (!ctrl->zonemap.zones[extent->zone].btree) { */
+/*         ctrl->zonemap.zones[extent->zone].btree = node; */
 /*     } else { */
 /*         insert_zone_btree_node(ctrl.zonemap.zones[extent->zone].btree, node);
  */
@@ -345,14 +527,18 @@ void cleanup_zonemap() {
 /* } */
 
 // TODO: description
-static struct node *create_zone_extent_node(struct extent *extent) {
+static struct node *create_zone_extent_node(struct control *ctrl,
+                                            struct extent *extent) {
     struct node *node = calloc(1, sizeof(struct node));
 
+    profile_zonemap(sizeof(struct node) + sizeof(struct extent) +
+                    (extent->fs_info ? ctrl->fs_info_bytes : 0));
+
     node->extent = calloc(1, sizeof(struct extent));
     memcpy(node->extent, extent, sizeof(struct extent));
     if (extent->fs_info) {
-        node->extent->fs_info = calloc(1, ctrl.fs_info_bytes);
-        memcpy(node->extent->fs_info, extent->fs_info, ctrl.fs_info_bytes);
+        node->extent->fs_info = calloc(1, ctrl->fs_info_bytes);
+        memcpy(node->extent->fs_info, extent->fs_info, ctrl->fs_info_bytes);
     }
 
     node->next = NULL;
@@ -360,34 +546,234 @@ static struct node *create_zone_extent_node(struct extent *extent) {
     return node;
 }
 
-static void insert_zone_list_head(struct node **head, struct node *node) {
-    *head = node;
+static uint32_t size_hist_bucket(uint64_t size) {
+    return size ? 63 - __builtin_clzll(size) : 0;
+}
+
+/*
+ * Add a size to the histogram of its zone and the global one
+ *
+ * @hist: histogram of the zone
+ * @global: global histogram of the zonemap
+ * @size: size to add
+ *
+ * */
+static void size_hist_add(struct size_hist *hist, struct size_hist *global,
+                          uint64_t size) {
+    hist->buckets[size_hist_bucket(size)]++;
+    hist->ctr++;
+    global->buckets[size_hist_bucket(size)]++;
+    global->ctr++;
+}
+
+static void size_hist_remove(struct size_hist *hist, struct size_hist *global,
+                             uint64_t size) {
+    hist->buckets[size_hist_bucket(size)]--;
+    hist->ctr--;
+    global->buckets[size_hist_bucket(size)]--;
+    global->ctr--;
+}
+
+/*
+ * Get the size of the hole between two consecutive extents in a zone
+ *
+ * returns: size of the hole, 0 if the extents are contiguous or overlap
+ *
+ * */
+static uint64_t get_hole_size(struct node *prev, struct node *next) {
+    uint64_t pbae = prev->extent->phy_blk + prev->extent->len;
+
+    if (next->extent->phy_blk > pbae) {
+        return next->extent->phy_blk - pbae;
+    }
+
+    return 0;
 }
 
-static void sorted_zone_list_insert(struct node **head, struct node *node) {
-    struct node **current = head;
+/*
+ * Insert the node into the sorted list of extents of the zone, and update the
+ * size histograms. Inserting an extent splits up the hole between the prior
+ * and the next extent, if there is one.
+ *
+ * */
+static void sorted_zone_list_insert(struct control *ctrl, struct zone *zone,
+                                    struct node *node) {
+    struct node **current = &zone->extents_head;
+    struct node *prev = NULL;
+    struct size_hist *holes = &ctrl->zonemap->hole_hist;
 
     while (*current != NULL &&
            (*current)->extent->phy_blk < node->extent->phy_blk) {
+        prev = *current;
         current = &((*current)->next);
     }
 
     node->next = *current;
     *current = node;
+
+    size_hist_add(&zone->extent_hist, &ctrl->zonemap->extent_hist,
+                  node->extent->len);
+
+    if (prev && node->next && get_hole_size(prev, node->next) > 0) {
+        size_hist_remove(&zone->hole_hist, holes,
+                         get_hole_size(prev, node->next));
+    }
+    if (prev && get_hole_size(prev, node) > 0) {
+        size_hist_add(&zone->hole_hist, holes, get_hole_size(prev, node));
+    }
+    if (node->next && get_hole_size(node, node->next) > 0) {
+        size_hist_add(&zone->hole_hist, holes, get_hole_size(node, node->next));
+    }
 }
 
-static void add_extent_to_zone_list(struct extent extent) {
-    struct node *node = create_zone_extent_node(&extent);
+/*
+ * Unlink the node from the sorted list of extents of the zone, and update the
+ * size histograms. Removing an extent merges the holes before and after it.
+ *
+ * @prev: node prior to the node in the list, NULL if it is the head
+ *
+ * */
+static void sorted_zone_list_remove(struct control *ctrl, struct zone *zone,
+                                    struct node *prev, struct node *node) {
+    struct size_hist *holes = &ctrl->zonemap->hole_hist;
+
+    size_hist_remove(&zone->extent_hist, &ctrl->zonemap->extent_hist,
+                     node->extent->len);
 
-    if (ctrl.zonemap->zones[extent.zone].extent_ctr == 0) {
-        insert_zone_list_head(&ctrl.zonemap->zones[extent.zone].extents_head,
-                              node);
+    if (prev && get_hole_size(prev, node) > 0) {
+        size_hist_remove(&zone->hole_hist, holes, get_hole_size(prev, node));
+    }
+    if (node->next && get_hole_size(node, node->next) > 0) {
+        size_hist_remove(&zone->hole_hist, holes,
+                         get_hole_size(node, node->next));
+    }
+    if (prev && node->next && get_hole_size(prev, node->next) > 0) {
+        size_hist_add(&zone->hole_hist, holes, get_hole_size(prev, node->next));
+    }
+
+    if (prev) {
+        prev->next = node->next;
     } else {
-        sorted_zone_list_insert(&ctrl.zonemap->zones[extent.zone].extents_head,
-                                node);
+        zone->extents_head = node->next;
+    }
+}
+
+/*
+ * Add an extent to the sorted extent list of its zone
+ *
+ * @extent: struct extent with the zone set, copied into the zonemap
+ *
+ * returns: struct node * of the extent in the zonemap
+ *
+ * */
+struct node *add_extent_to_zone_list(struct control *ctrl,
+                                     struct extent extent) {
+    struct node *node = create_zone_extent_node(ctrl, &extent);
+    uint64_t start = profile_start();
+
+    sorted_zone_list_insert(ctrl, &ctrl->zonemap->zones[extent.zone], node);
+    profile_stop(PROFILE_SORT, start);
+
+    ctrl->zonemap->zones[extent.zone].extent_ctr++;
+
+    return node;
+}
+
+/*
+ * Get a percentile of the sizes in the histogram
+ *
+ * @hist: histogram to get the percentile of
+ * @percentile: percentile to get, e.g., 99
+ *
+ * returns: upper bound of the log2 bucket the percentile falls into, 0 if the
+ * histogram is empty
+ *
+ * */
+uint64_t size_hist_percentile(struct size_hist *hist, uint32_t percentile) {
+    uint64_t rank = (hist->ctr * percentile + 99) / 100;
+    uint64_t cum = 0;
+
+    if (hist->ctr == 0) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < SIZE_HIST_BUCKETS; i++) {
+        cum += hist->buckets[i];
+        if (cum >= rank && cum > 0) {
+            return i == SIZE_HIST_BUCKETS - 1 ? UINT64_MAX : 2ULL << i;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Print the p50/p90/p99 extent and hole sizes of a zone in a single line.
+ * Output goes through the buffered report writer.
+ *
+ * @zone: number of the zone to print the percentiles of
+ *
+ * */
+void print_zone_size_hist(struct control *ctrl, uint32_t zone) {
+    struct zone *z = &ctrl->zonemap->zones[zone];
+
+    REP_LIT("P50/P90/P99  EXTENTS: ");
+    rep_hex(size_hist_percentile(&z->extent_hist, 50), 0);
+    REP_LIT("/");
+    rep_hex(size_hist_percentile(&z->extent_hist, 90), 0);
+    REP_LIT("/");
+    rep_hex(size_hist_percentile(&z->extent_hist, 99), 0);
+    REP_LIT("  HOLES: ");
+    rep_hex(size_hist_percentile(&z->hole_hist, 50), 0);
+    REP_LIT("/");
+    rep_hex(size_hist_percentile(&z->hole_hist, 90), 0);
+    REP_LIT("/");
+    rep_hex(size_hist_percentile(&z->hole_hist, 99), 0);
+    REP_LIT("\n");
+}
+
+/*
+ * Print the extent and hole size histograms as a table of the non-empty
+ * buckets, followed by their percentiles. Output goes through the buffered
+ * report writer.
+ *
+ * @extents: histogram of extent sizes
+ * @holes: histogram of hole sizes
+ *
+ * */
+void print_size_hist(struct size_hist *extents, struct size_hist *holes) {
+    static const uint32_t percentiles[] = {50, 90, 99};
+    uint32_t first = SIZE_HIST_BUCKETS, last = 0;
+
+    for (uint32_t i = 0; i < SIZE_HIST_BUCKETS; i++) {
+        if (extents->buckets[i] || holes->buckets[i]) {
+            if (first == SIZE_HIST_BUCKETS) {
+                first = i;
+            }
+            last = i;
+        }
+    }
+
+    /* bucket sizes are in 512B sectors, MAX SIZE is exclusive */
+    REP_LIT("\nMIN SIZE    MAX SIZE    EXTENTS     HOLES\n");
+    for (uint32_t i = first; i <= last && first < SIZE_HIST_BUCKETS; i++) {
+        rep_hex(i ? 1ULL << i : 0, -12);
+        rep_hex(i < SIZE_HIST_BUCKETS - 1 ? 2ULL << i : UINT64_MAX, -12);
+        rep_dec(extents->buckets[i], -12);
+        rep_dec(holes->buckets[i], 0);
+        REP_LIT("\n");
     }
 
-    ctrl.zonemap->zones[extent.zone].extent_ctr++;
+    for (uint32_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]);
+         i++) {
+        REP_LIT("P");
+        rep_dec(percentiles[i], 0);
+        REP_LIT(":  EXTENTS: ");
+        rep_hex(size_hist_percentile(extents, percentiles[i]), -10);
+        REP_LIT("  HOLES: ");
+        rep_hex(size_hist_percentile(holes, percentiles[i]), 0);
+        REP_LIT("\n");
+    }
 }
 
 /*
@@ -398,98 +784,199 @@ static void add_extent_to_zone_list(struct extent extent) {
  * returns: number of the zone
  *
  * */
-uint32_t get_zone_number(uint64_t lba) {
-    uint64_t slba = 0;
-    uint32_t zone_mask =
-        ~((ctrl.znsdev.zone_size << ctrl.zns_sector_shift) - 1);
+uint32_t get_zone_number(struct control *ctrl, uint64_t lba) {
+    /* divide, as a 32 bit zone mask truncates LBAs past 2^32 sectors, which
+     * the combined address space of several devices (zone_offset) reaches */
+    return lba / (ctrl->znsdev[0].zone_size << ctrl->zns_sector_shift);
+}
+
+/*
+ * Get the device holding a byte offset of the file system address space. F2FS
+ * places its devices back to back, starting with the conventional device.
+ *
+ * @physical: byte offset in the file system address space (e.g., fe_physical)
+ *
+ * returns: struct bdev * of the ZNS device, &ctrl->bdev for the conventional
+ *          device, NULL if the offset is past the last device
+ *
+ * */
+struct bdev *get_fs_dev(struct control *ctrl, uint64_t physical) {
+    if (ctrl->nr_znsdevs == 0 || physical < ctrl->znsdev[0].offset) {
+        return &ctrl->bdev;
+    }
 
-    slba = (lba & zone_mask);
+    for (uint8_t i = 0; i < ctrl->nr_znsdevs; i++) {
+        if (physical < ctrl->znsdev[i].end) {
+            return &ctrl->znsdev[i];
+        }
+    }
 
-    return slba / (ctrl.znsdev.zone_size << ctrl.zns_sector_shift);
+    return NULL;
 }
 
 /*
- * Print the information about a zone.
+ * Get the ZNS device holding a zone of the zonemap.
  *
- * @zone: number of the zone to print info of
+ * @zone: number of the zone
+ *
+ * returns: struct bdev * of the ZNS device
  *
  * */
-void print_zone_info(uint32_t zone) {
-    unsigned long long start_sector = 0;
+struct bdev *get_zone_dev(struct control *ctrl, uint32_t zone) {
+    uint8_t i = ctrl->nr_znsdevs - 1;
+
+    while (i > 0 && zone < ctrl->znsdev[i].zone_offset) {
+        i--;
+    }
+
+    return &ctrl->znsdev[i];
+}
+
+/*
+ * Report a single zone from the ZNS device holding it. The zone start and
+ * write pointer are offset by the zones of prior devices, as in the zonemap.
+ *
+ * @zone: number of the zone to report
+ * @blk_zone: struct blk_zone * to store the report in
+ *
+ * returns: 0 on Success, -1 on Failure
+ *
+ * */
+static int report_zone(struct control *ctrl, uint32_t zone,
+                       struct blk_zone *blk_zone) {
+    struct bdev *znsdev = get_zone_dev(ctrl, zone);
     struct blk_zone_report *hdr = NULL;
+    uint64_t zone_sectors;
 
-    start_sector = (ctrl.znsdev.zone_size << ctrl.zns_sector_shift) * zone;
+    zone_sectors = znsdev->zone_size << ctrl->zns_sector_shift;
 
-    int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
+    int fd = backend_open(znsdev->dev_path);
     if (fd < 0) {
-        return;
+        return -1;
     }
 
     hdr = calloc(1, sizeof(struct blk_zone_report) + sizeof(struct blk_zone));
-    hdr->sector = start_sector;
+    hdr->sector = zone_sectors * (zone - znsdev->zone_offset);
     hdr->nr_zones = 1;
 
-    if (ioctl(fd, BLKREPORTZONE, hdr) < 0) {
+    if (backend_ioctl(fd, znsdev->dev_path, BLKREPORTZONE, hdr) < 0) {
         ERR_MSG("getting Zone Info\n");
-        return;
+        return -1;
     }
 
-    MSG("\n============ ZONE %d ============\n", zone);
-    MSG("LBAS: 0x%06llx  LBAE: 0x%06llx  CAP: 0x%06llx  WP: 0x%06llx  SIZE: "
-        "0x%06llx  STATE: %#-4x  MASK: 0x%06" PRIx32 "\n",
-        hdr->zones[0].start >> ctrl.zns_sector_shift,
-        (hdr->zones[0].start >> ctrl.zns_sector_shift) +
-            (hdr->zones[0].capacity >> ctrl.zns_sector_shift),
-        hdr->zones[0].capacity >> ctrl.zns_sector_shift,
-        hdr->zones[0].wp >> ctrl.zns_sector_shift,
-        hdr->zones[0].len >> ctrl.zns_sector_shift, hdr->zones[0].cond << 4,
-        ctrl.znsdev.zone_mask);
+    *blk_zone = hdr->zones[0];
+    blk_zone->start += zone_sectors * znsdev->zone_offset;
+    blk_zone->wp += zone_sectors * znsdev->zone_offset;
 
     close(fd);
 
     free(hdr);
     hdr = NULL;
+
+    return 0;
 }
 
 /*
- * Get information about a zone.
+ * Print the information about a zone.
  *
- * @extent: struct extent * to store zone info in
+ * @zone: number of the zone to print info of
+ *
+ * Note, output goes through the buffered report writer, callers printing with
+ * MSG() afterwards must call rep_flush() first.
  *
  * */
-static void get_zone_info(struct extent *extent) {
-    struct blk_zone_report *hdr = NULL;
-    uint64_t start_sector;
-
-    start_sector =
-        (ctrl.znsdev.zone_size << ctrl.zns_sector_shift) * extent->zone;
+void print_zone_info(struct control *ctrl, uint32_t zone) {
+    struct blk_zone blk_zone;
 
-    int fd = open(ctrl.znsdev.dev_path, O_RDONLY);
-    if (fd < 0) {
+    if (report_zone(ctrl, zone, &blk_zone) < 0) {
         return;
     }
 
-    hdr = calloc(1, sizeof(struct blk_zone_report) + sizeof(struct blk_zone));
-    hdr->sector = start_sector;
-    hdr->nr_zones = 1;
-
-    if (ioctl(fd, BLKREPORTZONE, hdr) < 0) {
-        ERR_MSG("getting Zone Info\n");
-        return;
-    }
+    REP_LIT("\n============ ZONE ");
+    rep_dec(zone, 0);
+    REP_LIT(" ============\nLBAS: ");
+    rep_hex_zero(blk_zone.start >> ctrl->zns_sector_shift, 6);
+    REP_LIT("  LBAE: ");
+    rep_hex_zero((blk_zone.start >> ctrl->zns_sector_shift) +
+                     (blk_zone.capacity >> ctrl->zns_sector_shift),
+                 6);
+    REP_LIT("  CAP: ");
+    rep_hex_zero(blk_zone.capacity >> ctrl->zns_sector_shift, 6);
+    REP_LIT("  WP: ");
+    rep_hex_zero(blk_zone.wp >> ctrl->zns_sector_shift, 6);
+    REP_LIT("  SIZE: ");
+    rep_hex_zero(blk_zone.len >> ctrl->zns_sector_shift, 6);
+    REP_LIT("  STATE: ");
+    rep_hex(blk_zone.cond << 4, -4);
+    REP_LIT("  MASK: ");
+    rep_hex_zero(get_zone_dev(ctrl, zone)->zone_mask, 6);
+    REP_LIT("\n");
+}
 
-    extent->zone_wp = hdr->zones[0].wp >> ctrl.zns_sector_shift;
-    extent->zone_lbae = (hdr->zones[0].start >> ctrl.zns_sector_shift) +
-                        (hdr->zones[0].capacity >> ctrl.zns_sector_shift);
-    extent->zone_cap = hdr->zones[0].capacity >> ctrl.zns_sector_shift;
-    extent->zone_lbas = hdr->zones[0].start >> ctrl.zns_sector_shift;
+/*
+ * Print the information about a zone from the zonemap, like print_zone_info()
+ * but without reporting the zone again, for reports of many zones.
+ *
+ * @zone: number of the zone to print info of
+ *
+ * Note, output goes through the buffered report writer, as print_zone_info().
+ *
+ * */
+void rep_zone_info(struct control *ctrl, uint32_t zone) {
+    struct zone *z = &ctrl->zonemap->zones[zone];
+    struct bdev *znsdev = get_zone_dev(ctrl, zone);
+
+    REP_LIT("\n============ ZONE ");
+    rep_dec(zone, 0);
+    REP_LIT(" ============\nLBAS: ");
+    rep_hex_zero(z->start, 6);
+    REP_LIT("  LBAE: ");
+    rep_hex_zero(z->start + z->capacity, 6);
+    REP_LIT("  CAP: ");
+    rep_hex_zero(z->capacity, 6);
+    REP_LIT("  WP: ");
+    rep_hex_zero(z->wp, 6);
+    REP_LIT("  SIZE: ");
+    rep_hex_zero(znsdev->zone_size, 6);
+    REP_LIT("  STATE: ");
+    rep_hex(z->state, -4);
+    REP_LIT("  MASK: ");
+    rep_hex_zero(znsdev->zone_mask, 6);
+    REP_LIT("\n");
+}
 
-    close(fd);
+/*
+ * Get information about a zone from the zonemap, which holds the zone reports
+ * of init_ctrl() (or the last update_zone_map()). Reporting the zone of each
+ * extent again would cost an open() and ioctl() per extent.
+ *
+ * @extent: struct extent * to store zone info in
+ *
+ * */
+static void get_zone_info(struct control *ctrl, struct extent *extent) {
+    struct zone *zone = &ctrl->zonemap->zones[extent->zone];
 
-    free(hdr);
-    hdr = NULL;
+    extent->zone_wp = zone->wp;
+    extent->zone_lbae = zone->start + zone->capacity;
+    extent->zone_cap = zone->capacity;
+    extent->zone_lbas = zone->start;
 }
 
+static const struct {
+    uint32_t flag;
+    const char *name;
+} extent_flag_names[] = {
+    {FIEMAP_EXTENT_UNKNOWN, "FIEMAP_EXTENT_UNKNOWN  "},
+    {FIEMAP_EXTENT_DELALLOC, "FIEMAP_EXTENT_DELALLOC  "},
+    {FIEMAP_EXTENT_ENCODED, "FIEMAP_EXTENT_ENCODED  "},
+    {FIEMAP_EXTENT_DATA_ENCRYPTED, "FIEMAP_EXTENT_DATA_ENCRYPTED  "},
+    {FIEMAP_EXTENT_NOT_ALIGNED, "FIEMAP_EXTENT_NOT_ALIGNED  "},
+    {FIEMAP_EXTENT_DATA_INLINE, "FIEMAP_EXTENT_DATA_INLINE  "},
+    {FIEMAP_EXTENT_DATA_TAIL, "FIEMAP_EXTENT_DATA_TAIL  "},
+    {FIEMAP_EXTENT_UNWRITTEN, "FIEMAP_EXTENT_UNWRITTEN  "},
+    {FIEMAP_EXTENT_MERGED, "FIEMAP_EXTENT_MERGED  "},
+};
+
 /*
  * Show the flags that are set in an extent
  *
@@ -497,78 +984,336 @@ static void get_zone_info(struct extent *extent) {
  *
  * */
 void show_extent_flags(uint32_t flags) {
-
     MSG("|--- FLAGS:  ");
 
-    if (flags & FIEMAP_EXTENT_UNKNOWN) {
-        MSG("FIEMAP_EXTENT_UNKNOWN  ");
-    }
-    if (flags & FIEMAP_EXTENT_DELALLOC) {
-        MSG("FIEMAP_EXTENT_DELALLOC  ");
-    }
-    if (flags & FIEMAP_EXTENT_ENCODED) {
-        MSG("FIEMAP_EXTENT_ENCODED  ");
-    }
-    if (flags & FIEMAP_EXTENT_DATA_ENCRYPTED) {
-        MSG("FIEMAP_EXTENT_DATA_ENCRYPTED  ");
-    }
-    if (flags & FIEMAP_EXTENT_NOT_ALIGNED) {
-        MSG("FIEMAP_EXTENT_NOT_ALIGNED  ");
-    }
-    if (flags & FIEMAP_EXTENT_DATA_INLINE) {
-        MSG("FIEMAP_EXTENT_DATA_INLINE  ");
-    }
-    if (flags & FIEMAP_EXTENT_DATA_TAIL) {
-        MSG("FIEMAP_EXTENT_DATA_TAIL  ");
+    for (uint8_t i = 0;
+         i < sizeof(extent_flag_names) / sizeof(extent_flag_names[0]); i++) {
+        if (flags & extent_flag_names[i].flag) {
+            MSG("%s", extent_flag_names[i].name);
+        }
     }
-    if (flags & FIEMAP_EXTENT_UNWRITTEN) {
-        MSG("FIEMAP_EXTENT_UNWRITTEN  ");
+
+    MSG("\n");
+}
+
+/*
+ * Same as show_extent_flags(), but through the buffered report writer
+ *
+ * */
+static void rep_extent_flags(uint32_t flags) {
+    REP_LIT("|--- FLAGS:  ");
+
+    for (uint8_t i = 0;
+         i < sizeof(extent_flag_names) / sizeof(extent_flag_names[0]); i++) {
+        if (flags & extent_flag_names[i].flag) {
+            rep_str(extent_flag_names[i].name, 0);
+        }
     }
-    if (flags & FIEMAP_EXTENT_MERGED) {
-        MSG("FIEMAP_EXTENT_MERGED  ");
+
+    REP_LIT("\n");
+}
+
+/* FNV-1a of a file name */
+static uint64_t hash_file_name(const char *file) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (const unsigned char *bytes = (const unsigned char *)file; *bytes;
+         bytes++) {
+        hash = (hash ^ *bytes) * 0x100000001b3ULL;
     }
 
-    MSG("\n");
+    return hash;
 }
 
 /*
- * Increase the extent counts for a particular file
+ * Find a file name in the hash of the file counters
  *
  * @file: char * to file name (full path)
  *
+ * returns: slot of the file, or the empty slot to insert it into
+ *
  * */
-static void increase_file_extent_counter(char *file) {
-    for (uint32_t i = 0; i < ctrl.file_counter_map->file_ctr; i++) {
-        if (strcmp(ctrl.file_counter_map->files[i].file, file) == 0) {
-            ctrl.file_counter_map->files[i].ext_ctr++;
-            return;
-        }
+static uint32_t find_file_counter_slot(struct file_counter_map *map,
+                                       const char *file) {
+    uint32_t slot = hash_file_name(file) & map->hash_mask;
+
+    while (map->hash[slot] &&
+           strcmp(map->files[map->hash[slot] - 1].file, file) != 0) {
+        slot = (slot + 1) & map->hash_mask;
     }
 
-    strncpy(ctrl.file_counter_map->files[ctrl.file_counter_map->file_ctr].file,
-            file,
-            sizeof(ctrl.file_counter_map->files[ctrl.file_counter_map->file_ctr]
-                       .file));
-    ctrl.file_counter_map->files[ctrl.file_counter_map->file_ctr].ext_ctr = 1;
-    ctrl.file_counter_map->file_ctr++;
+    return slot;
 }
 
 /*
- * TODO: description and return codes
+ * Make room for the counter of a new file, allocating the counters on first
+ * use. The counters grow geometrically, and the hash of the file names is
+ * rebuilt with twice the slots of the counters, such that it is at most half
+ * full.
  *
  * */
-int get_extents(char *filename, int fd, struct stat *stats) {
-    struct fiemap *fiemap;
-    struct extent *extent;
-    uint8_t last_ext = 0;
-    uint64_t ext_ctr = 0;
-    struct file_counter_map *temp = NULL;
+static void grow_file_counters(struct control *ctrl) {
+    struct file_counter_map *map = ctrl->file_counter_map;
+    uint32_t size = map ? map->files_size * 2 : 64;
+
+    map = realloc(map, sizeof(struct file_counter_map) +
+                           sizeof(struct file_counter) * size);
+    if (map == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    if (ctrl->file_counter_map == NULL) {
+        memset(map, 0, sizeof(struct file_counter_map));
+    }
+    map->files_size = size;
+    ctrl->file_counter_map = map;
 
-    fiemap = calloc(1, sizeof(struct fiemap)
-		    + sizeof(struct fiemap_extent) * stats->st_blocks);
-    extent = calloc(1, sizeof(struct extent));
+    free(map->hash);
+    map->hash = calloc(size * 2, sizeof(uint32_t));
+    if (map->hash == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    map->hash_mask = size * 2 - 1;
 
-    fiemap->fm_flags = FIEMAP_FLAG_SYNC;
+    for (uint32_t i = 0; i < map->file_ctr; i++) {
+        map->hash[find_file_counter_slot(map, map->files[i].file)] = i + 1;
+    }
+}
+
+/*
+ * Increase the extent counts for a particular file. Files are looked up by
+ * name in the hash of the file counters, such that the cost does not grow with
+ * the number of files.
+ *
+ * @file: char * to file name (full path)
+ *
+ * returns: index of the file in ctrl->file_counter_map
+ *
+ * */
+uint32_t increase_file_extent_counter(struct control *ctrl, char *file) {
+    struct file_counter_map *map;
+    uint32_t last, slot;
+    struct file_counter *fc;
+
+    if (ctrl->file_counter_map == NULL) {
+        grow_file_counters(ctrl);
+    }
+    map = ctrl->file_counter_map;
+    last = map->file_ctr - 1;
+
+    /* extents of a file are added consecutively, check the last file first */
+    if (map->file_ctr > 0 && strcmp(map->files[last].file, file) == 0) {
+        map->files[last].ext_ctr++;
+        return last;
+    }
+
+    slot = find_file_counter_slot(map, file);
+    if (map->hash[slot]) {
+        map->files[map->hash[slot] - 1].ext_ctr++;
+        return map->hash[slot] - 1;
+    }
+
+    if (map->file_ctr == map->files_size) {
+        grow_file_counters(ctrl);
+        map = ctrl->file_counter_map;
+        slot = find_file_counter_slot(map, file);
+    }
+
+    fc = &map->files[map->file_ctr];
+    memset(fc, 0, sizeof(struct file_counter));
+    strncpy(fc->file, file, sizeof(fc->file));
+    fc->ext_ctr = 1;
+    map->hash[slot] = map->file_ctr + 1;
+
+    return map->file_ctr++;
+}
+
+/*
+ * Update the fragmentation counters of a file with its next extent. Extents
+ * must be added in logical order, a new run starts whenever an extent does not
+ * physically continue where the prior extent of the file ended.
+ *
+ * @fc: struct file_counter * of the file the extent belongs to
+ * @extent: struct extent * to add
+ *
+ * */
+static void increase_file_frag_counter(struct control *ctrl,
+                                       struct file_counter *fc,
+                                       struct extent *extent) {
+    if (fc->frag_runs == 0) {
+        fc->frag_runs = 1;
+    } else if (extent->phy_blk != fc->frag_last_pbae) {
+        fc->frag_runs++;
+        fc->frag_seek_dist += extent->phy_blk > fc->frag_last_pbae
+                                  ? extent->phy_blk - fc->frag_last_pbae
+                                  : fc->frag_last_pbae - extent->phy_blk;
+    }
+
+    fc->frag_size += extent->len;
+    fc->frag_last_pbae = extent->phy_blk + extent->len;
+
+    if (!(ctrl->file_zones[extent->zone >> 3] & (1 << (extent->zone & 7)))) {
+        ctrl->file_zones[extent->zone >> 3] |= 1 << (extent->zone & 7);
+        fc->frag_zone_ctr++;
+    }
+}
+
+/*
+ * (Re)allocate the per file counters for the next file, must be called before
+ * adding the extents of each file with add_file_extent(). The fileID table
+ * grows geometrically.
+ *
+ * returns: EXIT_SUCCESS or EXIT_FAILURE
+ *
+ * */
+static int init_file_counters(struct control *ctrl) {
+    uint32_t *ids = NULL;
+    uint32_t size;
+
+    if (ctrl->file_counter_map == NULL) {
+        grow_file_counters(ctrl);
+    }
+
+    if (ctrl->nr_files >= ctrl->file_counter_ids_size) {
+        size = ctrl->file_counter_ids_size ? ctrl->file_counter_ids_size * 2
+                                           : 64;
+        ids = realloc(ctrl->file_counter_ids, sizeof(uint32_t) * size);
+        if (ids == NULL) {
+            ERR_MSG("Failed memory allocation\n");
+            return EXIT_FAILURE;
+        }
+        ctrl->file_counter_ids = ids;
+        ctrl->file_counter_ids_size = size;
+    }
+    ctrl->file_counter_ids[ctrl->nr_files] = 0;
+
+    /* zones of the file are tracked in a bitmap, reset for each file */
+    if (ctrl->file_zones == NULL) {
+        ctrl->file_zones = malloc((ctrl->zonemap->nr_zones + 7) >> 3);
+        if (ctrl->file_zones == NULL) {
+            ERR_MSG("Failed memory allocation\n");
+            return EXIT_FAILURE;
+        }
+    }
+    memset(ctrl->file_zones, 0, (ctrl->zonemap->nr_zones + 7) >> 3);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Add an extent of the current file (ctrl->nr_files) to the zonemap and the
+ * file counters. Extents of a file must be added in logical order.
+ *
+ * @extent: struct extent * with the zone, zone info, and file set
+ *
+ * */
+static void add_file_extent(struct control *ctrl, struct extent *extent) {
+    struct node *node;
+
+    extent->fileID = ctrl->nr_files;
+    ctrl->zonemap->cum_extent_size += extent->len;
+
+    node = add_extent_to_zone_list(ctrl, *extent);
+    if (ctrl->extent_added) {
+        ctrl->extent_added(ctrl, node->extent);
+    }
+
+    ctrl->file_counter_ids[ctrl->nr_files] =
+        increase_file_extent_counter(ctrl, extent->file);
+    increase_file_frag_counter(ctrl, get_extent_file_counter(ctrl, extent),
+                               extent);
+
+    ctrl->zonemap->extent_ctr++;
+    ctrl->zonemap->zone_ctr++;
+}
+
+/*
+ * Add the extents of a file that were mapped before (e.g., loaded from a
+ * zonemap index) as if they were returned by get_extents(). The file is
+ * assigned the next fileID.
+ *
+ * @extents: struct extent * array of the extents in logical order, with the
+ * zone, zone info, file, and (if any) fs_info set
+ * @nr_extents: number of extents in the array
+ *
+ * returns: EXIT_SUCCESS or EXIT_FAILURE
+ *
+ * */
+int load_file_extents(struct control *ctrl, struct extent *extents,
+                      uint32_t nr_extents) {
+    if (init_file_counters(ctrl) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < nr_extents; i++) {
+        add_file_extent(ctrl, &extents[i]);
+    }
+
+    ctrl->nr_files++;
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Sync a file prior to mapping it, such that FIEMAP reports its extents on the
+ * device. The sync is accounted in the profile.
+ *
+ * @fd: file descriptor of the file
+ *
+ * returns: the return value of fsync()
+ *
+ * */
+int sync_file(int fd) {
+    uint64_t start = profile_start();
+    int ret;
+
+    profile_syscall(PROFILE_SYS_FSYNC);
+    ret = fsync(fd);
+    profile_stop(PROFILE_FSYNC, start);
+
+    return ret;
+}
+
+/*
+ * Get the F2FS segment of a byte offset in the file system address space.
+ * F2FS numbers its segments from segment0 over all devices, which differs from
+ * the sectors of the zonemap once the devices are not an exact multiple of the
+ * zone size. The segments of the procfs segment_info (and the fs_info) start
+ * at the main area.
+ *
+ * @physical: byte offset in the file system address space (e.g., fe_physical)
+ *
+ * returns: main area segment number
+ *
+ * */
+static uint32_t get_f2fs_segment(struct control *ctrl, uint64_t physical) {
+    struct f2fs_super_block *sb =
+        &((struct f2fs_sb_info *)ctrl->fs_super_block)->sb;
+    uint64_t blkaddr = physical >> F2FS_BLKSIZE_BITS;
+    uint32_t main_segment = (sb->main_blkaddr - sb->segment0_blkaddr) >>
+                            sb->log_blocks_per_seg;
+
+    return ((blkaddr - sb->segment0_blkaddr) >> sb->log_blocks_per_seg) -
+           main_segment;
+}
+
+/*
+ * TODO: description and return codes
+ *
+ * */
+int get_extents(struct control *ctrl, char *filename, int fd,
+                struct stat *stats) {
+    struct fiemap *fiemap;
+    struct extent *extent;
+    struct bdev *dev;
+    uint8_t last_ext = 0;
+    uint64_t ext_ctr = 0, start;
+    int ret;
+
+    fiemap = calloc(1, sizeof(struct fiemap)
+		    + sizeof(struct fiemap_extent) * stats->st_blocks);
+    extent = calloc(1, sizeof(struct extent));
+
+    fiemap->fm_flags = FIEMAP_FLAG_SYNC;
     fiemap->fm_start = 0;
     fiemap->fm_extent_count =
         stats->st_blocks; /* set to max number of blocks in file */
@@ -576,29 +1321,16 @@ int get_extents(char *filename, int fd, struct stat *stats) {
         (stats->st_blocks
          << 3); /* st_blocks is always 512B units, shift to bytes */
 
-    /* (re)allocate the file_counter_map here as this function is always called
-     * for a single file */
-    if (ctrl.file_counter_map == NULL) {
-        ctrl.file_counter_map = calloc(1, sizeof(struct file_counter_map) +
-                                              sizeof(struct file_counter));
-    } else {
-        temp = realloc(ctrl.file_counter_map,
-                       sizeof(struct file_counter_map) +
-                           sizeof(struct file_counter) * (ctrl.nr_files + 1));
-        if (temp == NULL) {
-            /* mem realloc failed */
-            free(ctrl.file_counter_map);
-            ERR_MSG("Failed memory allocation\n");
-            return EXIT_FAILURE;
-        }
-        ctrl.file_counter_map = temp;
-        temp = NULL;
-        memset(&ctrl.file_counter_map->files[ctrl.file_counter_map->file_ctr],
-               0, sizeof(struct file_counter));
+    if (init_file_counters(ctrl) == EXIT_FAILURE) {
+        return EXIT_FAILURE;
     }
 
     do {
-        if (ioctl(fd, FS_IOC_FIEMAP, fiemap) < 0) {
+        start = profile_start();
+        ret = backend_ioctl(fd, filename, FS_IOC_FIEMAP, fiemap);
+        profile_stop(PROFILE_FIEMAP, start);
+
+        if (ret < 0) {
             return EXIT_FAILURE;
         }
 
@@ -607,91 +1339,89 @@ int get_extents(char *filename, int fd, struct stat *stats) {
             return EXIT_FAILURE;
         }
 
+        dev = get_fs_dev(ctrl, fiemap->fm_extents[0].fe_physical);
+
         /* If data is on the bdev (empty files that have space allocated but
          * nothing written) or there are flags we want to ignore (inline data)
          * Disregard this extent but print warning (if logging is set) */
-        if (fiemap->fm_extents[0].fe_physical < ctrl.offset) {
+        if (dev == NULL || dev == &ctrl->bdev) {
             INFO(2,
                  "FILE %s\nExtent Reported on %s  PBAS: "
                  "0x%06llx  PBAE: 0x%06llx  SIZE: 0x%06llx\n",
-                 filename, ctrl.bdev.dev_name,
-                 fiemap->fm_extents[0].fe_physical >> ctrl.sector_shift,
+                 filename, dev ? dev->dev_name : "no device",
+                 fiemap->fm_extents[0].fe_physical >> ctrl->sector_shift,
                  (fiemap->fm_extents[0].fe_physical +
                   fiemap->fm_extents[0].fe_length) >>
-                     ctrl.sector_shift,
-                 fiemap->fm_extents[0].fe_length >> ctrl.sector_shift);
+                     ctrl->sector_shift,
+                 fiemap->fm_extents[0].fe_length >> ctrl->sector_shift);
 
-            if (ctrl.log_level > 1 && ctrl.show_flags) {
+            if (ctrl->log_level > 1 && ctrl->show_flags) {
                 show_extent_flags(fiemap->fm_extents[0].fe_flags);
             }
-        } else if (fiemap->fm_extents[0].fe_flags & ctrl.exclude_flags) {
+        } else if (fiemap->fm_extents[0].fe_flags & ctrl->exclude_flags) {
             INFO(2,
                  "FILE %s\nExtent Reported on %s  PBAS: "
                  "0x%06llx  PBAE: 0x%06llx  SIZE: 0x%06llx\n",
-                 filename, ctrl.bdev.dev_name,
-                 fiemap->fm_extents[0].fe_physical >> ctrl.sector_shift,
+                 filename, dev->dev_name,
+                 fiemap->fm_extents[0].fe_physical >> ctrl->sector_shift,
                  (fiemap->fm_extents[0].fe_physical +
                   fiemap->fm_extents[0].fe_length) >>
-                     ctrl.sector_shift,
-                 fiemap->fm_extents[0].fe_length >> ctrl.sector_shift);
+                     ctrl->sector_shift,
+                 fiemap->fm_extents[0].fe_length >> ctrl->sector_shift);
 
-            if (ctrl.log_level > 1) {
+            if (ctrl->log_level > 1) {
                 show_extent_flags(fiemap->fm_extents[0].fe_flags);
                 MSG("Disregarding extent because exclude flag is set to:\n");
-                show_extent_flags(ctrl.exclude_flags);
+                show_extent_flags(ctrl->exclude_flags);
             }
         } else {
+            /* the zones of a ZNS device follow the zones of prior devices */
             extent->phy_blk =
-                (fiemap->fm_extents[0].fe_physical - ctrl.offset) >>
-                ctrl.sector_shift;
+                ((fiemap->fm_extents[0].fe_physical - dev->offset) >>
+                 ctrl->sector_shift) +
+                dev->zone_offset * dev->zone_size;
             extent->logical_blk =
-                fiemap->fm_extents[0].fe_logical >> ctrl.sector_shift;
-            extent->len = fiemap->fm_extents[0].fe_length >> ctrl.sector_shift;
-            extent->zone_size = ctrl.znsdev.zone_size;
+                fiemap->fm_extents[0].fe_logical >> ctrl->sector_shift;
+            extent->len = fiemap->fm_extents[0].fe_length >> ctrl->sector_shift;
+            extent->zone_size = dev->zone_size;
             extent->ext_nr = ext_ctr; /* individual extent counter for each
-                                         get_extents() scope -> each file */
+                                         get_extents(ctrl) scope -> each file */
             extent->flags = fiemap->fm_extents[0].fe_flags;
 
-            ctrl.zonemap->cum_extent_size += extent->len;
-
             extent->zone =
-                get_zone_number((extent->phy_blk << ctrl.zns_sector_shift));
+                get_zone_number(ctrl,
+                                (extent->phy_blk << ctrl->zns_sector_shift));
 
             strncpy(extent->file, filename, sizeof(extent->file) - 1);
             extent->file[sizeof(extent->file) - 1] = '\0';
 
-            get_zone_info(extent);
-            extent->fileID = ctrl.nr_files;
+            get_zone_info(ctrl, extent);
 
-            if (ctrl.fs_info_bytes > 0) {
+            if (ctrl->fs_info_bytes > 0) {
                 /* only init if file system has fs_info setup */
-                extent->fs_info = calloc(1, ctrl.fs_info_bytes);
+                extent->fs_info = calloc(1, ctrl->fs_info_bytes);
 
                 /* must init the fs_info before adding extent to the zone list,
                  * it does a memcpy() */
-                ctrl.fs_info_init(ctrl.fs_manager, extent->fs_info,
-                                  (extent->phy_blk & ctrl.f2fs_segment_mask) >>
-                                      ctrl.segment_shift);
-                add_extent_to_zone_list(*extent);
+                ctrl->fs_info_init(
+                    ctrl->fs_manager, extent->fs_info,
+                    get_f2fs_segment(ctrl, fiemap->fm_extents[0].fe_physical));
+                add_file_extent(ctrl, extent);
 
                 /* free extent fs_info as it has been memcpy() */
                 free(extent->fs_info);
             } else {
-                add_extent_to_zone_list(*extent);
+                add_file_extent(ctrl, extent);
             }
 
-            increase_file_extent_counter(extent->file);
-
             /* clear extent memory for the next extent */
             memset(extent, 0, sizeof(struct extent));
 
             ext_ctr++;
-            ctrl.zonemap->extent_ctr++;
-            ctrl.zonemap->zone_ctr++;
         }
 
         if (fiemap->fm_extents[0].fe_flags & FIEMAP_EXTENT_DATA_INLINE) {
-            ctrl.inlined_extent_ctr++;
+            ctrl->inlined_extent_ctr++;
         }
 
         if (fiemap->fm_extents[0].fe_flags & FIEMAP_EXTENT_LAST) {
@@ -703,7 +1433,7 @@ int get_extents(char *filename, int fd, struct stat *stats) {
 
     } while (last_ext == 0);
 
-    ctrl.nr_files++;
+    ctrl->nr_files++;
 
     free(fiemap);
     fiemap = NULL;
@@ -740,11 +1470,11 @@ int contains_element(uint32_t list[], uint32_t element, uint32_t size) {
  * returns: uint32_t counter of extents for the file
  *
  * */
-uint32_t get_file_extent_count(char *file) {
-    for (uint32_t i = 0; i < ctrl.file_counter_map->file_ctr; i++) {
-        if (strncmp(ctrl.file_counter_map->files[i].file, file,
-                    strlen(ctrl.file_counter_map->files[i].file)) == 0) {
-            return ctrl.file_counter_map->files[i].ext_ctr;
+uint32_t get_file_extent_count(struct control *ctrl, char *file) {
+    for (uint32_t i = 0; i < ctrl->file_counter_map->file_ctr; i++) {
+        if (strncmp(ctrl->file_counter_map->files[i].file, file,
+                    strlen(ctrl->file_counter_map->files[i].file)) == 0) {
+            return ctrl->file_counter_map->files[i].ext_ctr;
         }
     }
 
@@ -752,56 +1482,117 @@ uint32_t get_file_extent_count(char *file) {
 }
 
 /*
- * TODO: move this to libf2fs, since it is only f2fs
- * Increase the segment counts for a particular file
+ * Get the file counter of the file an extent belongs to, without looking up
+ * the file name.
  *
- * @file: char * to file name (full path)
+ * @extent: extent collected with get_extents()
+ *
+ * returns: struct file_counter * of the file in ctrl->file_counter_map
+ *
+ * */
+struct file_counter *get_extent_file_counter(struct control *ctrl,
+                                             struct extent *extent) {
+    uint32_t id = ctrl->file_counter_ids[extent->fileID];
+
+    return &ctrl->file_counter_map->files[id];
+}
+
+/*
+ * Remove the extents of files from the zonemap, e.g., for files that changed
+ * or were deleted since they were mapped with get_extents(). The counters of
+ * the files are reset, such that the files can be mapped again.
+ *
+ * @stale: bitmap of the fileIDs of the files to remove
  *
  * */
-void increase_file_segment_counter(char *file, unsigned int num_segments,
-                                   unsigned int cur_segment, void *fs_info,
-                                   uint64_t zone_cap) {
-    uint32_t i;
-
-    struct segment_info *seg_i = (struct segment_info *)fs_info;
-    enum type type = seg_i->type;
-
-    for (i = 0; i < ctrl.file_counter_map->file_ctr; i++) {
-        if (strncmp(ctrl.file_counter_map->files[i].file, file,
-                    strlen(ctrl.file_counter_map->files[i].file)) == 0) {
-            goto found;
+void remove_file_extents(struct control *ctrl, uint8_t *stale) {
+    struct zone *zone;
+    struct node *prev, *current, *next;
+    struct file_counter *fc;
+    char file[MAX_FILE_LENGTH];
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        zone = &ctrl->zonemap->zones[i];
+        prev = NULL;
+
+        for (current = zone->extents_head; current; current = next) {
+            next = current->next;
+
+            if (!(stale[current->extent->fileID >> 3] &
+                  (1 << (current->extent->fileID & 7)))) {
+                prev = current;
+                continue;
+            }
+
+            sorted_zone_list_remove(ctrl, zone, prev, current);
+            zone->extent_ctr--;
+            ctrl->zonemap->extent_ctr--;
+            ctrl->zonemap->zone_ctr--;
+            ctrl->zonemap->cum_extent_size -= current->extent->len;
+
+            profile_zonemap(-get_node_bytes(ctrl, current));
+            free(current->extent->fs_info);
+            free(current->extent);
+            free(current);
         }
     }
 
-found:
-    if (ctrl.file_counter_map->files[i].last_segment_id != cur_segment) {
-        ctrl.file_counter_map->files[i].segment_ctr += num_segments;
-        ctrl.file_counter_map->files[i].last_segment_id = cur_segment;
+    for (uint32_t id = 0; id < ctrl->nr_files; id++) {
+        if (!(stale[id >> 3] & (1 << (id & 7))) ||
+            ctrl->file_counter_map == NULL) {
+            continue;
+        }
 
-        switch (type) {
-        case CURSEG_COLD_DATA:
-            ctrl.file_counter_map->files[i].cold_ctr += num_segments;
-            break;
-        case CURSEG_WARM_DATA:
-            ctrl.file_counter_map->files[i].warm_ctr += num_segments;
-            break;
-        case CURSEG_HOT_DATA:
-            ctrl.file_counter_map->files[i].hot_ctr += num_segments;
-            break;
-        default:
-            break;
+        fc = &ctrl->file_counter_map->files[ctrl->file_counter_ids[id]];
+        memcpy(file, fc->file, sizeof(file));
+        memset(fc, 0, sizeof(struct file_counter));
+        memcpy(fc->file, file, sizeof(file));
+    }
+}
+
+/*
+ * Remove the extents and counters of all files, keeping the zone information,
+ * such that files can be mapped one at a time with a single init_ctrl().
+ * Unlike remove_file_extents(), the next get_extents() starts again at fileID
+ * 0, hence the cost of mapping a file does not grow with the files before it.
+ *
+ * */
+void clear_file_extents(struct control *ctrl) {
+    struct zone *zone;
+    struct node *current, *next;
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        zone = &ctrl->zonemap->zones[i];
+        if (!zone->extents_head) {
+            continue;
         }
+
+        for (current = zone->extents_head; current; current = next) {
+            next = current->next;
+            profile_zonemap(-get_node_bytes(ctrl, current));
+            free(current->extent->fs_info);
+            free(current->extent);
+            free(current);
+        }
+
+        zone->extents_head = NULL;
+        zone->extent_ctr = 0;
+        memset(&zone->extent_hist, 0, sizeof(struct size_hist));
+        memset(&zone->hole_hist, 0, sizeof(struct size_hist));
     }
 
-    uint32_t zone = get_zone_number(cur_segment << ctrl.segment_shift >>
-                                    ctrl.zns_sector_shift);
-    if (ctrl.file_counter_map->files[i].last_zone != zone) {
-        ctrl.file_counter_map->files[i].zone_ctr +=
-            (num_segments * F2FS_SEGMENT_BYTES >> ctrl.sector_shift) /
-                zone_cap +
-            1;
-        ctrl.file_counter_map->files[i].last_zone = zone;
+    ctrl->zonemap->extent_ctr = 0;
+    ctrl->zonemap->cum_extent_size = 0;
+    ctrl->zonemap->zone_ctr = 0;
+    memset(&ctrl->zonemap->extent_hist, 0, sizeof(struct size_hist));
+    memset(&ctrl->zonemap->hole_hist, 0, sizeof(struct size_hist));
+
+    if (ctrl->file_counter_map) {
+        ctrl->file_counter_map->file_ctr = 0;
+        memset(ctrl->file_counter_map->hash, 0,
+               sizeof(uint32_t) * (ctrl->file_counter_map->hash_mask + 1));
     }
+    ctrl->nr_files = 0;
 }
 
 /*
@@ -814,9 +1605,9 @@ found:
 void map_extents(struct extent_map *extent_map) {
 
     /* for (uint32_t i = 0; i < extent_map->ext_ctr; i++) { */
-    /*     ctrl.zonemap.zones[extent_map->extent[i].zone].extents =
+    /*     ctrl->zonemap.zones[extent_map->extent[i].zone].extents =
      * &extent_map->extent[i]; */
-    /*     ctrl.zonemap.zones[extent_map->extent[i].zone].extent_ctr++; */
+    /*     ctrl->zonemap.zones[extent_map->extent[i].zone].extent_ctr++; */
     /* } */
 
     // TOOD: we need to collect statistics during the extent map iteration.
@@ -825,53 +1616,89 @@ void map_extents(struct extent_map *extent_map) {
     //  file counters, etc.
 }
 
-void set_super_block_info(struct f2fs_super_block f2fs_sb) {
-    // We currently assume a 2 device setup (conventional followed by ZNS)
-    for (uint8_t i = 0; i < ZNS_TOOLS_MAX_DEVS; i++) {
-        if (f2fs_sb.devs[ZNS_TOOLS_MAX_DEVS].total_segments > 0) {
-            WARN("Found more than 2 devices in F2FS superblock. Tools can "
-                 "currently only use the first 2 devices.");
-            break;
-        } else {
-            INFO(1, "Found device in superblock %s\n", f2fs_sb.devs[i].path);
-        }
-    }
+/*
+ * Set up the devices of the F2FS superblock. The first device is the
+ * conventional device, all following devices must be ZNS devices. F2FS places
+ * the devices back to back in its address space, each spanning its
+ * total_segments, with the first device additionally holding the blocks prior
+ * to segment0.
+ *
+ * @sb: struct f2fs_super_block * of the mount
+ *
+ * */
+void set_super_block_info(struct control *ctrl, struct f2fs_super_block *sb) {
+    struct bdev *znsdev;
+    uint64_t blk_addr, seg_blocks = 1ULL << sb->log_blocks_per_seg;
+    uint32_t nr_zones = 0;
+
+    INFO(1, "Found device in superblock %s\n", sb->devs[0].path);
 
     // Updated prior bdev info (as it's in <major:minor> format)
-    memset(ctrl.bdev.dev_name, 0, MAX_DEV_NAME);
-    memcpy(ctrl.bdev.dev_name, f2fs_sb.devs[0].path + 5, MAX_PATH_LEN);
-    memcpy(ctrl.bdev.dev_path, f2fs_sb.devs[0].path, MAX_PATH_LEN);
+    memset(ctrl->bdev.dev_name, 0, MAX_DEV_NAME);
+    strncpy(ctrl->bdev.dev_name, (char *)sb->devs[0].path + 5,
+            MAX_DEV_NAME - 1);
+    memcpy(ctrl->bdev.dev_path, sb->devs[0].path, MAX_PATH_LEN);
 
     // First cannot be zoned, we call function to initialize values and print
     // info
-    ctrl.bdev.is_zoned = is_zoned(ctrl.bdev.dev_path);
-    ctrl.sector_size = get_sector_size(ctrl.bdev.dev_path);
-    ctrl.segment_shift = ctrl.sector_size == 512 ? 12 : 9;
+    ctrl->bdev.is_zoned = is_zoned(ctrl, ctrl->bdev.dev_path);
+    ctrl->sector_size = get_sector_size(ctrl, ctrl->bdev.dev_path);
+    ctrl->segment_shift = ctrl->sector_size == 512 ? 12 : 9;
+
+    blk_addr = sb->segment0_blkaddr + sb->devs[0].total_segments * seg_blocks;
+    ctrl->bdev.end = blk_addr << sb->log_blocksize;
+
+    for (uint8_t i = 1; i < ZNS_TOOLS_MAX_DEVS; i++) {
+        if (sb->devs[i].total_segments == 0) {
+            break;
+        }
+
+        INFO(1, "Found device in superblock %s\n", sb->devs[i].path);
+
+        znsdev = &ctrl->znsdev[ctrl->nr_znsdevs++];
+        strncpy(znsdev->dev_name, (char *)sb->devs[i].path + 5,
+                MAX_DEV_NAME - 1);
+
+        if (init_znsdev(ctrl, znsdev) == EXIT_FAILURE) {
+            ERR_MSG("Failed initializing %s\n", znsdev->dev_path);
+        }
 
-    memcpy(ctrl.znsdev.dev_name, f2fs_sb.devs[1].path + 5, MAX_PATH_LEN);
+        if (znsdev->is_zoned != 1) {
+            ERR_MSG("%s is not a ZNS device\n", znsdev->dev_name);
+        }
+
+        if (znsdev->zone_size != ctrl->znsdev[0].zone_size) {
+            ERR_MSG("%s has a different zone size than %s\n",
+                    znsdev->dev_name, ctrl->znsdev[0].dev_name);
+        }
 
-    if (init_znsdev() == EXIT_FAILURE) {
-        ERR_MSG("Failed initializing %s\n", ctrl.znsdev.dev_path);
+        znsdev->offset = blk_addr << sb->log_blocksize;
+        blk_addr += sb->devs[i].total_segments * seg_blocks;
+        znsdev->end = blk_addr << sb->log_blocksize;
+        znsdev->zone_offset = nr_zones;
+        nr_zones += znsdev->nr_zones;
     }
 
-    if (ctrl.znsdev.is_zoned != 1) {
-        ERR_MSG("%s is not a ZNS device\n", ctrl.znsdev.dev_name);
+    if (ctrl->nr_znsdevs == 0) {
+        ERR_MSG("No ZNS device found in F2FS superblock\n");
     }
+
+    init_zone_map(ctrl);
 }
 
 /*
  * check the magic value of the file being checked and
  * store it in the control
  * */
-void set_fs_magic(char *name) {
+void set_fs_magic(struct control *ctrl, char *name) {
     struct statfs s;
 
-    if (statfs(name, &s)) {
+    if (backend_statfs(name, &s)) {
         ERR_MSG("failed getting file system magic value for file %s\n", name);
         return;
     }
 
-    ctrl.fs_magic = s.f_type;
+    ctrl->fs_magic = s.f_type;
 }
 
 /*
@@ -879,120 +1706,370 @@ void set_fs_magic(char *name) {
  *
  *
  * */
-void init_ctrl(char *filename, int fd, struct stat *stats) {
-    set_fs_magic(filename);
+void init_ctrl(struct control *ctrl, char *filename, int fd,
+               struct stat *stats) {
+    struct f2fs_sb_info *sbi;
+
+    set_fs_magic(ctrl, filename);
 
-    if (ctrl.fs_magic == F2FS_MAGIC) {
-        init_dev(stats);
+    if (ctrl->fs_magic == F2FS_MAGIC) {
+        init_dev(ctrl, stats);
 
-        f2fs_read_super_block(ctrl.bdev.dev_path);
-        set_super_block_info(f2fs_sb);
+        sbi = f2fs_read_super_block(ctrl->bdev.dev_path);
+        ctrl->fs_super_block = sbi;
+        set_super_block_info(ctrl, &sbi->sb);
 
-        ctrl.multi_dev = 1;
-        ctrl.offset = get_dev_size(ctrl.bdev.dev_path);
-        ctrl.znsdev.zone_size = get_zone_size();
-        ctrl.znsdev.zone_mask = ~(ctrl.znsdev.zone_size - 1);
-        ctrl.znsdev.nr_zones = get_nr_zones();
-    } else if (ctrl.fs_magic == BTRFS_MAGIC) {
+        ctrl->multi_dev = 1;
+    } else if (ctrl->fs_magic == BTRFS_MAGIC) {
         WARN("%s is registered as being on Btrfs which can occupy multiple "
              "devices.\nEnter the"
              " associated ZNS device name: ",
              filename);
 
-        int ret = scanf("%s", ctrl.znsdev.dev_name);
+        int ret = scanf("%14s", ctrl->znsdev[0].dev_name);
         if (!ret) {
             ERR_MSG("reading input\n");
         }
 
-        if (init_znsdev() == EXIT_FAILURE) {
-            ERR_MSG("Failed initializing %s\n", ctrl.znsdev.dev_path);
+        if (init_znsdev(ctrl, &ctrl->znsdev[0]) == EXIT_FAILURE) {
+            ERR_MSG("Failed initializing %s\n", ctrl->znsdev[0].dev_path);
         }
 
-        ctrl.multi_dev = 0;
-        ctrl.offset = 0;
-        ctrl.znsdev.zone_size = get_zone_size();
-        ctrl.znsdev.zone_mask = ~(ctrl.znsdev.zone_size - 1);
-        ctrl.znsdev.nr_zones = get_nr_zones();
+        ctrl->multi_dev = 0;
+        ctrl->nr_znsdevs = 1;
+        ctrl->znsdev[0].end = get_dev_size(ctrl->znsdev[0].dev_path);
+        init_zone_map(ctrl);
     }
 }
 
 /*
- * Print the report summary of all the extents in the zonemap.
- * This is used by zns.fiemap and by zns.segmap (for file systems
- * other than F2FS), therefore it is included in this lib to avoid
- * code duplication.
+ * Print a hole line of the fiemap report, framed by HOLE_FORMATTER lines
+ *
+ * @prefix: hole line prefix up to the PBAS value
+ * @pbas: starting address of the hole
+ * @pbae: ending address of the hole
+ * @size: size of the hole
+ *
+ * */
+static void rep_hole(const char *prefix, uint64_t pbas, uint64_t pbae,
+                     uint64_t size) {
+    HOLE_FORMATTER;
+    rep_str(prefix, 0);
+    rep_hex(pbas, -10);
+    REP_LIT("  PBAE: ");
+    rep_hex(pbae, -10);
+    REP_LIT("  SIZE: ");
+    rep_hex(size, -10);
+    REP_LIT("\n");
+    HOLE_FORMATTER;
+}
+
+/*
+ * Thread of the render pool, rendering tasks into memory until none are left.
+ * A task is only picked up once fewer than max_in_flight tasks are waiting to
+ * be written out, such that the captured output in memory is bounded.
+ *
+ * */
+static void *render_thread(void *arg) {
+    struct render_pool *pool = (struct render_pool *)arg;
+    struct render_task *task;
+    uint32_t t;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->next_task < pool->nr_tasks &&
+               pool->next_task >= pool->written + pool->max_in_flight) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        t = pool->next_task;
+        if (t < pool->nr_tasks) {
+            pool->next_task++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if (t >= pool->nr_tasks) {
+            break;
+        }
+        task = &pool->tasks[t];
+
+        rep_capture();
+        pool->render(pool->ctrl, task->start, task->end, task->acc);
+        rep_capture_end(&task->data, &task->len);
+
+        pthread_mutex_lock(&pool->lock);
+        task->done = 1;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * Split the zonemap into ranges of zones with roughly equal numbers of
+ * extents, one per task. Ranges hold at most RENDER_TASK_EXTENTS extents,
+ * unless a single zone has more, such that the output of a task is bounded.
+ *
+ * @pool: render pool to set the tasks of
+ * @nr_tasks: minimum number of tasks to split the extents into
+ *
+ * */
+static void init_render_tasks(struct control *ctrl, struct render_pool *pool,
+                              uint32_t nr_tasks) {
+    uint64_t per_task = ctrl->zonemap->extent_ctr / nr_tasks + 1;
+    uint64_t extents = 0;
+    uint32_t start = 0;
+
+    if (per_task > RENDER_TASK_EXTENTS) {
+        per_task = RENDER_TASK_EXTENTS;
+    }
+
+    pool->nr_tasks = 0;
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        extents += ctrl->zonemap->zones[i].extent_ctr;
+
+        if (extents >= per_task || i == ctrl->zonemap->nr_zones - 1) {
+            pool->tasks[pool->nr_tasks].start = start;
+            pool->tasks[pool->nr_tasks].end = i + 1;
+            pool->nr_tasks++;
+            start = i + 1;
+            extents = 0;
+        }
+    }
+}
+
+/*
+ * Render a report over all zones of the zonemap. Zones are split up in
+ * ranges that are rendered in parallel by a pool of ctrl->nr_threads threads
+ * (all CPUs if not set), each into its own memory buffer. The calling thread
+ * writes the buffers out in zone order with the report writer, and reduces the
+ * accumulators of the tasks into acc, also in zone order. At most
+ * RENDER_TASKS_IN_FLIGHT buffers per thread are kept, such that the peak
+ * memory does not depend on the size of the report.
+ *
+ * Small zonemaps are rendered directly by the calling thread, as a single
+ * range over all zones.
+ *
+ * @render: function rendering a range of zones
+ * @reduce: function reducing a task accumulator into acc, can be NULL
+ * @acc: final accumulator
+ * @acc_size: size in bytes of the accumulator, can be 0
+ * @sep: separator written in between non-empty ranges, can be NULL
+ *
+ * */
+void render_zones(struct control *ctrl, zone_render render, zone_reduce reduce,
+                  void *acc, size_t acc_size, const char *sep) {
+    struct render_pool pool;
+    struct render_task *task;
+    pthread_t *threads;
+    uint32_t nr_threads = ctrl->nr_threads;
+    uint8_t written = 0;
+
+    if (nr_threads == 0) {
+        nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    memset(&pool, 0, sizeof(struct render_pool));
+    pool.ctrl = ctrl;
+    pool.render = render;
+    pool.max_in_flight = nr_threads * RENDER_TASKS_IN_FLIGHT;
+    /* each task holds at least one zone */
+    pool.tasks =
+        calloc(ctrl->zonemap->nr_zones + 1, sizeof(struct render_task));
+    if (!pool.tasks) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    if (nr_threads > 1 && ctrl->zonemap->extent_ctr >= RENDER_MIN_EXTENTS) {
+        init_render_tasks(ctrl, &pool, nr_threads * RENDER_TASKS_PER_THREAD);
+    } else {
+        pool.tasks[0].start = 0;
+        pool.tasks[0].end = ctrl->zonemap->nr_zones;
+        pool.nr_tasks = 1;
+        nr_threads = 0;
+    }
+
+    for (uint32_t t = 0; t < pool.nr_tasks; t++) {
+        pool.tasks[t].acc = calloc(1, acc_size + 1);
+        if (!pool.tasks[t].acc) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+    }
+
+    if (nr_threads > pool.nr_tasks) {
+        nr_threads = pool.nr_tasks;
+    }
+
+    threads = calloc(nr_threads + 1, sizeof(pthread_t));
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+
+    for (uint32_t i = 0; i < nr_threads; i++) {
+        if (pthread_create(&threads[i], NULL, render_thread, &pool)) {
+            ERR_MSG("Failed creating render thread\n");
+        }
+    }
+
+    for (uint32_t t = 0; t < pool.nr_tasks; t++) {
+        task = &pool.tasks[t];
+
+        if (nr_threads == 0) {
+            render(ctrl, task->start, task->end, task->acc);
+        } else {
+            pthread_mutex_lock(&pool.lock);
+            while (!task->done) {
+                pthread_cond_wait(&pool.cond, &pool.lock);
+            }
+            pthread_mutex_unlock(&pool.lock);
+
+            if (task->len > 0) {
+                if (sep && written) {
+                    rep_str(sep, 0);
+                }
+                rep_write(task->data, task->len);
+                written = 1;
+            }
+            free(task->data);
+
+            pthread_mutex_lock(&pool.lock);
+            pool.written = t + 1;
+            pthread_cond_broadcast(&pool.cond);
+            pthread_mutex_unlock(&pool.lock);
+        }
+
+        if (reduce) {
+            reduce(acc, task->acc);
+        }
+        free(task->acc);
+    }
+
+    for (uint32_t i = 0; i < nr_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.lock);
+    free(threads);
+    free(pool.tasks);
+}
+
+struct hole_stats {
+    uint32_t hole_ctr;          /* number of holes */
+    uint64_t hole_cum_size;     /* cumulative size of the holes */
+    struct size_hist hole_hist; /* sizes of the holes */
+};
+
+/*
+ * Count a hole of the report in the summary (NOH, THS) and its histogram
+ *
+ * */
+static void count_hole(struct hole_stats *holes, uint64_t size) {
+    holes->hole_cum_size += size;
+    holes->hole_ctr++;
+    holes->hole_hist.buckets[size_hist_bucket(size)]++;
+    holes->hole_hist.ctr++;
+}
+
+/*
+ * Get the last extent of the zonemap before a zone
+ *
+ * @zone: zone to get the preceding extent of
+ *
+ * returns: struct node * of the extent, NULL if there is none
+ *
+ * */
+static struct node *get_prev_extent_node(struct control *ctrl, uint32_t zone) {
+    struct node *current = NULL;
+
+    while (zone > 0 && ctrl->zonemap->zones[zone - 1].extent_ctr == 0) {
+        zone--;
+    }
+
+    if (zone > 0) {
+        current = ctrl->zonemap->zones[zone - 1].extents_head;
+        while (current && current->next) {
+            current = current->next;
+        }
+    }
+
+    return current;
+}
+
+/*
+ * Render the extent mappings of a range of zones, see render_zones()
+ *
+ * @start: first zone to render
+ * @end: zone after the last zone to render
+ * @arg: struct hole_stats * to accumulate the holes in
  *
  * */
-void print_fiemap_report() {
+static void render_fiemap_zones(struct control *ctrl, uint32_t start,
+                                uint32_t end, void *arg) {
+    struct hole_stats *holes = (struct hole_stats *)arg;
     uint32_t i = 0;
-    uint32_t hole_ctr = 0;
-    uint64_t hole_cum_size = 0;
     uint64_t hole_size = 0;
     uint64_t hole_end = 0;
     uint64_t pbae = 0;
-    struct node *current, *prev = NULL;
-
-    MSG("================================================================="
-        "===\n");
-    MSG("\t\t\tEXTENT MAPPINGS\n");
-    MSG("==================================================================="
-        "=\n");
-
-    for (i = 0; i < ctrl.zonemap->nr_zones; i++) {
-        if (ctrl.zonemap->zones[i].extent_ctr == 0) {
+    uint64_t zone_lbae = 0;
+    struct zone *zone;
+    struct node *current, *prev = get_prev_extent_node(ctrl, start);
+
+    for (i = start; i < end; i++) {
+        /* zone values of the extents are copies from the time they were
+         * mapped, the zonemap has them after the last update_zone_map() */
+        zone = &ctrl->zonemap->zones[i];
+        if (zone->extent_ctr == 0) {
             continue;
         }
+        zone_lbae = zone->start + zone->capacity;
 
-        print_zone_info(i);
-        MSG("\n");
+        rep_zone_info(ctrl, i);
+        if (ctrl->show_hist) {
+            print_zone_size_hist(ctrl, i);
+        }
+        REP_LIT("\n");
 
-        current = ctrl.zonemap->zones[i].extents_head;
+        current = zone->extents_head;
 
         while (current) {
             /* Track holes in between extents in the same zone */
-            if (ctrl.show_holes && prev != NULL &&
+            if (ctrl->show_holes && prev != NULL &&
                 (prev->extent->phy_blk + prev->extent->len !=
                  current->extent->phy_blk)) {
                 if (prev->extent->zone == current->extent->zone) {
                     hole_size = current->extent->phy_blk -
-                                (prev->extent->phy_blk + prev->extent->len);
-                    hole_cum_size += hole_size;
-                    hole_ctr++;
-
-                    HOLE_FORMATTER;
-                    MSG("--- HOLE:    PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                        "  SIZE: %#-10" PRIx64 "\n",
-                        prev->extent->phy_blk + prev->extent->len,
-                        current->extent->phy_blk, hole_size);
-                    HOLE_FORMATTER;
+                                 (prev->extent->phy_blk + prev->extent->len);
+                    count_hole(holes, hole_size);
+
+                    rep_hole("--- HOLE:    PBAS: ",
+                             prev->extent->phy_blk + prev->extent->len,
+                             current->extent->phy_blk, hole_size);
                 }
             }
             /* Hole between LBAS of zone and PBAS of the extent */
-            if (ctrl.show_holes && current->next != NULL && prev != NULL &&
-                current->extent->zone_lbas != current->extent->phy_blk &&
+            if (ctrl->show_holes && current->next != NULL && prev != NULL &&
+                zone->start != current->extent->phy_blk &&
                 prev->extent->zone != current->extent->zone) {
 
-                hole_size =
-                    current->extent->phy_blk - current->extent->zone_lbas;
-                hole_cum_size += hole_size;
-                hole_ctr++;
-
-                HOLE_FORMATTER;
-                MSG("---- HOLE:    PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                    "  SIZE: %#-10" PRIx64 "\n",
-                    current->extent->zone_lbas, current->extent->phy_blk,
-                    hole_size);
-                HOLE_FORMATTER;
-            }
+                hole_size = current->extent->phy_blk - zone->start;
+                count_hole(holes, hole_size);
 
-            MSG("EXTID: %-4d  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                "  SIZE: %#-10" PRIx64 "\n",
-                current->extent->ext_nr + 1, current->extent->phy_blk,
-                (current->extent->phy_blk + current->extent->len),
-                current->extent->len);
+                rep_hole("---- HOLE:    PBAS: ", zone->start,
+                         current->extent->phy_blk, hole_size);
+            }
 
-            if (current->extent->flags != 0 && ctrl.show_flags) {
-                show_extent_flags(current->extent->flags);
+            REP_LIT("EXTID: ");
+            rep_dec(current->extent->ext_nr + 1, -4);
+            REP_LIT("  PBAS: ");
+            rep_hex(current->extent->phy_blk, -10);
+            REP_LIT("  PBAE: ");
+            rep_hex(current->extent->phy_blk + current->extent->len, -10);
+            REP_LIT("  SIZE: ");
+            rep_hex(current->extent->len, -10);
+            REP_LIT("\n");
+
+            if (current->extent->flags != 0 && ctrl->show_flags) {
+                rep_extent_flags(current->extent->flags);
             }
 
             /* Hole between PBAE of the extent and the zone LBAE (since WP can
@@ -1003,52 +2080,105 @@ void print_fiemap_report() {
             // TODO: only show hole after extents if  there is another extent
             // (need to track extents per file to know this value) - add once
             // file tracking is implemented
-            if (ctrl.show_holes && current->next == NULL &&
-                pbae != current->extent->zone_lbae &&
-                current->extent->zone_wp > pbae) {
+            if (ctrl->show_holes && current->next == NULL &&
+                pbae != zone_lbae && zone->wp > pbae) {
 
-                if (current->extent->zone_wp < current->extent->zone_lbae) {
-                    hole_end = current->extent->zone_wp;
+                if (zone->wp < zone_lbae) {
+                    hole_end = zone->wp;
                 } else {
-                    hole_end = current->extent->zone_lbae;
+                    hole_end = zone_lbae;
                 }
 
                 hole_size = hole_end - pbae;
-                hole_cum_size += hole_size;
-                hole_ctr++;
-
-                HOLE_FORMATTER;
-                MSG("--- HOLE:    PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                    "  SIZE: %#-10" PRIx64 "\n",
-                    current->extent->phy_blk + current->extent->len, hole_end,
-                    hole_size);
-                HOLE_FORMATTER;
+                count_hole(holes, hole_size);
+
+                rep_hole("--- HOLE:    PBAS: ",
+                         current->extent->phy_blk + current->extent->len,
+                         hole_end, hole_size);
             }
 
             prev = current;
             current = current->next;
         }
     }
+}
+
+static void reduce_hole_stats(void *arg, void *task_arg) {
+    struct hole_stats *holes = (struct hole_stats *)arg;
+    struct hole_stats *task_holes = (struct hole_stats *)task_arg;
+
+    holes->hole_ctr += task_holes->hole_ctr;
+    holes->hole_cum_size += task_holes->hole_cum_size;
+    holes->hole_hist.ctr += task_holes->hole_hist.ctr;
+    for (uint32_t i = 0; i < SIZE_HIST_BUCKETS; i++) {
+        holes->hole_hist.buckets[i] += task_holes->hole_hist.buckets[i];
+    }
+}
+
+/*
+ * Print the report summary of all the extents in the zonemap.
+ * This is used by zns.fiemap and by zns.segmap (for file systems
+ * other than F2FS), therefore it is included in this lib to avoid
+ * code duplication.
+ *
+ * */
+void print_fiemap_report(struct control *ctrl) {
+    struct hole_stats holes;
+    uint32_t hole_ctr = 0;
+    uint64_t hole_cum_size = 0;
+
+    REP_LIT("================================================================="
+            "===\n");
+    REP_LIT("\t\t\tEXTENT MAPPINGS\n");
+    REP_LIT("=============================================================="
+            "======\n");
+
+    memset(&holes, 0, sizeof(struct hole_stats));
+    render_zones(ctrl, render_fiemap_zones, reduce_hole_stats, &holes,
+                       sizeof(struct hole_stats), NULL);
+    hole_ctr = holes.hole_ctr;
+    hole_cum_size = holes.hole_cum_size;
+
+    REP_LIT("\n\n=========================================================="
+            "==========\n");
+    REP_LIT("\t\t\tSTATS SUMMARY\n");
+    REP_LIT("=============================================================="
+            "======\n");
+    REP_LIT("\nNOE: ");
+    rep_dec(ctrl->zonemap->extent_ctr, -4);
+    REP_LIT("  TES: ");
+    rep_hex(ctrl->zonemap->cum_extent_size, -10);
+    REP_LIT("  AES: ");
+    rep_hex(ctrl->zonemap->cum_extent_size / (ctrl->zonemap->extent_ctr), -10);
+    REP_LIT("  EAES: ");
+    rep_double((double)ctrl->zonemap->cum_extent_size /
+                   (double)(ctrl->zonemap->extent_ctr),
+               -10);
+    REP_LIT("  NOZ: ");
+    rep_dec(ctrl->zonemap->zone_ctr, -4);
+    REP_LIT("\n");
+
+    if (ctrl->show_holes && hole_ctr > 0) {
+        REP_LIT("NOH: ");
+        rep_dec(hole_ctr, -4);
+        REP_LIT("  THS: ");
+        rep_hex(hole_cum_size, -10);
+        REP_LIT("  AHS: ");
+        rep_hex(hole_cum_size / hole_ctr, -10);
+        REP_LIT("  EAHS: ");
+        rep_double((double)hole_cum_size / (double)hole_ctr, -10);
+        REP_LIT("\n");
+    } else if (ctrl->show_holes && hole_ctr == 0) {
+        REP_LIT("NOH: 0\n");
+    }
 
-    MSG("\n\n==============================================================="
-        "=====\n");
-    MSG("\t\t\tSTATS SUMMARY\n");
-    MSG("==================================================================="
-        "=\n");
-    MSG("\nNOE: %-4lu  TES: %#-10" PRIx64 "  AES: %#-10" PRIx64 "  EAES: %-10f"
-        "  NOZ: %-4u\n",
-        ctrl.zonemap->extent_ctr, ctrl.zonemap->cum_extent_size,
-        ctrl.zonemap->cum_extent_size / (ctrl.zonemap->extent_ctr),
-        (double)ctrl.zonemap->cum_extent_size /
-            (double)(ctrl.zonemap->extent_ctr),
-        ctrl.zonemap->zone_ctr);
-
-    if (ctrl.show_holes && hole_ctr > 0) {
-        MSG("NOH: %-4u  THS: %#-10" PRIx64 "  AHS: %#-10" PRIx64
-            "  EAHS: %-10f\n",
-            hole_ctr, hole_cum_size, hole_cum_size / hole_ctr,
-            (double)hole_cum_size / (double)hole_ctr);
-    } else if (ctrl.show_holes && hole_ctr == 0) {
-        MSG("NOH: 0\n");
+    /* with holes shown, the histogram has the holes of NOH and THS, which
+     * include the holes at the zone start and before the write pointer */
+    if (ctrl->show_hist && ctrl->show_holes) {
+        print_size_hist(&ctrl->zonemap->extent_hist, &holes.hole_hist);
+    } else if (ctrl->show_hist) {
+        print_size_hist(&ctrl->zonemap->extent_hist, &ctrl->zonemap->hole_hist);
     }
+
+    rep_flush();
 }
@@ -53,43 +53,498 @@ static void show_info() {
  * */
 static void show_help() {
     MSG("Possible flags are:\n");
-    MSG("-f [file]\tInput file to map [Required]\n");
+    MSG("-f [file]\tInput file to map [Required]. Can be repeated, be a glob "
+        "pattern,\n\t\tor - to read the files from stdin, one per line.\n");
     MSG("-h\t\tShow this help\n");
     MSG("-w\t\tShow Extent FLAGS\n");
+    MSG("-g\t\tShow extent and hole size histograms\n");
     MSG("-s\t\tShow file holes\n");
     MSG("-l [Int]\tLog Level to print\n");
+    MSG("-t [uint]\tThreads to render the report with. Default all CPUs.\n");
     MSG("-s\t\tShow file holes\n");
+    MSG("-x [file]\tAnswer from the zonemap index written by zns.segmap -x, "
+        "if the\n\t\tfile and its zones are unchanged.\n");
+    MSG("--lba [addr]\tFind the file holding the address in the zonemap index "
+        "(-x),\n\t\tor of each address read from stdin with -.\n");
+    MSG("--server[=path]\tQuery the extents from zns-toolsd on the socket. "
+        "Default %s\n",
+        ZNS_TOOLSD_SOCKET);
+    MSG("--record [file]\tRecord all device and file system accesses to the "
+        "capture.\n");
+    MSG("--replay [file]\tAnswer all device and file system accesses from "
+        "the capture.\n");
+    MSG("--profile\tPrint the time of each phase, the syscalls, and the "
+        "zonemap\n\t\tmemory to stderr.\n");
 
     show_info();
     exit(0);
 }
 
+/*
+ * Find a file in a zonemap index written by zns.segmap, if its indexed extents
+ * are current.
+ *
+ * @index: zonemap index opened with bin_index_open()
+ * @filename: file to find
+ * @stats: stat() of the file
+ *
+ * returns: index of the file, BIN_INDEX_NO_FILE if the index does not hold
+ * the file or is stale
+ *
+ * */
+static uint32_t find_fresh_file(struct control *ctrl, struct bin_index *index,
+                                char *filename, struct stat *stats) {
+    uint32_t file;
+    char *path;
+
+    path = realpath(filename, NULL);
+    if (!path) {
+        return BIN_INDEX_NO_FILE;
+    }
+
+    file = bin_index_find_file(index, path);
+    if (file == BIN_INDEX_NO_FILE) {
+        INFO(1, "%s is not in the index\n", path);
+    } else if (!bin_index_file_is_fresh(ctrl, index, file, stats)) {
+        INFO(1, "Index is stale for %s\n", path);
+        file = BIN_INDEX_NO_FILE;
+    }
+
+    free(path);
+
+    return file;
+}
+
+/*
+ * Find the files of the batch that are answered from the index, and sync all
+ * other files. The zones are reported again once after all syncs, instead of
+ * once for each stale file. Freshness is decided before any sync, as a sync
+ * moves the write pointers the index is checked against.
+ *
+ * @batch: batch to set the index_files of
+ * @index: zonemap index opened with bin_index_open()
+ * @first: first file of the batch that can be opened
+ *
+ * */
+static void check_batch_index(struct control *ctrl, struct fiemap_batch *batch,
+                              struct bin_index *index, uint32_t first) {
+    struct stat stats;
+    uint32_t nr_stale = 0;
+    int fd;
+
+    batch->index_files = malloc(sizeof(uint32_t) * batch->nr_files);
+    if (!batch->index_files) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (uint32_t i = 0; i < batch->nr_files; i++) {
+        batch->index_files[i] = BIN_INDEX_NO_FILE;
+        if (i < first) {
+            continue;
+        }
+
+        /* files that fail here also fail, with a warning, in map_batch_file */
+        fd = backend_open(batch->files[i]);
+        if (fd < 0) {
+            continue;
+        }
+
+        if (backend_fstat(fd, batch->files[i], &stats) == 0) {
+            batch->index_files[i] =
+                find_fresh_file(ctrl, index, batch->files[i], &stats);
+            if (batch->index_files[i] == BIN_INDEX_NO_FILE) {
+                sync_file(fd);
+                nr_stale++;
+            }
+        }
+
+        close(fd);
+    }
+
+    if (nr_stale > 0 && update_zone_map(ctrl) == EXIT_FAILURE) {
+        ERR_MSG("Failed updating the zone information\n");
+    }
+}
+
+/*
+ * Add a file to the files of the batch
+ *
+ * @path: path of the file, copied
+ *
+ * */
+static void add_batch_file(struct fiemap_batch *batch, const char *path) {
+    char **files;
+
+    if (batch->nr_files == batch->files_size) {
+        batch->files_size = batch->files_size ? batch->files_size * 2 : 16;
+        files = realloc(batch->files, sizeof(char *) * batch->files_size);
+        if (!files) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        batch->files = files;
+    }
+
+    batch->files[batch->nr_files] = strdup(path);
+    if (!batch->files[batch->nr_files]) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    batch->nr_files++;
+}
+
+/*
+ * Add the files of a -f argument to the batch
+ *
+ * @arg: a file, a glob pattern, or - to read files from stdin (one per line)
+ *
+ * */
+static void add_batch_files(struct fiemap_batch *batch, const char *arg) {
+    glob_t matches;
+    char *line = NULL;
+    size_t len = 0;
+    ssize_t read;
+    int ret;
+
+    if (strcmp(arg, "-") == 0) {
+        while ((read = getline(&line, &len, stdin)) != -1) {
+            if (read > 0 && line[read - 1] == '\n') {
+                line[read - 1] = '\0';
+            }
+            if (line[0] != '\0') {
+                add_batch_file(batch, line);
+            }
+        }
+        free(line);
+    } else if (strpbrk(arg, "*?[")) {
+        ret = glob(arg, 0, NULL, &matches);
+        if (ret == GLOB_NOMATCH) {
+            WARN("No files match %s\n", arg);
+        } else if (ret != 0) {
+            ERR_MSG("Failed expanding %s\n", arg);
+        }
+
+        for (size_t i = 0; i < matches.gl_pathc; i++) {
+            add_batch_file(batch, matches.gl_pathv[i]);
+        }
+        globfree(&matches);
+    } else {
+        add_batch_file(batch, arg);
+    }
+}
+
+/*
+ * Sync all files of the batch, before init_ctrl() reports the zones, such that
+ * the reported write pointers already include the synced data of all files.
+ *
+ * */
+static void sync_batch_files(struct fiemap_batch *batch) {
+    int fd;
+
+    for (uint32_t i = 0; i < batch->nr_files; i++) {
+        fd = backend_open(batch->files[i]);
+        if (fd < 0) {
+            continue;
+        }
+
+        sync_file(fd);
+        close(fd);
+    }
+}
+
+static void merge_size_hist(struct size_hist *dst, struct size_hist *src) {
+    dst->ctr += src->ctr;
+    for (uint8_t i = 0; i < SIZE_HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+/*
+ * Map a file of the batch into the (empty) zonemap, print its report, and add
+ * it to the statistics of the batch.
+ *
+ * @batch: batch the file is in
+ * @index: zonemap index to answer from, or NULL
+ * @i: number of the file in the batch
+ * @dev: st_dev of the file system of the batch
+ *
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE if the file could not be mapped
+ *
+ * */
+static int map_batch_file(struct control *ctrl, struct fiemap_batch *batch,
+                          struct bin_index *index, uint32_t i, dev_t dev) {
+    char *filename = batch->files[i];
+    struct stat stats;
+    uint64_t start;
+    int fd, ret = EXIT_SUCCESS;
+
+    fd = backend_open(filename);
+    if (fd < 0) {
+        WARN("Failed opening fd on %s.\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    if (backend_fstat(fd, filename, &stats) < 0) {
+        WARN("Failed stat on file %s\n", filename);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    if (stats.st_dev != dev) {
+        WARN("%s is not on the file system of %s, skipping it\n", filename,
+             batch->files[0]);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    /* stale files were synced, and the zones reported again, by
+     * check_batch_index() */
+    if (index && batch->index_files[i] != BIN_INDEX_NO_FILE) {
+        ret = bin_index_load_file(ctrl, index, batch->index_files[i],
+                                  filename);
+        INFO(1, "Loaded the extents of %s from the index\n", filename);
+    } else {
+        ret = get_extents(ctrl, filename, fd, &stats);
+    }
+
+    close(fd);
+
+    if (ret == EXIT_FAILURE) {
+        WARN("Failed retrieving extents for %s\n", filename);
+        clear_file_extents(ctrl);
+        return EXIT_FAILURE;
+    } else if (ctrl->zonemap->extent_ctr == 0) {
+        WARN("No extents found for %s\n", filename);
+        clear_file_extents(ctrl);
+        return EXIT_FAILURE;
+    }
+
+    if (batch->nr_files > 1) {
+        REP_LIT("\nFILE: ");
+        rep_str(filename, 0);
+        REP_LIT("\n");
+    }
+    start = profile_start();
+    print_fiemap_report(ctrl);
+    profile_stop(PROFILE_PRINT, start);
+
+    batch->mapped_ctr++;
+    batch->extent_ctr += ctrl->zonemap->extent_ctr;
+    batch->cum_extent_size += ctrl->zonemap->cum_extent_size;
+    merge_size_hist(&batch->extent_hist, &ctrl->zonemap->extent_hist);
+    merge_size_hist(&batch->hole_hist, &ctrl->zonemap->hole_hist);
+    for (uint32_t i = 0; i < (ctrl->zonemap->nr_zones + 7) >> 3; i++) {
+        batch->zones[i] |= ctrl->file_zones[i];
+    }
+
+    clear_file_extents(ctrl);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Print the statistics over all files of the batch
+ *
+ * */
+static void print_batch_summary(struct control *ctrl,
+                                struct fiemap_batch *batch) {
+    uint32_t zone_ctr = 0;
+
+    for (uint32_t i = 0; i < (ctrl->zonemap->nr_zones + 7) >> 3; i++) {
+        zone_ctr += __builtin_popcount(batch->zones[i]);
+    }
+
+    REP_LIT("\n\n=========================================================="
+            "==========\n");
+    REP_LIT("\t\t\tBATCH SUMMARY\n");
+    REP_LIT("=============================================================="
+            "======\n");
+    REP_LIT("\nFILES: ");
+    rep_dec(batch->mapped_ctr, 0);
+    REP_LIT("/");
+    rep_dec(batch->nr_files, -4);
+    REP_LIT("  NOE: ");
+    rep_dec(batch->extent_ctr, -4);
+    REP_LIT("  TES: ");
+    rep_hex(batch->cum_extent_size, -10);
+    REP_LIT("  AES: ");
+    rep_hex(batch->cum_extent_size / batch->extent_ctr, -10);
+    REP_LIT("  EAES: ");
+    rep_double((double)batch->cum_extent_size / (double)batch->extent_ctr,
+               -10);
+    REP_LIT("  NOZ: ");
+    rep_dec(zone_ctr, -4);
+    REP_LIT("\n");
+
+    if (ctrl->show_hist) {
+        print_size_hist(&batch->extent_hist, &batch->hole_hist);
+    }
+
+    rep_flush();
+}
+
+static const char *const seg_type_names[] = {
+    [CURSEG_HOT_DATA] = "CURSEG_HOT_DATA",
+    [CURSEG_WARM_DATA] = "CURSEG_WARM_DATA",
+    [CURSEG_COLD_DATA] = "CURSEG_COLD_DATA",
+    [CURSEG_HOT_NODE] = "CURSEG_HOT_NODE",
+    [CURSEG_WARM_NODE] = "CURSEG_WARM_NODE",
+    [CURSEG_COLD_NODE] = "CURSEG_COLD_NODE",
+};
+
+/*
+ * Print the file holding an address, as a single line
+ *
+ * @index: zonemap index to search
+ * @arg: address (decimal, or hexadecimal with 0x)
+ *
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE if no file holds the address
+ *
+ * */
+static int lookup_lba(struct bin_index *index, char *arg) {
+    struct bin_index_lba result;
+    uint64_t lba;
+    char *end;
+
+    arg[strcspn(arg, "\n")] = '\0';
+    lba = strtoull(arg, &end, 0);
+    if (end == arg || *end != '\0') {
+        rep_flush();
+        WARN("Invalid address %s\n", arg);
+        return EXIT_FAILURE;
+    }
+
+    REP_LIT("LBA: ");
+    rep_hex(lba, -10);
+
+    if (bin_index_find_lba(index, lba, &result) == EXIT_FAILURE) {
+        REP_LIT("  FILE: -\n");
+        return EXIT_FAILURE;
+    }
+
+    REP_LIT("  EXTID: ");
+    rep_dec(result.ext_nr + 1, 0);
+    REP_LIT("/");
+    rep_dec(result.nr_extents, -5);
+    REP_LIT("  LOGICAL: ");
+    rep_hex(result.logical_blk, -10);
+    REP_LIT("  TYPE: ");
+    if (result.seg_type <= CURSEG_COLD_NODE) {
+        rep_str(seg_type_names[result.seg_type], -16);
+    } else {
+        rep_str("-", -16);
+    }
+    REP_LIT("  FILE: ");
+    rep_str(result.path, 0);
+    REP_LIT("\n");
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Find the files holding addresses in the zonemap index, for a single address
+ * or each line of stdin (e.g., LBAs of a trace). Only the index is used, such
+ * that it can also be resolved without the devices.
+ *
+ * @index_file: path of the zonemap index
+ * @lba: address, or - to read addresses from stdin
+ *
+ * returns: EXIT_SUCCESS, or EXIT_FAILURE if a single address is not found
+ *
+ * */
+static int lookup_lbas(struct control *ctrl, char *index_file, char *lba) {
+    struct bin_index *index;
+    char *line = NULL;
+    size_t len = 0;
+    int ret = EXIT_SUCCESS;
+
+    index = bin_index_open(ctrl, index_file, NULL);
+    if (!index) {
+        ERR_MSG("Failed opening zonemap index %s\n", index_file);
+    }
+
+    if (strcmp(lba, "-") != 0) {
+        ret = lookup_lba(index, lba);
+    } else {
+        while (getline(&line, &len, stdin) != -1) {
+            if (line[0] != '\n') {
+                lookup_lba(index, line);
+            }
+        }
+        free(line);
+    }
+
+    rep_flush();
+    bin_index_close(index);
+
+    return ret;
+}
+
+static const struct option long_options[] = {
+    {"server", optional_argument, NULL, 'S'},
+    {"lba", required_argument, NULL, 'L'},
+    {"record", required_argument, NULL, 'R'},
+    {"replay", required_argument, NULL, 'P'},
+    {"profile", no_argument, NULL, 'F'},
+    {NULL, 0, NULL, 0}};
+
 int main(int argc, char *argv[]) {
-    struct stat *stats;
-    int c, ret = 0;
-    uint8_t set_file = 0;
-    char *filename;
+    struct control *ctrl;
+    struct fiemap_batch batch;
+    struct bin_index *index = NULL;
+    struct stat stats;
+    int c, ret = EXIT_SUCCESS;
+    char *path;
+    char *server = NULL;
+    char *index_file = NULL;
+    char *lba = NULL;
+    char *record = NULL, *replay = NULL;
+    char query[SERVER_MAX_QUERY];
+    uint32_t first;
     int fd = 0;
 
-    memset(&ctrl, 0, sizeof(struct control));
+    ctrl = alloc_ctrl();
+    memset(&batch, 0, sizeof(struct fiemap_batch));
 
-    while ((c = getopt(argc, argv, "f:hil:sw")) != -1) {
+    while ((c = getopt_long(argc, argv, "f:ghil:swt:x:", long_options, NULL)) !=
+           -1) {
         switch (c) {
         case 'h':
             show_help();
             break;
         case 'f':
-            filename = optarg;
-            set_file = 1;
+            add_batch_files(&batch, optarg);
             break;
         case 'w':
-            ctrl.show_flags = 1;
+            ctrl->show_flags = 1;
+            break;
+        case 'g':
+            ctrl->show_hist = 1;
             break;
         case 'l':
-            ctrl.log_level = atoi(optarg);
+            ctrl->log_level = atoi(optarg);
             break;
         case 's':
-            ctrl.show_holes = 1;
+            ctrl->show_holes = 1;
+            break;
+        case 't':
+            ctrl->nr_threads = atoi(optarg);
+            break;
+        case 'x':
+            index_file = optarg;
+            break;
+        case 'S':
+            server = optarg ? optarg : ZNS_TOOLSD_SOCKET;
+            break;
+        case 'R':
+            record = optarg;
+            break;
+        case 'P':
+            replay = optarg;
+            break;
+        case 'F':
+            profile_init();
+            break;
+        case 'L':
+            lba = optarg;
             break;
         default:
             show_help();
@@ -97,40 +552,128 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    if (!set_file) {
+    /* reverse lookups only need the index, not the file or the devices */
+    if (lba) {
+        if (!index_file) {
+            ERR_MSG("--lba requires the zonemap index -x\n");
+        }
+
+        ret = lookup_lbas(ctrl, index_file, lba);
+        cleanup_ctrl(ctrl);
+
+        return ret;
+    }
+
+    if (batch.nr_files == 0) {
         MSG("Missing file option\n");
         show_help();
     }
 
-    fd = open(filename, O_RDONLY);
-    if (fd < 0) {
-        ERR_MSG("Failed opening fd on %s.\n", filename);
-        return EXIT_FAILURE;
+    /* the daemon keeps the mapping, files are identified by their path */
+    if (server) {
+        for (uint32_t i = 0; i < batch.nr_files; i++) {
+            path = realpath(batch.files[i], NULL);
+            if (!path) {
+                WARN("Failed resolving path of %s\n", batch.files[i]);
+                ret = EXIT_FAILURE;
+                continue;
+            }
+
+            snprintf(query, sizeof(query), "extents %s", path);
+            if (server_query(server, query) == EXIT_FAILURE) {
+                ret = EXIT_FAILURE;
+            }
+
+            free(path);
+        }
+
+        goto cleanup;
     }
 
-    fsync(fd);
+    if (record && replay) {
+        ERR_MSG("--record cannot be used with --replay\n");
+    } else if (record &&
+               backend_init(BACKEND_RECORD, record) == EXIT_FAILURE) {
+        ERR_MSG("Failed creating capture %s\n", record);
+    } else if (replay &&
+               backend_init(BACKEND_REPLAY, replay) == EXIT_FAILURE) {
+        ERR_MSG("Failed loading capture %s\n", replay);
+    }
 
-    stats = calloc(1, sizeof(struct stat));
-    if (fstat(fd, stats) < 0) {
-        ERR_MSG("Failed stat on file %s\n", filename);
+    /* the index holds the extents after zns.segmap synced the files, a sync
+     * here would only be needed if it is stale */
+    if (!index_file) {
+        sync_batch_files(&batch);
     }
 
-    init_ctrl(filename, fd, stats);
+    /* the device setup and zone reports are shared by all files, the first
+     * file that can be opened identifies the file system */
+    for (first = 0; first < batch.nr_files; first++) {
+        fd = backend_open(batch.files[first]);
+        if (fd >= 0) {
+            break;
+        }
+        WARN("Failed opening fd on %s.\n", batch.files[first]);
+    }
 
-    ret = get_extents(filename, fd, stats);
+    if (first == batch.nr_files) {
+        ERR_MSG("Failed opening any file to map\n");
+    }
 
-    if (ret == EXIT_FAILURE) {
-        ERR_MSG("retrieving extents for %s\n", filename);
-    } else if (ctrl.zonemap->extent_ctr == 0) {
-        ERR_MSG("No extents found on device\n");
+    if (backend_fstat(fd, batch.files[first], &stats) < 0) {
+        ERR_MSG("Failed stat on file %s\n", batch.files[first]);
     }
 
+    init_ctrl(ctrl, batch.files[first], fd, &stats);
     close(fd);
 
-    print_fiemap_report();
+    if (index_file) {
+        index = bin_index_open(ctrl, index_file, NULL);
+        if (!index) {
+            INFO(1, "Failed opening zonemap index %s\n", index_file);
+
+            /* the files were not synced for the index */
+            sync_batch_files(&batch);
+            if (update_zone_map(ctrl) == EXIT_FAILURE) {
+                ERR_MSG("Failed updating the zone information\n");
+            }
+        } else {
+            check_batch_index(ctrl, &batch, index, first);
+        }
+    }
 
-    cleanup_ctrl();
-    free(stats);
+    batch.zones = calloc((ctrl->zonemap->nr_zones + 7) >> 3, sizeof(uint8_t));
+    if (!batch.zones) {
+        ERR_MSG("Failed memory allocation\n");
+    }
 
-    return EXIT_SUCCESS;
+    for (uint32_t i = first; i < batch.nr_files; i++) {
+        map_batch_file(ctrl, &batch, index, i, stats.st_dev);
+    }
+
+    if (batch.mapped_ctr == 0) {
+        ERR_MSG("No extents found on device\n");
+    } else if (batch.nr_files > 1) {
+        print_batch_summary(ctrl, &batch);
+    }
+
+    if (batch.mapped_ctr < batch.nr_files) {
+        ret = EXIT_FAILURE;
+    }
+
+    if (index) {
+        bin_index_close(index);
+    }
+    free(batch.zones);
+    free(batch.index_files);
+
+cleanup:
+    profile_report();
+    for (uint32_t i = 0; i < batch.nr_files; i++) {
+        free(batch.files[i]);
+    }
+    free(batch.files);
+    cleanup_ctrl(ctrl);
+
+    return ret;
 }
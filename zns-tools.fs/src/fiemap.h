@@ -1,7 +1,31 @@
 #ifndef _FIEMAP_H_
 #define _FIEMAP_H_
 
+#include "bindump.h"
 #include "json.h"
+#include "server.h"
 #include "zns-tools.h"
 
+#include <getopt.h>
+#include <glob.h>
+
+/*
+ * Files to map in a single run and the statistics over all of them. The files
+ * share the device setup and zone reports of one init_ctrl(), and are mapped
+ * one at a time into the zonemap.
+ *
+ * */
+struct fiemap_batch {
+    char **files;                 /* paths of the files to map */
+    uint32_t nr_files;            /* number of paths in files */
+    uint32_t files_size;          /* allocated entries of files */
+    uint32_t mapped_ctr;          /* number of files with extents */
+    uint64_t extent_ctr;          /* number of extents of all files */
+    uint64_t cum_extent_size;     /* size of all extents in 512B sectors */
+    uint8_t *zones;               /* bitmap of zones with extents of any file */
+    uint32_t *index_files;        /* file in the index, or BIN_INDEX_NO_FILE */
+    struct size_hist extent_hist; /* sizes of the extents of all files */
+    struct size_hist hole_hist;   /* sizes of the holes of all files */
+};
+
 #endif
@@ -17,6 +17,7 @@ static void show_help() {
 }
 
 int main(int argc, char *argv[]) {
+    struct control *ctrl;
     struct stat *stats;
     char *filename;
     int fd = 0;
@@ -25,6 +26,11 @@ int main(int argc, char *argv[]) {
     struct f2fs_nat_entry *nat_entry = NULL;
     struct f2fs_node *node_block = NULL;
     struct f2fs_inode *inode = NULL;
+    struct f2fs_sb_info *sbi;
+    struct bdev *dev;
+    uint64_t node_addr;
+
+    ctrl = alloc_ctrl();
 
     while ((c = getopt(argc, argv, "cf:hl:s")) != -1) {
         switch (c) {
@@ -36,13 +42,13 @@ int main(int argc, char *argv[]) {
             show_help();
             break;
         case 'l':
-            ctrl.log_level = atoi(optarg);
+            ctrl->log_level = atoi(optarg);
             break;
         case 's':
-            ctrl.show_superblock = 1;
+            ctrl->show_superblock = 1;
             break;
         case 'c':
-            ctrl.show_checkpoint = 1;
+            ctrl->show_checkpoint = 1;
             break;
         default:
             show_help();
@@ -69,20 +75,21 @@ int main(int argc, char *argv[]) {
         ERR_MSG("Failed stat on file %s\n", filename);
     }
 
-    init_ctrl(filename, fd, stats);
+    init_ctrl(ctrl, filename, fd, stats);
+    sbi = ctrl->fs_super_block;
 
-    if (ctrl.show_superblock) {
-        f2fs_show_super_block();
+    if (ctrl->show_superblock) {
+        f2fs_show_super_block(sbi);
     }
 
     INFO(1, "ZNS address space in F2FS starting at: %#10" PRIx64 "\n",
-         ctrl.offset);
+         ctrl->znsdev[0].offset);
     INFO(1, "F2FS main area starting at: %#10" PRIx64 "\n",
-         (uint64_t)f2fs_sb.main_blkaddr << F2FS_BLKSIZE_BITS);
+         (uint64_t)sbi->sb.main_blkaddr << F2FS_BLKSIZE_BITS);
 
-    if (ctrl.show_checkpoint) {
-        f2fs_read_checkpoint(ctrl.bdev.dev_path);
-        f2fs_show_checkpoint();
+    if (ctrl->show_checkpoint) {
+        f2fs_read_checkpoint(sbi, ctrl->bdev.dev_path);
+        f2fs_show_checkpoint(sbi);
     }
 
     INFO(1, "File %s has inode number %lu\n", filename, stats->st_ino);
@@ -97,7 +104,8 @@ int main(int argc, char *argv[]) {
             free(node_block);
         }
 
-        nat_entry = f2fs_get_inode_nat_entry(ctrl.bdev.dev_path, stats->st_ino);
+        nat_entry =
+            f2fs_get_inode_nat_entry(sbi, ctrl->bdev.dev_path, stats->st_ino);
 
         // nat_entry is NULL -> no block address found for the inode
         if (!nat_entry) {
@@ -105,8 +113,17 @@ int main(int argc, char *argv[]) {
                     stats->st_ino);
         }
 
-        node_block =
-            f2fs_get_node_block(ctrl.znsdev.dev_path, nat_entry->block_addr);
+        /* node blocks can be on any of the devices, which hold the F2FS
+         * address space back to back */
+        node_addr = (uint64_t)nat_entry->block_addr << F2FS_BLKSIZE_BITS;
+        dev = get_fs_dev(ctrl, node_addr);
+        if (!dev) {
+            ERR_MSG("block address %#" PRIx32 " is past the last device\n",
+                    nat_entry->block_addr);
+        }
+
+        node_block = f2fs_get_node_block(
+            dev->dev_path, (node_addr - dev->offset) >> F2FS_BLKSIZE_BITS);
         memcpy(inode, &node_block->i, sizeof(struct f2fs_inode));
 
     } while (!IS_INODE(node_block));
@@ -118,11 +135,12 @@ int main(int argc, char *argv[]) {
         "=\n");
 
     uint64_t lba =
-        nat_entry->block_addr << F2FS_BLKSIZE_BITS >> ctrl.sector_shift;
-    uint32_t zone_number = get_zone_number(lba);
+        nat_entry->block_addr << F2FS_BLKSIZE_BITS >> ctrl->sector_shift;
+    uint32_t zone_number = get_zone_number(ctrl, lba);
     MSG("\nFile %s with inode %u is located in zone %u\n", filename,
         nat_entry->ino, zone_number);
-    print_zone_info(zone_number);
+    print_zone_info(ctrl, zone_number);
+    rep_flush();
 
     MSG("\n***** INODE:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
         "  SIZE: %#-10" PRIx64 "  FILE: %s\n",
@@ -139,7 +157,7 @@ int main(int argc, char *argv[]) {
 
     f2fs_show_inode_info(inode);
 
-    cleanup_ctrl();
+    cleanup_ctrl(ctrl);
 
     free(nat_entry);
     free(node_block);
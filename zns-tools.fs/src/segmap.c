@@ -44,12 +44,31 @@ static void show_help() {
     MSG("-i\t\tResolve inlined file data in inodes\n");
     MSG("-p\t\tResolve segment information from procfs\n");
     MSG("-w\t\tShow extent flags\n");
+    MSG("-g\t\tShow extent and hole size histograms\n");
     MSG("-s [uint]\tSet the starting zone to map. Default zone 1.\n");
     MSG("-z [uint]\tOnly show this single zone\n");
     MSG("-e [uint]\tSet the ending zone to map. Default last zone.\n");
     MSG("-c\t\tShow segment statistics (requires -p to be enabled).\n");
     MSG("-o\t\tShow only segment statistics (automatically enables -s).\n");
     MSG("-n\t\tDon't show holes between extents (only for Btrfs).\n");
+    MSG("-b [file]\tDump the zonemap in binary column format to file.\n");
+    MSG("-t [uint]\tThreads to render the report with. Default all CPUs.\n");
+    MSG("-k [key]\tSort the per file statistics by extents, runs, runsize,\n"
+        "\t\tseek, or zones (most fragmented first).\n");
+    MSG("-x [file]\tZonemap index of the dir. Answer from it if the zones and "
+        "files\n\t\tare unchanged, else map the dir and write it.\n");
+    MSG("--server[=path]\tQuery zns-toolsd on the socket for the files in the "
+        "-z zone,\n\t\tor its statistics. Default %s\n",
+        ZNS_TOOLSD_SOCKET);
+    MSG("--shm[=name]\tShow the zonemap summary published by zns-toolsd -m, "
+        "for\n\t\tthe -z zone or all zones with extents. Default %s\n",
+        ZNS_SHM_NAME);
+    MSG("--record [file]\tRecord all device and file system accesses to the "
+        "capture.\n");
+    MSG("--replay [file]\tAnswer all device and file system accesses from "
+        "the capture.\n");
+    MSG("--profile\tPrint the time of each phase, the syscalls, and the "
+        "zonemap\n\t\tmemory to stderr (and the json info with -j).\n");
 
     show_info();
     exit(0);
@@ -62,14 +81,18 @@ static void show_help() {
  *
  *
  * */
-static void check_dir_init_ctrl() {
+static void check_dir_init_ctrl(struct control *ctrl) {
+    struct f2fs_sb_info *sbi;
     struct stat *stats;
+    int fd;
 
     stats = calloc(1, sizeof(struct stat));
 
-    if (stat(segmap_man.dir, stats) < 0) {
+    fd = backend_open(segmap_man.dir);
+    if (fd < 0 || backend_fstat(fd, segmap_man.dir, stats) < 0) {
         ERR_MSG("Failed stat on dir %s\n", segmap_man.dir);
     }
+    close(fd);
 
     if (S_ISDIR(stats->st_mode)) {
         segmap_man.isdir = 1;
@@ -78,86 +101,164 @@ static void check_dir_init_ctrl() {
         INFO(1, "%s is a file\n", segmap_man.dir);
     }
 
-    set_fs_magic(segmap_man.dir);
+    set_fs_magic(ctrl, segmap_man.dir);
 
-    if (ctrl.fs_magic == F2FS_MAGIC) {
-        init_dev(stats);
+    if (ctrl->fs_magic == F2FS_MAGIC) {
+        init_dev(ctrl, stats);
 
-        f2fs_read_super_block(ctrl.bdev.dev_path);
-        set_super_block_info(f2fs_sb);
+        sbi = f2fs_read_super_block(ctrl->bdev.dev_path);
+        ctrl->fs_super_block = sbi;
+        set_super_block_info(ctrl, &sbi->sb);
 
-        ctrl.multi_dev = 1;
-        ctrl.offset = get_dev_size(ctrl.bdev.dev_path);
-        ctrl.znsdev.zone_size = get_zone_size();
-        ctrl.znsdev.zone_mask = ~(ctrl.znsdev.zone_size - 1);
-        ctrl.znsdev.nr_zones = get_nr_zones();
-        ctrl.fs_manager = f2fs_fs_manager_init(ctrl.bdev.dev_name);
-        ctrl.fs_manager_cleanup =
-            (fs_manager_cleanup)f2fs_fs_manager_cleanup(ctrl.bdev.dev_name);
-        ctrl.fs_info_init = (fs_info_init)f2fs_fs_info_init();
-        ctrl.fs_info_show = (fs_info_show)f2fs_fs_info_show();
-        ctrl.fs_info_bytes = get_fs_info_bytes();
-        ctrl.fs_info_cleanup = (fs_info_cleanup)f2fs_fs_info_cleanup();
-    } else if (ctrl.fs_magic == BTRFS_MAGIC) {
+        ctrl->multi_dev = 1;
+        ctrl->fs_manager_cleanup =
+            (fs_manager_cleanup)f2fs_fs_manager_cleanup(ctrl->bdev.dev_name);
+        ctrl->fs_info_init = (fs_info_init)f2fs_fs_info_init();
+        ctrl->fs_info_show = (fs_info_show)f2fs_fs_info_show();
+        ctrl->fs_info_bytes = get_fs_info_bytes();
+        ctrl->fs_info_cleanup = (fs_info_cleanup)f2fs_fs_info_cleanup();
+    } else if (ctrl->fs_magic == BTRFS_MAGIC) {
         WARN("%s is registered as being on Btrfs which can occupy multiple "
              "devices.\nEnter the"
              " associated ZNS device name: ",
              segmap_man.dir);
 
-        int ret = scanf("%s", ctrl.znsdev.dev_name);
+        int ret = scanf("%14s", ctrl->znsdev[0].dev_name);
         if (!ret) {
             ERR_MSG("reading input\n");
         }
 
-        if (init_znsdev() == EXIT_FAILURE) {
-            ERR_MSG("Failed initializing %s\n", ctrl.znsdev.dev_path);
+        if (init_znsdev(ctrl, &ctrl->znsdev[0]) == EXIT_FAILURE) {
+            ERR_MSG("Failed initializing %s\n", ctrl->znsdev[0].dev_path);
         }
 
-        ctrl.multi_dev = 0;
-        ctrl.offset = 0;
-        ctrl.znsdev.zone_size = get_zone_size();
-        ctrl.znsdev.zone_mask = ~(ctrl.znsdev.zone_size - 1);
-        ctrl.znsdev.nr_zones = get_nr_zones();
+        ctrl->multi_dev = 0;
+        ctrl->nr_znsdevs = 1;
+        ctrl->znsdev[0].end = get_dev_size(ctrl->znsdev[0].dev_path);
+        init_zone_map(ctrl);
     }
 
     free(stats);
 }
 
+/*
+ * Keep the stat() of the file that is mapped next, for the zonemap index
+ *
+ * @filename: path of the file
+ * @stats: stat() of the file
+ *
+ * */
+static void add_index_file(struct control *ctrl, char *filename,
+                           struct stat *stats) {
+    struct bin_index_file *files, *file;
+
+    files = realloc(segmap_man.index_files,
+                    sizeof(struct bin_index_file) * (ctrl->nr_files + 1));
+    if (!files) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+    segmap_man.index_files = files;
+
+    /* the index is searched by absolute path */
+    file = &files[ctrl->nr_files];
+    file->path = realpath(filename, NULL);
+    file->ino = stats->st_ino;
+    file->size = stats->st_size;
+    file->mtime =
+        (uint64_t)stats->st_mtim.tv_sec * 1000000000 + stats->st_mtim.tv_nsec;
+}
+
+/*
+ * Add the extents of the files in the mapped zones from the zonemap index,
+ * instead of mapping all files of the directory.
+ *
+ * returns: 1 if the extents were loaded, 0 if the index is missing or stale
+ *
+ * */
+static uint8_t load_index(struct control *ctrl) {
+    struct bin_index *index;
+    int ret;
+
+    if (!segmap_man.isdir) {
+        WARN("The zonemap index is only used for directories\n");
+        return 0;
+    }
+
+    index = bin_index_open(ctrl, segmap_man.index_file, segmap_man.index_dir);
+    if (!index) {
+        return 0;
+    }
+
+    ret = bin_index_load_zones(ctrl, index, ctrl->start_zone - 1,
+                               ctrl->end_zone);
+    bin_index_close(index);
+
+    if (ret == EXIT_FAILURE) {
+        return 0;
+    }
+
+    INFO(1, "Loaded %u files from index %s\n", ctrl->nr_files,
+         segmap_man.index_file);
+
+    return 1;
+}
+
+/*
+ * Write the zonemap index of the mapped directory
+ *
+ * */
+static void write_index(struct control *ctrl) {
+    /* write pointers are the ones after the mapping (see main()), the index
+     * would be stale already with the ones before it */
+    if (bin_dump_index(ctrl, segmap_man.index_file, segmap_man.index_dir,
+                       segmap_man.index_files) == EXIT_FAILURE) {
+        WARN("Failed writing index %s\n", segmap_man.index_file);
+    } else {
+        INFO(1, "Wrote index %s\n", segmap_man.index_file);
+    }
+
+    for (uint32_t i = 0; i < ctrl->nr_files; i++) {
+        free(segmap_man.index_files[i].path);
+    }
+    free(segmap_man.index_files);
+}
+
 /*
  * Collect extents recursively from the path
  *
  * @path: char * to path to recursively check
  *
  * */
-static void collect_extents(char *path) {
+static void collect_extents(struct control *ctrl, char *path) {
     struct stat *stats; /* statistics from fstat() call */
-    struct dirent *dir;
+    char *entries, *entry, *name;
     char *sub_path = NULL;
-    size_t len = 0;
+    size_t len = 0, entries_len = 0;
     int ret = 0;
     char *filename = NULL;
     int fd = 0;
+    uint64_t start = profile_start();
 
-    DIR *directory = opendir(path);
-
-    if (!directory) {
+    if (backend_read_dir(path, &entries, &entries_len) == EXIT_FAILURE) {
         ERR_MSG("Failed opening dir %s\n", path);
     }
+    profile_stop(PROFILE_DIR_WALK, start);
 
-    while ((dir = readdir(directory)) != NULL) {
-        if (dir->d_type != DT_DIR) {
+    for (entry = entries; entry < entries + entries_len;
+         entry = BACKEND_DIRENT_NEXT(entry)) {
+        name = BACKEND_DIRENT_NAME(entry);
+
+        if (BACKEND_DIRENT_TYPE(entry) != DT_DIR) {
             // TODO: we want to pass the name not set a global field
             filename = NULL; // NULL so we can realloc
-            filename =
-                realloc(filename, strlen(path) + strlen(dir->d_name) + 2);
-            sprintf(filename, "%s/%s", path, dir->d_name);
+            filename = realloc(filename, strlen(path) + strlen(name) + 2);
+            sprintf(filename, "%s/%s", path, name);
 
-            fd = open(filename, O_RDONLY);
-            fsync(fd);
+            fd = backend_open(filename);
 
             if (fd < 0) {
                 // The file could have been deleted in the meantime.
-                if (access(filename, F_OK) != 0) {
+                if (errno == ENOENT) {
                     INFO(1, "File no longer exists: %s", filename);
                     continue;
                 } else {
@@ -165,17 +266,23 @@ static void collect_extents(char *path) {
                 }
             }
 
+            sync_file(fd);
+
             stats = calloc(1, sizeof(struct stat));
 
-            if (fstat(fd, stats) < 0) {
+            if (backend_fstat(fd, filename, stats) < 0) {
                 ERR_MSG("Failed stat on file %s\n", filename);
             }
 
-            ret = get_extents(filename, fd, stats);
+            if (segmap_man.index_file) {
+                add_index_file(ctrl, filename, stats);
+            }
+
+            ret = get_extents(ctrl, filename, fd, stats);
 
             if (ret == EXIT_FAILURE) {
                 ERR_MSG("retrieving extents for %s\n", filename);
-            } else if (ctrl.zonemap->extent_ctr == 0) {
+            } else if (ctrl->zonemap->extent_ctr == 0) {
                 ERR_MSG("No extents found on device\n");
             }
 
@@ -200,13 +307,13 @@ static void collect_extents(char *path) {
 
             close(fd);
             free(stats);
-        } else if (dir->d_type == DT_DIR && strcmp(dir->d_name, ".") != 0 &&
-                   strcmp(dir->d_name, "..") != 0) {
-            len = strlen(path) + strlen(dir->d_name) + 2;
+        } else {
+            /* "." and ".." are not in the entries */
+            len = strlen(path) + strlen(name) + 2;
             sub_path = realloc(sub_path, len);
 
-            snprintf(sub_path, len, "%s/%s/", path, dir->d_name);
-            collect_extents(sub_path);
+            snprintf(sub_path, len, "%s/%s/", path, name);
+            collect_extents(ctrl, sub_path);
         }
     }
 
@@ -215,28 +322,66 @@ static void collect_extents(char *path) {
     }
 
     free(sub_path);
-    closedir(directory);
+    free(entries);
 }
 
-static void show_segment_info(struct extent *extent, uint64_t segment_start) {
-    if (ctrl.cur_segment != segment_start) {
-        REP_UNDERSCORE
-        REP_FORMATTER
-        REP(ctrl.show_only_stats,
-            "SEGMENT: %-4lu  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-            "  SIZE: %#-10" PRIx64 "\n",
-            segment_start, segment_start << ctrl.segment_shift,
-            ((segment_start << ctrl.segment_shift) + ctrl.f2fs_segment_sectors),
-            ctrl.f2fs_segment_sectors);
-
-        // TODO: still need the procfs flag? any fs can enable and show here
-        // what it want, a bit iffy with the other functions that purely map to
-        // segments ...
-        ctrl.fs_info_show(extent->fs_info, ctrl.show_only_stats,
-                          ctrl.sector_shift);
-
-        REP_FORMATTER
-        ctrl.cur_segment = segment_start;
+/*
+ * Print a single extent line of the segment report
+ *
+ * @pbas: starting address of the (part of the) extent
+ * @pbae: ending address of the (part of the) extent
+ * @size: size of the (part of the) extent
+ * @extent: the extent to print the file and extent number for
+ *
+ * */
+static void show_extent(struct control *ctrl, uint64_t pbas, uint64_t pbae,
+                        uint64_t size, struct extent *extent) {
+    if (ctrl->show_only_stats) {
+        return;
+    }
+
+    REP_LIT("***** EXTENT:  PBAS: ");
+    rep_hex(pbas, -10);
+    REP_LIT("  PBAE: ");
+    rep_hex(pbae, -10);
+    REP_LIT("  SIZE: ");
+    rep_hex(size, -10);
+    REP_LIT("  FILE: ");
+    rep_str(extent->file, 50);
+    REP_LIT("  EXTID:  ");
+    rep_dec(extent->ext_nr + 1, 0);
+    REP_LIT("/");
+    rep_dec(get_extent_file_counter(ctrl, extent)->ext_ctr, -5);
+    REP_LIT("\n");
+}
+
+static void show_segment_info(struct control *ctrl, struct segment_render *sr,
+                              struct extent *extent, uint64_t segment_start) {
+    if (sr->cur_segment != segment_start) {
+        if (!ctrl->show_only_stats) {
+            REP_UNDERSCORE
+            REP_FORMATTER
+            REP_LIT("SEGMENT: ");
+            rep_dec(segment_start, -4);
+            REP_LIT("  PBAS: ");
+            rep_hex(segment_start << ctrl->segment_shift, -10);
+            REP_LIT("  PBAE: ");
+            rep_hex((segment_start << ctrl->segment_shift) +
+                         ctrl->f2fs_segment_sectors,
+                     -10);
+            REP_LIT("  SIZE: ");
+            rep_hex(ctrl->f2fs_segment_sectors, -10);
+            REP_LIT("\n");
+
+            // TODO: still need the procfs flag? any fs can enable and show
+            // here what it want, a bit iffy with the other functions that
+            // purely map to segments ...
+            ctrl->fs_info_show(extent->fs_info, ctrl->show_only_stats,
+                               ctrl->sector_shift);
+
+            REP_FORMATTER
+        }
+        sr->cur_segment = segment_start;
     }
 }
 
@@ -247,95 +392,192 @@ static void show_segment_info(struct extent *extent, uint64_t segment_start) {
  * Note, this function is only called if the extent occupies multiple segments,
  * which is only possible if the extent goes from somewhere in the segment until
  * the end of this segment, and continues in the next segment (which is printed
- * by any of the other functions, show_consecutive_segments() or
+ * by any of the other functions, show_consecutive_segments(ctrl) or
  * show_remainder_segment())
  *
  * */
-static void show_beginning_segment(struct extent *extent) {
-    uint64_t segment_start = (extent->phy_blk & ctrl.f2fs_segment_mask);
-    uint64_t segment_end = segment_start + (ctrl.f2fs_segment_sectors);
-
-    REP(ctrl.show_only_stats,
-        "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-        "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-        extent->phy_blk, segment_end, segment_end - extent->phy_blk,
-        extent->file, extent->ext_nr + 1, get_file_extent_count(extent->file));
+static void show_beginning_segment(struct control *ctrl,
+                                   struct extent *extent) {
+    uint64_t segment_start = (extent->phy_blk & ctrl->f2fs_segment_mask);
+    uint64_t segment_end = segment_start + (ctrl->f2fs_segment_sectors);
+
+    show_extent(ctrl, extent->phy_blk, segment_end,
+                segment_end - extent->phy_blk, extent);
 }
 
 /*
- * Get the index in segmap_man.fs for the filename
  *
- * @filename: filename to get index of
+ * Show consecutive segment ranges that the extent occupies.
+ * This only shows fully utilized segments, which contain only that extent.
+ * In the case where the extent occupies a full segment and part of the next
+ * segment, we show it as a regular segment, not a range, and the remainder in
+ * the next segment is shown by show_remainder_segment().
  *
- * Note, creates a new fs entry if the file entry does not exits yet.
- * segmap_man.ctr indicates the number of initialized entries.
+ * TODO docs
  *
  * */
-static unsigned int get_file_stats_index(char *filename) {
-    uint32_t i = 0;
+static void show_consecutive_segments(struct control *ctrl,
+                                      struct segment_render *sr,
+                                      struct extent *extent,
+                                      uint64_t segment_start) {
+    uint64_t segment_end =
+        ((extent->phy_blk + extent->len) & ctrl->f2fs_segment_mask) >>
+        ctrl->segment_shift;
+    uint64_t num_segments = segment_end - segment_start;
+
+    if (num_segments == 1) {
+        /* The extent starts exactly at the segment beginning and ends somewhere
+         * in the next segment then we just want to show the 1st segment (2nd
+         * segment will be printed in the function after this) */
+        show_segment_info(ctrl, sr, extent, segment_start);
+        show_extent(ctrl, segment_start, segment_end << ctrl->segment_shift,
+                          ctrl->f2fs_segment_sectors, extent);
+    } else {
+        if (!ctrl->show_only_stats) {
+            REP_UNDERSCORE
+            REP_FORMATTER
+            REP_LIT(">>>>> SEGMENT RANGE: ");
+            rep_dec(segment_start, -4);
+            REP_LIT("-");
+            rep_dec(segment_end - 1, -4);
+            REP_LIT("   PBAS: ");
+            rep_hex(segment_start << ctrl->segment_shift, -10);
+            REP_LIT("  PBAE: ");
+            rep_hex(segment_end << ctrl->segment_shift, -10);
+            REP_LIT("  SIZE: ");
+            rep_hex(num_segments * ctrl->f2fs_segment_sectors, -10);
+            REP_LIT("\n");
+        }
+
+        // Since segments are in the same zone, they must be of the same type
+        // therefore, we can just print the flags of the first one, and since
+        // they are contiguous ranges, they cannot have invalid blocks
+        // (otherwise it would be broken into multiple extents), for which the
+        // function will print 512 4KiB blocks (all 4KiB blocks in a segment)
+        // anyways
+        show_segment_info(ctrl, sr, extent, segment_start);
 
-    for (i = 0; i < segmap_man.ctr; i++) {
-        if (strncmp(segmap_man.fs[i].filename, filename, MAX_FILE_LENGTH) ==
-            0) {
-            return i;
+        if (!ctrl->show_only_stats) {
+            REP_FORMATTER
         }
+        show_extent(ctrl, segment_start << ctrl->segment_shift,
+                          segment_end << ctrl->segment_shift,
+                          num_segments * ctrl->f2fs_segment_sectors, extent);
     }
+}
+
+/*
+ *
+ * Shows the remainder of an extent in the last segment it occupies.
+ *
+ * */
+static void show_remainder_segment(struct control *ctrl,
+                                   struct segment_render *sr,
+                                   struct extent *extent) {
+    uint64_t segment_start =
+        ((extent->phy_blk + extent->len) & ctrl->f2fs_segment_mask) >>
+        ctrl->segment_shift;
+    uint64_t remainder =
+        extent->phy_blk + extent->len - (segment_start << ctrl->segment_shift);
+
+    show_segment_info(ctrl, sr, extent, segment_start);
+    show_extent(ctrl, segment_start << ctrl->segment_shift,
+                (segment_start << ctrl->segment_shift) + remainder, remainder,
+                      extent);
+}
+
+/*
+ * Count the segments and zones a file occupies, and the heat classification of
+ * the segments. Segments and zones are only counted for the first extent of the
+ * file in them, which relies on the extents being visited in sorted order.
+ *
+ * @fc: file counter of the file the extent belongs to
+ * @extent: extent to count
+ * @segment_id: segment the extent starts in
+ * @num_segments: number of segments the extent spans
+ *
+ * */
+static void count_file_segments(struct control *ctrl, struct file_counter *fc,
+                                struct extent *extent, uint64_t segment_id,
+                                uint64_t num_segments) {
+    struct segment_info *seg_i = (struct segment_info *)extent->fs_info;
+    uint32_t zone;
 
-    segmap_man.fs[i].filename = calloc(1, MAX_FILE_LENGTH);
-    memcpy(segmap_man.fs[i].filename, filename, MAX_FILE_LENGTH);
-    segmap_man.ctr++;
+    if (fc->last_segment_id != segment_id) {
+        fc->segment_ctr += num_segments;
+        fc->last_segment_id = segment_id;
 
-    return i;
+        switch (seg_i ? seg_i->type : NO_CHECK_TYPE) {
+        case CURSEG_COLD_DATA:
+            fc->cold_ctr += num_segments;
+            break;
+        case CURSEG_WARM_DATA:
+            fc->warm_ctr += num_segments;
+            break;
+        case CURSEG_HOT_DATA:
+            fc->hot_ctr += num_segments;
+            break;
+        default:
+            break;
+        }
+    }
+
+    zone = get_zone_number(ctrl, segment_id << ctrl->segment_shift >>
+                                 ctrl->zns_sector_shift);
+    if (fc->last_zone != zone) {
+        fc->zone_ctr += (num_segments * F2FS_SEGMENT_BYTES >>
+                         ctrl->sector_shift) /
+                            ctrl->zonemap->zones[extent->zone].capacity +
+                        1;
+        fc->last_zone = zone;
+    }
 }
 
 /*
- * Track information for the workload, counting the types of segments the
- * file is split up into. This function retrieves the segment type of the
- * provided segment id and increases counters.
+ * Count the segments of the directory, and their heat classification. Each
+ * occupied segment is only counted once, even if it holds multiple extents.
  *
- * @segment_id: id of the segment to retrieve the type for
- * @num_segments: the number of segments to increase the counters by. Typically
- * 1, but for segment ranges this options allows different values.
+ * @extent: extent to count
+ * @segment_id: segment the extent starts in
  *
  * */
-static void set_segment_counters(uint32_t num_segments, struct extent *extent) {
-    uint32_t fs_stats_index = 0;
+static void count_dir_segments(struct control *ctrl, struct extent *extent,
+                               uint64_t segment_id) {
     struct segment_info *seg_i = (struct segment_info *)extent->fs_info;
-    enum type type = seg_i->type;
+    uint64_t last_segment = segment_id;
+    uint64_t num_segments;
 
     if (extent->flags & FIEMAP_EXTENT_DATA_INLINE &&
-        !(ctrl.exclude_flags & FIEMAP_EXTENT_DATA_INLINE))
+        !(ctrl->exclude_flags & FIEMAP_EXTENT_DATA_INLINE)) {
         return;
+    }
 
-    segmap_man.segment_ctr += num_segments;
+    if (extent->len > 0) {
+        last_segment = ((extent->phy_blk + extent->len - 1) &
+                        ctrl->f2fs_segment_mask) >>
+                       ctrl->segment_shift;
+    }
 
-    if (ctrl.show_class_stats && ctrl.nr_files > 1) {
-        fs_stats_index = get_file_stats_index(extent->file);
-        segmap_man.fs[fs_stats_index].segment_ctr += num_segments;
-        if (segmap_man.fs[fs_stats_index].last_zone != extent->zone) {
-            segmap_man.fs[fs_stats_index].last_zone = extent->zone;
-            segmap_man.fs[fs_stats_index].zone_ctr++;
+    if (segmap_man.segment_ctr > 0 && segmap_man.last_segment >= segment_id) {
+        if (segmap_man.last_segment >= last_segment) {
+            return;
         }
+        segment_id = segmap_man.last_segment + 1;
     }
 
-    switch (type) {
+    num_segments = last_segment - segment_id + 1;
+    segmap_man.segment_ctr += num_segments;
+    segmap_man.last_segment = last_segment;
+
+    switch (seg_i ? seg_i->type : NO_CHECK_TYPE) {
     case CURSEG_COLD_DATA:
         segmap_man.cold_ctr += num_segments;
-        if (ctrl.show_class_stats && ctrl.nr_files > 1) {
-            segmap_man.fs[fs_stats_index].cold_ctr += num_segments;
-        }
         break;
     case CURSEG_WARM_DATA:
         segmap_man.warm_ctr += num_segments;
-        if (ctrl.show_class_stats && ctrl.nr_files > 1) {
-            segmap_man.fs[fs_stats_index].warm_ctr += num_segments;
-        }
         break;
     case CURSEG_HOT_DATA:
         segmap_man.hot_ctr += num_segments;
-        if (ctrl.show_class_stats && ctrl.nr_files > 1) {
-            segmap_man.fs[fs_stats_index].hot_ctr += num_segments;
-        }
         break;
     default:
         break;
@@ -343,103 +585,228 @@ static void set_segment_counters(uint32_t num_segments, struct extent *extent) {
 }
 
 /*
+ * Aggregate the segment statistics of the mapped zones in a single pass over
+ * the extents, without rendering any of the segment mappings.
  *
- * Show consecutive segment ranges that the extent occupies.
- * This only shows fully utilized segments, which contain only that extent.
- * In the case where the extent occupies a full segment and part of the next
- * segment, we show it as a regular segment, not a range, and the remainder in
- * the next segment is shown by show_remainder_segment().
+ * */
+static void aggregate_segment_stats(struct control *ctrl) {
+    struct node *current;
+    uint8_t zone_counted;
+    uint64_t segment_id, num_segments, pbae;
+    uint64_t start_lba = ctrl->start_zone * ctrl->znsdev[0].zone_size -
+                         ctrl->znsdev[0].zone_size;
+    uint64_t end_lba = (ctrl->end_zone + 1) * ctrl->znsdev[0].zone_size -
+                       ctrl->znsdev[0].zone_size;
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        current = ctrl->zonemap->zones[i].extents_head;
+        zone_counted = 0;
+
+        while (current) {
+            segment_id = (current->extent->phy_blk & ctrl->f2fs_segment_mask) >>
+                         ctrl->segment_shift;
+            if ((segment_id << ctrl->segment_shift) >= end_lba) {
+                break;
+            }
+
+            if ((segment_id << ctrl->segment_shift) >= start_lba) {
+                if (!zone_counted) {
+                    segmap_man.zone_ctr++;
+                    zone_counted = 1;
+                }
+
+                /* Can be zero if file starts and ends in same segment,
+                 * therefore + 1 for current segment */
+                pbae = current->extent->phy_blk + current->extent->len;
+                num_segments =
+                    ((pbae & ctrl->f2fs_segment_mask) >> ctrl->segment_shift) -
+                    segment_id + 1;
+
+                count_file_segments(
+                    ctrl, get_extent_file_counter(ctrl, current->extent),
+                    current->extent, segment_id, num_segments);
+                count_dir_segments(ctrl, current->extent, segment_id);
+            }
+
+            current = current->next;
+        }
+    }
+}
+
+/*
+ * Get the average run size of a file, files without runs are sorted last.
  *
- * TODO docs
+ * */
+static uint64_t get_avg_run_size(struct file_counter *fc) {
+    return fc->frag_runs ? fc->frag_size / fc->frag_runs : UINT64_MAX;
+}
+
+/*
+ * Compare two struct file_counter * for qsort() by segmap_man.sort_key. Ties
+ * keep the order in which files were mapped.
  *
  * */
-static void show_consecutive_segments(struct extent *extent,
-                                      uint64_t segment_start) {
-    uint64_t segment_end =
-        ((extent->phy_blk + extent->len) & ctrl.f2fs_segment_mask) >>
-        ctrl.segment_shift;
-    uint64_t num_segments = segment_end - segment_start;
+static int compare_file_counters(const void *a, const void *b) {
+    struct file_counter *fc_a = *(struct file_counter *const *)a;
+    struct file_counter *fc_b = *(struct file_counter *const *)b;
+    uint64_t val_a = 0, val_b = 0;
+
+    switch (segmap_man.sort_key) {
+    case SORT_EXTENTS:
+        val_a = fc_b->ext_ctr;
+        val_b = fc_a->ext_ctr;
+        break;
+    case SORT_RUNS:
+        val_a = fc_b->frag_runs;
+        val_b = fc_a->frag_runs;
+        break;
+    case SORT_RUN_SIZE:
+        val_a = get_avg_run_size(fc_a);
+        val_b = get_avg_run_size(fc_b);
+        break;
+    case SORT_SEEK:
+        val_a = fc_b->frag_seek_dist;
+        val_b = fc_a->frag_seek_dist;
+        break;
+    case SORT_ZONES:
+        val_a = fc_b->frag_zone_ctr;
+        val_b = fc_a->frag_zone_ctr;
+        break;
+    }
 
-    // TODO: we don't need ctrl.procfs anymore, it will be resolved if exists,
-    // otherwise not
-    if (ctrl.show_class_stats && ctrl.procfs) {
-        /* num_segments + 1 because the ending segment is included, but we only
-         * use its starting LBA */
-        set_segment_counters(num_segments + 1, extent);
+    if (val_a != val_b) {
+        return val_a < val_b ? -1 : 1;
     }
 
-    if (num_segments == 1) {
-        /* The extent starts exactly at the segment beginning and ends somewhere
-         * in the next segment then we just want to show the 1st segment (2nd
-         * segment will be printed in the function after this) */
-        show_segment_info(extent, segment_start);
-        REP(ctrl.show_only_stats,
-            "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-            "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-            segment_start, segment_end << ctrl.segment_shift,
-            (unsigned long)ctrl.f2fs_segment_sectors, extent->file,
-            extent->ext_nr + 1, get_file_extent_count(extent->file));
-    } else {
-        REP_UNDERSCORE
-        REP_FORMATTER
-        REP(ctrl.show_only_stats,
-            ">>>>> SEGMENT RANGE: %-4lu-%-4lu   PBAS: %#-10" PRIx64
-            "  PBAE: %#-10" PRIx64 "  SIZE: %#-10" PRIx64 "\n",
-            segment_start, segment_end - 1, segment_start << ctrl.segment_shift,
-            segment_end << ctrl.segment_shift,
-            num_segments * ctrl.f2fs_segment_sectors);
+    return fc_a < fc_b ? -1 : fc_a > fc_b;
+}
 
-        // Since segments are in the same zone, they must be of the same type
-        // therefore, we can just print the flags of the first one, and since
-        // they are contiguous ranges, they cannot have invalid blocks
-        // (otherwise it would be broken into multiple extents), for which the
-        // function will print 512 4KiB blocks (all 4KiB blocks in a segment)
-        // anyways
-        show_segment_info(extent, segment_start);
+/*
+ * Get the order in which to show the per file statistics
+ *
+ * returns: struct file_counter ** array of the file_counter_map entries, to be
+ * freed by the caller
+ *
+ * */
+static struct file_counter **get_file_counter_order(struct control *ctrl) {
+    struct file_counter **order;
+    uint64_t start;
+
+    order = malloc(sizeof(struct file_counter *) *
+                   (ctrl->file_counter_map->file_ctr + 1));
+    if (order == NULL) {
+        ERR_MSG("Failed memory allocation\n");
+    }
 
-        REP_FORMATTER
-        REP(ctrl.show_only_stats,
-            "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-            "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-            segment_start << ctrl.segment_shift,
-            segment_end << ctrl.segment_shift,
-            num_segments * ctrl.f2fs_segment_sectors, extent->file,
-            extent->ext_nr + 1, get_file_extent_count(extent->file));
+    for (uint32_t i = 0; i < ctrl->file_counter_map->file_ctr; i++) {
+        order[i] = &ctrl->file_counter_map->files[i];
     }
+
+    if (segmap_man.sort_key != SORT_NONE) {
+        start = profile_start();
+        qsort(order, ctrl->file_counter_map->file_ctr,
+              sizeof(struct file_counter *), compare_file_counters);
+        profile_stop(PROFILE_SORT, start);
+    }
+
+    return order;
 }
 
 /*
+ * Parse the -k argument
  *
- * Shows the remainder of an extent in the last segment it occupies.
+ * returns: enum segmap_sort_key
  *
  * */
-static void show_remainder_segment(struct extent *extent) {
-    uint64_t segment_start =
-        ((extent->phy_blk + extent->len) & ctrl.f2fs_segment_mask) >>
-        ctrl.segment_shift;
-    uint64_t remainder =
-        extent->phy_blk + extent->len - (segment_start << ctrl.segment_shift);
-
-    show_segment_info(extent, segment_start);
-    REP(ctrl.show_only_stats,
-        "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-        "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-        segment_start << ctrl.segment_shift,
-        (segment_start << ctrl.segment_shift) + remainder, remainder,
-        extent->file, extent->ext_nr + 1, get_file_extent_count(extent->file));
+static uint8_t parse_sort_key(char *key) {
+    if (strcmp(key, "extents") == 0) {
+        return SORT_EXTENTS;
+    } else if (strcmp(key, "runs") == 0) {
+        return SORT_RUNS;
+    } else if (strcmp(key, "runsize") == 0) {
+        return SORT_RUN_SIZE;
+    } else if (strcmp(key, "seek") == 0) {
+        return SORT_SEEK;
+    } else if (strcmp(key, "zones") == 0) {
+        return SORT_ZONES;
+    }
+
+    ERR_MSG("Invalid sort key %s, must be one of extents, runs, runsize, seek, "
+            "zones\n",
+            key);
+    return SORT_NONE;
+}
+
+/*
+ * Show the fragmentation of the files, as collected in get_extents(). Contrary
+ * to the segment statistics, these are over all extents of the files and do
+ * not depend on the mapped zone range.
+ *
+ * @order: order of the file_counter_map entries to show
+ *
+ * */
+static void show_fragmentation_stats(struct control *ctrl,
+                                     struct file_counter **order) {
+    struct file_counter *fc;
+    uint64_t runs = 0, size = 0, seek_dist = 0;
+    uint32_t zones = 0;
+
+    for (uint32_t i = 0; i < ctrl->file_counter_map->file_ctr; i++) {
+        fc = &ctrl->file_counter_map->files[i];
+        runs += fc->frag_runs;
+        size += fc->frag_size;
+        seek_dist += fc->frag_seek_dist;
+    }
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        if (ctrl->zonemap->zones[i].extent_ctr > 0) {
+            zones++;
+        }
+    }
+
+    EQUAL_FORMATTER
+    MSG("\t\t\tFRAGMENTATION STATS");
+    EQUAL_FORMATTER
+
+    FORMATTER
+    MSG("%-50s | Number of Extents | Physical Runs | Avg Run Size | Seek "
+        "Distance    | Distinct Zones\n",
+        "Dir/File Name");
+    FORMATTER
+
+    MSG("%-50s | %-17lu | %-13lu | %-12lu | %-16lu | %-14u\n", segmap_man.dir,
+        ctrl->zonemap->extent_ctr, runs, runs ? size / runs : 0, seek_dist,
+        zones);
+
+    if (segmap_man.isdir && ctrl->nr_files > 1) {
+        UNDERSCORE_FORMATTER
+        FORMATTER
+        for (uint32_t i = 0; i < ctrl->file_counter_map->file_ctr; i++) {
+            fc = order[i];
+            MSG("%-50s | %-17u | %-13u | %-12lu | %-16lu | %-14u\n", fc->file,
+                fc->ext_ctr, fc->frag_runs,
+                fc->frag_runs ? fc->frag_size / fc->frag_runs : 0,
+                fc->frag_seek_dist, fc->frag_zone_ctr);
+        }
+    }
 }
 
 /*
  * Show the segment statistics report
  *
  * */
-static void show_segment_stats() {
-    REP(ctrl.show_only_stats, "\n\n");
+static void show_segment_stats(struct control *ctrl) {
+    struct file_counter **order, *fc;
+
+    if (!ctrl->show_only_stats) {
+        REP_LIT("\n\n");
+    }
+    rep_flush();
     EQUAL_FORMATTER
     MSG("\t\t\tSEGMENT STATS");
     EQUAL_FORMATTER
 
-    if (!(ctrl.exclude_flags & FIEMAP_EXTENT_DATA_INLINE)) {
+    if (!(ctrl->exclude_flags & FIEMAP_EXTENT_DATA_INLINE)) {
         WARN("Segment Heat Classification statistics exclude inode inlined "
              "file data, and is only for segments of type DATA, not "
              "NODE.\n");
@@ -452,132 +819,117 @@ static void show_segment_stats() {
         "Dir/File Name");
     FORMATTER
 
-    /* MSG("%-50s | %-17u | %-28u | %-25u | %-13u | %-13u | %-13u\n", */
-    /*     segmap_man.dir, glob_extent_map->ext_ctr, segmap_man.segment_ctr, */
-    /*     glob_extent_map->zone_ctr, segmap_man.cold_ctr, segmap_man.warm_ctr,
-     */
-    /*     segmap_man.hot_ctr); */
+    MSG("%-50s | %-17lu | %-28u | %-25u | %-13u | %-13u | %-13u\n",
+        segmap_man.dir, ctrl->zonemap->extent_ctr, segmap_man.segment_ctr,
+        segmap_man.zone_ctr, segmap_man.cold_ctr, segmap_man.warm_ctr,
+        segmap_man.hot_ctr);
 
-    if (ctrl.inlined_extent_ctr > 0 &&
-        !(ctrl.exclude_flags & FIEMAP_EXTENT_DATA_INLINE)) {
+    if (ctrl->inlined_extent_ctr > 0 &&
+        !(ctrl->exclude_flags & FIEMAP_EXTENT_DATA_INLINE)) {
         FORMATTER
         MSG("%-50s | %-17lu | %-28s | %-25s | %-13s | %-13s | %-13s\n",
-            "FIEMAP_EXTENT_DATA_INLINE", ctrl.inlined_extent_ctr, "-", "-", "-",
-            "-", "-");
+            "FIEMAP_EXTENT_DATA_INLINE", ctrl->inlined_extent_ctr, "-", "-",
+            "-", "-", "-");
     }
 
+    order = get_file_counter_order(ctrl);
+
     // TODO: show summary for a single file
     // Show the per file statistics of directory if has more than 1 file
-    if (segmap_man.isdir && ctrl.nr_files > 1) {
+    if (segmap_man.isdir && ctrl->nr_files > 1) {
         UNDERSCORE_FORMATTER
         FORMATTER
-        for (uint32_t i = 0; i < ctrl.file_counter_map->file_ctr; i++) {
+        for (uint32_t i = 0; i < ctrl->file_counter_map->file_ctr; i++) {
+            fc = order[i];
             MSG("%-50s | %-17u | %-28u | %-25u | %-13u | %-13u | %-13u\n",
-                ctrl.file_counter_map->files[i].file,
-                ctrl.file_counter_map->files[i].ext_ctr,
-                ctrl.file_counter_map->files[i].segment_ctr,
-                ctrl.file_counter_map->files[i].zone_ctr,
-                ctrl.file_counter_map->files[i].cold_ctr,
-                ctrl.file_counter_map->files[i].warm_ctr,
-                ctrl.file_counter_map->files[i].hot_ctr);
+                fc->file, fc->ext_ctr, fc->segment_ctr, fc->zone_ctr,
+                fc->cold_ctr, fc->warm_ctr, fc->hot_ctr);
         }
     }
+
+    show_fragmentation_stats(ctrl, order);
+    free(order);
+
+    if (ctrl->show_hist) {
+        print_size_hist(&ctrl->zonemap->extent_hist, &ctrl->zonemap->hole_hist);
+        rep_flush();
+    }
 }
 
 /*
- * Print the segment report from the global extent map
+ * Render the segment mappings of a range of zones, see render_zones()
+ *
+ * @start: first zone to render
+ * @end: zone after the last zone to render
+ * @arg: struct segment_render * to track the shown segment in
  *
  * */
-static void show_segment_report() {
+static void render_segment_zones(struct control *ctrl, uint32_t start,
+                                 uint32_t end, void *arg) {
+    struct segment_render *sr = (struct segment_render *)arg;
     struct node *current;
     uint32_t i = 0;
     uint32_t current_zone = 0;
+    uint8_t zone_shown = 0;
     uint64_t segment_id = 0;
-    uint64_t start_lba =
-        ctrl.start_zone * ctrl.znsdev.zone_size - ctrl.znsdev.zone_size;
-    uint64_t end_lba =
-        (ctrl.end_zone + 1) * ctrl.znsdev.zone_size - ctrl.znsdev.zone_size;
+    uint64_t start_lba = ctrl->start_zone * ctrl->znsdev[0].zone_size -
+                         ctrl->znsdev[0].zone_size;
+    uint64_t end_lba = (ctrl->end_zone + 1) * ctrl->znsdev[0].zone_size -
+                       ctrl->znsdev[0].zone_size;
 
-    if (ctrl.show_class_stats) {
-        segmap_man.fs = calloc(1, sizeof(struct file_stats) * ctrl.nr_files);
-    }
-
-    REP_EQUAL_FORMATTER
-    REP(ctrl.show_only_stats, "\t\t\tSEGMENT MAPPINGS\n");
-    REP_EQUAL_FORMATTER
-
-    for (i = 0; i < ctrl.zonemap->nr_zones; i++) {
-        if (ctrl.zonemap->zones[i].extent_ctr == 0) {
+    for (i = start; i < end; i++) {
+        if (ctrl->zonemap->zones[i].extent_ctr == 0) {
             continue;
         }
 
-        current = ctrl.zonemap->zones[i].extents_head;
+        current = ctrl->zonemap->zones[i].extents_head;
 
         while (current) {
-            segment_id = (current->extent->phy_blk & ctrl.f2fs_segment_mask) >>
-                         ctrl.segment_shift;
-            if ((segment_id << ctrl.segment_shift) >= end_lba) {
+            segment_id = (current->extent->phy_blk & ctrl->f2fs_segment_mask) >>
+                         ctrl->segment_shift;
+            if ((segment_id << ctrl->segment_shift) >= end_lba) {
                 break;
             }
 
-            if ((segment_id << ctrl.segment_shift) < start_lba) {
+            if ((segment_id << ctrl->segment_shift) < start_lba) {
+                current = current->next;
                 continue;
             }
 
-            if (current_zone != current->extent->zone) {
-                if (current_zone != 0) {
+            if (!zone_shown || current_zone != current->extent->zone) {
+                /* zones of prior ranges are separated by render_zones() */
+                if (zone_shown && !ctrl->show_only_stats) {
                     REP_FORMATTER
                 }
 
                 current_zone = current->extent->zone;
-                if (!ctrl.show_only_stats) {
-                    print_zone_info(current_zone);
+                zone_shown = 1;
+                if (!ctrl->show_only_stats) {
+                    rep_zone_info(ctrl, current_zone);
+                    if (ctrl->show_hist) {
+                        print_zone_size_hist(ctrl, current_zone);
+                    }
                 }
             }
 
             uint64_t segment_start =
-                (current->extent->phy_blk & ctrl.f2fs_segment_mask);
+                (current->extent->phy_blk & ctrl->f2fs_segment_mask);
             uint64_t extent_end =
                 current->extent->phy_blk + current->extent->len;
-            uint64_t segment_end =
-                ((current->extent->phy_blk + current->extent->len) &
-                 ctrl.f2fs_segment_mask) >>
-                ctrl.segment_shift;
-
-            /* Can be zero if file starts and ends in same segment therefore + 1
-             * for current segment */
-            uint64_t num_segments =
-                segment_end - (segment_start >> ctrl.segment_shift) + 1;
-
-            /* Extent can only be a single file so add all segments we have here
-             */
-            /* if (ctrl.procfs) { */
-            increase_file_segment_counter(current->extent->file, num_segments,
-                                          segment_id, current->extent->fs_info,
-                                          current->extent->zone_cap);
-            /* } */
 
             /* if the beginning of the extent and the ending of the extent are
              * in the same segment */
-            if (segment_start == (extent_end & ctrl.f2fs_segment_mask) ||
+            if (segment_start == (extent_end & ctrl->f2fs_segment_mask) ||
                 extent_end == (segment_start +
-                               (F2FS_SEGMENT_BYTES >> ctrl.sector_shift))) {
-                if (segment_id != ctrl.cur_segment) {
-                    show_segment_info(current->extent, segment_id);
-                    ctrl.cur_segment = segment_id;
-                    /* if (ctrl.show_class_stats && ctrl.procfs) { */
-                    set_segment_counters(1, current->extent);
-                    /* } */
+                               (F2FS_SEGMENT_BYTES >> ctrl->sector_shift))) {
+                if (segment_id != sr->cur_segment) {
+                    show_segment_info(ctrl, sr, current->extent, segment_id);
+                    sr->cur_segment = segment_id;
                 }
 
-                REP(ctrl.show_only_stats,
-                    "***** EXTENT:  PBAS: %#-10" PRIx64 "  PBAE: %#-10" PRIx64
-                    "  SIZE: %#-10" PRIx64 "  FILE: %50s  EXTID:  %d/%-5d\n",
-                    current->extent->phy_blk,
-                    current->extent->phy_blk + current->extent->len,
-                    current->extent->len, current->extent->file,
-                    current->extent->ext_nr + 1,
-                    get_file_extent_count(current->extent->file));
+                show_extent(ctrl, current->extent->phy_blk,
+                            current->extent->phy_blk + current->extent->len,
+                            current->extent->len, current->extent);
             } else {
                 /* Else the extent spans across multiple segments, so we need to
                  * break it up */
@@ -585,16 +937,14 @@ static void show_segment_report() {
                 /* part 1: the beginning of extent to end of that single segment
                  */
                 if (current->extent->phy_blk != segment_start) {
-                    if (segment_id != ctrl.cur_segment) {
+                    if (segment_id != sr->cur_segment) {
                         uint64_t segment_start = (current->extent->phy_blk &
-                                                  ctrl.f2fs_segment_mask) >>
-                                                 ctrl.segment_shift;
-                        show_segment_info(current->extent, segment_start);
+                                                  ctrl->f2fs_segment_mask) >>
+                                                 ctrl->segment_shift;
+                        show_segment_info(ctrl, sr, current->extent,
+                                          segment_start);
                     }
-                    show_beginning_segment(current->extent);
-                    /* if (ctrl.show_class_stats && ctrl.procfs) { */
-                    set_segment_counters(1, current->extent);
-                    /* } */
+                    show_beginning_segment(ctrl, current->extent);
                     segment_id++;
                 }
 
@@ -603,46 +953,146 @@ static void show_segment_report() {
                  * - checks if there are more than 1 segments after the start */
                 uint64_t segment_end =
                     ((current->extent->phy_blk + current->extent->len) &
-                     ctrl.f2fs_segment_mask);
-                if ((segment_end - segment_start) >> ctrl.segment_shift > 1)
-                    show_consecutive_segments(current->extent, segment_id);
+                     ctrl->f2fs_segment_mask);
+                if ((segment_end - segment_start) >> ctrl->segment_shift > 1)
+                    show_consecutive_segments(ctrl, sr, current->extent,
+                                              segment_id);
 
                 /* part 3: any remaining parts of the last segment, which do not
                  * fill the entire last segment only if the segment actually has
                  * a remaining fragment */
                 if (segment_end !=
                     current->extent->phy_blk + current->extent->len) {
-                    show_remainder_segment(current->extent);
-                    /* if (ctrl.show_class_stats && ctrl.procfs) { */
-                    set_segment_counters(1, current->extent);
-                    /* } */
+                    show_remainder_segment(ctrl, sr, current->extent);
                 }
             }
 
             current = current->next;
         }
     }
+}
 
-    show_segment_stats();
+/*
+ * Print the segment report from the global extent map. With
+ * ctrl->show_only_stats the mappings are not rendered at all, and only the
+ * statistics are aggregated.
+ *
+ * */
+static void show_segment_report(struct control *ctrl) {
+    if (!ctrl->show_only_stats) {
+        REP_EQUAL_FORMATTER
+        REP_LIT("\t\t\tSEGMENT MAPPINGS\n");
+        REP_EQUAL_FORMATTER
+
+        render_zones(ctrl, render_segment_zones, NULL, NULL,
+                           sizeof(struct segment_render), REP_FORMATTER_STR);
+    }
+
+    aggregate_segment_stats(ctrl);
+    show_segment_stats(ctrl);
 }
 
+/*
+ * Show a snapshot of the zonemap summary a collector (zns-toolsd -m) publishes
+ * in shared memory, without a query to the collector.
+ *
+ * @name: name of the POSIX shared memory segment
+ * @zone: index of the zone to show, UINT32_MAX to show all zones with extents
+ *
+ * returns: 0 on Success, 1 if the summary cannot be read
+ *
+ * */
+static int show_shm(const char *name, uint32_t zone) {
+    static const char *const temps[] = {
+        [SHM_TEMP_NONE] = "-",
+        [SHM_TEMP_HOT] = "HOT",
+        [SHM_TEMP_WARM] = "WARM",
+        [SHM_TEMP_COLD] = "COLD",
+    };
+    const struct shm_zonemap *map;
+    struct shm_zonemap *snap;
+    struct shm_zone *z;
+    time_t update_time;
+
+    map = shm_zonemap_open(name);
+    if (!map) {
+        fprintf(stderr, "Failed opening zonemap summary %s: %s\n", name,
+                strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    snap = shm_zonemap_snapshot(map);
+    shm_zonemap_close(map);
+    if (!snap) {
+        fprintf(stderr, "Failed reading zonemap summary %s: %s\n", name,
+                strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (zone != UINT32_MAX && zone >= snap->nr_zones) {
+        fprintf(stderr, "Zone %u is not in the summary of %u zones\n",
+                zone + 1, snap->nr_zones);
+        free(snap);
+        return EXIT_FAILURE;
+    }
+
+    update_time = snap->update_time;
+    MSG("Zonemap summary %s, update %lu at %s", name, snap->nr_updates,
+        ctime(&update_time));
+    MSG("FILES: %u  EXTENTS: %lu  VALID: %lu\n", snap->nr_files,
+        snap->extent_ctr, snap->valid_bytes);
+
+    for (uint32_t i = 0; i < snap->nr_zones; i++) {
+        z = &snap->zones[i];
+        if ((zone != UINT32_MAX && i != zone) ||
+            (zone == UINT32_MAX && z->extent_ctr == 0)) {
+            continue;
+        }
+
+        MSG("ZONE %u  START: %#lx  CAP: %#lx  WP: %#lx  STATE: %#x  VALID: %lu"
+            "  EXTENTS: %u  FILES: %u  TEMP: %s\n",
+            i + 1, z->start, z->capacity, z->wp, z->state, z->valid_bytes,
+            z->extent_ctr, z->file_ctr,
+            z->temp <= SHM_TEMP_COLD ? temps[z->temp] : "-");
+    }
+
+    free(snap);
+
+    return EXIT_SUCCESS;
+}
+
+static const struct option long_options[] = {
+    {"server", optional_argument, NULL, 'S'},
+    {"shm", optional_argument, NULL, 'M'},
+    {"record", required_argument, NULL, 'R'},
+    {"replay", required_argument, NULL, 'P'},
+    {"profile", no_argument, NULL, 'F'},
+    {NULL, 0, NULL, 0}};
+
 int main(int argc, char *argv[]) {
+    struct control *ctrl;
     struct stat *stats;
     char *filename;
     int fd = 0, c = 0;
+    uint64_t start;
     uint8_t ret = 0;
     uint8_t set_zone = 0;
     uint8_t set_dir = 0;
     uint8_t set_zone_end = 0;
     uint8_t set_zone_start = 0;
+    uint8_t from_index = 0;
+    char *server = NULL, *shm = NULL;
+    char *record = NULL, *replay = NULL;
+    char query[SERVER_MAX_QUERY];
 
-    memset(&ctrl, 0, sizeof(struct control));
+    ctrl = alloc_ctrl();
     memset(&segmap_man, 0, sizeof(struct segmap_manager));
-    ctrl.exclude_flags = FIEMAP_EXTENT_DATA_INLINE;
-    ctrl.show_holes = 1; /* holes only apply to Btrfs */
-    ctrl.argv = argv[0];
+    ctrl->exclude_flags = FIEMAP_EXTENT_DATA_INLINE;
+    ctrl->show_holes = 1; /* holes only apply to Btrfs */
+    ctrl->argv = argv[0];
 
-    while ((c = getopt(argc, argv, "d:hil:ws:e:pz:conj:")) != -1) {
+    while ((c = getopt_long(argc, argv, "d:ghil:ws:e:pz:conj:b:t:k:x:",
+                            long_options, NULL)) != -1) {
         switch (c) {
         case 'h':
             show_help();
@@ -652,43 +1102,74 @@ int main(int argc, char *argv[]) {
             set_dir = 1;
             break;
         case 'l':
-            ctrl.log_level = atoi(optarg);
+            ctrl->log_level = atoi(optarg);
             break;
         case 'i':
-            ctrl.exclude_flags = 0;
+            ctrl->exclude_flags = 0;
             break;
         case 'j':
-            ctrl.json_file = optarg;
-            ctrl.json_dump = 1;
+            ctrl->json_file = optarg;
+            ctrl->json_dump = 1;
             break;
         case 'w':
-            ctrl.show_flags = 1;
+            ctrl->show_flags = 1;
+            break;
+        case 'g':
+            ctrl->show_hist = 1;
             break;
         case 's':
-            ctrl.start_zone = atoi(optarg);
+            ctrl->start_zone = atoi(optarg);
             set_zone_start = 1;
             break;
         case 'z':
-            ctrl.start_zone = atoi(optarg);
-            ctrl.end_zone = atoi(optarg);
+            ctrl->start_zone = atoi(optarg);
+            ctrl->end_zone = atoi(optarg);
             set_zone = 1;
             break;
         case 'e':
-            ctrl.end_zone = atoi(optarg);
+            ctrl->end_zone = atoi(optarg);
             set_zone_end = 1;
             break;
         case 'p':
-            ctrl.procfs = 1;
+            ctrl->procfs = 1;
             break;
         case 'c':
-            ctrl.show_class_stats = 1;
+            ctrl->show_class_stats = 1;
             break;
         case 'o':
-            ctrl.show_only_stats = 1;
-            ctrl.show_class_stats = 1;
+            ctrl->show_only_stats = 1;
+            ctrl->show_class_stats = 1;
             break;
         case 'n':
-            ctrl.show_holes = 0;
+            ctrl->show_holes = 0;
+            break;
+        case 'b':
+            ctrl->bin_file = optarg;
+            ctrl->bin_dump = 1;
+            break;
+        case 't':
+            ctrl->nr_threads = atoi(optarg);
+            break;
+        case 'k':
+            segmap_man.sort_key = parse_sort_key(optarg);
+            break;
+        case 'x':
+            segmap_man.index_file = optarg;
+            break;
+        case 'S':
+            server = optarg ? optarg : ZNS_TOOLSD_SOCKET;
+            break;
+        case 'M':
+            shm = optarg ? optarg : ZNS_SHM_NAME;
+            break;
+        case 'R':
+            record = optarg;
+            break;
+        case 'P':
+            replay = optarg;
+            break;
+        case 'F':
+            profile_init();
             break;
         default:
             show_help();
@@ -696,6 +1177,29 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    /* -z counts zones from 1, as the zones of the daemon in reports */
+    if (shm) {
+        ret = show_shm(shm, set_zone ? ctrl->start_zone - 1 : UINT32_MAX);
+        cleanup_ctrl(ctrl);
+
+        return ret;
+    }
+
+    /* the daemon keeps the mapping of its directory, -d is not needed */
+    if (server) {
+        if (set_zone) {
+            /* -z counts zones from 1, the daemon as numbered in reports */
+            snprintf(query, sizeof(query), "zone %u", ctrl->start_zone - 1);
+        } else {
+            snprintf(query, sizeof(query), "stats");
+        }
+
+        ret = server_query(server, query);
+        cleanup_ctrl(ctrl);
+
+        return ret;
+    }
+
     if (!set_dir) {
         ERR_MSG("Missing directory -d flag.\n");
     }
@@ -704,49 +1208,89 @@ int main(int argc, char *argv[]) {
         ERR_MSG("Flag -z cannot be used with -s or -e\n");
     }
 
-    if (ctrl.show_class_stats && !ctrl.procfs) {
-        if (ctrl.show_only_stats) {
+    if (ctrl->show_class_stats && !ctrl->procfs) {
+        if (ctrl->show_only_stats) {
             ERR_MSG("Cannot show stats without -p enabled\n");
         }
 
         WARN("-c requires -p flag to be enabled. Disabling it.\n");
-        ctrl.show_class_stats = 0;
+        ctrl->show_class_stats = 0;
+    }
+
+    if (record && replay) {
+        ERR_MSG("--record cannot be used with --replay\n");
+    } else if (record &&
+               backend_init(BACKEND_RECORD, record) == EXIT_FAILURE) {
+        ERR_MSG("Failed creating capture %s\n", record);
+    } else if (replay &&
+               backend_init(BACKEND_REPLAY, replay) == EXIT_FAILURE) {
+        ERR_MSG("Failed loading capture %s\n", replay);
     }
 
-    check_dir_init_ctrl();
+    check_dir_init_ctrl(ctrl);
 
-    if (ctrl.start_zone == 0 && !set_zone) {
-        ctrl.start_zone = 1;
+    if (ctrl->start_zone == 0 && !set_zone) {
+        ctrl->start_zone = 1;
     }
 
-    if (ctrl.end_zone == 0 && !set_zone) {
-        ctrl.end_zone = ctrl.znsdev.nr_zones;
+    if (ctrl->end_zone == 0 && !set_zone) {
+        ctrl->end_zone = ctrl->zonemap->nr_zones;
     }
 
-    if (segmap_man.isdir) {
-        collect_extents(segmap_man.dir);
-        if (ctrl.zonemap->extent_ctr == 0) {
+    if (segmap_man.index_file) {
+        segmap_man.index_dir = realpath(segmap_man.dir, NULL);
+        from_index = load_index(ctrl);
+    }
+
+    if (ctrl->fs_magic == F2FS_MAGIC && !from_index) {
+        ctrl->fs_manager = f2fs_fs_manager_init(ctrl->fs_super_block,
+                                                ctrl->bdev.dev_name);
+    }
+
+    if (from_index) {
+        if (ctrl->zonemap->extent_ctr == 0) {
+            WARN("No extents found in the mapped zones\n");
+            goto cleanup;
+        }
+    } else if (segmap_man.isdir) {
+        collect_extents(ctrl, segmap_man.dir);
+
+        /* write pointers moved while the files were mapped and synced */
+        if (update_zone_map(ctrl) == EXIT_FAILURE) {
+            ERR_MSG("Failed updating the zone information\n");
+        }
+
+        if (segmap_man.index_file) {
+            write_index(ctrl);
+        }
+        if (ctrl->zonemap->extent_ctr == 0) {
             WARN("No separate extent mappings found for any file.\nFound "
-                 "Inlined inode Extents: %lu\n",
-                 ctrl.inlined_extent_ctr);
+                  "Inlined inode Extents: %lu\n",
+                  ctrl->inlined_extent_ctr);
             goto cleanup;
         }
     } else {
         filename = segmap_man.dir;
-        fd = open(filename, O_RDONLY);
-        fsync(fd);
+        fd = backend_open(filename);
+        sync_file(fd);
+
+        /* extents take the zone info from the zonemap, which must hold the
+         * write pointers after the sync */
+        if (update_zone_map(ctrl) == EXIT_FAILURE) {
+            ERR_MSG("Failed updating the zone information\n");
+        }
 
         stats = calloc(1, sizeof(struct stat));
 
-        if (fstat(fd, stats) < 0) {
+        if (backend_fstat(fd, filename, stats) < 0) {
             ERR_MSG("Failed stat on file %s\n", filename);
         }
 
-        ret = get_extents(filename, fd, stats);
+        ret = get_extents(ctrl, filename, fd, stats);
 
         if (ret == EXIT_FAILURE) {
             ERR_MSG("retrieving extents for %s\n", filename);
-        } else if (ctrl.zonemap->extent_ctr == 0) {
+        } else if (ctrl->zonemap->extent_ctr == 0) {
             ERR_MSG("No extents found on device\n");
         }
 
@@ -755,36 +1299,37 @@ int main(int argc, char *argv[]) {
         free(stats);
     }
 
-    if (ctrl.fs_magic == F2FS_MAGIC) {
-        if (ctrl.json_dump)
-            json_dump_data(ctrl.zonemap);
-        else
-            show_segment_report();
+    if (ctrl->bin_dump && bin_dump_data(ctrl) == EXIT_FAILURE) {
+        ERR_MSG("Failed dumping binary data to %s\n", ctrl->bin_file);
+    }
+
+    if (ctrl->fs_magic == F2FS_MAGIC) {
+        if (ctrl->json_dump) {
+            json_dump_data(ctrl);
+        } else if (!ctrl->bin_dump) {
+            start = profile_start();
+            show_segment_report(ctrl);
+            profile_stop(PROFILE_PRINT, start);
+        }
 
         // TODO: clenaup memory
         /*     free(file_counter_map->file); */
         /*     free(file_counter_map); */
-        /*     if (ctrl.show_class_stats) { */
-        /*         free(segmap_man.fs); */
-        /*         for (uint32_t i = 0; i < segmap_man.ctr; i++) { */
-        /*             free(segmap_man.fs[i].filename); */
-        /*         } */
-        /*     } */
-        /*     /1* if (ctrl.procfs) { *1/ */
+        /*     /1* if (ctrl->procfs) { *1/ */
         /*     /1*     free(segman.sm_info); *1/ */
         /*     /1* } *1/ */
-    } else if (ctrl.fs_magic == BTRFS_MAGIC) {
-        print_fiemap_report(); /* generic report from zns.fiemap */
+    } else if (ctrl->fs_magic == BTRFS_MAGIC && !ctrl->bin_dump) {
+        start = profile_start();
+        print_fiemap_report(ctrl); /* generic report from zns.fiemap */
+        profile_stop(PROFILE_PRINT, start);
     }
 
 cleanup:
+    profile_report();
     // TODO: cleanup the fs info in each extent - in the zonemap cleanup during
     // extent freeing
-    if (ctrl.fs_manager != NULL) {
-        ctrl.fs_manager_cleanup(ctrl.fs_manager);
-    }
-
-    cleanup_ctrl();
+    free(segmap_man.index_dir);
+    cleanup_ctrl(ctrl);
 
     return EXIT_SUCCESS;
 }
@@ -1,35 +1,50 @@
 #ifndef _SEGMAP_H_
 #define _SEGMAP_H_
 
+#include "bindump.h"
 #include "json.h"
+#include "server.h"
+#include "shm.h"
 #include "zns-tools.h"
 
 #include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
 
 /*
- * Per file segment statistics
+ * Keys to sort the per file statistics by, see -k
  *
  * */
-struct file_stats {
-    uint32_t cold_ctr;    /* segment type counter: cold */
-    uint32_t warm_ctr;    /* segment type counter: warm */
-    uint32_t hot_ctr;     /* segment type counter: hot */
-    uint32_t zone_ctr;    /* count zones that contain file data */
-    uint32_t last_zone;   /* track the last zone that was set - avoid double
-                             setting. requires sorted extents */
-    uint32_t segment_ctr; /* per file segment counting */
-    char *filename;       /* full file path that stats are being tracked for */
+enum segmap_sort_key {
+    SORT_NONE = 0, /* order in which files were mapped */
+    SORT_EXTENTS,  /* most extents first */
+    SORT_RUNS,     /* most physically discontiguous runs first */
+    SORT_RUN_SIZE, /* smallest average run size first */
+    SORT_SEEK,     /* largest seek distance first */
+    SORT_ZONES,    /* most distinct zones first */
 };
 
 struct segmap_manager {
     char *dir;             /* Storing the cmd_line arg */
     uint8_t isdir;         /* identify if it is a directory or a file */
     uint32_t segment_ctr;  /* count number of segments occupied by *dir */
+    uint32_t zone_ctr;     /* count number of zones occupied by *dir */
     uint32_t cold_ctr;     /* segment type counter: cold */
     uint32_t warm_ctr;     /* segment type counter: warm */
     uint32_t hot_ctr;      /* segment type counter: hot */
-    struct file_stats *fs; /* file segment stats */
-    uint32_t ctr;          /* number of initialized fs entries */
+    uint64_t last_segment; /* last segment counted in segment_ctr */
+    uint8_t sort_key;      /* enum segmap_sort_key of the per file stats */
+    char *index_file;      /* zonemap index to answer from or to write */
+    char *index_dir;       /* absolute path of dir, identifies the index */
+    struct bin_index_file *index_files; /* stat() of each mapped fileID */
+};
+
+/*
+ * State of rendering a range of zones of the segment report
+ *
+ * */
+struct segment_render {
+    uint64_t cur_segment; /* segment that was shown last */
 };
 
 extern struct segmap_manager segmap_man;
@@ -45,25 +60,27 @@ extern struct extent_map extent_map;
         "____________________________________________________________________" \
         "___\n");
 
+/* REP_ formatters go through the report writer, callers must skip them when
+ * ctrl->show_only_stats is set */
 #define REP_UNDERSCORE                                                         \
-    REP(ctrl.show_only_stats,                                                  \
-        "\n__________________________________________________________________" \
-        "________________________________________________________________"     \
-        "__________\n");
+    REP_LIT("\n______________________________________________________________" \
+            "________________________________________________________________" \
+            "______________\n");
 
-#define REP_FORMATTER                                                          \
-    REP(ctrl.show_only_stats,                                                  \
-        "--------------------------------------------------------------------" \
-        "----------------------------------------------------------------"     \
-        "--------\n");
+#define REP_FORMATTER_STR                                                      \
+    "----------------------------------------------------------------"         \
+    "----------------------------------------------------------------"         \
+    "------------\n"
+
+#define REP_FORMATTER REP_LIT(REP_FORMATTER_STR);
 
 #define EQUAL_FORMATTER                                                        \
     MSG("\n==================================================================" \
         "==\n");
 
 #define REP_EQUAL_FORMATTER                                                    \
-    REP(ctrl.show_only_stats, "==============================================" \
-                              "======================\n");
+    REP_LIT("=============================================="                   \
+            "======================\n");
 
 #define FORMATTER_SHORT                                                        \
     MSG("--------------------------------------------------------------------" \
@@ -0,0 +1,865 @@
+#include "toolsd.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static struct toolsd_manager toolsd_man;
+static volatile sig_atomic_t toolsd_stop;
+
+/*
+ *
+ * Show the command help.
+ *
+ *
+ * */
+static void show_help() {
+    MSG("Possible flags are:\n");
+    MSG("-d [dir]\tDirectory to map and keep in memory [Required]\n");
+    MSG("-s [path]\tUnix socket to listen on. Default %s\n",
+        ZNS_TOOLSD_SOCKET);
+    MSG("-r [uint]\tSeconds between refreshes of the mappings, 0 to only "
+        "refresh on request. Default %u\n",
+        TOOLSD_REFRESH_INTERVAL);
+    MSG("-p\t\tUse the F2FS procfs segment_info for segment types\n");
+    MSG("-m [name]\tPublish a zonemap summary in POSIX shared memory "
+        "(e.g., %s)\n",
+        ZNS_SHM_NAME);
+    MSG("-l [Int]\tLog Level to print\n");
+    MSG("-h\t\tShow this help\n");
+
+    exit(0);
+}
+
+static void toolsd_signal(int sig) {
+    (void)sig;
+    toolsd_stop = 1;
+}
+
+static int compare_file_paths(const void *a, const void *b) {
+    return strcmp(((struct toolsd_file *)a)->path,
+                  ((struct toolsd_file *)b)->path);
+}
+
+/*
+ * Find a file in the sorted part of the file table
+ *
+ * @path: absolute path of the file
+ * @nr_sorted: number of sorted files at the start of the table
+ *
+ * returns: struct toolsd_file * of the file, NULL if it is not mapped
+ *
+ * */
+static struct toolsd_file *find_file(char *path, uint32_t nr_sorted) {
+    struct toolsd_file key = {.path = path};
+
+    return bsearch(&key, toolsd_man.files, nr_sorted,
+                   sizeof(struct toolsd_file), compare_file_paths);
+}
+
+static void set_stale(struct toolsd_scan *scan, uint32_t file_id) {
+    if (file_id == TOOLSD_NO_ID ||
+        scan->stale[file_id >> 3] & (1 << (file_id & 7))) {
+        return;
+    }
+
+    scan->stale[file_id >> 3] |= 1 << (file_id & 7);
+    scan->nr_stale++;
+    toolsd_man.file_paths[file_id] = NULL;
+}
+
+/*
+ * Mark the extents of all files in a zone as stale. Used for zones that were
+ * written or reset since the last refresh (e.g., by F2FS garbage collection),
+ * which moves file data without changing the file.
+ *
+ * @zone: number of the zone
+ *
+ * */
+static void set_zone_stale(struct control *ctrl, struct toolsd_scan *scan,
+                           uint32_t zone) {
+    struct node *current = ctrl->zonemap->zones[zone].extents_head;
+
+    while (current) {
+        set_stale(scan, current->extent->fileID);
+        current = current->next;
+    }
+}
+
+static void add_pending(struct toolsd_scan *scan, uint32_t file,
+                        struct stat *stats) {
+    struct toolsd_pending *pending;
+
+    if (scan->nr_pending == scan->pending_size) {
+        scan->pending_size = scan->pending_size ? scan->pending_size * 2 : 64;
+        pending = realloc(scan->pending,
+                          sizeof(struct toolsd_pending) * scan->pending_size);
+        if (!pending) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        scan->pending = pending;
+    }
+
+    scan->pending[scan->nr_pending].file = file;
+    scan->pending[scan->nr_pending].stats = *stats;
+    scan->nr_pending++;
+}
+
+/*
+ * Check a file found in the scan against the file table. New files are added
+ * to the table, new and changed files are queued for mapping, and the extents
+ * of changed files are marked as stale.
+ *
+ * @path: absolute path of the file
+ * @stats: struct stat * of the file
+ *
+ * */
+static void check_file(struct toolsd_scan *scan, char *path,
+                       struct stat *stats) {
+    struct toolsd_file *file, *files;
+    uint32_t id;
+
+    file = find_file(path, scan->nr_sorted);
+
+    if (file) {
+        file->seen = 1;
+        id = file->file_id;
+
+        if (file->ino == stats->st_ino && file->size == stats->st_size &&
+            file->mtime.tv_sec == stats->st_mtim.tv_sec &&
+            file->mtime.tv_nsec == stats->st_mtim.tv_nsec &&
+            (id == TOOLSD_NO_ID || !(scan->stale[id >> 3] & (1 << (id & 7))))) {
+            return;
+        }
+
+        set_stale(scan, id);
+        file->file_id = TOOLSD_NO_ID;
+        add_pending(scan, file - toolsd_man.files, stats);
+        return;
+    }
+
+    if (toolsd_man.nr_files == toolsd_man.files_size) {
+        toolsd_man.files_size =
+            toolsd_man.files_size ? toolsd_man.files_size * 2 : 64;
+        files = realloc(toolsd_man.files,
+                        sizeof(struct toolsd_file) * toolsd_man.files_size);
+        if (!files) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        toolsd_man.files = files;
+    }
+
+    file = &toolsd_man.files[toolsd_man.nr_files];
+    memset(file, 0, sizeof(struct toolsd_file));
+    file->path = strdup(path);
+    file->file_id = TOOLSD_NO_ID;
+    file->seen = 1;
+
+    add_pending(scan, toolsd_man.nr_files++, stats);
+}
+
+/*
+ * Scan a directory recursively for new, changed and deleted files
+ *
+ * @path: absolute path of the directory
+ *
+ * */
+static void scan_dir(struct control *ctrl, struct toolsd_scan *scan,
+                     char *path) {
+    struct dirent *dir;
+    struct stat stats;
+    char *sub_path;
+
+    DIR *directory = opendir(path);
+
+    if (!directory) {
+        WARN("Failed opening dir %s\n", path);
+        return;
+    }
+
+    while ((dir = readdir(directory)) != NULL) {
+        if (strcmp(dir->d_name, ".") == 0 || strcmp(dir->d_name, "..") == 0) {
+            continue;
+        }
+
+        sub_path = malloc(strlen(path) + strlen(dir->d_name) + 2);
+        if (!sub_path) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        sprintf(sub_path, "%s/%s", path, dir->d_name);
+
+        // The file could have been deleted in the meantime.
+        if (lstat(sub_path, &stats) == 0) {
+            if (S_ISDIR(stats.st_mode)) {
+                scan_dir(ctrl, scan, sub_path);
+            } else if (S_ISREG(stats.st_mode)) {
+                check_file(scan, sub_path, &stats);
+            }
+        }
+
+        free(sub_path);
+    }
+
+    closedir(directory);
+}
+
+static void clear_extent_list(struct toolsd_file *file) {
+    free(file->extents);
+    file->extents = NULL;
+    file->nr_extents = 0;
+    file->extents_size = 0;
+}
+
+/*
+ * Keep each extent of the file being mapped in its extent list, see
+ * extent_added in struct control.
+ *
+ * */
+static void add_mapped_extent(struct control *ctrl, struct extent *extent) {
+    struct toolsd_file *file = toolsd_man.mapping;
+    struct extent **extents;
+
+    (void)ctrl;
+
+    if (file->nr_extents == file->extents_size) {
+        file->extents_size = file->extents_size ? file->extents_size * 2 : 16;
+        extents = realloc(file->extents,
+                          sizeof(struct extent *) * file->extents_size);
+        if (!extents) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        file->extents = extents;
+    }
+
+    file->extents[file->nr_extents++] = extent;
+}
+
+static int compare_extent_pbas(const void *a, const void *b) {
+    uint64_t pbas_a = (*(struct extent **)a)->phy_blk;
+    uint64_t pbas_b = (*(struct extent **)b)->phy_blk;
+
+    return (pbas_a > pbas_b) - (pbas_a < pbas_b);
+}
+
+/*
+ * Map the extents of a file into the zonemap, and record the stat() values
+ * it is mapped at.
+ *
+ * @file: struct toolsd_file * of the file to map
+ * @stats: struct stat * of the file
+ *
+ * */
+static void map_file(struct control *ctrl, struct toolsd_file *file,
+                     struct stat *stats) {
+    char **paths;
+    uint32_t nr_paths;
+    int fd;
+
+    file->ino = stats->st_ino;
+    file->size = stats->st_size;
+    file->mtime = stats->st_mtim;
+    file->file_id = TOOLSD_NO_ID;
+    clear_extent_list(file);
+
+    /* FIEMAP does not report any extents for files without blocks */
+    if (stats->st_blocks == 0) {
+        return;
+    }
+
+    fd = open(file->path, O_RDONLY);
+    if (fd < 0) {
+        /* deleted in the meantime, the next refresh drops the file */
+        INFO(1, "Failed opening %s\n", file->path);
+        return;
+    }
+
+    if (toolsd_man.nr_file_paths <= ctrl->nr_files) {
+        nr_paths = (ctrl->nr_files + 1) * 2;
+        paths = realloc(toolsd_man.file_paths, sizeof(char *) * nr_paths);
+        if (!paths) {
+            ERR_MSG("Failed memory allocation\n");
+        }
+        memset(paths + toolsd_man.nr_file_paths, 0,
+               sizeof(char *) * (nr_paths - toolsd_man.nr_file_paths));
+        toolsd_man.file_paths = paths;
+        toolsd_man.nr_file_paths = nr_paths;
+    }
+
+    file->file_id = ctrl->nr_files;
+    toolsd_man.mapping = file;
+
+    if (get_extents(ctrl, file->path, fd, stats) == EXIT_FAILURE) {
+        WARN("Failed retrieving extents for %s\n", file->path);
+
+        /* keep fileIDs unique, the next refresh maps the file again */
+        ctrl->nr_files = file->file_id + 1;
+        file->mtime.tv_sec = 0;
+        file->mtime.tv_nsec = 0;
+    }
+
+    toolsd_man.file_paths[file->file_id] = file->path;
+    /* extents arrive in logical order, queries list them in zone order */
+    qsort(file->extents, file->nr_extents, sizeof(struct extent *),
+          compare_extent_pbas);
+
+    close(fd);
+}
+
+/*
+ * Map all files again, starting at fileID 0. Each remapped or removed file
+ * leaves its fileID unused, and the tables indexed by fileID (file counters,
+ * paths, and the bitmaps of each refresh and query) grow with them. Compacting
+ * once most fileIDs are unused keeps these at most twice the mapped files,
+ * independent of how many files were changed since the start.
+ *
+ * */
+static void compact_file_ids(struct control *ctrl) {
+    struct toolsd_file *file;
+    struct stat stats;
+
+    clear_file_extents(ctrl);
+    free(toolsd_man.file_paths);
+    toolsd_man.file_paths = NULL;
+    toolsd_man.nr_file_paths = 0;
+
+    for (uint32_t i = 0; i < toolsd_man.nr_files; i++) {
+        file = &toolsd_man.files[i];
+        clear_extent_list(file);
+        if (file->file_id == TOOLSD_NO_ID) {
+            continue;
+        }
+
+        if (lstat(file->path, &stats) < 0) {
+            /* deleted in the meantime, the next refresh drops the file */
+            file->file_id = TOOLSD_NO_ID;
+            continue;
+        }
+        map_file(ctrl, file, &stats);
+    }
+
+    INFO(1, "Compacted fileIDs of %s: %u fileIDs in use\n", toolsd_man.dir,
+         ctrl->nr_files);
+}
+
+/*
+ * Refresh the mappings incrementally. The zone reports are updated, and only
+ * files that are new, changed, or located in zones that were reset since the
+ * last refresh are mapped again. Extents of deleted files are removed.
+ *
+ * */
+static void refresh(struct control *ctrl) {
+    struct toolsd_scan scan;
+    struct f2fs_sb_info *sbi;
+    struct toolsd_zone_state *states;
+    struct zone *zone;
+    uint32_t i, kept = 0;
+
+    memset(&scan, 0, sizeof(struct toolsd_scan));
+    scan.nr_sorted = toolsd_man.nr_files;
+    scan.stale = calloc((ctrl->nr_files + 8) >> 3, 1);
+    states = malloc(sizeof(struct toolsd_zone_state) * ctrl->zonemap->nr_zones);
+    if (!scan.stale || !states) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    for (i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        states[i].start = ctrl->zonemap->zones[i].start;
+        states[i].wp = ctrl->zonemap->zones[i].wp;
+        states[i].state = ctrl->zonemap->zones[i].state;
+    }
+
+    /* the daemon keeps running if a report fails, the zones of the device are
+     * then kept, and compared against at the next refresh */
+    update_zone_map(ctrl);
+
+    /* a reset followed by writes past the prior WP within one interval only
+     * shows as a WP increase, hence zones with any change are mapped again */
+    for (i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        zone = &ctrl->zonemap->zones[i];
+        if (zone->wp != states[i].wp || zone->state != states[i].state ||
+            zone->start != states[i].start) {
+            set_zone_stale(ctrl, &scan, i);
+        }
+    }
+    free(states);
+
+    scan_dir(ctrl, &scan, toolsd_man.dir);
+
+    toolsd_man.last_removed = 0;
+    for (i = 0; i < scan.nr_sorted; i++) {
+        if (!toolsd_man.files[i].seen) {
+            set_stale(&scan, toolsd_man.files[i].file_id);
+            toolsd_man.last_removed++;
+        }
+    }
+
+    if (scan.nr_stale > 0) {
+        remove_file_extents(ctrl, scan.stale);
+    }
+
+    /* segment types of the remapped extents come from the current procfs */
+    if (scan.nr_pending > 0 && ctrl->procfs) {
+        sbi = ctrl->fs_super_block;
+        ctrl->fs_manager_cleanup(ctrl->fs_manager);
+        ctrl->fs_manager = f2fs_fs_manager_init(sbi, ctrl->bdev.dev_name);
+        ctrl->fs_info_bytes = ctrl->fs_manager ? get_fs_info_bytes() : 0;
+    }
+
+    for (i = 0; i < scan.nr_pending; i++) {
+        map_file(ctrl, &toolsd_man.files[scan.pending[i].file],
+                 &scan.pending[i].stats);
+    }
+    toolsd_man.last_mapped = scan.nr_pending;
+
+    for (i = 0; i < toolsd_man.nr_files; i++) {
+        if (!toolsd_man.files[i].seen) {
+            free(toolsd_man.files[i].path);
+            clear_extent_list(&toolsd_man.files[i]);
+            continue;
+        }
+
+        toolsd_man.files[i].seen = 0;
+        toolsd_man.files[kept++] = toolsd_man.files[i];
+    }
+    toolsd_man.nr_files = kept;
+
+    for (i = 0, kept = 0; i < toolsd_man.nr_files; i++) {
+        kept += toolsd_man.files[i].file_id != TOOLSD_NO_ID;
+    }
+    if (ctrl->nr_files >= TOOLSD_COMPACT_MIN && ctrl->nr_files - kept > kept) {
+        compact_file_ids(ctrl);
+    }
+
+    qsort(toolsd_man.files, toolsd_man.nr_files, sizeof(struct toolsd_file),
+          compare_file_paths);
+
+    if (toolsd_man.shm) {
+        shm_zonemap_publish(ctrl, toolsd_man.shm);
+    }
+
+    toolsd_man.nr_refreshes++;
+    toolsd_man.last_refresh = time(NULL);
+
+    INFO(1, "Refreshed %s: %u files mapped, %u files removed\n",
+         toolsd_man.dir, toolsd_man.last_mapped, toolsd_man.last_removed);
+
+    free(scan.pending);
+    free(scan.stale);
+}
+
+/*
+ * Respond with the extents of a file, in the order of the zones
+ *
+ * @path: absolute path of the file
+ *
+ * */
+static void query_extents(struct control *ctrl, char *path) {
+    struct toolsd_file *file;
+    struct extent *extent;
+    uint64_t ext_ctr = 0, size = 0;
+    uint32_t zone_ctr = 0, zone = UINT32_MAX;
+
+    (void)ctrl;
+
+    file = find_file(path, toolsd_man.nr_files);
+    if (!file) {
+        REP_LIT(SERVER_ERROR);
+        rep_str(path, 0);
+        REP_LIT(" is not mapped\n");
+        return;
+    }
+
+    REP_LIT("FILE: ");
+    rep_str(path, 0);
+    REP_LIT("\n");
+
+    for (uint32_t i = 0; i < file->nr_extents; i++) {
+        extent = file->extents[i];
+
+        REP_LIT("EXTID: ");
+        rep_dec(extent->ext_nr + 1, -4);
+        REP_LIT("  ZONE: ");
+        rep_dec(extent->zone, -6);
+        REP_LIT("  PBAS: ");
+        rep_hex(extent->phy_blk, -10);
+        REP_LIT("  PBAE: ");
+        rep_hex(extent->phy_blk + extent->len, -10);
+        REP_LIT("  SIZE: ");
+        rep_hex(extent->len, 0);
+        REP_LIT("\n");
+
+        ext_ctr++;
+        size += extent->len;
+        zone_ctr += extent->zone != zone;
+        zone = extent->zone;
+    }
+
+    REP_LIT("NOE: ");
+    rep_dec(ext_ctr, -6);
+    REP_LIT("  TES: ");
+    rep_hex(size, -10);
+    REP_LIT("  NOZ: ");
+    rep_dec(zone_ctr, 0);
+    REP_LIT("\n");
+}
+
+/*
+ * Respond with the zone information and the files with extents in the zone
+ *
+ * @arg: number of the zone
+ *
+ * */
+static void query_zone(struct control *ctrl, char *arg) {
+    struct zone *zone;
+    struct node *current;
+    uint32_t *ext_ctrs, *order, nr_files = 0;
+    uint64_t *sizes;
+    unsigned long zone_number;
+    char *end;
+    uint32_t id;
+
+    errno = 0;
+    zone_number = strtoul(arg, &end, 10);
+    if (errno || *end != '\0' || end == arg ||
+        zone_number >= ctrl->zonemap->nr_zones) {
+        REP_LIT(SERVER_ERROR "invalid zone ");
+        rep_str(arg, 0);
+        REP_LIT("\n");
+        return;
+    }
+    zone = &ctrl->zonemap->zones[zone_number];
+
+    REP_LIT("============ ZONE ");
+    rep_dec(zone_number, 0);
+    REP_LIT(" ============\nDEV: ");
+    rep_str(get_zone_dev(ctrl, zone_number)->dev_name, 0);
+    REP_LIT("  LBAS: ");
+    rep_hex_zero(zone->start, 6);
+    REP_LIT("  LBAE: ");
+    rep_hex_zero(zone->end, 6);
+    REP_LIT("  CAP: ");
+    rep_hex_zero(zone->capacity, 6);
+    REP_LIT("  WP: ");
+    rep_hex_zero(zone->wp, 6);
+    REP_LIT("  STATE: ");
+    rep_hex(zone->state, 0);
+    REP_LIT("\nEXTENTS: ");
+    rep_dec(zone->extent_ctr, 0);
+    REP_LIT("\n");
+
+    ext_ctrs = calloc(ctrl->nr_files + 1, sizeof(uint32_t));
+    order = calloc(ctrl->nr_files + 1, sizeof(uint32_t));
+    sizes = calloc(ctrl->nr_files + 1, sizeof(uint64_t));
+    if (!ext_ctrs || !order || !sizes) {
+        ERR_MSG("Failed memory allocation\n");
+    }
+
+    /* files in the order of their first extent in the zone */
+    for (current = zone->extents_head; current; current = current->next) {
+        id = current->extent->fileID;
+        if (ext_ctrs[id]++ == 0) {
+            order[nr_files++] = id;
+        }
+        sizes[id] += current->extent->len;
+    }
+
+    for (uint32_t i = 0; i < nr_files; i++) {
+        id = order[i];
+
+        REP_LIT("EXTENTS: ");
+        rep_dec(ext_ctrs[id], -6);
+        REP_LIT("  SIZE: ");
+        rep_hex(sizes[id], -10);
+        REP_LIT("  FILE: ");
+        rep_str(toolsd_man.file_paths[id] ? toolsd_man.file_paths[id]
+                                          : "<unknown>",
+                0);
+        REP_LIT("\n");
+    }
+
+    free(ext_ctrs);
+    free(order);
+    free(sizes);
+}
+
+/*
+ * Respond with the statistics of all mapped files
+ *
+ * */
+static void query_stats(struct control *ctrl) {
+    uint32_t zone_ctr = 0;
+
+    for (uint32_t i = 0; i < ctrl->zonemap->nr_zones; i++) {
+        zone_ctr += ctrl->zonemap->zones[i].extent_ctr > 0;
+    }
+
+    REP_LIT("DIR: ");
+    rep_str(toolsd_man.dir, 0);
+    REP_LIT("\nDEVICES:");
+    for (uint8_t i = 0; i < ctrl->nr_znsdevs; i++) {
+        REP_LIT(" ");
+        rep_str(ctrl->znsdev[i].dev_name, 0);
+    }
+    REP_LIT("\nFILES: ");
+    rep_dec(toolsd_man.nr_files, 0);
+    REP_LIT("\nEXTENTS: ");
+    rep_dec(ctrl->zonemap->extent_ctr, -10);
+    REP_LIT("  TES: ");
+    rep_hex(ctrl->zonemap->cum_extent_size, 0);
+    REP_LIT("\nZONES: ");
+    rep_dec(zone_ctr, 0);
+    REP_LIT(" of ");
+    rep_dec(ctrl->zonemap->nr_zones, 0);
+    REP_LIT(" zones hold extents\nINLINED EXTENTS: ");
+    rep_dec(ctrl->inlined_extent_ctr, 0);
+    REP_LIT("\nREFRESHES: ");
+    rep_dec(toolsd_man.nr_refreshes, 0);
+    REP_LIT("  LAST: ");
+    rep_dec(time(NULL) - toolsd_man.last_refresh, 0);
+    REP_LIT("s ago  MAPPED: ");
+    rep_dec(toolsd_man.last_mapped, 0);
+    REP_LIT("  REMOVED: ");
+    rep_dec(toolsd_man.last_removed, 0);
+    REP_LIT("\n\n");
+
+    print_size_hist(&ctrl->zonemap->extent_hist, &ctrl->zonemap->hole_hist);
+}
+
+/*
+ * Read a query from the client and write the response back to it
+ *
+ * @fd: connection to the client
+ *
+ * */
+static void handle_client(struct control *ctrl, int fd) {
+    struct timeval tv = {.tv_sec = TOOLSD_RECV_TIMEOUT};
+    char query[SERVER_MAX_QUERY];
+    size_t len = 0;
+    ssize_t ret;
+    char *arg;
+
+    /* don't block other clients on a client that never sends its query, or
+     * stops reading the response */
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    tv.tv_sec = TOOLSD_SEND_TIMEOUT;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    while (len < sizeof(query) - 1 && !memchr(query, '\n', len)) {
+        ret = read(fd, query + len, sizeof(query) - 1 - len);
+        if (ret <= 0) {
+            break;
+        }
+        len += ret;
+    }
+    query[len] = '\0';
+    query[strcspn(query, "\n")] = '\0';
+
+    arg = strchr(query, ' ');
+    if (arg) {
+        *arg++ = '\0';
+    }
+
+    INFO(2, "Query: %s %s\n", query, arg ? arg : "");
+
+    rep_set_fd(fd);
+
+    if (strcmp(query, "extents") == 0 && arg) {
+        query_extents(ctrl, arg);
+    } else if (strcmp(query, "zone") == 0 && arg) {
+        query_zone(ctrl, arg);
+    } else if (strcmp(query, "stats") == 0) {
+        query_stats(ctrl);
+    } else if (strcmp(query, "refresh") == 0) {
+        refresh(ctrl);
+        query_stats(ctrl);
+    } else {
+        REP_LIT(SERVER_ERROR "unknown query ");
+        rep_str(query, 0);
+        REP_LIT("\n");
+    }
+
+    /* writes the response to the client */
+    rep_set_fd(-1);
+}
+
+/*
+ * Create the Unix socket of the daemon, replacing a stale socket file
+ *
+ * returns: fd of the listening socket
+ *
+ * */
+static int init_socket() {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(toolsd_man.socket) >= sizeof(addr.sun_path)) {
+        ERR_MSG("Socket path %s is too long\n", toolsd_man.socket);
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ERR_MSG("Failed creating socket\n");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, toolsd_man.socket);
+
+    unlink(toolsd_man.socket);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ERR_MSG("Failed binding socket %s\n", toolsd_man.socket);
+    }
+
+    if (listen(fd, SOMAXCONN) < 0) {
+        ERR_MSG("Failed listening on socket %s\n", toolsd_man.socket);
+    }
+
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    struct control *ctrl;
+    struct f2fs_sb_info *sbi;
+    struct stat stats;
+    struct sigaction sa;
+    struct pollfd pfd;
+    char *dir = NULL;
+    int c, fd, listen_fd, timeout;
+
+    ctrl = alloc_ctrl();
+    ctrl->exclude_flags = FIEMAP_EXTENT_DATA_INLINE;
+    ctrl->argv = argv[0];
+    ctrl->extent_added = add_mapped_extent;
+    toolsd_man.socket = ZNS_TOOLSD_SOCKET;
+    toolsd_man.refresh_interval = TOOLSD_REFRESH_INTERVAL;
+
+    while ((c = getopt(argc, argv, "d:hl:m:pr:s:")) != -1) {
+        switch (c) {
+        case 'h':
+            show_help();
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        case 'l':
+            ctrl->log_level = atoi(optarg);
+            break;
+        case 'm':
+            toolsd_man.shm_name = optarg;
+            break;
+        case 'p':
+            ctrl->procfs = 1;
+            break;
+        case 'r':
+            toolsd_man.refresh_interval = atoi(optarg);
+            break;
+        case 's':
+            toolsd_man.socket = optarg;
+            break;
+        default:
+            show_help();
+            abort();
+        }
+    }
+
+    if (!dir) {
+        ERR_MSG("Missing directory -d flag.\n");
+    }
+
+    /* clients query files by their absolute path */
+    toolsd_man.dir = realpath(dir, NULL);
+    if (!toolsd_man.dir || stat(toolsd_man.dir, &stats) < 0 ||
+        !S_ISDIR(stats.st_mode)) {
+        ERR_MSG("%s is not a directory\n", dir);
+    }
+
+    fd = open(toolsd_man.dir, O_RDONLY);
+    init_ctrl(ctrl, toolsd_man.dir, fd, &stats);
+    close(fd);
+
+    if (!ctrl->zonemap) {
+        ERR_MSG("%s is not on a supported file system\n", toolsd_man.dir);
+    }
+
+    if (ctrl->fs_magic == F2FS_MAGIC && ctrl->procfs) {
+        sbi = ctrl->fs_super_block;
+        ctrl->fs_manager = f2fs_fs_manager_init(sbi, ctrl->bdev.dev_name);
+        ctrl->fs_manager_cleanup =
+            (fs_manager_cleanup)f2fs_fs_manager_cleanup(ctrl->bdev.dev_name);
+        ctrl->fs_info_init = (fs_info_init)f2fs_fs_info_init();
+        ctrl->fs_info_show = (fs_info_show)f2fs_fs_info_show();
+        ctrl->fs_info_cleanup = (fs_info_cleanup)f2fs_fs_info_cleanup();
+    } else {
+        ctrl->procfs = 0;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = toolsd_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    /* clients closing the connection early must not terminate the daemon */
+    signal(SIGPIPE, SIG_IGN);
+
+    if (toolsd_man.shm_name) {
+        toolsd_man.shm =
+            shm_zonemap_create(toolsd_man.shm_name, ctrl->zonemap->nr_zones);
+        if (!toolsd_man.shm) {
+            ERR_MSG("Failed creating shared memory %s: %s\n",
+                    toolsd_man.shm_name, strerror(errno));
+        }
+    }
+
+    refresh(ctrl);
+
+    listen_fd = init_socket();
+    INFO(1, "Listening on %s\n", toolsd_man.socket);
+
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+
+    while (!toolsd_stop) {
+        timeout = -1;
+        if (toolsd_man.refresh_interval > 0) {
+            timeout = toolsd_man.last_refresh + toolsd_man.refresh_interval -
+                      time(NULL);
+            if (timeout <= 0) {
+                refresh(ctrl);
+                continue;
+            }
+            timeout *= 1000;
+        }
+
+        /* interrupted by a signal or the refresh interval passed */
+        if (poll(&pfd, 1, timeout) <= 0) {
+            continue;
+        }
+
+        fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+
+        handle_client(ctrl, fd);
+        close(fd);
+    }
+
+    close(listen_fd);
+    unlink(toolsd_man.socket);
+
+    if (toolsd_man.shm) {
+        shm_zonemap_destroy(toolsd_man.shm_name, toolsd_man.shm);
+    }
+
+    for (uint32_t i = 0; i < toolsd_man.nr_files; i++) {
+        free(toolsd_man.files[i].path);
+        clear_extent_list(&toolsd_man.files[i]);
+    }
+    free(toolsd_man.files);
+    free(toolsd_man.file_paths);
+    free(toolsd_man.dir);
+    cleanup_ctrl(ctrl);
+
+    return EXIT_SUCCESS;
+}
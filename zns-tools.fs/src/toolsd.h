@@ -0,0 +1,79 @@
+#ifndef _TOOLSD_H_
+#define _TOOLSD_H_
+
+#include "server.h"
+#include "shm.h"
+#include "zns-tools.h"
+
+#include <dirent.h>
+#include <time.h>
+
+#define TOOLSD_REFRESH_INTERVAL 10  /* default seconds between refreshes */
+#define TOOLSD_NO_ID UINT32_MAX     /* file_id of files without extents */
+#define TOOLSD_RECV_TIMEOUT 1       /* seconds to wait for a query */
+#define TOOLSD_SEND_TIMEOUT 1       /* seconds to wait for a client to read */
+#define TOOLSD_COMPACT_MIN 1024     /* fileIDs before dead ones are compacted */
+
+/*
+ * A file of the mapped directory, with the stat() values it was mapped at to
+ * detect changes on a refresh.
+ *
+ * */
+struct toolsd_file {
+    char *path;              /* absolute path of the file */
+    ino_t ino;               /* inode number of the file when it was mapped */
+    off_t size;              /* size of the file when it was mapped */
+    struct timespec mtime;   /* modification time of the file when mapped */
+    uint32_t file_id;        /* fileID of the extents in the zonemap */
+    uint8_t seen;            /* flag if the file was seen in the current scan */
+    struct extent **extents; /* extents of the file in the zonemap, in PBAS
+                                order, such that queries need no zone walk */
+    uint32_t nr_extents;     /* number of extents in *extents */
+    uint32_t extents_size;   /* number of allocated entries in *extents */
+};
+
+/* file of a scan, to be (re)mapped after the stale extents are removed */
+struct toolsd_pending {
+    uint32_t file;     /* index of the file in toolsd_manager files */
+    struct stat stats; /* stat() of the file during the scan */
+};
+
+/*
+ * State of a refresh scan of the directory
+ *
+ * */
+struct toolsd_scan {
+    uint8_t *stale;                 /* bitmap of fileIDs with stale extents */
+    uint32_t nr_stale;              /* number of bits set in stale */
+    uint32_t nr_sorted;             /* sorted files at the start of the table */
+    struct toolsd_pending *pending; /* files to map */
+    uint32_t nr_pending;            /* number of files in *pending */
+    uint32_t pending_size;          /* number of allocated entries in pending */
+};
+
+struct toolsd_manager {
+    char *dir;                 /* absolute path of the mapped directory */
+    char *socket;              /* path of the Unix socket to listen on */
+    uint32_t refresh_interval; /* seconds between refreshes */
+    struct toolsd_file *files; /* mapped files, sorted by path after a scan */
+    uint32_t nr_files;         /* number of files in *files */
+    uint32_t files_size;       /* number of allocated entries in *files */
+    char **file_paths;         /* path of each fileID, NULL once removed */
+    uint32_t nr_file_paths;    /* number of allocated entries in file_paths */
+    uint64_t nr_refreshes;     /* number of refreshes since the start */
+    time_t last_refresh;       /* time of the last refresh */
+    uint32_t last_mapped;      /* files (re)mapped in the last refresh */
+    uint32_t last_removed;     /* files removed in the last refresh */
+    char *shm_name;            /* shared memory segment of the summary */
+    struct shm_zonemap *shm;   /* published zonemap summary, if enabled */
+    struct toolsd_file *mapping; /* file being mapped by map_file() */
+};
+
+/* zone report values that change when a zone is written or reset */
+struct toolsd_zone_state {
+    uint64_t start; /* PBAS of the zone */
+    uint64_t wp;    /* write pointer of the zone */
+    uint8_t state;  /* condition of the zone */
+};
+
+#endif
@@ -21,15 +21,19 @@ NR_ZONES = 0
 # Latency is stored in nsec, convert to μsec (change to 10**6 for msec)
 LAT_CONV = 10**3
 VMAX = 30
+# Percentile of the histograms of zns.nvmetrace (z_size_hist and z_lat_hist)
+PERCENTILE = 99
+# 121 (zone management send) holds the zone reset latencies of zns.nvmetrace
+HIST_OPS = {1: "write", 2: "read", 121: "reset", 125: "append"}
 
 
 def main(argv):
     try:
         opts, args = getopt.getopt(
-            argv, "hs:z:v:", ["vmax=", "zone_size=", "nr_zones="])
+            argv, "hs:z:v:p:", ["vmax=", "zone_size=", "nr_zones=", "percentile="])
     except getopt.GetoptError:
         print(
-            'Error. Usage: plot.py -s [ZONE_SIZE (in 512B sectors)] [-z NR_ZONES] [-v MAX_VAL]')
+            'Error. Usage: plot.py -s [ZONE_SIZE (in 512B sectors)] [-z NR_ZONES] [-v MAX_VAL] [-p PERCENTILE]')
         sys.exit(2)
     for opt, arg in opts:
         if opt == '-h':
@@ -46,6 +50,9 @@ def main(argv):
             global VMAX
             print(arg)
             VMAX = int(arg)
+        elif opt in ("-p", "--percentile"):
+            global PERCENTILE
+            PERCENTILE = float(arg)
 
 
 def plot_z_op_map(data, type):
@@ -294,6 +301,191 @@ def plot_avg_io_size(data, counter):
     plt.clf()
 
 
+def plot_z_lat_map(data, counter):
+    """
+    Plot the average completion latency of reads and writes (including appends)
+    of each zone, as read-lat and write-lat heatmaps
+    """
+
+    dimension = math.floor(NR_ZONES ** 0.5)
+    remainder = NR_ZONES - (dimension ** 2)
+    if remainder != 0:
+        dimension += 1
+
+    for op in ["read", "write"]:
+        plt_data = np.zeros(shape=(dimension, dimension))
+        plt_data[plt_data == 0] = -1
+
+        difference = abs(NR_ZONES - dimension ** 2)
+        for val in range(difference):
+            plt_data[-1 - val//dimension, -1 - val%dimension] = None
+
+        for key, entry in data.items():
+            if key >= dimension ** 2 or op not in entry:
+                continue
+            x_ind = key % dimension
+            plt_data[math.floor(key/dimension)][x_ind] = entry[op] / \
+                counter[key][op] / LAT_CONV
+
+        cmap = sns.color_palette('rocket_r', as_cmap=True).copy()
+        cmap.set_under('#88CCEE')
+        unit = "μsec" if LAT_CONV == 10**3 else "msec"
+        ax = sns.heatmap(plt_data, linewidth=0.1, xticklabels=False, cmap=cmap, mask=(plt_data == None), yticklabels=False, clip_on=False, cbar_kws={
+                         'shrink': 0.8, 'extend': 'min', 'extendrect': True, 'format': f'%d {unit}'}, square=True, cbar=True, vmin=0)
+        ax.set_facecolor("white")
+        plt.ylim(0, dimension)
+        plt.xlim(0, dimension)
+
+        plt.savefig(
+            f"{file_path}/figs/{file_name}/{op}-lat-heatmap.pdf", bbox_inches="tight")
+        plt.title(f"avg {op} latency")
+        plt.savefig(
+            f"{file_path}/figs/{file_name}/{op}-lat-heatmap.png", bbox_inches="tight")
+        plt.clf()
+
+
+def parse_op_line(line, op_map):
+    """
+    Parse a line of a map indexed by zlbas and nvme_command, such as
+    "z_lat_map[zlbas, 1]: N", into op_map[zone_index]["write"] = N
+    """
+
+    key = line[line.index("[") + 1:line.index("]")].split(",")
+    zone_index = math.floor(int(key[0]) / ZONE_SIZE)
+    op = HIST_OPS[int(key[1])]
+
+    op_map.setdefault(zone_index, dict())[op] = int(
+        line.split(":")[1].strip())
+
+
+def hist_percentile(hist, percentile):
+    """
+    Get the percentile of a log2 histogram of zns.nvmetrace, as the upper bound
+    of the slot that contains it (slot i holds values of [2^i, 2^(i+1)))
+    """
+
+    total = sum(hist.values())
+    target = total * percentile / 100
+    count = 0
+    for slot in sorted(hist):
+        count += hist[slot]
+        if count >= target:
+            return 2 ** (slot + 1)
+
+    return 2 ** (max(hist) + 1)
+
+
+def plot_z_hist_percentile(data, type, unit):
+    """
+    Plot the percentile of z_size_hist or z_lat_hist for each zone, with a
+    heatmap of each operation (write, append, and read)
+    """
+
+    dimension = math.floor(NR_ZONES ** 0.5)
+    remainder = NR_ZONES - (dimension ** 2)
+    if remainder != 0:
+        dimension += 1
+
+    for op in HIST_OPS.values():
+        plt_data = np.zeros(shape=(dimension, dimension))
+        plt_data[plt_data == 0] = -1
+
+        difference = abs(NR_ZONES - dimension ** 2)
+        for val in range(difference):
+            plt_data[-1 - val//dimension, -1 - val%dimension] = None
+
+        found = False
+        for key, entry in data.items():
+            if key >= dimension ** 2 or op not in entry:
+                continue
+            x_ind = key % dimension
+            plt_data[math.floor(key/dimension)][x_ind] = hist_percentile(
+                entry[op], PERCENTILE)
+            found = True
+
+        if not found:
+            continue
+
+        cmap = sns.color_palette('rocket_r', as_cmap=True).copy()
+        cmap.set_under('#88CCEE')
+        ax = sns.heatmap(plt_data, linewidth=0.1, xticklabels=False, cmap=cmap, mask=(plt_data == None), yticklabels=False, clip_on=False, cbar_kws={
+                         'shrink': 0.8, 'extend': 'min', 'extendrect': True, 'format': f'%d {unit}'}, square=True, cbar=True, vmin=0)
+        ax.set_facecolor("white")
+        plt.ylim(0, dimension)
+        plt.xlim(0, dimension)
+
+        name = f"{op}-p{PERCENTILE:g}-{type}"
+        plt.savefig(
+            f"{file_path}/figs/{file_name}/{name}-heatmap.pdf", bbox_inches="tight")
+        plt.title(f"{type} {op} p{PERCENTILE:g}")
+        plt.savefig(
+            f"{file_path}/figs/{file_name}/{name}-heatmap.png", bbox_inches="tight")
+        plt.clf()
+
+
+def plot_zone_timeline(timeline_file):
+    """
+    Plot the timeline of zns.nvmetrace: the open and active zones over time,
+    against the limits of the device, and the latency of each zone management
+    command
+    """
+
+    limits = dict()
+    rows = []
+    with open(timeline_file) as f:
+        for line in f:
+            if line.startswith("#"):
+                values = line[1:].split()
+                limits = dict(zip(values[0::2], map(int, values[1::2])))
+            elif not line.startswith("time_s"):
+                rows.append(line.strip().split(","))
+
+    if len(rows) == 0:
+        return
+
+    fig, (ax_zones, ax_lat) = plt.subplots(2, 1, sharex=True, figsize=(10, 7))
+
+    time = [float(row[0]) for row in rows]
+    ax_zones.step(time, [int(row[4]) for row in rows], where="post", label="open")
+    ax_zones.step(time, [int(row[5]) for row in rows], where="post", label="active")
+    for limit, style in [("max_open_zones", "dotted"), ("max_active_zones", "dashed")]:
+        if limits.get(limit, 0) > 0:
+            ax_zones.axhline(limits[limit], color="red", linestyle=style, label=limit)
+    ax_zones.set_ylabel("Zones")
+    ax_zones.legend(loc="upper left", fontsize=10)
+
+    for event in ["reset", "open", "close", "finish"]:
+        points = [(float(row[0]), int(row[3]) / LAT_CONV) for row in rows if row[2] == event]
+        if len(points) > 0:
+            ax_lat.scatter(*zip(*points), s=8, label=event)
+    ax_lat.set_ylabel("Latency (μsec)" if LAT_CONV == 10**3 else "Latency (msec)")
+    ax_lat.set_xlabel("Time (sec)")
+    if len(ax_lat.collections) > 0:
+        ax_lat.set_yscale("log")
+        ax_lat.legend(loc="upper left", fontsize=10)
+
+    plt.savefig(
+        f"{file_path}/figs/{file_name}/zone-timeline.pdf", bbox_inches="tight")
+    plt.savefig(
+        f"{file_path}/figs/{file_name}/zone-timeline.png", bbox_inches="tight")
+    plt.close(fig)
+
+
+def parse_hist_line(line, hist):
+    """
+    Parse a histogram line of zns.nvmetrace, "z_lat_hist[zlbas, op, slot]: N",
+    into hist[zone_index][op][slot] = N
+    """
+
+    key = line[line.index("[") + 1:line.index("]")].split(",")
+    zone_index = math.floor(int(key[0]) / ZONE_SIZE)
+    op = HIST_OPS[int(key[1])]
+    slot = int(key[2])
+
+    hist.setdefault(zone_index, dict()).setdefault(op, dict())[
+        slot] = int(line.split(":")[1].strip())
+
+
 if __name__ == "__main__":
     main(sys.argv[1:])
     file_path = '/'.join(os.path.abspath(__file__).split('/')[:-1])
@@ -306,6 +498,9 @@ if __name__ == "__main__":
         sys.exit()
 
     for file in glob.glob(f"{file_path}/data/*"):
+        # timelines of zns.nvmetrace are plotted with their data file
+        if file.endswith(".timeline"):
+            continue
         z_counter = 0
         file_name = file.split('/')[-1]
 
@@ -319,10 +514,22 @@ if __name__ == "__main__":
             data["z_rw_ctr_map"] = dict()
             data["z_reset_ctr_map"] = dict()
             data["z_reset_lat_map"] = dict()
+            data["z_size_hist"] = dict()
+            data["z_lat_hist"] = dict()
+            data["z_lat_map"] = dict()
+            data["z_lat_ctr_map"] = dict()
             for line in data_file:
                 line = line[1:]
                 if "logging" in line:
                     pass
+                elif "z_size_hist" in line:
+                    parse_hist_line(line, data["z_size_hist"])
+                elif "z_lat_hist" in line:
+                    parse_hist_line(line, data["z_lat_hist"])
+                elif "z_lat_map" in line:
+                    parse_op_line(line, data["z_lat_map"])
+                elif "z_lat_ctr_map" in line:
+                    parse_op_line(line, data["z_lat_ctr_map"])
                 elif "reset_all_ctr" in line:
                     data["reset_all_ctr"] = int(line.split(" ")[-1])
                 elif "z_data_map" in line:
@@ -388,11 +595,25 @@ if __name__ == "__main__":
                     lat = int(line[1].split(":")[1].strip())
                     data["z_reset_lat_map"][zone_index][reset_cnt] = lat
 
+            # zns.nvmetrace keeps the sum and number of the reset latencies
+            # of each zone instead of every single one, use their average
+            for zone_index, entry in data["z_lat_map"].items():
+                if "reset" in entry:
+                    ctr = data["z_lat_ctr_map"][zone_index]["reset"]
+                    data["z_reset_lat_map"].setdefault(zone_index, dict())[
+                        "avg"] = entry["reset"] / ctr
+
             plot_z_op_map(data["z_data_map"], "z_data_map")
             plot_z_op_map(data["z_rw_ctr_map"], "z_rw_ctr_map")
             plot_z_reset_ctr_map(data["z_reset_ctr_map"])
             plot_z_reset_lat_map(data["z_reset_lat_map"])
             plot_avg_io_size(data["z_data_map"], data["z_rw_ctr_map"])
+            plot_z_lat_map(data["z_lat_map"], data["z_lat_ctr_map"])
+            # Only in traces of zns.nvmetrace
+            plot_z_hist_percentile(data["z_size_hist"], "z_size_hist", "Blocks (512B)")
+            plot_z_hist_percentile(data["z_lat_hist"], "z_lat_hist", "μsec")
+            if os.path.exists(f"{file}.timeline"):
+                plot_zone_timeline(f"{file}.timeline")
 
             print(f"{file} Total zone resets: {z_counter}")
             data.clear()